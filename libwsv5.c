@@ -35,15 +35,18 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <poll.h>
 #include <limits.h>
+#include <stdatomic.h>
+#include <ctype.h>
 
 /* Third-party dependencies */
 #include <libwebsockets.h>
 #include <openssl/sha.h>
 #include <openssl/evp.h>
-#include <openssl/bio.h>
-#include <openssl/buffer.h>
+#include <openssl/crypto.h>
+#include <openssl/rand.h>
 #include <cjson/cJSON.h>
 
 /* ============================================================================
@@ -53,21 +56,125 @@
 #define OBSWS_VERSION "1.0.0"                   /* Library version string */
 #define OBSWS_PROTOCOL_VERSION 1                /* OBS WebSocket protocol version (v5 uses RPC version 1) */
 
-/* Buffer sizing: 64KB is large enough for most OBS messages. Larger messages
-   (like scene lists with many scenes) might need bigger buffers, but this is
-   a reasonable default. We could make it dynamic, but that adds complexity.
-   The protocol itself doesn't define a max message size, so we have to choose. */
-#define OBSWS_DEFAULT_BUFFER_SIZE 65536         /* 64KB buffer for WebSocket messages */
+/* Buffer sizing: 64KB is large enough for most OBS messages, so it's the baseline
+   receive buffer. Larger messages (GetSceneItemList on big collections,
+   GetInputSettings, GetSourceScreenshot) grow the buffer by doubling, up to the
+   per-connection max_message_size from the config. The protocol itself doesn't
+   define a max message size, so the cap is the caller's choice. */
+#define OBSWS_DEFAULT_BUFFER_SIZE 65536         /* 64KB baseline buffer for WebSocket messages */
+#define OBSWS_DEFAULT_MAX_MESSAGE_SIZE (32u * 1024u * 1024u)  /* 32MB default reassembly cap */
 
-/* Pending requests tracking: We use a linked list to track requests waiting for
-   responses. 256 is a reasonable limit - you can have up to 256 requests in-flight
-   at once. In practice, most apps will have way fewer. We chose a limit to prevent
-   unbounded memory growth if something goes wrong and requests never complete. */
+/* After a large message the receive buffer stays grown for this long, so a burst
+   of big responses doesn't realloc on every message. Once the connection has
+   gone this long without needing the extra room, we shrink back to baseline. */
+#define OBSWS_RECV_SHRINK_IDLE_MS 10000
+
+/* Initial capacity of a connection's request deadline heap (doubles as needed) */
+#define OBSWS_DEADLINE_HEAP_INITIAL 64
+
+/* Waiting on futures that belong to external-loop connections means servicing
+   those connections ourselves. With several of them (or threaded ones mixed
+   in) we can't block in any single poll(), so we take turns in slices this long. */
+#define OBSWS_FUTURE_PUMP_MS 10
+
+/* Keep-alive RTT statistics are computed over this many most recent pongs */
+#define OBSWS_RTT_WINDOW 32
+
+/* External event loop mode: libwebsockets keeps a few timeouts of its own
+   (handshake, close) that we can't see, all with one-second granularity, so
+   obsws_next_timeout() never tells the application to sleep longer than this. */
+#define OBSWS_EXTERNAL_MAX_WAIT_MS 1000
+
+/* Recover the enclosing struct from a pointer to one of its members - used to
+   get from an lws timer or a queue node back to its connection */
+#define OBSWS_CONTAINER_OF(ptr, type, member) \
+    ((type *)(void *)((char *)(ptr) - offsetof(type, member)))
+
+/* Outbound frame pool: most requests (scene switches, mute toggles, visibility
+   changes) serialize to well under 512 bytes, so each connection keeps a small
+   stack of frames that size and reuses them instead of going to malloc for
+   every request. Bigger payloads get a one-off exact-size frame. */
+#define OBSWS_FRAME_POOL_PAYLOAD 512            /* Payload capacity of a pooled frame */
+#define OBSWS_FRAME_POOL_MAX 64                 /* Most idle frames kept per connection */
+
+/* permessage-deflate defaults: messages smaller than this aren't worth the
+   deflate header and CPU - a scene switch compresses to about the same size -
+   so they go out uncompressed (RSV1 clear), which RFC 7692 allows at any time. */
+#define OBSWS_DEFAULT_COMPRESSION_THRESHOLD 256
+#define OBSWS_DEFAULT_COMPRESSION_WINDOW_BITS 15
+
+/* Nesting limit for the requestData syntax check - same spirit as cJSON's own
+   limit, just lower, since OBS request parameters are never deeply nested. */
+#define OBSWS_JSON_MAX_DEPTH 128
+
+/* Pending request table: in-flight requests are spread by ID over this
+   many shards, each with its own lock, so the event thread matching a response
+   and callers adding or removing their own requests rarely meet on the same
+   mutex. Each shard is a chained hash table that starts with
+   OBSWS_REQUEST_BUCKETS buckets and doubles whenever it holds more requests
+   than buckets, keeping match, insert and remove O(1) however many are out. */
+#define OBSWS_REQUEST_SHARDS 8                  /* Must be a power of two */
+#define OBSWS_REQUEST_BUCKETS 16                /* Initial buckets per shard (power of two) */
+
+/* Pending request slab: request objects come from a per-connection pool of
+   slots whose mutex, condition variable and response struct are set up once
+   and then recycled through a lock-free free list. The pool grows a chunk of
+   slots at a time; past the last chunk, requests fall back to one-off
+   allocations, so there's no hard limit here. */
+#define OBSWS_REQUEST_SLAB_CHUNK 64             /* Slots added per growth step */
+#define OBSWS_REQUEST_SLAB_CHUNKS 64            /* Most chunks per connection (4096 slots) */
+
+/* Read coalescing (config.coalesce_reads): requests that went to OBS and can
+   share their response are found by hashing their type and requestData into
+   this many chains. Only requests still in flight are in there, so the chains
+   stay short. */
+#define OBSWS_COALESCE_BUCKETS 64               /* Must be a power of two */
+
+/* In-flight window defaults (config.max_in_flight / window_backlog): 256 is a
+   reasonable limit - you can have up to 256 requests in flight at once. In
+   practice, most apps will have way fewer. OBS answers requests one at a time,
+   so past this point more in flight only lengthens its queue (and its frame
+   times); the rest wait on our side, in a backlog of up to 1024 when
+   window_policy is OBSWS_WINDOW_QUEUE. */
 #define OBSWS_MAX_PENDING_REQUESTS 256
+#define OBSWS_DEFAULT_WINDOW_BACKLOG 1024
+
+/* Priority lanes: the share of writes bulk requests get, in percent, while
+   normal requests are also waiting (config.bulk_share). Capped short of 100,
+   which would leave normal traffic nothing while bulk has a backlog. */
+#define OBSWS_DEFAULT_BULK_SHARE 10
+#define OBSWS_MAX_BULK_SHARE 90
+
+/* Late responses: once a request has been cancelled or has timed out with a
+   response still owed, incoming MessagePack messages are checked for its ID
+   before they're decoded. OBS puts "requestId" first in a response, so only
+   this many leading bytes are looked at - enough for the envelope and the ID. */
+#define OBSWS_LATE_SCAN_BYTES 96
+
+/* Envelope pre-scan: the longest eventType copied out onto the stack. OBS's
+   event names are far shorter; a longer or escaped one takes the full-parse
+   path instead. */
+#define OBSWS_EVENT_TYPE_LENGTH 64
+
+/* obsws_send_request_raw() / obsws_send_request_cjson() take the caller's
+   word that requestData is a well-formed JSON object. Debug builds check it
+   anyway and turn a bad one away with OBSWS_ERROR_INVALID_PARAM, rather than
+   letting OBS close the connection over it. Define as 0 or 1 to override. */
+#ifndef OBSWS_VALIDATE_RAW_REQUESTS
+#ifdef NDEBUG
+#define OBSWS_VALIDATE_RAW_REQUESTS 0
+#else
+#define OBSWS_VALIDATE_RAW_REQUESTS 1
+#endif
+#endif
 
-/* UUIDs are exactly 36 characters (8-4-4-4-12 hex digits with dashes) plus null terminator.
-   We use these to match requests with their responses in the asynchronous protocol. */
-#define OBSWS_UUID_LENGTH 37
+/* Request IDs are 32 lowercase hex digits plus null terminator: a random
+   per-connection prefix (16 digits) followed by that connection's request
+   counter (16 digits). See request_id_format(). */
+#define OBSWS_REQUEST_ID_LENGTH 33
+
+/* A SHA256 digest in base64: 32 bytes -> 44 characters including padding */
+#define OBSWS_SHA256_B64_LENGTH 44
 
 /* OBS WebSocket v5 OpCodes - message type identifiers in the protocol.
    
@@ -83,43 +190,19 @@
    
    Batch operations (opcodes 8-9) let you send multiple requests in one message,
    but we don't use them in this library - each request is sent individually.
-   REIDENTIFY (opcode 3) is used if we lose connection and reconnect.
+   REIDENTIFY (opcode 3) changes session parameters (the event subscriptions) on a
+   live connection; OBS answers it with another IDENTIFIED.
 */
 
 #define OBSWS_OPCODE_HELLO 0                    /* Server: Initial greeting with auth info */
 #define OBSWS_OPCODE_IDENTIFY 1                 /* Client: Authentication and protocol agreement */
 #define OBSWS_OPCODE_IDENTIFIED 2               /* Server: Auth successful, ready for commands */
-#define OBSWS_OPCODE_REIDENTIFY 3               /* Client: Re-authenticate after reconnect */
+#define OBSWS_OPCODE_REIDENTIFY 3               /* Client: Change session parameters */
 #define OBSWS_OPCODE_EVENT 5                    /* Server: Something happened in OBS */
 #define OBSWS_OPCODE_REQUEST 6                  /* Client: Execute an operation in OBS */
 #define OBSWS_OPCODE_REQUEST_RESPONSE 7         /* Server: Result of a client request */
-#define OBSWS_OPCODE_REQUEST_BATCH 8            /* Client: Multiple requests at once (unused) */
-#define OBSWS_OPCODE_REQUEST_BATCH_RESPONSE 9   /* Server: Responses to batch (unused) */
-
-/* Event subscription flags - bitmask for which OBS event categories we subscribe to.
-   
-   The OBS WebSocket protocol lets you specify which events you want to receive. This
-   avoids bandwidth waste - if you don't care about media playback events, don't subscribe.
-   We subscribe to most categories by default (using a bitmask), but you could modify
-   this to be more selective if needed.
-   
-   We chose a bitmask (0x7FF for all) rather than subscribing/unsubscribing individually
-   because it's more efficient - one subscription message at connect-time instead of
-   many individual subscribe/unsubscribe messages.
-*/
-
-#define OBSWS_EVENT_GENERAL (1 << 0)        /* General OBS events (startup, shutdown) */
-#define OBSWS_EVENT_CONFIG (1 << 1)         /* Configuration change events */
-#define OBSWS_EVENT_SCENES (1 << 2)         /* Scene-related events (scene switched, etc) */
-#define OBSWS_EVENT_INPUTS (1 << 3)         /* Input source events (muted, volume changed) */
-#define OBSWS_EVENT_TRANSITIONS (1 << 4)    /* Transition events (transition started) */
-#define OBSWS_EVENT_FILTERS (1 << 5)        /* Filter events (filter added, removed) */
-#define OBSWS_EVENT_OUTPUTS (1 << 6)        /* Output events (recording started, streaming stopped) */
-#define OBSWS_EVENT_SCENE_ITEMS (1 << 7)    /* Scene item events (source added to scene) */
-#define OBSWS_EVENT_MEDIA_INPUTS (1 << 8)   /* Media playback events (media finished) */
-#define OBSWS_EVENT_VENDORS (1 << 9)        /* Vendor-specific extensions */
-#define OBSWS_EVENT_UI (1 << 10)            /* UI events (Studio Mode toggled) */
-#define OBSWS_EVENT_ALL 0x7FF               /* Subscribe to all event types */
+#define OBSWS_OPCODE_REQUEST_BATCH 8            /* Client: Multiple requests at once */
+#define OBSWS_OPCODE_REQUEST_BATCH_RESPONSE 9   /* Server: Responses to batch */
 
 /* ============================================================================
  * Internal Structures
@@ -131,9 +214,9 @@
    wait for the response before continuing. Instead, responses come back later with
    a request ID matching them to the original request.
    
-   This struct tracks one in-flight request. We keep a linked list of these, one for
-   each request waiting for a response. When a response arrives, we find the matching
-   pending_request by ID, populate the response field, and set completed=true. The
+   This struct tracks one in-flight request. We keep a hash table of these (see
+   request_shard_t), one for each request waiting for a response. When a response
+   arrives, we look up the matching pending_request by ID, populate the response field, and set completed=true. The
    thread that sent the request is waiting on the condition variable, so it wakes up
    and gets the response.
    
@@ -141,20 +224,273 @@
    thread waiting on a condition variable goes to sleep until the response arrives,
    at which point it's woken up. Much more efficient.
    
-   Why use a timestamp? For timeout detection. If a response never arrives (OBS crashed,
-   network died, etc.), we detect it by checking if the request is older than the timeout.
+   Why a deadline? For timeout detection. If a response never arrives (OBS crashed,
+   network died, etc.), the request fails with OBSWS_ERROR_TIMEOUT when its own
+   timeout_ms runs out. Deadlines are on CLOCK_MONOTONIC, so setting the wall clock
+   can't time requests out early or keep them waiting; see request_deadline_t.
+   
+   When the connection drops, idempotent requests (see request_is_idempotent) are
+   held and sent again, under the same ID, once the reconnect has re-identified.
+   Anything else fails straight away - OBS may or may not have run it, and running
+   it twice could start a second recording or toggle something back.
+   
+   Async requests (obsws_send_request_async) have nobody blocked on them, so the
+   event thread finishes the job: it times them out at their deadline, takes them
+   off the list once complete and runs their completion callback. The
+   obsws_future_t handed to the caller is the pending_request_t itself, kept
+   alive by a reference count - one reference for the list (dropped after the
+   callback), one for the future (dropped by obsws_future_free). Futures can be
+   waited on in groups (obsws_future_wait_any/all): each waiter hangs a link on
+   every future it watches, and completion signals them all.
 */
 
+/* A thread in obsws_future_wait_any/all. fired counts completions among the
+   futures it watches, so it can't miss one that lands between its check and
+   its sleep. */
+typedef struct future_waiter {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    unsigned fired;
+} future_waiter_t;
+
+typedef struct future_waiter_link {
+    future_waiter_t *waiter;
+    struct future_waiter_link *next;
+} future_waiter_link_t;
+
+struct request_slab;
+struct pending_request;
+
+/* A request type's lane, as set by obsws_set_request_priority() */
+typedef struct {
+    char *request_type;
+    obsws_priority_t priority;
+} priority_rule_t;
+
+/* A cancel token. The blocking requests sent with it hang off requests
+   (through pending_request_t.token_next) until they're freed, so cancelling
+   reaches each of them. Lock order: the token's mutex, then a request's. */
+struct obsws_cancel_token {
+    pthread_mutex_t mutex;                  /* Protects cancelled and requests */
+    bool cancelled;                         /* Set once, never cleared */
+    struct pending_request *requests;       /* Requests sent with it and not yet freed */
+};
+
 typedef struct pending_request {
-    char request_id[OBSWS_UUID_LENGTH];     /* Unique ID matching request to response */
+    char request_id[OBSWS_REQUEST_ID_LENGTH];     /* Unique ID matching request to response */
     obsws_response_t *response;             /* Response data populated when received */
     bool completed;                         /* Flag indicating response received */
+    obsws_error_t error;                    /* Transport-level failure (OBSWS_OK if none) */
+    bool data_tree_only;                    /* Library helpers: keep responseData as a tree, skip the text */
+    char *replay_type;                      /* Idempotent requests only: kept to resend after a reconnect */
+    char *replay_data;                      /* requestData to resend with it (may be NULL) */
+    bool held;                              /* Connection dropped - waiting to be replayed */
+    obsws_batch_result_t *batch_result;     /* Batches only: filled in from the opcode 9 response */
+    const obsws_batch_t *replay_batch;      /* Batches of idempotent requests: resend this after a reconnect */
+    const obsws_request_template_t *replay_template;  /* Blocking template sends: resend from this... */
+    const obsws_template_arg_t *replay_args;          /* ...and the caller's args, valid while it waits */
+    uint64_t deadline_ms;                   /* Monotonic time it times out at (from its timeout_ms) */
+    obsws_connection_t *conn;               /* Owning connection - only valid until completed */
+    
+    /* Cancellation (obsws_cancel / cancel tokens) */
+    atomic_bool cancelled;                  /* Completed by a cancel - read without the mutex by window_block() */
+    obsws_cancel_token_t *token;            /* Token it was sent with (NULL if none) */
+    struct pending_request *token_next;     /* Next request on the same token (under the token's mutex) */
+    
+    /* Async requests only */
+    bool async;                             /* Completed by the event thread - nobody waits on cond */
+    obsws_completion_callback_t callback;   /* Run once complete (may be NULL) */
+    void *callback_data;                    /* Passed to callback */
+    bool external;                          /* conn is external-loop: waiters must service it */
+    future_waiter_link_t *waiters;          /* Group waiters to signal on completion (under mutex) */
+    atomic_int refs;                        /* List + future handle; freed when it drops to 0 */
+    
+    uint64_t seq;                           /* Sequence number from the ID - picks shard and bucket */
+    struct pending_request *next;           /* Next request in the same hash bucket */
+    
+    /* Read coalescing (config.coalesce_reads). A leader went to OBS and sits in
+       the connection's coalesce registry; its followers didn't and complete
+       with a copy of its outcome. Links change under coalesce_mutex plus the
+       mutexes of the requests involved. */
+    char *coalesce_key;                     /* requestType '\0' requestData (NULL = never shared) */
+    size_t coalesce_key_len;                /* Bytes in coalesce_key */
+    uint32_t coalesce_hash;                 /* FNV-1a of coalesce_key - picks the registry chain */
+    bool coalesce_registered;               /* Leader: findable in the registry */
+    struct pending_request *coalesce_next;  /* Next leader in the same registry chain */
+    struct pending_request *leader;         /* Follower: whose response it shares */
+    struct pending_request *followers;      /* Leader: requests sharing its response */
+    struct pending_request *follower_next;  /* Next follower of the same leader */
+    
+    /* In-flight window (config.max_in_flight) */
+    bool window_slot;                       /* Holds one of the window's slots (under mutex) */
+    bool backlogged;                        /* Waiting in the backlog (changed under mutex and backlog_mutex) */
+    struct obsws_frame *backlog_frame;      /* Frame to send once it gets a slot */
+    uint64_t backlog_since_us;              /* Monotonic time it started waiting - for the wait stats */
+    struct pending_request *backlog_next;   /* Next request in the backlog */
+    obsws_priority_t lane;                  /* Priority lane its frames go in (see request_priority()) */
+    
+    /* === Kept Across Reuse ===
+       alloc_pending_request() zeroes everything above this point when it hands
+       out a recycled slot; these fields survive, which is what saves the
+       allocator and pthread init/destroy calls on every request. */
+    struct request_slab *slab;              /* Owning slab (NULL for a one-off allocation) */
+    uint32_t slot;                          /* Index within the slab */
+    _Atomic uint32_t free_next;             /* On the free list: next free slot index + 1 (0 = end) */
     pthread_mutex_t mutex;                  /* Protects the response/completed fields */
     pthread_cond_t cond;                    /* Waiting thread sleeps here until response arrives */
-    time_t timestamp;                       /* When request was created - used for timeout detection */
-    struct pending_request *next;           /* Linked list pointer to next pending request */
 } pending_request_t;
 
+/* An entry in a connection's deadline heap: a binary min-heap on deadline_ms
+   that the event thread pops from its deadline timer, so expiring requests
+   costs O(log n) each and nothing at all while none are due. Entries name
+   the request by sequence number rather than by pointer and are never
+   removed early - a request that completes first is simply not found when
+   its entry comes up. That keeps the completion path off the heap lock, and
+   since entries leave once their deadline passes, the heap only ever holds
+   requests sent within the last timeout period. */
+typedef struct {
+    uint64_t deadline_ms;                   /* Monotonic expiry time */
+    uint64_t seq;                           /* Request it belongs to */
+} request_deadline_t;
+
+/* Per-connection pool of pending_request_t slots. Slots live in chunks that
+   are never moved or freed while the slab exists, so a slot can be named by
+   its index. The free list is a Treiber stack of those indexes; the head
+   carries a tag that changes on every push and pop so a thread that was
+   preempted mid-pop can't be fooled by the same index coming back (ABA).
+   
+   The slab is reference counted - one for the connection, one for every slot
+   out on loan - because a future can outlive its connection and still has
+   to give its slot back somewhere. */
+typedef struct request_slab {
+    _Atomic uint64_t free_head;             /* Low 32 bits: free slot index + 1 (0 = empty); high: ABA tag */
+    pending_request_t *chunks[OBSWS_REQUEST_SLAB_CHUNKS];  /* OBSWS_REQUEST_SLAB_CHUNK slots each */
+    size_t chunk_count;                     /* Chunks allocated so far (under grow_mutex) */
+    pthread_mutex_t grow_mutex;             /* Serializes adding a chunk - the rare path */
+    atomic_int refs;                        /* Connection + slots in use */
+} request_slab_t;
+
+/* One shard of a connection's pending request table. Requests hang off their
+   bucket through pending_request_t.next; the shard is picked by the low bits
+   of the request's sequence number and the bucket by the bits above them.
+   Sequence numbers are handed out in order, so they spread evenly without
+   any hashing. */
+typedef struct {
+    pthread_mutex_t mutex;                  /* Protects buckets, bucket_count and count */
+    pending_request_t **buckets;            /* bucket_count chains */
+    size_t bucket_count;                    /* Power of two; doubles as the shard fills */
+    size_t count;                           /* Requests in this shard */
+} request_shard_t;
+
+/* Outbound send queue - frames waiting for the event thread to write them.
+   
+   libwebsockets is not designed for lws_write() to be called from arbitrary
+   threads while another thread sits in lws_service(). The safe pattern is to
+   only write from the LWS_CALLBACK_CLIENT_WRITEABLE callback on the service
+   thread. So callers build a complete frame (LWS_PRE headroom + payload),
+   push it onto this queue, and wake the service loop with lws_cancel_service().
+   The event thread then asks for a writable callback and drains the queue
+   there, one frame per callback as libwebsockets recommends.
+   
+   The queue is an intrusive multi-producer/single-consumer list (Vyukov style):
+   producers do one atomic exchange on the head and never take a lock, so 30+
+   threads issuing requests at the same time don't serialize on a send mutex.
+   Only the event thread pops. A producer that has swapped the head but not yet
+   linked its node leaves the queue briefly "in flux" - pop returns NULL and
+   the depth counter tells the consumer to come back on the next writable
+   callback.
+*/
+
+typedef struct obsws_queue_node {
+    _Atomic(struct obsws_queue_node *) next;   /* Next node (towards the head) */
+} obsws_queue_node_t;
+
+typedef struct {
+    _Atomic(obsws_queue_node_t *) head;     /* Producers append here (atomic exchange) */
+    obsws_queue_node_t *tail;               /* Consumer pops here (event thread only) */
+    obsws_queue_node_t stub;                /* Sentinel so the list is never truly empty */
+    atomic_size_t depth;                    /* Frames pushed but not yet popped */
+} obsws_mpsc_queue_t;
+
+/* One outbound WebSocket message. The payload starts at buf + LWS_PRE so the
+   frame can be handed to lws_write() as-is - libwebsockets writes the frame
+   header into the headroom in front of it. Requests are serialized straight
+   into that payload area (see the Request Serialization section), so there is
+   no intermediate string to copy from.
+   
+   Frames with cap == OBSWS_FRAME_POOL_PAYLOAD come from and go back to the
+   connection's frame pool; anything else is a one-off allocation. */
+typedef struct obsws_frame {
+    obsws_queue_node_t node;                /* Queue link - must stay first */
+    struct obsws_frame *pool_next;          /* Free list link while sitting in the pool */
+    char request_id[OBSWS_REQUEST_ID_LENGTH];     /* Request to fail if the write fails ("" if none) */
+    obsws_priority_t lane;                  /* Which send queue it goes in */
+    uint64_t queued_us;                     /* Monotonic time it was queued - for the lane stats */
+    size_t cap;                             /* Payload capacity behind the headroom */
+    size_t len;                             /* Payload length in bytes */
+    unsigned char buf[];                    /* LWS_PRE headroom followed by the payload */
+} obsws_frame_t;
+
+/* Event loop shard - one lws_context plus the thread that services it.
+   
+   By default every connection gets a private shard: its own context and its
+   own thread, exactly as before. A shared reactor (obsws_reactor_create) is
+   just a fixed array of shards, with many connections attached to each one.
+   That's how a controller talking to hundreds of OBS instances gets by with a
+   handful of threads instead of one thread and one context per instance.
+   
+   libwebsockets objects belonging to a context must only be touched from the
+   thread servicing it. So connections never attach or detach themselves from
+   a shared shard directly - they queue an op on the shard and wake it with
+   lws_cancel_service(), and the shard thread does the work between service
+   passes. Connections with frames to write are handed over the same way
+   through the lock-free ready queue, so a send on one connection doesn't make
+   the shard scan all of its other connections.
+*/
+
+typedef struct obsws_shard {
+    struct lws_context *context;            /* Context shared by every connection on this shard */
+    pthread_t thread;                       /* Thread running lws_service() for the context */
+    bool thread_running;                    /* Was the thread started? */
+    atomic_bool should_exit;                /* Signal to thread: time to stop */
+    bool shared;                            /* Part of an obsws_reactor_t (vs. one connection's own) */
+    
+    obsws_connection_t *conns;              /* Attached connections - shard thread only */
+    atomic_size_t conn_count;               /* Attached or attaching, for load balancing */
+    
+    pthread_mutex_t ops_mutex;              /* Protects ops and each connection's shard_op */
+    pthread_cond_t ops_cond;                /* Signalled when a detach completes */
+    obsws_connection_t *ops;                /* Connections waiting to attach or detach */
+    
+    obsws_mpsc_queue_t ready;               /* Connections with frames waiting to be written */
+    
+    /* === External event loop (config.external_loop) ===
+       No thread at all - the application polls these descriptors and calls
+       obsws_service(). lws_cancel_service() only wakes lws' own poll(), which
+       nobody is sitting in, so producers write to wake_fd instead. */
+    bool external;                          /* Serviced by the application, not a thread */
+    pthread_mutex_t service_mutex;          /* One thread inside lws at a time */
+    int wake_fd[2];                         /* Self-pipe: [0] is polled, [1] is written */
+    struct pollfd *pollfds;                 /* wake_fd[0] plus every socket lws asked us to watch */
+    size_t pollfd_count;
+    size_t pollfd_cap;
+} obsws_shard_t;
+
+/* A shared reactor: connections are spread across a fixed set of shards */
+struct obsws_reactor {
+    obsws_shard_t *shards;                  /* One context + thread each */
+    uint32_t num_shards;                    /* Number of entries in shards */
+};
+
+/* Pending work for a shard thread on behalf of one connection */
+typedef enum {
+    OBSWS_SHARD_OP_NONE = 0,                /* Nothing queued */
+    OBSWS_SHARD_OP_ATTACH,                  /* Join the shard and open the WebSocket */
+    OBSWS_SHARD_OP_DETACH,                  /* Close the WebSocket and leave the shard */
+    OBSWS_SHARD_OP_CLOSING,                 /* Detach in progress, waiting for WSI_DESTROY */
+    OBSWS_SHARD_OP_DETACHED                 /* Shard has let go - safe to free */
+} obsws_shard_op_t;
+
 /* Main connection structure - holds all state for an OBS WebSocket connection.
    
    This is the main opaque type that users interact with. It holds everything needed
@@ -170,15 +506,20 @@ typedef struct pending_request {
    Why is it opaque (hidden in the .c file)? So we can change the internal structure
    without breaking the API. Callers just use the pointer, they don't know what's inside.
    
-   Threading model: Each connection has one background thread (event_thread) that
-   processes WebSocket events, calls callbacks, etc. The main application thread sends
+   Threading model: Each connection is serviced by one background thread (its
+   shard's thread) that processes WebSocket events, calls callbacks, etc. By
+   default that thread belongs to this connection alone; with a shared reactor
+   it is shared with other connections. The main application thread sends
    requests and gets responses. This avoids the app freezing while waiting for responses.
    
    Synchronization: We use many mutexes because different parts of the connection
    are accessed from different threads:
    - state_mutex protects the connection state (so both threads see consistent state)
-   - send_mutex protects sending (prevents two threads from sending at the same time)
-   - requests_mutex protects the pending requests list
+   - sending needs no mutex: frames go through the lock-free send_queue and only
+     the event thread ever calls lws_write()
+   - each shard of the pending request table has its own mutex, covering just
+     the requests whose IDs hash to it
+   - frame_pool_mutex protects the free list of reusable outbound frames
    - stats_mutex protects the statistics counters
    - scene_mutex protects the cached current scene name
    
@@ -196,48 +537,135 @@ struct obsws_connection {
     pthread_mutex_t state_mutex;            /* Protects state from concurrent access */
     
     /* === WebSocket Layer === */
-    struct lws_context *lws_context;        /* libwebsockets context (manages the WebSocket) */
+    struct lws_context *lws_context;        /* libwebsockets context (the shard's - may be shared) */
     struct lws *wsi;                        /* WebSocket instance - the actual connection */
+    bool closing;                           /* Close the WebSocket on the next writable callback */
     
     /* === Message Buffers ===
        We keep persistent buffers instead of allocating for every message because
        it's more efficient and avoids memory fragmentation. */
     char *recv_buffer;                      /* Buffer for incoming messages from OBS */
-    size_t recv_buffer_size;                /* Total capacity of receive buffer */
+    size_t recv_buffer_size;                /* Total capacity of receive buffer (grows by doubling) */
     size_t recv_buffer_used;                /* How many bytes are currently in the buffer */
-    
-    char *send_buffer;                      /* Buffer for outgoing messages to OBS */
-    size_t send_buffer_size;                /* Total capacity of send buffer */
-    
-    /* === Background Thread ===
-       The event thread continuously processes WebSocket events. This allows the
-       connection to receive messages and call callbacks without blocking the app. */
-    pthread_t event_thread;                 /* ID of the background thread */
-    pthread_mutex_t send_mutex;             /* Prevents two threads from sending simultaneously */
-    bool thread_running;                    /* Is the thread currently running? */
-    bool should_exit;                       /* Signal to thread: time to stop */
+    uint64_t recv_last_large_ms;            /* Monotonic time the grown buffer was last needed */
+    bool recv_discarding;                   /* Skipping the rest of an oversized message */
+    size_t recv_discarded;                  /* Bytes of the oversized message seen so far */
+    char recv_overflow_id[OBSWS_REQUEST_ID_LENGTH];  /* requestId of the oversized message, if found */
+    
+    /* === Outbound Queue ===
+       Frames are written only from LWS_CALLBACK_CLIENT_WRITEABLE on the event
+       thread. Any thread may push; see obsws_mpsc_queue_t. There's one queue
+       per priority lane, and send_lane_next() picks which to write from. */
+    obsws_mpsc_queue_t send_queue[OBSWS_PRIORITY_COUNT];  /* Frames waiting to be written, by lane */
+    uint32_t bulk_credit;                   /* Builds up by bulk_share per write; bulk goes at 100 (event thread only) */
+    obsws_frame_t *frame_pool;              /* Idle pooled frames ready for reuse */
+    size_t frame_pool_count;                /* How many frames are in the pool */
+    pthread_mutex_t frame_pool_mutex;       /* Protects the pool (held for a pointer swap only) */
+    
+    /* === Event Loop ===
+       The shard's thread continuously processes WebSocket events. This allows the
+       connection to receive messages and call callbacks without blocking the app.
+       The links below are only touched by that thread or under ops_mutex. */
+    obsws_shard_t *shard;                   /* Private shard, or one of a reactor's */
+    struct obsws_connection *shard_next;    /* Next connection attached to the shard */
+    struct obsws_connection *op_next;       /* Next connection in shard->ops */
+    obsws_shard_op_t shard_op;              /* Attach/detach progress (under ops_mutex) */
+    obsws_queue_node_t ready_node;          /* Link in shard->ready */
+    atomic_bool write_scheduled;            /* Already sitting in shard->ready */
     
     /* === Async Request/Response Handling ===
        When you send a request, it returns immediately with a request ID. When the
-       response comes back, we find the pending_request by ID and notify the waiter. */
-    pending_request_t *pending_requests;    /* Linked list of in-flight requests */
-    pthread_mutex_t requests_mutex;         /* Protects the linked list */
+       response comes back, we look up the pending_request by ID and notify the waiter. */
+    request_shard_t request_shards[OBSWS_REQUEST_SHARDS];  /* In-flight requests, hashed by ID */
+    request_slab_t *request_slab;           /* Where their pending_request_t objects come from */
+    request_deadline_t *deadlines;          /* Min-heap of request deadlines */
+    size_t deadline_count;                  /* Entries in the heap */
+    size_t deadline_capacity;               /* Allocated entries */
+    pthread_mutex_t deadline_mutex;         /* Protects the heap (pushed from any thread) */
+    uint64_t request_id_prefix;             /* Random first half of every request ID */
+    atomic_uint_fast64_t next_request_seq;  /* Second half: bumped once per request */
+    atomic_size_t pending_count;            /* Requests across all shards */
+    atomic_bool completions_pending;        /* An async request completed - run dispatch_completions() */
+    pending_request_t *coalesce_buckets[OBSWS_COALESCE_BUCKETS];  /* Leaders open to followers (coalesce_reads) */
+    pthread_mutex_t coalesce_mutex;         /* Protects the registry and leader/follower links */
+    atomic_bool deadline_rearm;             /* A new earliest deadline - shard thread re-arms sul_deadline */
+    atomic_uint abandoned_count;            /* Responses still owed to cancelled / timed-out requests (roughly) */
+    
+    /* === In-Flight Window ===
+       How many requests are out with OBS (config.max_in_flight caps it), the
+       callers blocked waiting for a slot, and the backlog of requests queued
+       for one (window_policy OBSWS_WINDOW_QUEUE). */
+    atomic_uint in_flight;                  /* Slots taken */
+    atomic_uint in_flight_peak;             /* Most ever taken at once */
+    atomic_uint window_waiters;             /* Threads asleep on window_cond */
+    pthread_mutex_t window_mutex;           /* Pairs with window_cond */
+    pthread_cond_t window_cond;             /* Broadcast when a slot frees and someone waits */
+    pending_request_t *backlog_head;        /* Oldest queued request (under backlog_mutex) */
+    pending_request_t *backlog_tail;        /* Newest queued request */
+    atomic_size_t backlog_count;            /* Requests in the backlog */
+    pthread_mutex_t backlog_mutex;          /* Protects the backlog list */
+    atomic_bool window_drain;               /* A slot freed with a backlog - shard thread sends more */
+    
+    /* === Priority Lanes ===
+       Request types moved out of their default lane by obsws_set_request_priority() */
+    priority_rule_t *priority_rules;        /* Array of priority_rule_count rules (under priority_mutex) */
+    atomic_size_t priority_rule_count;      /* Read without the lock to skip it when there are none */
+    pthread_mutex_t priority_mutex;         /* Protects priority_rules */
     
     /* === Performance Monitoring === */
     obsws_stats_t stats;                    /* Message counts, errors, latency, etc */
     pthread_mutex_t stats_mutex;            /* Protects stats from concurrent access */
     
     /* === Keep-Alive / Health Monitoring ===
-       We send periodic pings to detect when the connection dies. If we don't get
-       a pong back within the timeout, we know something is wrong. */
-    time_t last_ping_sent;                  /* When we last sent a ping */
-    time_t last_pong_received;              /* When we last got a pong back */
+       We send periodic WebSocket pings to detect when the connection dies. If we
+       don't get a pong back within ping_timeout_ms, the peer is presumed dead and
+       the socket is dropped so the reconnect logic takes over. Pings carry a
+       sequence number so a late pong for an earlier ping isn't mistaken for the
+       current one. Event thread only, except where noted. */
+    bool ping_due;                          /* Send a ping on the next writable callback */
+    uint64_t ping_sent_us;                  /* Monotonic send time of the outstanding ping (0 = none) */
+    uint64_t ping_seq;                      /* Sequence number of the last ping sent */
+    atomic_bool ping_requested;             /* obsws_ping() wants a ping - any thread */
+    pthread_mutex_t ping_mutex;             /* Protects pong_count for obsws_ping() waiters */
+    pthread_cond_t ping_cond;               /* Broadcast on every matched pong */
+    uint64_t pong_count;                    /* Matched pongs so far (under ping_mutex) */
+    uint32_t rtt_window[OBSWS_RTT_WINDOW];  /* Recent RTTs in microseconds (under stats_mutex) */
+    size_t rtt_count;                       /* Valid entries in rtt_window */
+    size_t rtt_next;                        /* Slot the next sample goes into */
+    
+    /* === Timers ===
+       lws_sul timers on the shard's context replace polling: each one is only
+       scheduled while it has work to do, so an idle connection costs no
+       wakeups at all. Scheduled and cancelled on the shard thread only. */
+    lws_sorted_usec_list_t sul_keepalive;   /* Next keep-alive ping (while CONNECTED) */
+    lws_sorted_usec_list_t sul_deadline;    /* Earliest request deadline (while any are queued) */
+    lws_sorted_usec_list_t sul_shrink;      /* Receive buffer shrink check (while grown) */
+    lws_sorted_usec_list_t sul_reconnect;   /* Next reconnect attempt (while backing off) */
+    lws_sorted_usec_list_t sul_ping_timeout;  /* Dead-peer deadline (while a ping is outstanding) */
+    uint64_t deadline_armed_ms;             /* When sul_deadline fires (0 = not scheduled) */
+    bool shrink_armed;                      /* sul_shrink is scheduled */
+    
+    /* === Compression ===
+       Set from the permessage-deflate extension callbacks on the shard thread. */
+    bool deflate_active;                    /* permessage-deflate was negotiated */
+    bool deflate_skip_tx;                   /* Current outbound message is under the threshold */
+    bool deflate_rx_message;                /* Current inbound message arrived compressed */
+    
+    /* === Wire Format === */
+    bool msgpack_active;                    /* obswebsocket.msgpack negotiated: binary MessagePack frames */
     
     /* === Reconnection ===
        If the connection drops and auto_reconnect is enabled, we try to reconnect.
        We use exponential backoff - each attempt waits longer, up to a maximum. */
     uint32_t reconnect_attempts;            /* How many times have we tried reconnecting */
-    uint32_t current_reconnect_delay;       /* How long we're waiting before next attempt */
+    uint32_t current_reconnect_delay;       /* Current backoff ceiling (doubles per attempt) */
+    uint64_t jitter_state;                  /* Per-connection PRNG for backoff jitter */
+    bool ever_identified;                   /* Reached CONNECTED at least once */
+    bool reconnecting;                      /* The next IDENTIFIED completes a reconnect */
+    bool restarting;                        /* Closing the socket on purpose for obsws_reconnect() */
+    atomic_bool reconnect_requested;        /* obsws_reconnect() called - shard thread picks it up */
+    atomic_bool shutting_down;              /* obsws_disconnect() in progress - never reconnect */
+    atomic_bool offline;                    /* No socket and no reconnect coming - sends fail at once */
     
     /* === Authentication State ===
        OBS uses a challenge-response authentication scheme. The server sends a
@@ -246,6 +674,21 @@ struct obsws_connection {
     char *challenge;                        /* Challenge string from OBS HELLO */
     char *salt;                             /* Salt string from OBS HELLO */
     
+    /* The secret half of the auth response only depends on the password and the
+       salt, and OBS keeps its salt until the password changes - so a reconnect
+       only has to hash the fresh challenge. Event thread only. */
+    char *auth_secret_salt;                 /* Salt auth_secret was derived from (NULL = none yet) */
+    char auth_secret[OBSWS_SHA256_B64_LENGTH + 1]; /* base64(sha256(password + salt)) */
+    
+    /* === Identify Template ===
+       Everything in the JSON Identify message before the optional authentication
+       field, rendered once and reused for every (re)connect until the event
+       subscriptions change. */
+    _Atomic uint32_t event_subscriptions;   /* Current mask - obsws_reidentify() updates it */
+    char identify_template[64];             /* {"op":1,"d":{"rpcVersion":1,"eventSubscriptions":N */
+    size_t identify_template_len;           /* 0 = not rendered yet */
+    uint32_t identify_template_subs;        /* Mask the template was rendered with */
+    
     /* === Optimization Cache ===
        We cache the current scene to avoid querying OBS unnecessarily. When we get
        a SceneChanged event, we update the cache. */
@@ -711,99 +1154,135 @@ static void obsws_debug(obsws_connection_t *conn, obsws_debug_level_t min_level,
  * Utility Functions
  * ============================================================================ */
 
-/* Generate a UUID v4 for request identification.
-   
-   UUIDs uniquely identify each request, so when a response comes back, we can match
-   it to the original request. We use UUID v4 (random) because it's simple and the
-   uniqueness probability is astronomically high.
+/* Request IDs.
    
-   Note: This implementation uses rand() for simplicity. A production system might
-   use /dev/urandom for better randomness, but the current approach is fine for
-   most use cases. The protocol doesn't require cryptographically secure randomness.
+   Every request carries an ID that OBS echoes back in the response, so we can
+   match the two up. Ours are a per-connection random prefix followed by a
+   per-connection counter, both as fixed-width hex:
    
-   Format: 8-4-4-4-12 hex digits with dashes, exactly 36 characters.
-   Example: 550e8400-e29b-41d4-a716-446655440000
+       3f9c0a7d51e2b846 000000000000002a
+       `-- prefix ----' `-- sequence --'    (no space in the real thing)
    
-   The version bits (0x4) and variant bits (0x8-b) mark this as a v4 UUID.
+   The counter is bumped with one atomic add, so any number of threads can
+   take IDs at once without a lock and without ever colliding; the prefix
+   keeps IDs from two connections (or two runs) apart. Formatting is a table
+   lookup per digit - no sprintf - and the receive side turns the digits
+   straight back into the sequence number, which is what the pending request
+   table is keyed on. A response whose ID doesn't parse, or carries another
+   prefix, can't be one of ours and is rejected before any lookup.
 */
 
-static void generate_uuid(char *uuid_out) {
-    unsigned int r1 = rand();
-    unsigned int r2 = rand();
-    unsigned int r3 = rand();
-    unsigned int r4 = rand();
-    
-    sprintf(uuid_out, "%08x-%04x-%04x-%04x-%04x%08x",
-            r1,                          /* 8 hex digits */
-            r2 & 0xFFFF,                /* 4 hex digits */
-            (r3 & 0x0FFF) | 0x4000,     /* 4 hex digits (set version 4) */
-            (r4 & 0x3FFF) | 0x8000,     /* 4 hex digits (set variant bits) */
-            rand() & 0xFFFF,            /* 4 hex digits */
-            (unsigned int)rand());       /* 8 hex digits */
+static void request_id_format(char *out, uint64_t prefix, uint64_t seq) {
+    static const char digits[16] = "0123456789abcdef";
+    for (int i = 0; i < 16; i++) {
+        out[i] = digits[(prefix >> (60 - 4 * i)) & 0xF];
+        out[16 + i] = digits[(seq >> (60 - 4 * i)) & 0xF];
+    }
+    out[32] = '\0';
 }
 
-/* Base64 encode binary data using OpenSSL.
-   
-   Why base64 and not hex? Hex would be twice as large. Base64 is a standard
-   encoding for binary data in text contexts (like WebSocket JSON messages).
-   
-   We use OpenSSL's BIO (Basic I/O) interface for encoding because it's robust
-   and well-tested. The BIO_FLAGS_BASE64_NO_NL flag removes newlines that OpenSSL
-   normally adds for readability - we don't want those in JSON.
-*/
-
-static char* base64_encode(const unsigned char *input, size_t length) {
-    BIO *bio, *b64;
-    BUF_MEM *buffer_ptr;
-    
-    /* Set up OpenSSL base64 encoder: b64 filter pushing to memory buffer */
-    b64 = BIO_new(BIO_f_base64());
-    bio = BIO_new(BIO_s_mem());
-    bio = BIO_push(b64, bio);
-    
-    /* Disable newlines in output (OpenSSL adds them by default for readability) */
-    BIO_set_flags(bio, BIO_FLAGS_BASE64_NO_NL);
-    
-    /* Encode the data */
-    BIO_write(bio, input, length);
-    BIO_flush(bio);
-    BIO_get_mem_ptr(bio, &buffer_ptr);
+/* Decode one of our IDs back to its sequence number. Branch-free per digit:
+   invalid characters are collected in a mask and checked once at the end. */
+static bool request_id_parse(const char *id, size_t len, uint64_t prefix, uint64_t *seq) {
+    if (len != OBSWS_REQUEST_ID_LENGTH - 1) {
+        return false;
+    }
     
-    /* Copy result to our own allocated buffer and null-terminate */
-    char *result = malloc(buffer_ptr->length + 1);
-    if (!result) {
-        BIO_free_all(bio);
-        return NULL;
+    uint64_t value[2] = {0, 0};
+    unsigned bad = 0;
+    for (int i = 0; i < 32; i++) {
+        unsigned d = (unsigned)(unsigned char)id[i] - '0';
+        unsigned l = (unsigned)(unsigned char)id[i] - 'a';
+        unsigned is_digit = d < 10, is_letter = l < 6;
+        bad |= !(is_digit | is_letter);
+        value[i / 16] = (value[i / 16] << 4) | (is_digit * d + is_letter * (l + 10));
     }
-    memcpy(result, buffer_ptr->data, buffer_ptr->length);
-    result[buffer_ptr->length] = '\0';
     
-    BIO_free_all(bio);
-    return result;
+    *seq = value[1];
+    return !bad && value[0] == prefix;
+}
+
+/* Milliseconds on CLOCK_MONOTONIC - for intervals that must not jump when the
+   wall clock is adjusted (NTP, DST, manual changes). */
+static uint64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+/* Condition variables that time out on CLOCK_MONOTONIC, so stepping the wall
+   clock (NTP, DST, manual changes) can't cut a wait short or stretch it.
+   macOS has no pthread_condattr_setclock(); there the wait is made relative
+   to now instead, which comes to the same thing. */
+static void cond_init_monotonic(pthread_cond_t *cond) {
+#ifdef __APPLE__
+    pthread_cond_init(cond, NULL);
+#else
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+#endif
+}
+
+/* Wait on a cond_init_monotonic() condition variable until deadline_ms (on
+   monotonic_ms()'s clock). Returns ETIMEDOUT like pthread_cond_timedwait(). */
+static int cond_wait_until(pthread_cond_t *cond, pthread_mutex_t *mutex, uint64_t deadline_ms) {
+    struct timespec ts;
+#ifdef __APPLE__
+    uint64_t now = monotonic_ms();
+    uint64_t left = deadline_ms > now ? deadline_ms - now : 0;
+    ts.tv_sec = (time_t)(left / 1000);
+    ts.tv_nsec = (long)(left % 1000) * 1000000;
+    return pthread_cond_timedwait_relative_np(cond, mutex, &ts);
+#else
+    ts.tv_sec = (time_t)(deadline_ms / 1000);
+    ts.tv_nsec = (long)(deadline_ms % 1000) * 1000000;
+    return pthread_cond_timedwait(cond, mutex, &ts);
+#endif
 }
 
-/* Compute SHA256 hash of a null-terminated string.
+/* Same clock in microseconds - for RTT, where milliseconds are too coarse on a LAN */
+static uint64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+/* SHA256 of two concatenated strings, written out in base64.
    
    SHA256 is a cryptographic hash function. It's deterministic (same input always
    produces same output) and has an avalanche property (changing one bit in the
    input completely changes the output). This makes it perfect for authentication
    protocols.
    
-   Why SHA256 instead of SHA1 or MD5? SHA256 is current-best-practice. SHA1 has
-   known collisions, and MD5 is even more broken. SHA256 is secure for the
-   foreseeable future.
+   Why base64 and not hex? Hex would be twice as large, and base64 is what OBS
+   expects. EVP_EncodeBlock() never adds newlines and writes straight into the
+   caller's buffer, unlike the BIO chain we used to build per call.
+   
+   Feeding the two halves as separate digest updates gives the same hash as
+   hashing the concatenation, without building the concatenated string.
    
-   Why use EVP (Envelope) API instead of raw SHA256 functions? EVP is higher-level
-   and more flexible - if we ever need to support different hash algorithms, we
-   just change one line.
+   out must hold OBSWS_SHA256_B64_LENGTH + 1 bytes.
 */
 
-static void sha256_hash(const char *input, unsigned char *output) {
+static bool sha256_base64(const char *a, const char *b, char *out) {
+    unsigned char digest[SHA256_DIGEST_LENGTH];
     EVP_MD_CTX *ctx = EVP_MD_CTX_new();
-    EVP_DigestInit_ex(ctx, EVP_sha256(), NULL);
-    EVP_DigestUpdate(ctx, input, strlen(input));
-    EVP_DigestFinal_ex(ctx, output, NULL);
+    if (!ctx) {
+        return false;
+    }
+    bool ok = EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) &&
+              EVP_DigestUpdate(ctx, a, strlen(a)) &&
+              EVP_DigestUpdate(ctx, b, strlen(b)) &&
+              EVP_DigestFinal_ex(ctx, digest, NULL);
     EVP_MD_CTX_free(ctx);
+    if (ok) {
+        EVP_EncodeBlock((unsigned char *)out, digest, SHA256_DIGEST_LENGTH);
+    }
+    OPENSSL_cleanse(digest, sizeof(digest));
+    return ok;
 }
 
 /* Generate OBS WebSocket v5 authentication response using challenge-response protocol.
@@ -822,40 +1301,29 @@ static void sha256_hash(const char *input, unsigned char *output) {
    Why not use the password directly? That would be incredibly insecure. The
    two-step approach means an eavesdropper who sees the response can't use it
    again - the challenge was random and won't repeat.
+   
+   Step 2 is cached on the connection per salt, so reconnecting to the same OBS
+   instance costs one hash instead of two. Runs on the event thread only.
+   
+   response must hold OBSWS_SHA256_B64_LENGTH + 1 bytes.
 */
 
-static char* generate_auth_response(const char *password, const char *salt, const char *challenge) {
-    unsigned char secret_hash[SHA256_DIGEST_LENGTH];
-    unsigned char auth_hash[SHA256_DIGEST_LENGTH];
-    
-    /* Step 1: Compute secret = base64(sha256(password + salt)) */
-    char *password_salt = malloc(strlen(password) + strlen(salt) + 1);
-    if (!password_salt) {
-        return NULL;
-    }
-    sprintf(password_salt, "%s%s", password, salt);
-    sha256_hash(password_salt, secret_hash);
-    free(password_salt);
-    
-    char *secret = base64_encode(secret_hash, SHA256_DIGEST_LENGTH);
-    if (!secret) {
-        return NULL;
-    }
-    
-    /* Step 2: Compute auth response = base64(sha256(secret + challenge)) */
-    char *secret_challenge = malloc(strlen(secret) + strlen(challenge) + 1);
-    if (!secret_challenge) {
-        free(secret);
-        return NULL;
+static bool generate_auth_response(obsws_connection_t *conn, char *response) {
+    const char *password = conn->config.password;
+    
+    if (!conn->auth_secret_salt || strcmp(conn->auth_secret_salt, conn->salt) != 0) {
+        free(conn->auth_secret_salt);
+        conn->auth_secret_salt = NULL;
+        if (!sha256_base64(password, conn->salt, conn->auth_secret)) {
+            return false;
+        }
+        conn->auth_secret_salt = strdup(conn->salt);
+        obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Derived auth secret for salt %s", conn->salt);
+    } else {
+        obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Reusing cached auth secret for salt %s", conn->salt);
     }
-    sprintf(secret_challenge, "%s%s", secret, challenge);
-    sha256_hash(secret_challenge, auth_hash);
-    free(secret_challenge);
-    free(secret);
     
-    /* Return the final response, base64-encoded */
-    char *auth_response = base64_encode(auth_hash, SHA256_DIGEST_LENGTH);
-    return auth_response;
+    return sha256_base64(conn->auth_secret, conn->challenge, response);
 }
 
 /* ============================================================================
@@ -895,1393 +1363,7701 @@ static void set_connection_state(obsws_connection_t *conn, obsws_state_t new_sta
  * Request Management
  * ============================================================================ */
 
-/* Create a new pending request and add it to the tracking list.
-   
-   When we send a request to OBS, we need to track it so we can match the response
-   when it arrives. This function creates a pending_request_t struct and adds it
-   to the linked list. The request is initialized with the ID, a condition variable
-   for waiting, and a current timestamp for timeout detection.
-*/
+static request_shard_t* request_shard(obsws_connection_t *conn, uint64_t seq) {
+    return &conn->request_shards[seq & (OBSWS_REQUEST_SHARDS - 1)];
+}
 
-static pending_request_t* create_pending_request(obsws_connection_t *conn, const char *request_id) {
-    pending_request_t *req = calloc(1, sizeof(pending_request_t));
-    if (!req) return NULL;
-    
-    /* Copy request ID and ensure null termination */
-    strncpy(req->request_id, request_id, OBSWS_UUID_LENGTH - 1);
-    req->request_id[OBSWS_UUID_LENGTH - 1] = '\0';
+/* The bits below OBSWS_REQUEST_SHARDS already picked the shard, so the bucket
+   comes from the ones above them */
+static pending_request_t** request_bucket(request_shard_t *shard, uint64_t seq) {
+    return &shard->buckets[(seq / OBSWS_REQUEST_SHARDS) & (shard->bucket_count - 1)];
+}
+
+static pending_request_t* slab_slot(request_slab_t *slab, uint32_t index) {
+    return &slab->chunks[index / OBSWS_REQUEST_SLAB_CHUNK][index % OBSWS_REQUEST_SLAB_CHUNK];
+}
+
+static void slab_push(request_slab_t *slab, pending_request_t *req) {
+    uint64_t head = atomic_load_explicit(&slab->free_head, memory_order_relaxed);
+    uint64_t next;
+    do {
+        atomic_store_explicit(&req->free_next, (uint32_t)head, memory_order_relaxed);
+        next = (((head >> 32) + 1) << 32) | (req->slot + 1);
+    } while (!atomic_compare_exchange_weak_explicit(&slab->free_head, &head, next,
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+/* NULL when the free list is empty. Reading free_next of a slot that another
+   thread pops (and starts using) first is harmless: the tag makes our CAS fail. */
+static pending_request_t* slab_pop(request_slab_t *slab) {
+    uint64_t head = atomic_load_explicit(&slab->free_head, memory_order_acquire);
+    for (;;) {
+        uint32_t index = (uint32_t)head;
+        if (index == 0) {
+            return NULL;
+        }
+        pending_request_t *req = slab_slot(slab, index - 1);
+        uint64_t next = (((head >> 32) + 1) << 32) |
+                        atomic_load_explicit(&req->free_next, memory_order_relaxed);
+        if (atomic_compare_exchange_weak_explicit(&slab->free_head, &head, next,
+                                                  memory_order_acquire, memory_order_acquire)) {
+            return req;
+        }
+    }
+}
+
+/* Add a chunk of ready-to-use slots. Returns false once the slab is at its
+   size limit or out of memory - the caller then allocates a one-off request. */
+static bool slab_grow(request_slab_t *slab) {
+    pthread_mutex_lock(&slab->grow_mutex);
+    
+    /* Someone may have grown it, or freed slots, while we waited for the lock */
+    if ((uint32_t)atomic_load_explicit(&slab->free_head, memory_order_acquire) != 0) {
+        pthread_mutex_unlock(&slab->grow_mutex);
+        return true;
+    }
     
-    /* Initialize request structure */
-    req->response = calloc(1, sizeof(obsws_response_t));
-    if (!req->response) {
-        free(req);
-        return NULL;
+    size_t n = slab->chunk_count;
+    pending_request_t *chunk = n < OBSWS_REQUEST_SLAB_CHUNKS
+                             ? calloc(OBSWS_REQUEST_SLAB_CHUNK, sizeof(pending_request_t)) : NULL;
+    if (!chunk) {
+        pthread_mutex_unlock(&slab->grow_mutex);
+        return false;
     }
-    req->completed = false;
-    req->timestamp = time(NULL);
-    pthread_mutex_init(&req->mutex, NULL);
-    pthread_cond_init(&req->cond, NULL);
+    for (uint32_t i = 0; i < OBSWS_REQUEST_SLAB_CHUNK; i++) {
+        chunk[i].slab = slab;
+        chunk[i].slot = (uint32_t)(n * OBSWS_REQUEST_SLAB_CHUNK) + i;
+        pthread_mutex_init(&chunk[i].mutex, NULL);
+        cond_init_monotonic(&chunk[i].cond);
+    }
+    slab->chunks[n] = chunk;
+    slab->chunk_count = n + 1;
+    pthread_mutex_unlock(&slab->grow_mutex);
     
-    /* Add to linked list of pending requests */
-    pthread_mutex_lock(&conn->requests_mutex);
-    req->next = conn->pending_requests;
-    conn->pending_requests = req;
-    pthread_mutex_unlock(&conn->requests_mutex);
+    /* Pushed in reverse so the lowest slot is handed out first */
+    for (uint32_t i = OBSWS_REQUEST_SLAB_CHUNK; i-- > 0; ) {
+        slab_push(slab, &chunk[i]);
+    }
+    return true;
+}
+
+static request_slab_t* slab_create(void) {
+    request_slab_t *slab = calloc(1, sizeof(request_slab_t));
+    if (!slab) return NULL;
+    
+    atomic_init(&slab->free_head, 0);
+    atomic_init(&slab->refs, 1);
+    pthread_mutex_init(&slab->grow_mutex, NULL);
+    return slab;
+}
+
+/* Drop a reference; the last one out frees every chunk. By then every slot is
+   back on the free list, holding at most its recycled response struct. */
+static void slab_release(request_slab_t *slab) {
+    if (atomic_fetch_sub_explicit(&slab->refs, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
     
-    return req;
+    for (size_t c = 0; c < slab->chunk_count; c++) {
+        for (size_t i = 0; i < OBSWS_REQUEST_SLAB_CHUNK; i++) {
+            pending_request_t *req = &slab->chunks[c][i];
+            obsws_response_free(req->response);
+            pthread_mutex_destroy(&req->mutex);
+            pthread_cond_destroy(&req->cond);
+        }
+        free(slab->chunks[c]);
+    }
+    pthread_mutex_destroy(&slab->grow_mutex);
+    free(slab);
 }
 
-/* Find a pending request by its UUID */
-static pending_request_t* find_pending_request(obsws_connection_t *conn, const char *request_id) {
-    pthread_mutex_lock(&conn->requests_mutex);
-    pending_request_t *req = conn->pending_requests;
+static bool request_table_init(obsws_connection_t *conn) {
+    conn->request_slab = slab_create();
+    if (!conn->request_slab) {
+        return false;
+    }
     
-    /* Search linked list for matching request ID */
-    while (req) {
-        if (strcmp(req->request_id, request_id) == 0) {
-            pthread_mutex_unlock(&conn->requests_mutex);
+    for (size_t i = 0; i < OBSWS_REQUEST_SHARDS; i++) {
+        request_shard_t *shard = &conn->request_shards[i];
+        shard->buckets = calloc(OBSWS_REQUEST_BUCKETS, sizeof(pending_request_t *));
+        if (!shard->buckets) {
+            while (i-- > 0) {
+                free(conn->request_shards[i].buckets);
+                pthread_mutex_destroy(&conn->request_shards[i].mutex);
+            }
+            slab_release(conn->request_slab);
+            return false;
+        }
+        shard->bucket_count = OBSWS_REQUEST_BUCKETS;
+        shard->count = 0;
+        pthread_mutex_init(&shard->mutex, NULL);
+    }
+    atomic_init(&conn->pending_count, 0);
+    
+    conn->deadlines = NULL;
+    conn->deadline_count = 0;
+    conn->deadline_capacity = 0;
+    pthread_mutex_init(&conn->deadline_mutex, NULL);
+    
+    memset(conn->coalesce_buckets, 0, sizeof(conn->coalesce_buckets));
+    pthread_mutex_init(&conn->coalesce_mutex, NULL);
+    atomic_init(&conn->deadline_rearm, false);
+    
+    atomic_init(&conn->in_flight, 0);
+    atomic_init(&conn->in_flight_peak, 0);
+    atomic_init(&conn->window_waiters, 0);
+    pthread_mutex_init(&conn->window_mutex, NULL);
+    cond_init_monotonic(&conn->window_cond);
+    conn->backlog_head = NULL;
+    conn->backlog_tail = NULL;
+    atomic_init(&conn->backlog_count, 0);
+    pthread_mutex_init(&conn->backlog_mutex, NULL);
+    atomic_init(&conn->window_drain, false);
+    
+    conn->priority_rules = NULL;
+    atomic_init(&conn->priority_rule_count, 0);
+    pthread_mutex_init(&conn->priority_mutex, NULL);
+    return true;
+}
+
+/* Free the table itself - the requests in it are the caller's business. The
+   slab goes once the last request still out (a future, say) comes back. */
+static void request_table_destroy(obsws_connection_t *conn) {
+    for (size_t i = 0; i < OBSWS_REQUEST_SHARDS; i++) {
+        free(conn->request_shards[i].buckets);
+        pthread_mutex_destroy(&conn->request_shards[i].mutex);
+    }
+    free(conn->deadlines);
+    pthread_mutex_destroy(&conn->deadline_mutex);
+    pthread_mutex_destroy(&conn->coalesce_mutex);
+    pthread_mutex_destroy(&conn->window_mutex);
+    pthread_cond_destroy(&conn->window_cond);
+    pthread_mutex_destroy(&conn->backlog_mutex);
+    for (size_t i = 0; i < atomic_load(&conn->priority_rule_count); i++) {
+        free(conn->priority_rules[i].request_type);
+    }
+    free(conn->priority_rules);
+    pthread_mutex_destroy(&conn->priority_mutex);
+    slab_release(conn->request_slab);
+}
+
+/* Double a shard's bucket array and rehash its chains. Caller holds the shard
+   lock. If the allocation fails we just carry on with longer chains. */
+static void request_shard_grow(request_shard_t *shard) {
+    size_t bucket_count = shard->bucket_count * 2;
+    pending_request_t **buckets = calloc(bucket_count, sizeof(pending_request_t *));
+    if (!buckets) return;
+    
+    for (size_t i = 0; i < shard->bucket_count; i++) {
+        pending_request_t *req = shard->buckets[i];
+        while (req) {
+            pending_request_t *next = req->next;
+            pending_request_t **bucket = &buckets[(req->seq / OBSWS_REQUEST_SHARDS) & (bucket_count - 1)];
+            req->next = *bucket;
+            *bucket = req;
+            req = next;
+        }
+    }
+    free(shard->buckets);
+    shard->buckets = buckets;
+    shard->bucket_count = bucket_count;
+}
+
+/* Find a request by sequence number within its shard. Caller holds the
+   shard lock. The prefix was checked when the ID was parsed, so the sequence
+   number alone identifies the request - no string compare. */
+static pending_request_t* request_shard_lookup(request_shard_t *shard, uint64_t seq) {
+    for (pending_request_t *req = *request_bucket(shard, seq); req; req = req->next) {
+        if (req->seq == seq) {
             return req;
         }
-        req = req->next;
     }
-    
-    pthread_mutex_unlock(&conn->requests_mutex);
     return NULL;
 }
 
-/* Remove a pending request from the tracking list and free it */
-static void remove_pending_request(obsws_connection_t *conn, pending_request_t *target) {
-    pthread_mutex_lock(&conn->requests_mutex);
-    pending_request_t **req = &conn->pending_requests;
-    
-    /* Find and remove from linked list */
-    while (*req) {
-        if (*req == target) {
-            *req = target->next;
-            pthread_mutex_unlock(&conn->requests_mutex);
-            
-            /* Clean up request resources */
-            pthread_mutex_destroy(&target->mutex);
-            pthread_cond_destroy(&target->cond);
-            free(target);
-            return;
+/* Take a request out of its shard. Caller holds the shard lock. */
+static bool request_shard_unlink(obsws_connection_t *conn, request_shard_t *shard, pending_request_t *target) {
+    for (pending_request_t **link = request_bucket(shard, target->seq); *link; link = &(*link)->next) {
+        if (*link == target) {
+            *link = target->next;
+            target->next = NULL;
+            shard->count--;
+            atomic_fetch_sub_explicit(&conn->pending_count, 1, memory_order_relaxed);
+            return true;
         }
-        req = &(*req)->next;
     }
-    
-    pthread_mutex_unlock(&conn->requests_mutex);
+    return false;
 }
 
-/* Clean up requests that have exceeded the timeout period */
-static void cleanup_old_requests(obsws_connection_t *conn) {
-    time_t now = time(NULL);
-    pthread_mutex_lock(&conn->requests_mutex);
-    
-    pending_request_t **req = &conn->pending_requests;
-    while (*req) {
-        /* Check if request has timed out (30 seconds) */
-        if (now - (*req)->timestamp > 30) {
-            pending_request_t *old = *req;
-            *req = old->next;
-            
-            /* Mark as completed with timeout error */
-            pthread_mutex_lock(&old->mutex);
-            old->completed = true;
-            old->response->success = false;
-            old->response->error_message = strdup("Request timeout");
-            pthread_cond_broadcast(&old->cond);  /* Wake waiting threads */
-            pthread_mutex_unlock(&old->mutex);
-        } else {
-            req = &(*req)->next;
+/* Walk every pending request, one shard at a time with that shard's lock held
+   (so visit may take req->mutex, but must not call back into the table).
+   Requests for which visit returns true are unlinked and handed back as a
+   list through ->next, for the caller to finish off once no lock is held. */
+typedef bool (*pending_visit_t)(obsws_connection_t *conn, pending_request_t *req, void *arg);
+
+static pending_request_t* visit_pending_requests(obsws_connection_t *conn, pending_visit_t visit, void *arg) {
+    pending_request_t *removed = NULL, **tail = &removed;
+    
+    for (size_t i = 0; i < OBSWS_REQUEST_SHARDS; i++) {
+        request_shard_t *shard = &conn->request_shards[i];
+        pthread_mutex_lock(&shard->mutex);
+        for (size_t b = 0; b < shard->bucket_count && shard->count > 0; b++) {
+            pending_request_t **link = &shard->buckets[b];
+            while (*link) {
+                pending_request_t *req = *link;
+                if (visit(conn, req, arg)) {
+                    *link = req->next;
+                    req->next = NULL;
+                    shard->count--;
+                    atomic_fetch_sub_explicit(&conn->pending_count, 1, memory_order_relaxed);
+                    *tail = req;
+                    tail = &req->next;
+                } else {
+                    link = &req->next;
+                }
+            }
         }
+        pthread_mutex_unlock(&shard->mutex);
     }
     
-    pthread_mutex_unlock(&conn->requests_mutex);
+    return removed;
 }
 
-/* ============================================================================
- * WebSocket Protocol Handling
- * ============================================================================ */
-
-/**
- * @brief Handle the initial HELLO handshake message from OBS.
- * 
- * When we first connect to OBS, the server sends a HELLO message containing
- * protocol version information and, if required, an authentication challenge
- * and salt. This function extracts that information and immediately responds
- * with an IDENTIFY message.
- * 
- * The authentication flow (if enabled) works as follows:
- * 1. Server sends HELLO with a random challenge string and a salt
- * 2. We compute: secret = base64(SHA256(password + salt))
- * 3. We compute: response = base64(SHA256(secret + challenge))
- * 4. We send this response in the IDENTIFY message
- * 5. If it matches what the server computed, auth succeeds
- * 
- * This challenge-response approach has several advantages over sending the
- * raw password:
- * - Password never travels across the network (only the computed response)
- * - If someone captures the network traffic, they can't replay the captured
- *   response because it's specific to this challenge (which was random)
- * - Similar to HTTP Digest Authentication (RFC 2617) but simpler
- * 
- * The function transitions the connection state from CONNECTING to AUTHENTICATING,
- * sends the IDENTIFY message, and logs any authentication requirements.
- * 
- * @param conn The connection structure containing buffers, config, and state
- * @param data The parsed JSON "d" field from the HELLO message, containing
- *             authentication info if auth is required
- * @return 0 on success, -1 on error (though errors are logged and connection
- *         continues - failure to authenticate will be detected by the server
- *         refusing to transition to IDENTIFIED state)
- * 
- * @internal
- */
-static int handle_hello_message(obsws_connection_t *conn, cJSON *data) {
-    /* DEBUG_LOW: Basic connection event */
-    obsws_debug(conn, OBSWS_DEBUG_LOW, "Received Hello message from OBS");
-    
-    cJSON *auth = cJSON_GetObjectItem(data, "authentication");
-    if (auth) {
-        conn->auth_required = true;
-        
-        cJSON *challenge = cJSON_GetObjectItem(auth, "challenge");
-        cJSON *salt = cJSON_GetObjectItem(auth, "salt");
-        
-        if (challenge && salt) {
-            conn->challenge = strdup(challenge->valuestring);
-            conn->salt = strdup(salt->valuestring);
-            /* DEBUG_MEDIUM: Show auth parameters */
-            obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Authentication required - salt: %s, challenge: %s", 
-                     conn->salt, conn->challenge);
+/* Take a request off the cancel token it was sent with */
+static void token_forget(pending_request_t *req) {
+    obsws_cancel_token_t *token = req->token;
+    pthread_mutex_lock(&token->mutex);
+    for (pending_request_t **link = &token->requests; *link; link = &(*link)->token_next) {
+        if (*link == req) {
+            *link = req->token_next;
+            break;
         }
-    } else {
-        conn->auth_required = false;
-        obsws_debug(conn, OBSWS_DEBUG_LOW, "No authentication required");
+    }
+    pthread_mutex_unlock(&token->mutex);
+    req->token = NULL;
+    req->token_next = NULL;
+}
+
+/* Free what a response points to, leaving it empty */
+static void response_clear(obsws_response_t *response) {
+    free(response->error_message);
+    free(response->response_data);
+    cJSON_Delete(response->data_tree);
+    memset(response, 0, sizeof(obsws_response_t));
+}
+
+/* Return a request to its slab (or the heap) along with whatever it still owns */
+static void free_pending_request(pending_request_t *req) {
+    if (req->token) {
+        token_forget(req);
     }
     
-    /* Send Identify message */
-    set_connection_state(conn, OBSWS_STATE_AUTHENTICATING);
+    /* response / batch_result are NULL if ownership moved to the caller */
+    obsws_batch_result_free(req->batch_result);
+    free(req->replay_type);
+    free(req->replay_data);
+    free(req->coalesce_key);
     
-    cJSON *identify = cJSON_CreateObject();
-    cJSON_AddNumberToObject(identify, "op", OBSWS_OPCODE_IDENTIFY);
+    if (req->slab) {
+        /* Back to the slab. A response the caller didn't take is emptied and
+           stays with the slot for its next user. */
+        request_slab_t *slab = req->slab;
+        if (req->response) {
+            response_clear(req->response);
+        }
+        slab_push(slab, req);
+        slab_release(slab);
+        return;
+    }
     
-    cJSON *identify_data = cJSON_CreateObject();
-    cJSON_AddNumberToObject(identify_data, "rpcVersion", OBSWS_PROTOCOL_VERSION);
-    cJSON_AddNumberToObject(identify_data, "eventSubscriptions", OBSWS_EVENT_ALL);
+    obsws_response_free(req->response);
+    pthread_mutex_destroy(&req->mutex);
+    pthread_cond_destroy(&req->cond);
+    free(req);
+}
+
+/* Create a new pending request.
+   
+   When we send a request to OBS, we need to track it so we can match the response
+   when it arrives. This function creates a pending_request_t struct with a
+   fresh request ID; the caller
+   fills in anything else it needs and then adds it to the request table with
+   track_pending_request(). The request is initialized with the ID and a
+   condition variable for waiting; launch_request() gives it its deadline.
+   
+   In the steady state the object is a recycled slab slot: its mutex, condition
+   variable and (unless the last user kept it) response struct are already set
+   up, so nothing here calls the allocator or pthread_*_init.
+*/
+
+static pending_request_t* alloc_pending_request(obsws_connection_t *conn) {
+    request_slab_t *slab = conn->request_slab;
+    pending_request_t *req;
+    while ((req = slab_pop(slab)) == NULL && slab_grow(slab)) {
+        /* Retry with the new chunk */
+    }
     
-    if (conn->auth_required && conn->config.password) {
-        /* DEBUG_HIGH: Show password being used */
-        obsws_debug(conn, OBSWS_DEBUG_HIGH, "Generating auth response with password: '%s'", conn->config.password);
-        char *auth_response = generate_auth_response(conn->config.password, conn->salt, conn->challenge);
-        /* DEBUG_MEDIUM: Show generated auth string */
-        obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Generated auth response: '%s'", auth_response);
-        cJSON_AddStringToObject(identify_data, "authentication", auth_response);
-        free(auth_response);
+    if (req) {
+        atomic_fetch_add_explicit(&slab->refs, 1, memory_order_relaxed);
+        obsws_response_t *response = req->response;
+        memset(req, 0, offsetof(pending_request_t, slab));
+        req->response = response;
     } else {
-        if (conn->auth_required) {
-            obsws_log(conn, OBSWS_LOG_ERROR, "Authentication required but no password provided!");
-        }
+        req = calloc(1, sizeof(pending_request_t));
+        if (!req) return NULL;
+        pthread_mutex_init(&req->mutex, NULL);
+        cond_init_monotonic(&req->cond);
     }
     
-    cJSON_AddItemToObject(identify, "d", identify_data);
-    
-    char *message = cJSON_PrintUnformatted(identify);
-    cJSON_Delete(identify);
+    /* Take the next ID - one atomic add, unique across threads */
+    req->seq = atomic_fetch_add_explicit(&conn->next_request_seq, 1, memory_order_relaxed);
+    request_id_format(req->request_id, conn->request_id_prefix, req->seq);
+    req->conn = conn;
     
-    /* DEBUG_HIGH: Show full Identify message */
-    obsws_debug(conn, OBSWS_DEBUG_HIGH, "Sending Identify message: %s", message);
-    
-    pthread_mutex_lock(&conn->send_mutex);
-    size_t len = strlen(message);
-    if (len < conn->send_buffer_size - LWS_PRE) {
-        memcpy(conn->send_buffer + LWS_PRE, message, len);
-        int written = lws_write(conn->wsi, (unsigned char *)(conn->send_buffer + LWS_PRE), len, LWS_WRITE_TEXT);
-        /* DEBUG_HIGH: Show bytes sent */
-        obsws_debug(conn, OBSWS_DEBUG_HIGH, "Sent %d bytes (requested %zu)", written, len);
-    } else {
-        obsws_log(conn, OBSWS_LOG_ERROR, "Message too large for send buffer: %zu bytes", len);
+    /* Initialize request structure */
+    if (!req->response) {
+        req->response = calloc(1, sizeof(obsws_response_t));
+        if (!req->response) {
+            free_pending_request(req);
+            return NULL;
+        }
     }
-    pthread_mutex_unlock(&conn->send_mutex);
+    req->completed = false;
+    atomic_init(&req->refs, 1);
     
-    free(message);
-    return 0;
+    return req;
+}
+
+/* Add a request to the request table. From here on the event thread can see
+   it, so everything it needs (replay copies, async fields) must be set first. */
+static void track_pending_request(obsws_connection_t *conn, pending_request_t *req) {
+    request_shard_t *shard = request_shard(conn, req->seq);
+    pthread_mutex_lock(&shard->mutex);
+    if (shard->count >= shard->bucket_count) {
+        request_shard_grow(shard);
+    }
+    pending_request_t **bucket = request_bucket(shard, req->seq);
+    req->next = *bucket;
+    *bucket = req;
+    shard->count++;
+    pthread_mutex_unlock(&shard->mutex);
+    atomic_fetch_add_explicit(&conn->pending_count, 1, memory_order_relaxed);
+}
+
+/* Drop one reference to an async request (the list's or the future's) */
+static void release_pending_request(pending_request_t *req) {
+    if (atomic_fetch_sub_explicit(&req->refs, 1, memory_order_acq_rel) == 1) {
+        free_pending_request(req);
+    }
+}
+
+/* ============================================================================
+ * In-Flight Window
+ * ============================================================================ */
+
+/* Every request sent to OBS holds one of config.max_in_flight slots until it
+   completes (or leaves the table without completing, see request_retire()).
+   Slots are a plain atomic count, so taking and returning one is a CAS and a
+   subtraction. A full window is handled by window_admit(), further down. */
+
+static void connection_kick(obsws_connection_t *conn);
+static void enqueue_frame(obsws_connection_t *conn, obsws_frame_t *frame);
+static void frame_free(obsws_connection_t *conn, obsws_frame_t *frame);
+
+/* Take a slot if one is free. With no limit set, slots are still counted, for
+   the stats; with force (realtime requests) the limit is ignored the same way. */
+static bool window_try_acquire(obsws_connection_t *conn, bool force) {
+    uint32_t max = force ? 0 : conn->config.max_in_flight;
+    unsigned cur = atomic_load_explicit(&conn->in_flight, memory_order_relaxed);
+    do {
+        if (max && cur >= max) {
+            return false;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&conn->in_flight, &cur, cur + 1,
+                                                    memory_order_acq_rel, memory_order_relaxed));
+    
+    unsigned peak = atomic_load_explicit(&conn->in_flight_peak, memory_order_relaxed);
+    while (cur + 1 > peak &&
+           !atomic_compare_exchange_weak_explicit(&conn->in_flight_peak, &peak, cur + 1,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+        /* peak reloaded - try again */
+    }
+    return true;
+}
+
+/* Give a slot back and pass it on: the shard thread sends the next backlogged
+   request, and blocked callers wake up to compete for it. Safe under any
+   request or shard lock - nothing here takes one. */
+static void window_release(obsws_connection_t *conn) {
+    atomic_fetch_sub_explicit(&conn->in_flight, 1, memory_order_seq_cst);
+    
+    if (atomic_load_explicit(&conn->backlog_count, memory_order_seq_cst) > 0) {
+        atomic_store_explicit(&conn->window_drain, true, memory_order_release);
+        connection_kick(conn);
+    }
+    if (atomic_load_explicit(&conn->window_waiters, memory_order_seq_cst) > 0) {
+        pthread_mutex_lock(&conn->window_mutex);
+        pthread_cond_broadcast(&conn->window_cond);
+        pthread_mutex_unlock(&conn->window_mutex);
+    }
+}
+
+/* Hand a freshly taken slot to req. Returns false (and gives the slot back)
+   if req has already completed - timed out while it waited, say. */
+static bool window_claim_slot(obsws_connection_t *conn, pending_request_t *req) {
+    pthread_mutex_lock(&req->mutex);
+    bool live = !req->completed;
+    if (live) {
+        req->window_slot = true;
+    }
+    pthread_mutex_unlock(&req->mutex);
+    
+    if (!live) {
+        window_release(conn);
+    }
+    return live;
+}
+
+/* Caller holds req->mutex */
+static void window_return_slot_locked(obsws_connection_t *conn, pending_request_t *req) {
+    if (req->window_slot) {
+        req->window_slot = false;
+        window_release(conn);
+    }
+}
+
+/* req is ending without its response - cancelled, timed out. If it holds a
+   slot it went out to OBS, and the answer may still turn up; count it so
+   incoming messages get checked for late responses. Caller holds req->mutex. */
+static void note_abandoned_locked(obsws_connection_t *conn, pending_request_t *req) {
+    if (req->window_slot) {
+        atomic_fetch_add_explicit(&conn->abandoned_count, 1, memory_order_relaxed);
+    }
+}
+
+/* Copy a leader's response into a follower's (empty) one. responseData
+   goes across the way the follower wants it: as text for the caller, or as
+   a tree for a library helper. A leader that only kept the tree is printed
+   for a follower that needs the text. False if out of memory. */
+static bool response_copy(obsws_response_t *dst, const obsws_response_t *src, bool tree_only) {
+    dst->success = src->success;
+    dst->status_code = src->status_code;
+    dst->error_message = src->error_message ? strdup(src->error_message) : NULL;
+    if (src->error_message && !dst->error_message) {
+        return false;
+    }
+    
+    if (tree_only && src->data_tree) {
+        dst->data_tree = cJSON_Duplicate(src->data_tree, true);
+        return dst->data_tree != NULL;
+    }
+    if (src->response_data) {
+        dst->response_data = strdup(src->response_data);
+    } else if (src->data_tree) {
+        dst->response_data = cJSON_PrintUnformatted(src->data_tree);
+    } else {
+        return true;
+    }
+    return dst->response_data != NULL;
+}
+
+/* Mark a request complete and wake everyone waiting on it. Caller holds
+   req->mutex and has filled in the response / error. Async requests stay in
+   the table; dispatch_completions() takes them off and runs their callbacks
+   once no locks are held. */
+static void complete_request_locked(obsws_connection_t *conn, pending_request_t *req) {
+    req->completed = true;
+    window_return_slot_locked(conn, req);
+    pthread_cond_broadcast(&req->cond);
+    
+    for (future_waiter_link_t *link = req->waiters; link; link = link->next) {
+        pthread_mutex_lock(&link->waiter->mutex);
+        link->waiter->fired++;
+        pthread_cond_signal(&link->waiter->cond);
+        pthread_mutex_unlock(&link->waiter->mutex);
+    }
+    
+    if (req->async) {
+        atomic_store_explicit(&conn->completions_pending, true, memory_order_release);
+    }
+    
+    /* A cancelled leader's followers weren't cancelled themselves; they stay
+       linked until the leader is retired, and coalesce_detach() sends them */
+    if (atomic_load(&req->cancelled)) {
+        return;
+    }
+    
+    /* Coalesced followers finish the same way, each with its own copy of the
+       response. The list only changes under req->mutex, which we hold. A
+       leader that timed out only takes the followers due by then along; the
+       rest stay linked and are sent on their own, like a cancelled leader's. */
+    bool timed_out = req->error == OBSWS_ERROR_TIMEOUT;
+    for (pending_request_t *f = req->followers; f; f = f->follower_next) {
+        pthread_mutex_lock(&f->mutex);
+        if (!f->completed && !(timed_out && f->deadline_ms > req->deadline_ms)) {
+            f->error = req->error;
+            if (!response_copy(f->response, req->response, f->data_tree_only)) {
+                f->error = OBSWS_ERROR_OUT_OF_MEMORY;
+            }
+            complete_request_locked(conn, f);
+        }
+        pthread_mutex_unlock(&f->mutex);
+    }
+}
+
+/* ============================================================================
+ * Read Coalescing
+ * ============================================================================ */
+
+/* With config.coalesce_reads, a Get* request identical to one already in
+   flight - same type, byte-for-byte the same requestData - is not sent. It
+   joins that request (its leader) as a follower and complete_request_locked()
+   hands it a copy of the leader's outcome. A follower is otherwise an
+   ordinary pending request: it's in the table with its own ID and deadline,
+   so timeouts, callbacks and futures work as usual. If the leader times out
+   while a follower still has time left, the follower is sent on its own
+   (coalesce_resend()) rather than failed with it.
+   
+   Lock order: coalesce_mutex, then the leader's mutex, then a follower's.
+   Every request leaves the registry through coalesce_detach() before it
+   leaves the table, so no link ever points at a freed request. */
+
+/* Remember what would make another request identical to this one. The key
+   is null-terminated past its length too, so coalesce_resend() can rebuild
+   the request from it. */
+static bool coalesce_key_init(pending_request_t *req, const char *request_type,
+                              const char *request_data, size_t data_len) {
+    size_t type_len = strlen(request_type);
+    char *key = malloc(type_len + 1 + data_len + 1);
+    if (!key) return false;
+    
+    memcpy(key, request_type, type_len + 1);
+    if (data_len) {
+        memcpy(key + type_len + 1, request_data, data_len);
+    }
+    key[type_len + 1 + data_len] = '\0';
+    
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < type_len + 1 + data_len; i++) {
+        hash = (hash ^ (unsigned char)key[i]) * 16777619u;
+    }
+    
+    req->coalesce_key = key;
+    req->coalesce_key_len = type_len + 1 + data_len;
+    req->coalesce_hash = hash;
+    return true;
+}
+
+/* Attach a freshly tracked request to a matching leader, or register it as a
+   leader itself. Returns true if it became a follower (and must not be sent). */
+static bool coalesce_join(obsws_connection_t *conn, pending_request_t *req) {
+    pending_request_t **chain = &conn->coalesce_buckets[req->coalesce_hash & (OBSWS_COALESCE_BUCKETS - 1)];
+    bool joined = false;
+    
+    pthread_mutex_lock(&conn->coalesce_mutex);
+    for (pending_request_t *leader = *chain; leader && !joined; leader = leader->coalesce_next) {
+        if (leader->coalesce_hash != req->coalesce_hash || leader->coalesce_key_len != req->coalesce_key_len ||
+            memcmp(leader->coalesce_key, req->coalesce_key, req->coalesce_key_len) != 0) {
+            continue;
+        }
+        
+        pthread_mutex_lock(&leader->mutex);
+        if (!leader->completed) {
+            pthread_mutex_lock(&req->mutex);
+            if (!req->completed && !req->held) {
+                req->leader = leader;
+                req->follower_next = leader->followers;
+                leader->followers = req;
+                joined = true;
+            }
+            pthread_mutex_unlock(&req->mutex);
+        }
+        pthread_mutex_unlock(&leader->mutex);
+    }
+    
+    if (!joined) {
+        req->coalesce_next = *chain;
+        *chain = req;
+        req->coalesce_registered = true;
+    }
+    pthread_mutex_unlock(&conn->coalesce_mutex);
+    return joined;
+}
+
+static bool window_backlog_push(obsws_connection_t *conn, pending_request_t *req, obsws_frame_t *frame);
+static obsws_frame_t* build_request_frame(obsws_connection_t *conn, const char *request_type,
+                                          const char *request_id, const char *request_data);
+
+/* Send a follower whose leader went without answering it - cancelled, or
+   timed out before the follower's own deadline. The frame is rebuilt from
+   the coalescing key, which is the request's type and data. Caller holds
+   coalesce_mutex, so f can't be retired meanwhile. */
+static void coalesce_resend(obsws_connection_t *conn, pending_request_t *f) {
+    const char *request_type = f->coalesce_key;
+    size_t type_len = strlen(request_type);
+    const char *request_data = f->coalesce_key_len > type_len + 1 ? request_type + type_len + 1 : NULL;
+    
+    obsws_error_t error = OBSWS_ERROR_OUT_OF_MEMORY;
+    obsws_frame_t *frame = build_request_frame(conn, request_type, f->request_id, request_data);
+    if (frame) {
+        frame->lane = f->lane;
+        if (window_try_acquire(conn, false)) {
+            if (window_claim_slot(conn, f)) {
+                enqueue_frame(conn, frame);
+            } else {
+                frame_free(conn, frame);
+            }
+            return;
+        }
+        if (window_backlog_push(conn, f, frame)) {
+            return;
+        }
+        frame_free(conn, frame);
+        error = OBSWS_ERROR_WINDOW_FULL;
+    }
+    
+    pthread_mutex_lock(&f->mutex);
+    if (!f->completed) {
+        f->error = error;
+        f->response->success = false;
+        f->response->error_message = strdup(obsws_error_string(error));
+        complete_request_locked(conn, f);
+    }
+    pthread_mutex_unlock(&f->mutex);
+    connection_kick(conn);
+}
+
+/* Cut a request loose from its leader, followers and the registry. Called
+   whenever a request leaves the table. A follower whose leader goes first
+   without answering it is sent on its own if it still has time left - the
+   leader was cancelled or timed out, say. One due by now is left to time
+   out. */
+static void coalesce_detach(obsws_connection_t *conn, pending_request_t *req) {
+    if (!req->coalesce_key) return;
+    
+    pthread_mutex_lock(&conn->coalesce_mutex);
+    
+    pending_request_t *leader = req->leader;
+    if (leader) {
+        pthread_mutex_lock(&leader->mutex);
+        for (pending_request_t **link = &leader->followers; *link; link = &(*link)->follower_next) {
+            if (*link == req) {
+                *link = req->follower_next;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&leader->mutex);
+    }
+    
+    if (req->coalesce_registered) {
+        pending_request_t **link = &conn->coalesce_buckets[req->coalesce_hash & (OBSWS_COALESCE_BUCKETS - 1)];
+        while (*link && *link != req) {
+            link = &(*link)->coalesce_next;
+        }
+        if (*link) {
+            *link = req->coalesce_next;
+        }
+        req->coalesce_registered = false;
+    }
+    
+    pthread_mutex_lock(&req->mutex);
+    pending_request_t *followers = req->followers;
+    req->followers = NULL;
+    req->leader = NULL;
+    req->follower_next = NULL;
+    pthread_mutex_unlock(&req->mutex);
+    
+    uint64_t now = followers ? monotonic_ms() : 0;
+    bool resend = !atomic_load_explicit(&conn->shutting_down, memory_order_acquire);
+    while (followers) {
+        pending_request_t *f = followers;
+        followers = f->follower_next;
+        pthread_mutex_lock(&f->mutex);
+        f->leader = NULL;
+        f->follower_next = NULL;
+        bool orphaned = !f->completed && f->deadline_ms > now;
+        pthread_mutex_unlock(&f->mutex);
+        if (orphaned && resend) {
+            coalesce_resend(conn, f);
+        }
+    }
+    
+    pthread_mutex_unlock(&conn->coalesce_mutex);
+}
+
+/* ============================================================================
+ * Window Backlog
+ * ============================================================================ */
+
+/* With window_policy OBSWS_WINDOW_QUEUE, requests that find the window full
+   wait here - already in the table, with their deadline running - and the
+   shard thread sends them oldest first as slots free up. Lock order:
+   backlog_mutex, then a request's mutex. */
+
+/* Queue req with its frame. Returns false if the backlog is full. */
+static bool window_backlog_push(obsws_connection_t *conn, pending_request_t *req, obsws_frame_t *frame) {
+    pthread_mutex_lock(&conn->backlog_mutex);
+    if (atomic_load_explicit(&conn->backlog_count, memory_order_relaxed) >= conn->config.window_backlog) {
+        pthread_mutex_unlock(&conn->backlog_mutex);
+        return false;
+    }
+    
+    pthread_mutex_lock(&req->mutex);
+    req->backlogged = true;
+    req->backlog_frame = frame;
+    req->backlog_since_us = monotonic_us();
+    req->backlog_next = NULL;
+    pthread_mutex_unlock(&req->mutex);
+    
+    if (conn->backlog_tail) {
+        conn->backlog_tail->backlog_next = req;
+    } else {
+        conn->backlog_head = req;
+    }
+    conn->backlog_tail = req;
+    atomic_fetch_add_explicit(&conn->backlog_count, 1, memory_order_seq_cst);
+    pthread_mutex_unlock(&conn->backlog_mutex);
+    
+    /* A slot may have freed between our failed try and the push, with nobody
+       to see the backlog yet - let the shard thread look */
+    atomic_store_explicit(&conn->window_drain, true, memory_order_release);
+    connection_kick(conn);
+    return true;
+}
+
+/* Unlink req from the backlog. Caller holds backlog_mutex. Returns its frame. */
+static obsws_frame_t* window_backlog_unlink(obsws_connection_t *conn, pending_request_t *req) {
+    pending_request_t *prev = NULL;
+    for (pending_request_t *cur = conn->backlog_head; cur; prev = cur, cur = cur->backlog_next) {
+        if (cur != req) continue;
+        
+        if (prev) {
+            prev->backlog_next = req->backlog_next;
+        } else {
+            conn->backlog_head = req->backlog_next;
+        }
+        if (conn->backlog_tail == req) {
+            conn->backlog_tail = prev;
+        }
+        atomic_fetch_sub_explicit(&conn->backlog_count, 1, memory_order_seq_cst);
+        break;
+    }
+    
+    pthread_mutex_lock(&req->mutex);
+    obsws_frame_t *frame = req->backlog_frame;
+    req->backlogged = false;
+    req->backlog_frame = NULL;
+    req->backlog_next = NULL;
+    pthread_mutex_unlock(&req->mutex);
+    return frame;
+}
+
+static void window_note_wait(obsws_connection_t *conn, uint64_t since_us) {
+    uint64_t waited = monotonic_us() - since_us;
+    pthread_mutex_lock(&conn->stats_mutex);
+    conn->stats.window_waits++;
+    conn->stats.window_wait_us_total += waited;
+    if (waited > conn->stats.window_wait_us_max) {
+        conn->stats.window_wait_us_max = waited;
+    }
+    pthread_mutex_unlock(&conn->stats_mutex);
+}
+
+/* Send backlogged requests while there are slots for them. Shard thread only
+   (from shard_dispatch_writes() and handle_identified_message()). Requests
+   that completed while they waited - timed out, failed by a disconnect - are
+   dropped on the way. Nothing moves until the session is identified: a frame
+   queued before then would be held (or failed) by flush_send_queue() while
+   still counting against the window, so the backlog waits for
+   handle_identified_message() to start it again. */
+static void window_drain(obsws_connection_t *conn) {
+    if (conn->state != OBSWS_STATE_CONNECTED) {
+        return;
+    }
+    
+    pthread_mutex_lock(&conn->backlog_mutex);
+    while (conn->backlog_head && window_try_acquire(conn, false)) {
+        pending_request_t *req = conn->backlog_head;
+        uint64_t since_us = req->backlog_since_us;
+        obsws_frame_t *frame = window_backlog_unlink(conn, req);
+        
+        if (window_claim_slot(conn, req)) {
+            window_note_wait(conn, since_us);
+            enqueue_frame(conn, frame);
+        } else {
+            frame_free(conn, frame);
+        }
+    }
+    pthread_mutex_unlock(&conn->backlog_mutex);
+}
+
+/* Everything a request has to let go of before it leaves the table: its
+   coalescing links, its place in the backlog and its window slot. */
+static void request_retire(obsws_connection_t *conn, pending_request_t *req) {
+    coalesce_detach(conn, req);
+    
+    if (atomic_load_explicit(&conn->backlog_count, memory_order_acquire) > 0) {
+        pthread_mutex_lock(&conn->backlog_mutex);
+        obsws_frame_t *frame = req->backlogged ? window_backlog_unlink(conn, req) : NULL;
+        pthread_mutex_unlock(&conn->backlog_mutex);
+        if (frame) {
+            frame_free(conn, frame);
+        }
+    }
+    
+    pthread_mutex_lock(&req->mutex);
+    note_abandoned_locked(conn, req);  /* Still holding a slot, so it never completed */
+    window_return_slot_locked(conn, req);
+    pthread_mutex_unlock(&req->mutex);
+}
+
+/* ============================================================================
+ * Cancellation
+ * ============================================================================ */
+
+/* End a request with OBSWS_ERROR_CANCELLED if it hasn't ended yet. It stays in
+   the table and leaves the usual way - its waiter, or dispatch_completions()
+   for an async request, takes it out - so this is safe from any thread.
+   Everything that needs the connection happens before req->mutex is let go:
+   until then the request can't be retired, so the connection is still there.
+   Returns true if this call cancelled it. */
+static bool cancel_request(pending_request_t *req) {
+    pthread_mutex_lock(&req->mutex);
+    bool cancelled = !req->completed;
+    if (cancelled) {
+        obsws_connection_t *conn = req->conn;
+        note_abandoned_locked(conn, req);
+        atomic_store(&req->cancelled, true);
+        req->error = OBSWS_ERROR_CANCELLED;
+        req->response->success = false;
+        req->response->error_message = strdup(obsws_error_string(OBSWS_ERROR_CANCELLED));
+        complete_request_locked(conn, req);
+        
+        pthread_mutex_lock(&conn->stats_mutex);
+        conn->stats.requests_cancelled++;
+        pthread_mutex_unlock(&conn->stats_mutex);
+        
+        /* Wake a caller still waiting for a window slot, and the event thread:
+           it runs async completions, and an external-loop caller may be
+           asleep in obsws_process_events() */
+        if (atomic_load(&conn->window_waiters) > 0) {
+            pthread_mutex_lock(&conn->window_mutex);
+            pthread_cond_broadcast(&conn->window_cond);
+            pthread_mutex_unlock(&conn->window_mutex);
+        }
+        connection_kick(conn);
+    }
+    pthread_mutex_unlock(&req->mutex);
+    return cancelled;
+}
+
+static void run_completion(void *arg) {
+    pending_request_t *req = (pending_request_t *)arg;
+    if (req->callback) {
+        req->callback(req->error, req->response, req->callback_data);
+    }
+    release_pending_request(req);
+}
+
+static bool take_completed_async(obsws_connection_t *conn, pending_request_t *req, void *arg) {
+    if (!req->async) return false;
+    pthread_mutex_lock(&req->mutex);
+    bool finished = req->completed;
+    pthread_mutex_unlock(&req->mutex);
+    return finished;
+}
+
+/* Take completed async requests out of the table and run their callbacks - on
+   this thread, or handed to config.completion_executor. Called by the event
+   thread after anything that can complete a request, and by obsws_disconnect().
+   The callback may send new requests, which is why no lock is held for it. */
+static void dispatch_completions(obsws_connection_t *conn) {
+    if (!atomic_exchange_explicit(&conn->completions_pending, false, memory_order_acq_rel)) {
+        return;
+    }
+    
+    pending_request_t *done = visit_pending_requests(conn, take_completed_async, NULL);
+    while (done) {
+        pending_request_t *req = done;
+        done = req->next;
+        req->next = NULL;
+        request_retire(conn, req);
+        if (req->callback && conn->config.completion_executor) {
+            conn->config.completion_executor(run_completion, req, conn->config.executor_data);
+        } else {
+            run_completion(req);
+        }
+    }
+}
+
+/* Find a pending request by its ID - only its own shard is locked */
+static pending_request_t* find_pending_request(obsws_connection_t *conn, const char *request_id) {
+    uint64_t seq;
+    if (!request_id_parse(request_id, strlen(request_id), conn->request_id_prefix, &seq)) {
+        return NULL;
+    }
+    request_shard_t *shard = request_shard(conn, seq);
+    
+    pthread_mutex_lock(&shard->mutex);
+    pending_request_t *req = request_shard_lookup(shard, seq);
+    pthread_mutex_unlock(&shard->mutex);
+    return req;
+}
+
+/* Late responses. A request that was cancelled or timed out after going out
+   may still be answered; nobody wants that answer, so it's dropped with a
+   debug line rather than the warning an unknown ID gets. */
+
+/* Is this an ID we handed out? (Whether or not the request is still around.) */
+static bool request_id_issued(obsws_connection_t *conn, const char *request_id, uint64_t *seq) {
+    return request_id_parse(request_id, strlen(request_id), conn->request_id_prefix, seq) &&
+           *seq < atomic_load_explicit(&conn->next_request_seq, memory_order_relaxed);
+}
+
+/* Is this the ID of one of our requests that has already ended? Used on raw
+   messages, before they're parsed. */
+static bool request_id_abandoned(obsws_connection_t *conn, const char *request_id) {
+    uint64_t seq;
+    if (!request_id_issued(conn, request_id, &seq)) {
+        return false;
+    }
+    request_shard_t *shard = request_shard(conn, seq);
+    
+    pthread_mutex_lock(&shard->mutex);
+    pending_request_t *req = request_shard_lookup(shard, seq);
+    bool ended = true;
+    if (req) {
+        pthread_mutex_lock(&req->mutex);
+        ended = req->completed;
+        pthread_mutex_unlock(&req->mutex);
+    }
+    pthread_mutex_unlock(&shard->mutex);
+    return ended;
+}
+
+/* One response fewer owed - it turned up late, or its request never went out */
+static void abandoned_settle(obsws_connection_t *conn) {
+    unsigned owed = atomic_load_explicit(&conn->abandoned_count, memory_order_relaxed);
+    while (owed > 0 && !atomic_compare_exchange_weak_explicit(&conn->abandoned_count, &owed, owed - 1,
+                                                              memory_order_relaxed, memory_order_relaxed)) {
+        /* owed reloaded - try again */
+    }
+}
+
+static void late_response_dropped(obsws_connection_t *conn, const char *request_id) {
+    obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Dropped late response for request: %s", request_id);
+    abandoned_settle(conn);
+    
+    pthread_mutex_lock(&conn->stats_mutex);
+    conn->stats.late_responses++;
+    pthread_mutex_unlock(&conn->stats_mutex);
+}
+
+/* Can this request safely run twice? OBS v5 request names say what they do:
+   Get* only reads, and Set* assigns an absolute value, so a second run leaves
+   OBS exactly as the first did. Everything else (Start*, Stop*, Toggle*,
+   Create*, Remove*, Trigger*, ...) has effects that stack. */
+static bool request_is_idempotent(const char *request_type) {
+    return strncmp(request_type, "Get", 3) == 0 || strncmp(request_type, "Set", 3) == 0;
+}
+
+/* Does this request only read? Those are the ones coalesce_reads may share. */
+static bool request_is_read_only(const char *request_type) {
+    return strncmp(request_type, "Get", 3) == 0;
+}
+
+/* Which lane a request type goes in: a rule from obsws_set_request_priority()
+   if there is one, else normal. Nothing is realtime unless the application
+   says so - moving a request ahead of ones sent before it changes the order
+   OBS sees them in, and only the caller knows when that's safe. */
+static obsws_priority_t request_priority(obsws_connection_t *conn, const char *request_type) {
+    if (atomic_load_explicit(&conn->priority_rule_count, memory_order_acquire) > 0) {
+        obsws_priority_t priority = OBSWS_PRIORITY_COUNT;
+        pthread_mutex_lock(&conn->priority_mutex);
+        size_t count = atomic_load_explicit(&conn->priority_rule_count, memory_order_relaxed);
+        for (size_t i = 0; i < count; i++) {
+            if (strcmp(conn->priority_rules[i].request_type, request_type) == 0) {
+                priority = conn->priority_rules[i].priority;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&conn->priority_mutex);
+        if (priority != OBSWS_PRIORITY_COUNT) return priority;
+    }
+    return OBSWS_PRIORITY_NORMAL;
+}
+
+/* Remove a pending request from the request table and free it */
+static void remove_pending_request(obsws_connection_t *conn, pending_request_t *target) {
+    request_shard_t *shard = request_shard(conn, target->seq);
+    
+    pthread_mutex_lock(&shard->mutex);
+    bool found = request_shard_unlink(conn, shard, target);
+    pthread_mutex_unlock(&shard->mutex);
+    
+    if (found) {
+        request_retire(conn, target);
+        free_pending_request(target);
+    }
+}
+
+/* Add a request's deadline to the heap. Any thread. Returns false if the heap
+   couldn't grow; *earliest says whether it went in at the top, ahead of
+   whatever sul_deadline is armed for. */
+static bool deadline_push(obsws_connection_t *conn, uint64_t deadline_ms, uint64_t seq, bool *earliest) {
+    pthread_mutex_lock(&conn->deadline_mutex);
+    
+    if (conn->deadline_count == conn->deadline_capacity) {
+        size_t capacity = conn->deadline_capacity ? conn->deadline_capacity * 2 : OBSWS_DEADLINE_HEAP_INITIAL;
+        request_deadline_t *heap = realloc(conn->deadlines, capacity * sizeof(request_deadline_t));
+        if (!heap) {
+            pthread_mutex_unlock(&conn->deadline_mutex);
+            return false;
+        }
+        conn->deadlines = heap;
+        conn->deadline_capacity = capacity;
+    }
+    
+    /* Sift up */
+    request_deadline_t *heap = conn->deadlines;
+    size_t i = conn->deadline_count++;
+    while (i > 0 && heap[(i - 1) / 2].deadline_ms > deadline_ms) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i].deadline_ms = deadline_ms;
+    heap[i].seq = seq;
+    *earliest = (i == 0);
+    
+    pthread_mutex_unlock(&conn->deadline_mutex);
+    return true;
+}
+
+/* Pop the earliest entry if it's due by now_ms. Otherwise leave the heap as is
+   and report the earliest deadline through next_ms (0 if the heap is empty). */
+static bool deadline_pop_due(obsws_connection_t *conn, uint64_t now_ms, uint64_t *seq, uint64_t *next_ms) {
+    pthread_mutex_lock(&conn->deadline_mutex);
+    
+    request_deadline_t *heap = conn->deadlines;
+    if (conn->deadline_count == 0 || heap[0].deadline_ms > now_ms) {
+        *next_ms = conn->deadline_count ? heap[0].deadline_ms : 0;
+        pthread_mutex_unlock(&conn->deadline_mutex);
+        return false;
+    }
+    
+    *seq = heap[0].seq;
+    
+    /* Move the last entry to the root and sift it down */
+    request_deadline_t last = heap[--conn->deadline_count];
+    size_t n = conn->deadline_count, i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= n) break;
+        if (child + 1 < n && heap[child + 1].deadline_ms < heap[child].deadline_ms) {
+            child++;
+        }
+        if (heap[child].deadline_ms >= last.deadline_ms) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    if (n > 0) {
+        heap[i] = last;
+    }
+    
+    pthread_mutex_unlock(&conn->deadline_mutex);
+    return true;
+}
+
+/* A deadline came up: time the request out if it's still waiting. Anything
+   that completed (or left the table) in the meantime is simply not there. */
+static void expire_request(obsws_connection_t *conn, uint64_t seq) {
+    request_shard_t *shard = request_shard(conn, seq);
+    
+    pthread_mutex_lock(&shard->mutex);
+    pending_request_t *req = request_shard_lookup(shard, seq);
+    if (req) {
+        pthread_mutex_lock(&req->mutex);
+        if (!req->completed) {
+            note_abandoned_locked(conn, req);
+            req->error = OBSWS_ERROR_TIMEOUT;
+            req->response->success = false;
+            req->response->error_message = strdup("Request timeout");
+            complete_request_locked(conn, req);  /* Wake waiting threads */
+        }
+        pthread_mutex_unlock(&req->mutex);
+    }
+    pthread_mutex_unlock(&shard->mutex);
+}
+
+/* ============================================================================
+ * Timers
+ * ============================================================================ */
+
+/* Request deadlines. sul_deadline is kept scheduled for the earliest deadline
+   in the heap; when it fires, every request that's due is timed out and the
+   timer moves on to the next one. Shard thread only, like every lws_sul. */
+static void request_deadline_cb(lws_sorted_usec_list_t *sul);
+
+static void arm_request_deadline(obsws_connection_t *conn) {
+    pthread_mutex_lock(&conn->deadline_mutex);
+    uint64_t next_ms = conn->deadline_count ? conn->deadlines[0].deadline_ms : 0;
+    pthread_mutex_unlock(&conn->deadline_mutex);
+    
+    if (next_ms && (!conn->deadline_armed_ms || next_ms < conn->deadline_armed_ms)) {
+        uint64_t now = monotonic_ms();
+        conn->deadline_armed_ms = next_ms;
+        lws_sul_schedule(conn->lws_context, 0, &conn->sul_deadline, request_deadline_cb,
+                         next_ms > now ? (lws_usec_t)(next_ms - now) * LWS_US_PER_MS : 0);
+    }
+}
+
+static void request_deadline_cb(lws_sorted_usec_list_t *sul) {
+    obsws_connection_t *conn = OBSWS_CONTAINER_OF(sul, obsws_connection_t, sul_deadline);
+    uint64_t now = monotonic_ms();
+    uint64_t seq, next_ms;
+    
+    conn->deadline_armed_ms = 0;
+    while (deadline_pop_due(conn, now, &seq, &next_ms)) {
+        expire_request(conn, seq);
+    }
+    dispatch_completions(conn);
+    arm_request_deadline(conn);
+}
+
+/* Dead-peer detection. Armed when a ping goes out, cancelled by the matching
+   pong. If it fires, OBS (or the path to it) has stalled: a healthy peer
+   answers a ping in milliseconds even while busy. We don't attempt a close
+   handshake - a stalled peer won't answer that either - and just have lws
+   drop the socket, which sends us through WSI_DESTROY into the reconnect
+   logic. */
+static void ping_timeout_cb(lws_sorted_usec_list_t *sul) {
+    obsws_connection_t *conn = OBSWS_CONTAINER_OF(sul, obsws_connection_t, sul_ping_timeout);
+    
+    if (!conn->ping_sent_us || !conn->wsi) {
+        return;
+    }
+    
+    obsws_log(conn, OBSWS_LOG_ERROR, "No pong within %u ms - dropping connection",
+              conn->config.ping_timeout_ms);
+    pthread_mutex_lock(&conn->stats_mutex);
+    conn->stats.ping_timeouts++;
+    conn->stats.error_count++;
+    pthread_mutex_unlock(&conn->stats_mutex);
+    
+    conn->ping_sent_us = 0;
+    lws_set_timeout(conn->wsi, PENDING_TIMEOUT_USER_OK, LWS_TO_KILL_ASYNC);
+}
+
+/* Keep-alive. Armed when the connection reaches CONNECTED and re-armed every
+   ping_interval_ms for as long as it stays there. The ping itself goes out
+   from the writable callback, ahead of any queued frames. */
+static void keepalive_cb(lws_sorted_usec_list_t *sul) {
+    obsws_connection_t *conn = OBSWS_CONTAINER_OF(sul, obsws_connection_t, sul_keepalive);
+    
+    if (conn->state != OBSWS_STATE_CONNECTED || !conn->wsi) {
+        return;
+    }
+    
+    if (conn->ping_sent_us && conn->config.ping_timeout_ms == 0) {
+        /* No ping timeout to give up on it for us: a ping still unanswered a
+           whole interval later is lost, and mustn't stop every ping after it.
+           Its pong, should it turn up, no longer matches ping_seq. */
+        obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Ping #%llu unanswered - sending a new one",
+                    (unsigned long long)conn->ping_seq);
+        conn->ping_sent_us = 0;
+    }
+    
+    conn->ping_due = true;
+    lws_callback_on_writable(conn->wsi);
+    
+    lws_sul_schedule(conn->lws_context, 0, &conn->sul_keepalive, keepalive_cb,
+                     (lws_usec_t)conn->config.ping_interval_ms * LWS_US_PER_MS);
+}
+
+static void arm_keepalive(obsws_connection_t *conn) {
+    if (conn->config.ping_interval_ms > 0) {
+        lws_sul_schedule(conn->lws_context, 0, &conn->sul_keepalive, keepalive_cb,
+                         (lws_usec_t)conn->config.ping_interval_ms * LWS_US_PER_MS);
+    }
+}
+
+/* Drop every timer of a connection. Shard thread only (or after it has
+   stopped) - must happen before the connection is freed. */
+static void cancel_connection_timers(obsws_connection_t *conn) {
+    lws_sul_cancel(&conn->sul_keepalive);
+    lws_sul_cancel(&conn->sul_deadline);
+    lws_sul_cancel(&conn->sul_shrink);
+    lws_sul_cancel(&conn->sul_reconnect);
+    lws_sul_cancel(&conn->sul_ping_timeout);
+    conn->deadline_armed_ms = 0;
+    conn->shrink_armed = false;
+}
+
+/* ============================================================================
+ * Outbound Send Queue
+ * ============================================================================ */
+
+static void mpsc_init(obsws_mpsc_queue_t *q) {
+    atomic_store_explicit(&q->stub.next, NULL, memory_order_relaxed);
+    atomic_store_explicit(&q->head, &q->stub, memory_order_relaxed);
+    q->tail = &q->stub;
+    atomic_store_explicit(&q->depth, 0, memory_order_relaxed);
+}
+
+/* Append a node. Safe from any number of threads at once - wait-free. */
+static void mpsc_push(obsws_mpsc_queue_t *q, obsws_queue_node_t *node) {
+    atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+    obsws_queue_node_t *prev = atomic_exchange_explicit(&q->head, node, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, node, memory_order_release);
+}
+
+/* Remove the oldest node. Event thread only. Returns NULL if the queue is empty
+   or a producer is half-way through mpsc_push(); the depth counter tells the
+   two cases apart. */
+static obsws_queue_node_t* mpsc_pop(obsws_mpsc_queue_t *q) {
+    obsws_queue_node_t *tail = q->tail;
+    obsws_queue_node_t *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    
+    /* Skip over the stub if it's at the front */
+    if (tail == &q->stub) {
+        if (!next) return NULL;
+        q->tail = next;
+        tail = next;
+        next = atomic_load_explicit(&next->next, memory_order_acquire);
+    }
+    
+    if (next) {
+        q->tail = next;
+        return tail;
+    }
+    
+    /* tail is the last linked node. If head moved on, a producer is mid-push. */
+    if (tail != atomic_load_explicit(&q->head, memory_order_acquire)) {
+        return NULL;
+    }
+    
+    /* Re-insert the stub behind the last node so we can hand that node out */
+    mpsc_push(q, &q->stub);
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (next) {
+        q->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+/* Get a frame with room for len payload bytes behind the LWS_PRE headroom.
+   Small frames come from the connection's pool when one is free; the pool
+   starts empty and fills up as frames are written and handed back. */
+static obsws_frame_t* frame_alloc(obsws_connection_t *conn, size_t len) {
+    obsws_frame_t *frame = NULL;
+    size_t cap = len;
+    
+    if (len <= OBSWS_FRAME_POOL_PAYLOAD) {
+        cap = OBSWS_FRAME_POOL_PAYLOAD;
+        pthread_mutex_lock(&conn->frame_pool_mutex);
+        frame = conn->frame_pool;
+        if (frame) {
+            conn->frame_pool = frame->pool_next;
+            conn->frame_pool_count--;
+        }
+        pthread_mutex_unlock(&conn->frame_pool_mutex);
+    }
+    
+    if (!frame) {
+        frame = malloc(sizeof(obsws_frame_t) + LWS_PRE + cap + 1);
+        if (!frame) return NULL;
+        frame->cap = cap;
+    }
+    
+    frame->pool_next = NULL;
+    frame->request_id[0] = '\0';
+    frame->lane = OBSWS_PRIORITY_NORMAL;
+    frame->len = len;
+    return frame;
+}
+
+/* Return a frame to the pool, or free it if it's oversized or the pool is full */
+static void frame_free(obsws_connection_t *conn, obsws_frame_t *frame) {
+    if (!frame) return;
+    
+    if (frame->cap == OBSWS_FRAME_POOL_PAYLOAD) {
+        pthread_mutex_lock(&conn->frame_pool_mutex);
+        if (conn->frame_pool_count < OBSWS_FRAME_POOL_MAX) {
+            frame->pool_next = conn->frame_pool;
+            conn->frame_pool = frame;
+            conn->frame_pool_count++;
+            frame = NULL;
+        }
+        pthread_mutex_unlock(&conn->frame_pool_mutex);
+    }
+    
+    free(frame);
+}
+
+/* Release every idle pooled frame - teardown only */
+static void frame_pool_destroy(obsws_connection_t *conn) {
+    pthread_mutex_lock(&conn->frame_pool_mutex);
+    obsws_frame_t *frame = conn->frame_pool;
+    while (frame) {
+        obsws_frame_t *next = frame->pool_next;
+        free(frame);
+        frame = next;
+    }
+    conn->frame_pool = NULL;
+    conn->frame_pool_count = 0;
+    pthread_mutex_unlock(&conn->frame_pool_mutex);
+}
+
+/* Wake whoever services the shard: lws_cancel_service() for our own threads,
+   or the wake pipe an external event loop is watching. A full pipe just means
+   a wakeup is already pending. */
+static void shard_wake(obsws_shard_t *shard) {
+    if (shard->external) {
+        ssize_t n = write(shard->wake_fd[1], "w", 1);
+        (void)n;
+    } else {
+        lws_cancel_service(shard->context);
+    }
+}
+
+/* Hand a frame to the event thread. Ownership of the frame moves to the queue.
+   
+   lws_cancel_service() is the one libwebsockets call documented as safe from
+   any thread - it pokes the service loop, which then raises
+   LWS_CALLBACK_EVENT_WAIT_CANCELLED on the shard thread. That handler asks for
+   a writable callback on every connection in the shard's ready queue, and the
+   frame goes out from there. (With an external event loop, the wake pipe
+   takes lws_cancel_service()'s place - see shard_wake().)
+   
+   The connection joins the ready queue at most once at a time: if it's already
+   there, whoever put it there also woke the shard, and the writable callback
+   that follows drains everything queued up to that point and beyond.
+   
+   connection_kick() is that second half on its own, for requests that carry
+   no frame (obsws_reconnect, obsws_ping) - the shard thread checks their
+   flags when it pops the connection. */
+static void connection_kick(obsws_connection_t *conn) {
+    obsws_shard_t *shard = conn->shard;
+    if (shard && !atomic_exchange_explicit(&conn->write_scheduled, true, memory_order_acq_rel)) {
+        atomic_fetch_add_explicit(&shard->ready.depth, 1, memory_order_relaxed);
+        mpsc_push(&shard->ready, &conn->ready_node);
+        shard_wake(shard);
+    }
+}
+
+/* Hand a frame to the shard thread. Any thread, under any lock. If the
+   connection is offline - no socket, no reconnect coming - the kick has the
+   shard thread fail the frame's request with OBSWS_ERROR_NOT_CONNECTED right
+   away (see shard_dispatch_writes()) instead of leaving it to wait for a
+   write that will never happen. */
+static void enqueue_frame(obsws_connection_t *conn, obsws_frame_t *frame) {
+    obsws_mpsc_queue_t *queue = &conn->send_queue[frame->lane];
+    frame->queued_us = monotonic_us();
+    /* Count first so the consumer never sees the node without the count */
+    atomic_fetch_add_explicit(&queue->depth, 1, memory_order_relaxed);
+    mpsc_push(queue, &frame->node);
+    connection_kick(conn);
+}
+
+static size_t send_lane_depth(obsws_connection_t *conn, obsws_priority_t lane) {
+    return atomic_load_explicit(&conn->send_queue[lane].depth, memory_order_acquire);
+}
+
+static bool send_queue_pending(obsws_connection_t *conn) {
+    for (int lane = 0; lane < OBSWS_PRIORITY_COUNT; lane++) {
+        if (send_lane_depth(conn, (obsws_priority_t)lane) > 0) return true;
+    }
+    return false;
+}
+
+/* Which lane to write from next: realtime whenever it has anything, then
+   normal - but while both normal and bulk are waiting, each write adds
+   bulk_share to a credit and bulk goes whenever it reaches 100. Work
+   conserving: a lane with nothing queued never holds the others up. Event
+   thread only. */
+static obsws_priority_t send_lane_next(obsws_connection_t *conn) {
+    if (send_lane_depth(conn, OBSWS_PRIORITY_REALTIME) > 0) {
+        return OBSWS_PRIORITY_REALTIME;
+    }
+    if (send_lane_depth(conn, OBSWS_PRIORITY_BULK) == 0) {
+        return OBSWS_PRIORITY_NORMAL;
+    }
+    if (send_lane_depth(conn, OBSWS_PRIORITY_NORMAL) == 0) {
+        return OBSWS_PRIORITY_BULK;
+    }
+    
+    conn->bulk_credit += conn->config.bulk_share;
+    if (conn->bulk_credit >= 100) {
+        conn->bulk_credit -= 100;
+        return OBSWS_PRIORITY_BULK;
+    }
+    return OBSWS_PRIORITY_NORMAL;
+}
+
+/* Free everything left in the queues - used on teardown after the event thread exits */
+static void drain_send_queue(obsws_connection_t *conn) {
+    for (int lane = 0; lane < OBSWS_PRIORITY_COUNT; lane++) {
+        obsws_queue_node_t *node;
+        while ((node = mpsc_pop(&conn->send_queue[lane])) != NULL) {
+            atomic_fetch_sub_explicit(&conn->send_queue[lane].depth, 1, memory_order_relaxed);
+            frame_free(conn, (obsws_frame_t *)node);
+        }
+    }
+}
+
+/* Complete a pending request with a transport error (write failed, etc).
+   The waiting thread wakes up and returns the error instead of timing out. */
+static void fail_pending_request(obsws_connection_t *conn, const char *request_id,
+                                 obsws_error_t error, const char *reason) {
+    uint64_t seq;
+    if (!request_id_parse(request_id, strlen(request_id), conn->request_id_prefix, &seq)) {
+        return;
+    }
+    request_shard_t *shard = request_shard(conn, seq);
+    
+    pthread_mutex_lock(&shard->mutex);
+    pending_request_t *req = request_shard_lookup(shard, seq);
+    if (req) {
+        pthread_mutex_lock(&req->mutex);
+        if (!req->completed) {
+            req->error = error;
+            req->response->success = false;
+            req->response->error_message = strdup(reason);
+            complete_request_locked(conn, req);
+        }
+        pthread_mutex_unlock(&req->mutex);
+    }
+    pthread_mutex_unlock(&shard->mutex);
+}
+
+/* Nothing will ever write what's queued: fail each request in it with
+   OBSWS_ERROR_NOT_CONNECTED rather than leave it to time out. Shard thread
+   only, with no socket and no reconnect coming (conn->offline). */
+static void fail_send_queue(obsws_connection_t *conn) {
+    for (int lane = 0; lane < OBSWS_PRIORITY_COUNT; lane++) {
+        obsws_queue_node_t *node;
+        while ((node = mpsc_pop(&conn->send_queue[lane])) != NULL) {
+            atomic_fetch_sub_explicit(&conn->send_queue[lane].depth, 1, memory_order_relaxed);
+            obsws_frame_t *frame = (obsws_frame_t *)node;
+            if (frame->request_id[0]) {
+                fail_pending_request(conn, frame->request_id, OBSWS_ERROR_NOT_CONNECTED, "Not connected");
+            }
+            frame_free(conn, frame);
+        }
+    }
+}
+
+/* Settle one request whose connection went away: hold it for replay if it's
+   idempotent and a reconnect is coming, otherwise fail it now. Caller holds
+   the request's shard lock. */
+static void hold_or_fail_locked(obsws_connection_t *conn, pending_request_t *req, bool will_reconnect) {
+    pthread_mutex_lock(&req->mutex);
+    if (will_reconnect && req->leader) {
+        /* A coalesced follower: its leader is held (or failed) and settles it */
+    } else if (will_reconnect && req->backlogged) {
+        /* Never sent - it goes out from the backlog once there's a socket */
+    } else if (!req->completed) {
+        if (will_reconnect && (req->replay_type || req->replay_batch || req->replay_template)) {
+            req->held = true;
+        } else {
+            req->error = OBSWS_ERROR_NOT_CONNECTED;
+            req->response->success = false;
+            req->response->error_message = strdup("Connection lost");
+            complete_request_locked(conn, req);
+        }
+    }
+    pthread_mutex_unlock(&req->mutex);
+}
+
+static bool hold_or_fail_visit(obsws_connection_t *conn, pending_request_t *req, void *arg) {
+    hold_or_fail_locked(conn, req, *(const bool *)arg);
+    return false;
+}
+
+/* Settle every outstanding request after the connection dropped */
+static void hold_or_fail_requests(obsws_connection_t *conn, bool will_reconnect) {
+    visit_pending_requests(conn, hold_or_fail_visit, &will_reconnect);
+}
+
+/* Same for a single request, by ID - for a frame that reached the event thread
+   while the connection was between sockets */
+static void hold_or_fail_request(obsws_connection_t *conn, const char *request_id, bool will_reconnect) {
+    uint64_t seq;
+    if (!request_id_parse(request_id, strlen(request_id), conn->request_id_prefix, &seq)) {
+        return;
+    }
+    request_shard_t *shard = request_shard(conn, seq);
+    
+    pthread_mutex_lock(&shard->mutex);
+    pending_request_t *req = request_shard_lookup(shard, seq);
+    if (req) {
+        hold_or_fail_locked(conn, req, will_reconnect);
+    }
+    pthread_mutex_unlock(&shard->mutex);
+}
+
+/* Write a WebSocket ping carrying our sequence number. Writable callback only.
+   With a ping already outstanding we don't send another - its pong (or its
+   timeout) answers for both. */
+static int send_ping(obsws_connection_t *conn, struct lws *wsi) {
+    conn->ping_due = false;
+    
+    if (!conn->ping_sent_us) {
+        unsigned char buf[LWS_PRE + sizeof(uint64_t)];
+        uint64_t seq = ++conn->ping_seq;
+        memcpy(buf + LWS_PRE, &seq, sizeof(seq));
+        
+        if (lws_write(wsi, buf + LWS_PRE, sizeof(seq), LWS_WRITE_PING) < (int)sizeof(seq)) {
+            obsws_log(conn, OBSWS_LOG_ERROR, "Failed to send keep-alive ping");
+            return -1;
+        }
+        conn->ping_sent_us = monotonic_us();
+        
+        if (conn->config.ping_timeout_ms > 0) {
+            lws_sul_schedule(conn->lws_context, 0, &conn->sul_ping_timeout, ping_timeout_cb,
+                             (lws_usec_t)conn->config.ping_timeout_ms * LWS_US_PER_MS);
+        }
+        obsws_debug(conn, OBSWS_DEBUG_HIGH, "Sent ping #%llu", (unsigned long long)seq);
+    }
+    
+    if (send_queue_pending(conn)) {
+        lws_callback_on_writable(wsi);
+    }
+    return 0;
+}
+
+/* Fold one RTT sample into the stats. The window gives a mean, min and max
+   that follow the link as it is now, and jitter as the mean difference
+   between consecutive samples. Event thread only. */
+static void record_rtt(obsws_connection_t *conn, uint64_t rtt_us) {
+    if (rtt_us > UINT32_MAX) rtt_us = UINT32_MAX;
+    
+    pthread_mutex_lock(&conn->stats_mutex);
+    conn->rtt_window[conn->rtt_next] = (uint32_t)rtt_us;
+    conn->rtt_next = (conn->rtt_next + 1) % OBSWS_RTT_WINDOW;
+    if (conn->rtt_count < OBSWS_RTT_WINDOW) conn->rtt_count++;
+    
+    /* Walk oldest to newest so consecutive entries are consecutive samples */
+    size_t start = (conn->rtt_next + OBSWS_RTT_WINDOW - conn->rtt_count) % OBSWS_RTT_WINDOW;
+    uint64_t sum = 0, diff_sum = 0, min = UINT64_MAX, max = 0;
+    uint32_t prev = 0;
+    for (size_t i = 0; i < conn->rtt_count; i++) {
+        uint32_t v = conn->rtt_window[(start + i) % OBSWS_RTT_WINDOW];
+        sum += v;
+        if (v < min) min = v;
+        if (v > max) max = v;
+        if (i > 0) diff_sum += v > prev ? v - prev : prev - v;
+        prev = v;
+    }
+    
+    conn->stats.last_rtt_us = rtt_us;
+    conn->stats.last_ping_ms = (rtt_us + 500) / 1000;
+    conn->stats.rtt_mean_us = sum / conn->rtt_count;
+    conn->stats.rtt_min_us = min;
+    conn->stats.rtt_max_us = max;
+    conn->stats.rtt_jitter_us = conn->rtt_count > 1 ? diff_sum / (conn->rtt_count - 1) : 0;
+    pthread_mutex_unlock(&conn->stats_mutex);
+}
+
+/* LWS_CALLBACK_CLIENT_RECEIVE_PONG. Only the pong echoing our outstanding
+   ping counts - unsolicited or stale pongs are ignored. */
+static void handle_pong(obsws_connection_t *conn, const void *in, size_t len) {
+    uint64_t seq;
+    if (!conn->ping_sent_us || len != sizeof(seq)) {
+        return;
+    }
+    memcpy(&seq, in, sizeof(seq));
+    if (seq != conn->ping_seq) {
+        return;
+    }
+    
+    uint64_t rtt_us = monotonic_us() - conn->ping_sent_us;
+    conn->ping_sent_us = 0;
+    lws_sul_cancel(&conn->sul_ping_timeout);
+    record_rtt(conn, rtt_us);
+    
+    obsws_debug(conn, OBSWS_DEBUG_HIGH, "Pong #%llu - RTT %llu us",
+                (unsigned long long)seq, (unsigned long long)rtt_us);
+    
+    pthread_mutex_lock(&conn->ping_mutex);
+    conn->pong_count++;
+    pthread_cond_broadcast(&conn->ping_cond);
+    pthread_mutex_unlock(&conn->ping_mutex);
+}
+
+/* Write the next queued frame. Called from LWS_CALLBACK_CLIENT_WRITEABLE only.
+   
+   We write at most one frame per callback and re-arm if more are waiting - that
+   is the pattern libwebsockets expects, and it lets lws interleave control frames
+   and buffer partial socket writes itself. If the kernel send buffer is still
+   full (lws_send_pipe_choked) we don't write at all and wait for the next
+   callback instead of letting the frame get truncated.
+   
+   Returns -1 if the connection should be closed. */
+static int flush_send_queue(obsws_connection_t *conn, struct lws *wsi) {
+    if (conn->closing || conn->restarting) {
+        /* Detaching from a shared shard, or obsws_reconnect() - send a normal
+           close and let lws tear down */
+        lws_close_reason(wsi, LWS_CLOSE_STATUS_NORMAL, NULL, 0);
+        return -1;
+    }
+    
+    if (conn->ping_due) {
+        if (lws_send_pipe_choked(wsi)) {
+            lws_callback_on_writable(wsi);
+            return 0;
+        }
+        return send_ping(conn, wsi);
+    }
+    
+    if (!send_queue_pending(conn)) {
+        return 0;
+    }
+    
+    if (lws_send_pipe_choked(wsi)) {
+        lws_callback_on_writable(wsi);
+        return 0;
+    }
+    
+    obsws_priority_t lane = send_lane_next(conn);
+    obsws_queue_node_t *node = mpsc_pop(&conn->send_queue[lane]);
+    if (!node) {
+        /* A producer is mid-push - its wakeup will bring us back */
+        lws_callback_on_writable(wsi);
+        return 0;
+    }
+    atomic_fetch_sub_explicit(&conn->send_queue[lane].depth, 1, memory_order_relaxed);
+    
+    obsws_frame_t *frame = (obsws_frame_t *)node;
+    if (frame->request_id[0] && request_id_abandoned(conn, frame->request_id)) {
+        /* Cancelled or timed out while it sat in the queue. Sending it now
+           would only have OBS act on a request nobody is waiting for - and
+           no answer is owed for it after all. */
+        obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Dropped unsent request: %s", frame->request_id);
+        abandoned_settle(conn);
+        frame_free(conn, frame);
+        if (send_queue_pending(conn)) {
+            lws_callback_on_writable(wsi);
+        }
+        return 0;
+    }
+    if (frame->request_id[0] && conn->state != OBSWS_STATE_CONNECTED) {
+        /* Queued just as the old socket died, and only reaching us while the
+           new one is still handshaking. OBS would close us for a request sent
+           before Identify, so replay it after IDENTIFIED (or fail it) instead. */
+        hold_or_fail_request(conn, frame->request_id, true);
+        arm_request_deadline(conn);
+        frame_free(conn, frame);
+        if (send_queue_pending(conn)) {
+            lws_callback_on_writable(wsi);
+        }
+        return 0;
+    }
+    
+    bool deflated = conn->deflate_active && frame->len >= conn->config.compression_threshold;
+    conn->deflate_skip_tx = !deflated;
+    int written = lws_write(wsi, frame->buf + LWS_PRE, frame->len,
+                            conn->msgpack_active ? LWS_WRITE_BINARY : LWS_WRITE_TEXT);
+    
+    /* DEBUG_HIGH: Show bytes sent */
+    obsws_debug(conn, OBSWS_DEBUG_HIGH, "Sent %d bytes (requested %zu)", written, frame->len);
+    
+    int result = 0;
+    if (written < (int)frame->len) {
+        /* lws buffers partial socket writes internally, so a short count here
+           means the frame was not accepted. Don't drop it silently - fail the
+           request now rather than letting the caller sit until its timeout. */
+        obsws_log(conn, OBSWS_LOG_ERROR, "WebSocket write failed (%d of %zu bytes)", written, frame->len);
+        if (frame->request_id[0]) {
+            fail_pending_request(conn, frame->request_id, OBSWS_ERROR_SEND_FAILED, "Send failed");
+        }
+        pthread_mutex_lock(&conn->stats_mutex);
+        conn->stats.error_count++;
+        pthread_mutex_unlock(&conn->stats_mutex);
+        result = written < 0 ? -1 : 0;
+    } else {
+        uint64_t queued = monotonic_us() - frame->queued_us;
+        pthread_mutex_lock(&conn->stats_mutex);
+        conn->stats.messages_sent++;
+        conn->stats.bytes_sent += frame->len;
+        if (deflated) {
+            conn->stats.uncompressed_bytes_sent += frame->len;
+        }
+        conn->stats.lane_frames_sent[lane]++;
+        conn->stats.lane_queue_us_total[lane] += queued;
+        if (queued > conn->stats.lane_queue_us_max[lane]) {
+            conn->stats.lane_queue_us_max[lane] = queued;
+        }
+        pthread_mutex_unlock(&conn->stats_mutex);
+    }
+    
+    /* Its deadline is in the heap by now - make sure the timer covers it */
+    if (frame->request_id[0]) {
+        arm_request_deadline(conn);
+    }
+    frame_free(conn, frame);
+    
+    if (result == 0 && send_queue_pending(conn)) {
+        lws_callback_on_writable(wsi);
+    }
+    return result;
+}
+
+/* ============================================================================
+ * Request Serialization
+ * ============================================================================ */
+
+/* Requests used to take four copies on the way out: build a cJSON tree, print
+   it to a malloc'd string, strlen() it, then memcpy() it behind LWS_PRE. The
+   opcode 6 envelope is fixed-shape, so instead we measure the pieces, take a
+   frame of exactly the right size (usually from the pool) and write the JSON
+   text directly into its payload area:
+   
+     {"op":6,"d":{"requestType":"...","requestId":"...","requestData":...}}
+   
+   requestData is already JSON text supplied by the caller, so it is checked
+   for well-formedness with a non-allocating scanner and then copied in once.
+   Sending malformed JSON to OBS would get the whole connection closed with a
+   decode error, so a payload that fails the check is left out - the same
+   thing the old cJSON_Parse() path did. */
+
+/* Length of the len bytes at s once escaped as a JSON string body (without
+   the quotes). Length-based because MessagePack strings aren't terminated. */
+static size_t json_escaped_len(const char *s, size_t len) {
+    size_t n = 0;
+    const unsigned char *end = (const unsigned char *)s + len;
+    for (const unsigned char *p = (const unsigned char *)s; p < end; p++) {
+        if (*p == '"' || *p == '\\' || *p == '\b' || *p == '\f' ||
+            *p == '\n' || *p == '\r' || *p == '\t') {
+            n += 2;
+        } else if (*p < 0x20) {
+            n += 6;                         /* \u00XX */
+        } else {
+            n += 1;
+        }
+    }
+    return n;
+}
+
+/* Write len bytes of s escaped as a JSON string body. dst must have
+   json_escaped_len(s, len) bytes free. Returns the position just past the
+   last byte written. */
+static char* json_write_escaped(char *dst, const char *s, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char *end = (const unsigned char *)s + len;
+    for (const unsigned char *p = (const unsigned char *)s; p < end; p++) {
+        switch (*p) {
+            case '"':  *dst++ = '\\'; *dst++ = '"';  break;
+            case '\\': *dst++ = '\\'; *dst++ = '\\'; break;
+            case '\b': *dst++ = '\\'; *dst++ = 'b';  break;
+            case '\f': *dst++ = '\\'; *dst++ = 'f';  break;
+            case '\n': *dst++ = '\\'; *dst++ = 'n';  break;
+            case '\r': *dst++ = '\\'; *dst++ = 'r';  break;
+            case '\t': *dst++ = '\\'; *dst++ = 't';  break;
+            default:
+                if (*p < 0x20) {
+                    memcpy(dst, "\\u00", 4);
+                    dst[4] = hex[*p >> 4];
+                    dst[5] = hex[*p & 0x0F];
+                    dst += 6;
+                } else {
+                    *dst++ = (char)*p;
+                }
+                break;
+        }
+    }
+    return dst;
+}
+
+static const char* json_skip_ws(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+    return p;
+}
+
+/* Check that [p, end) starts with one well-formed JSON value and return the
+   position just past it, or NULL if it's malformed. Nothing is allocated -
+   this only walks the text. */
+static const char* json_skip_value(const char *p, const char *end, int depth) {
+    if (depth > OBSWS_JSON_MAX_DEPTH) return NULL;
+    p = json_skip_ws(p, end);
+    if (p >= end) return NULL;
+    
+    switch (*p) {
+        case '{':
+        case '[': {
+            const char close = (*p == '{') ? '}' : ']';
+            const bool is_object = (*p == '{');
+            p = json_skip_ws(p + 1, end);
+            if (p < end && *p == close) return p + 1;
+            for (;;) {
+                if (is_object) {
+                    p = json_skip_ws(p, end);
+                    if (p >= end || *p != '"') return NULL;
+                    p = json_skip_value(p, end, depth + 1);     /* key */
+                    if (!p) return NULL;
+                    p = json_skip_ws(p, end);
+                    if (p >= end || *p != ':') return NULL;
+                    p++;
+                }
+                p = json_skip_value(p, end, depth + 1);
+                if (!p) return NULL;
+                p = json_skip_ws(p, end);
+                if (p >= end) return NULL;
+                if (*p == close) return p + 1;
+                if (*p != ',') return NULL;
+                p++;
+            }
+        }
+        case '"':
+            for (p++; p < end; p++) {
+                unsigned char c = (unsigned char)*p;
+                if (c == '"') return p + 1;
+                if (c < 0x20) return NULL;
+                if (c == '\\') {
+                    if (++p >= end) return NULL;
+                    if (*p == 'u') {
+                        if (end - p < 5) return NULL;
+                        for (int i = 1; i <= 4; i++) {
+                            if (!isxdigit((unsigned char)p[i])) return NULL;
+                        }
+                        p += 4;
+                    } else if (!strchr("\"\\/bfnrt", *p)) {
+                        return NULL;
+                    }
+                }
+            }
+            return NULL;
+        case 't':
+            return (end - p >= 4 && memcmp(p, "true", 4) == 0) ? p + 4 : NULL;
+        case 'f':
+            return (end - p >= 5 && memcmp(p, "false", 5) == 0) ? p + 5 : NULL;
+        case 'n':
+            return (end - p >= 4 && memcmp(p, "null", 4) == 0) ? p + 4 : NULL;
+        default: {
+            /* Number: -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)? */
+            const char *start = p;
+            if (p < end && *p == '-') p++;
+            if (p >= end || !isdigit((unsigned char)*p)) return NULL;
+            if (*p == '0') {
+                p++;
+            } else {
+                while (p < end && isdigit((unsigned char)*p)) p++;
+            }
+            if (p < end && *p == '.') {
+                p++;
+                if (p >= end || !isdigit((unsigned char)*p)) return NULL;
+                while (p < end && isdigit((unsigned char)*p)) p++;
+            }
+            if (p < end && (*p == 'e' || *p == 'E')) {
+                p++;
+                if (p < end && (*p == '+' || *p == '-')) p++;
+                if (p >= end || !isdigit((unsigned char)*p)) return NULL;
+                while (p < end && isdigit((unsigned char)*p)) p++;
+            }
+            return p > start ? p : NULL;
+        }
+    }
+}
+
+/* Find the single JSON value in text, with surrounding whitespace trimmed off.
+   Returns false if text isn't exactly one well-formed value. */
+static bool json_value_span(const char *text, size_t len, const char **start_out, size_t *len_out) {
+    const char *end = text + len;
+    const char *start = json_skip_ws(text, end);
+    const char *stop = json_skip_value(start, end, 0);
+    if (!stop || json_skip_ws(stop, end) != end) {
+        return false;
+    }
+    *start_out = start;
+    *len_out = (size_t)(stop - start);
+    return true;
+}
+
+static obsws_frame_t* build_request_frame_msgpack(obsws_connection_t *conn, const char *request_type,
+                                                  const char *request_id, const char *data, size_t data_len);
+
+/* The fixed pieces of the envelope, shared with the request templates */
+static const char request_part_op[] = "{\"op\":6,\"d\":{\"requestType\":\"";
+static const char request_part_id[] = "\",\"requestId\":\"";
+static const char request_part_data[] = "\",\"requestData\":";
+static const char request_part_end_data[] = "}}";
+static const char request_part_end_nodata[] = "\"}}";
+
+/* Serialize an opcode 6 Request envelope straight into a frame.
+   
+   data/data_len is the requestData, already validated as one JSON value, or
+   NULL to omit it. The frame comes back sized exactly for the message with
+   request_id already filled in, ready for enqueue_frame(). On an
+   obswebsocket.msgpack connection the envelope is MessagePack instead, with
+   requestData transcoded from the JSON. Returns NULL only if allocation fails. */
+static obsws_frame_t* build_request_frame_span(obsws_connection_t *conn, const char *request_type,
+                                               const char *request_id, const char *data, size_t data_len) {
+    if (conn->msgpack_active) {
+        return build_request_frame_msgpack(conn, request_type, request_id, data, data_len);
+    }
+    
+    size_t type_raw_len = strlen(request_type);
+    size_t type_len = json_escaped_len(request_type, type_raw_len);
+    size_t id_len = strlen(request_id);
+    size_t len = (sizeof(request_part_op) - 1) + type_len + (sizeof(request_part_id) - 1) + id_len;
+    len += data ? (sizeof(request_part_data) - 1) + data_len + (sizeof(request_part_end_data) - 1)
+                : (sizeof(request_part_end_nodata) - 1);
+    
+    obsws_frame_t *frame = frame_alloc(conn, len);
+    if (!frame) return NULL;
+    
+    char *p = (char *)frame->buf + LWS_PRE;
+    memcpy(p, request_part_op, sizeof(request_part_op) - 1);
+    p += sizeof(request_part_op) - 1;
+    p = json_write_escaped(p, request_type, type_raw_len);
+    memcpy(p, request_part_id, sizeof(request_part_id) - 1);
+    p += sizeof(request_part_id) - 1;
+    memcpy(p, request_id, id_len);
+    p += id_len;
+    if (data) {
+        memcpy(p, request_part_data, sizeof(request_part_data) - 1);
+        p += sizeof(request_part_data) - 1;
+        memcpy(p, data, data_len);
+        p += data_len;
+        memcpy(p, request_part_end_data, sizeof(request_part_end_data) - 1);
+        p += sizeof(request_part_end_data) - 1;
+    } else {
+        memcpy(p, request_part_end_nodata, sizeof(request_part_end_nodata) - 1);
+        p += sizeof(request_part_end_nodata) - 1;
+    }
+    *p = '\0';                               /* Handy for debug logging; not sent */
+    
+    snprintf(frame->request_id, sizeof(frame->request_id), "%s", request_id);
+    return frame;
+}
+
+/* build_request_frame_span() from optional JSON text (NULL to omit), which
+   is checked first */
+static obsws_frame_t* build_request_frame(obsws_connection_t *conn, const char *request_type,
+                                          const char *request_id, const char *request_data) {
+    const char *data = NULL;
+    size_t data_len = 0;
+    if (request_data && !json_value_span(request_data, strlen(request_data), &data, &data_len)) {
+        obsws_log(conn, OBSWS_LOG_WARNING, "Ignoring malformed requestData for %s", request_type);
+        data = NULL;
+    }
+    return build_request_frame_span(conn, request_type, request_id, data, data_len);
+}
+
+/* ============================================================================
+ * MessagePack
+ * ============================================================================ */
+
+/* obs-websocket also speaks the obswebsocket.msgpack subprotocol: the same
+   messages, encoded as MessagePack in binary frames. Keys are still spelled
+   out, but numbers, bools and container headers shrink to a byte or two and
+   nothing has to be tokenized character by character - on event-heavy
+   sessions that's a real saving in both parse time and bytes on the wire.
+   
+   None of this goes through cJSON:
+   
+   - Inbound, the fields we dispatch on (op, requestId, requestStatus,
+     eventType, ...) are read in place with a cursor over the receive buffer.
+     Only the payload handed to the application (responseData / eventData) is
+     rendered, straight to JSON text, since that's what the public API returns.
+   - Outbound, the caller's requestData JSON text is encoded directly into the
+     frame - one pass to measure, one to write, no intermediate tree.
+   
+   The decoder understands every MessagePack type, so anything unexpected is
+   skipped cleanly instead of being misread. */
+
+#define OBSWS_MSGPACK_PROTOCOL "obswebsocket.msgpack"
+
+/* Output cursor shared by the encoders. With p == NULL nothing is written and
+   only len advances, which is how every encoder measures before allocating. */
+typedef struct {
+    unsigned char *p;                       /* Next byte to write, or NULL to measure only */
+    size_t len;                             /* Bytes written (or that would have been) so far */
+} obsws_writer_t;
+
+static void writer_put(obsws_writer_t *w, const void *src, size_t n) {
+    if (w->p) {
+        memcpy(w->p, src, n);
+        w->p += n;
+    }
+    w->len += n;
+}
+
+/* What snprintf() actually left in a buffer of `size` bytes. Its return value
+   is what it would have written given room, so passing that straight to
+   writer_put() would copy past the end of a too-small buffer. */
+static size_t printed_len(int n, size_t size) {
+    if (n < 0) return 0;
+    return (size_t)n < size ? (size_t)n : size - 1;
+}
+
+/* One type byte followed by a big-endian value of `bytes` bytes (0 for fix types) */
+static void mp_put_head(obsws_writer_t *w, uint8_t tag, uint64_t value, int bytes) {
+    unsigned char b[9];
+    b[0] = tag;
+    for (int i = 0; i < bytes; i++) {
+        b[1 + i] = (unsigned char)(value >> (8 * (bytes - 1 - i)));
+    }
+    writer_put(w, b, (size_t)(1 + bytes));
+}
+
+static void mp_put_uint(obsws_writer_t *w, uint64_t v) {
+    if (v < 0x80)               mp_put_head(w, (uint8_t)v, 0, 0);       /* positive fixint */
+    else if (v <= 0xFF)         mp_put_head(w, 0xcc, v, 1);
+    else if (v <= 0xFFFF)       mp_put_head(w, 0xcd, v, 2);
+    else if (v <= 0xFFFFFFFFu)  mp_put_head(w, 0xce, v, 4);
+    else                        mp_put_head(w, 0xcf, v, 8);
+}
+
+static void mp_put_int(obsws_writer_t *w, int64_t v) {
+    if (v >= 0)                 mp_put_uint(w, (uint64_t)v);
+    else if (v >= -32)          mp_put_head(w, (uint8_t)v, 0, 0);       /* negative fixint */
+    else if (v >= INT8_MIN)     mp_put_head(w, 0xd0, (uint64_t)v & 0xFFu, 1);
+    else if (v >= INT16_MIN)    mp_put_head(w, 0xd1, (uint64_t)v & 0xFFFFu, 2);
+    else if (v >= INT32_MIN)    mp_put_head(w, 0xd2, (uint64_t)v & 0xFFFFFFFFu, 4);
+    else                        mp_put_head(w, 0xd3, (uint64_t)v, 8);
+}
+
+static void mp_put_double(obsws_writer_t *w, double d) {
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    mp_put_head(w, 0xcb, bits, 8);
+}
+
+static void mp_put_str_head(obsws_writer_t *w, size_t n) {
+    if (n < 32)                 mp_put_head(w, (uint8_t)(0xa0 | n), 0, 0);
+    else if (n <= 0xFF)         mp_put_head(w, 0xd9, n, 1);
+    else if (n <= 0xFFFF)       mp_put_head(w, 0xda, n, 2);
+    else                        mp_put_head(w, 0xdb, n, 4);
+}
+
+static void mp_put_str(obsws_writer_t *w, const char *s, size_t n) {
+    mp_put_str_head(w, n);
+    writer_put(w, s, n);
+}
+
+static void mp_put_container(obsws_writer_t *w, bool is_map, size_t n) {
+    if (n < 16)                 mp_put_head(w, (uint8_t)((is_map ? 0x80 : 0x90) | n), 0, 0);
+    else if (n <= 0xFFFF)       mp_put_head(w, is_map ? 0xde : 0xdc, n, 2);
+    else                        mp_put_head(w, is_map ? 0xdf : 0xdd, n, 4);
+}
+
+/* Decode the body of a JSON string (p just past the opening quote) to UTF-8,
+   writing it to out unless out is NULL. *len_out gets the decoded length.
+   Returns the position just past the closing quote, or NULL if malformed. */
+static const char* json_decode_string(const char *p, const char *end, unsigned char *out, size_t *len_out) {
+    size_t n = 0;
+    while (p < end && *p != '"') {
+        uint32_t cp;
+        if (*p != '\\') {
+            if (out) out[n] = (unsigned char)*p;
+            n++;
+            p++;
+            continue;
+        }
+        if (++p >= end) return NULL;
+        switch (*p++) {
+            case '"':  cp = '"';  break;
+            case '\\': cp = '\\'; break;
+            case '/':  cp = '/';  break;
+            case 'b':  cp = '\b'; break;
+            case 'f':  cp = '\f'; break;
+            case 'n':  cp = '\n'; break;
+            case 'r':  cp = '\r'; break;
+            case 't':  cp = '\t'; break;
+            case 'u': {
+                if (end - p < 4) return NULL;
+                char hex[5] = { p[0], p[1], p[2], p[3], '\0' };
+                cp = (uint32_t)strtoul(hex, NULL, 16);
+                p += 4;
+                /* A surrogate pair spells one code point; a lone half becomes U+FFFD */
+                if (cp >= 0xD800 && cp <= 0xDBFF && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                    char lo_hex[5] = { p[2], p[3], p[4], p[5], '\0' };
+                    uint32_t lo = (uint32_t)strtoul(lo_hex, NULL, 16);
+                    if (lo >= 0xDC00 && lo <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                        p += 6;
+                    }
+                }
+                if (cp >= 0xD800 && cp <= 0xDFFF) cp = 0xFFFD;
+                break;
+            }
+            default:
+                return NULL;
+        }
+        
+        unsigned char utf8[4];
+        size_t k;
+        if (cp < 0x80) {
+            utf8[0] = (unsigned char)cp; k = 1;
+        } else if (cp < 0x800) {
+            utf8[0] = (unsigned char)(0xC0 | (cp >> 6));
+            utf8[1] = (unsigned char)(0x80 | (cp & 0x3F)); k = 2;
+        } else if (cp < 0x10000) {
+            utf8[0] = (unsigned char)(0xE0 | (cp >> 12));
+            utf8[1] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+            utf8[2] = (unsigned char)(0x80 | (cp & 0x3F)); k = 3;
+        } else {
+            utf8[0] = (unsigned char)(0xF0 | (cp >> 18));
+            utf8[1] = (unsigned char)(0x80 | ((cp >> 12) & 0x3F));
+            utf8[2] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+            utf8[3] = (unsigned char)(0x80 | (cp & 0x3F)); k = 4;
+        }
+        if (out) memcpy(out + n, utf8, k);
+        n += k;
+    }
+    if (p >= end) return NULL;
+    *len_out = n;
+    return p + 1;
+}
+
+/* Encode one JSON value at *pp as MessagePack and advance *pp past it.
+   
+   MessagePack puts element counts in container headers, so each object or
+   array is counted with json_skip_value() before its members are encoded.
+   That re-walks nested containers once per level, which is nothing for the
+   small, shallow parameter objects OBS requests take.
+   
+   The text must be NUL-terminated somewhere at or after end (numbers are
+   converted with strtoll/strtod), which holds for caller-supplied requestData. */
+static bool json_to_msgpack(obsws_writer_t *w, const char **pp, const char *end, int depth) {
+    const char *p = json_skip_ws(*pp, end);
+    if (depth > OBSWS_JSON_MAX_DEPTH || p >= end) return false;
+    
+    switch (*p) {
+        case '{':
+        case '[': {
+            const bool is_object = (*p == '{');
+            const char close = is_object ? '}' : ']';
+            
+            size_t count = 0;
+            const char *q = json_skip_ws(p + 1, end);
+            if (q < end && *q != close) {
+                for (;;) {
+                    if (is_object) {
+                        q = json_skip_value(q, end, depth + 1);
+                        if (!q) return false;
+                        q = json_skip_ws(q, end);
+                        if (q >= end || *q != ':') return false;
+                        q++;
+                    }
+                    q = json_skip_value(q, end, depth + 1);
+                    if (!q) return false;
+                    count++;
+                    q = json_skip_ws(q, end);
+                    if (q >= end) return false;
+                    if (*q == close) break;
+                    if (*q != ',') return false;
+                    q++;
+                }
+            }
+            
+            mp_put_container(w, is_object, count);
+            p++;
+            for (size_t i = 0; i < count; i++) {
+                if (is_object) {
+                    if (!json_to_msgpack(w, &p, end, depth + 1)) return false;
+                    p = json_skip_ws(p, end) + 1;                       /* ':' */
+                }
+                if (!json_to_msgpack(w, &p, end, depth + 1)) return false;
+                p = json_skip_ws(p, end);
+                if (*p == ',') p++;
+            }
+            *pp = json_skip_ws(p, end) + 1;                             /* close */
+            return true;
+        }
+        case '"': {
+            size_t n;
+            const char *stop = json_decode_string(p + 1, end, NULL, &n);
+            if (!stop) return false;
+            mp_put_str_head(w, n);
+            if (w->p) {
+                json_decode_string(p + 1, end, w->p, &n);
+                w->p += n;
+            }
+            w->len += n;
+            *pp = stop;
+            return true;
+        }
+        case 't':
+            mp_put_head(w, 0xc3, 0, 0);
+            *pp = p + 4;
+            return true;
+        case 'f':
+            mp_put_head(w, 0xc2, 0, 0);
+            *pp = p + 5;
+            return true;
+        case 'n':
+            mp_put_head(w, 0xc0, 0, 0);
+            *pp = p + 4;
+            return true;
+        default: {
+            const char *stop = json_skip_value(p, end, depth);
+            if (!stop) return false;
+            
+            /* Integers stay integers (OBS checks types, so sceneItemId must not
+               arrive as a float); anything with a fraction, exponent or outside
+               int64 goes out as a float64 */
+            bool integral = true;
+            for (const char *c = p; c < stop; c++) {
+                if (*c == '.' || *c == 'e' || *c == 'E') {
+                    integral = false;
+                    break;
+                }
+            }
+            if (integral) {
+                errno = 0;
+                long long v = strtoll(p, NULL, 10);
+                if (errno != ERANGE) {
+                    mp_put_int(w, (int64_t)v);
+                    *pp = stop;
+                    return true;
+                }
+            }
+            mp_put_double(w, strtod(p, NULL));
+            *pp = stop;
+            return true;
+        }
+    }
+}
+
+/* Decoded MessagePack item header */
+typedef enum {
+    MP_NIL, MP_BOOL, MP_INT, MP_UINT, MP_FLOAT, MP_STR, MP_BIN, MP_ARRAY, MP_MAP, MP_EXT
+} mp_type_t;
+
+typedef struct {
+    mp_type_t type;
+    union {
+        bool b;
+        int64_t i;
+        uint64_t u;
+        double f;
+    } v;
+    const unsigned char *data;              /* STR / BIN / EXT payload */
+    uint32_t len;                           /* Payload bytes, or element count for ARRAY / MAP */
+} mp_item_t;
+
+/* Read cursor over a MessagePack buffer. A reader with p == NULL stands for
+   "field not present" in the lookups below. */
+typedef struct {
+    const unsigned char *p;
+    const unsigned char *end;
+} mp_reader_t;
+
+static bool mp_take(mp_reader_t *r, int bytes, uint64_t *out) {
+    if (r->end - r->p < bytes) return false;
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++) {
+        v = (v << 8) | r->p[i];
+    }
+    r->p += bytes;
+    *out = v;
+    return true;
+}
+
+/* Read one item header. STR, BIN and EXT payloads are consumed along with it;
+   for ARRAY and MAP only the header is, and the elements follow. */
+static bool mp_read(mp_reader_t *r, mp_item_t *it) {
+    if (r->p >= r->end) return false;
+    const unsigned char t = *r->p++;
+    uint64_t v;
+    int len_bytes = 0;
+    
+    if (t <= 0x7f) { it->type = MP_UINT; it->v.u = t; return true; }
+    if (t >= 0xe0) { it->type = MP_INT; it->v.i = (int8_t)t; return true; }
+    if ((t & 0xf0) == 0x80) { it->type = MP_MAP; it->len = t & 0x0f; return true; }
+    if ((t & 0xf0) == 0x90) { it->type = MP_ARRAY; it->len = t & 0x0f; return true; }
+    if ((t & 0xe0) == 0xa0) { it->type = MP_STR; it->len = t & 0x1f; goto payload; }
+    
+    switch (t) {
+        case 0xc0: it->type = MP_NIL; return true;
+        case 0xc2: it->type = MP_BOOL; it->v.b = false; return true;
+        case 0xc3: it->type = MP_BOOL; it->v.b = true; return true;
+        
+        case 0xc4: case 0xc5: case 0xc6:
+            it->type = MP_BIN;
+            len_bytes = 1 << (t - 0xc4);
+            break;
+        case 0xd9: case 0xda: case 0xdb:
+            it->type = MP_STR;
+            len_bytes = 1 << (t - 0xd9);
+            break;
+        case 0xc7: case 0xc8: case 0xc9:
+            /* ext: length, then a type byte we don't care about */
+            it->type = MP_EXT;
+            if (!mp_take(r, 1 << (t - 0xc7), &v) || r->p >= r->end) return false;
+            r->p++;
+            it->len = (uint32_t)v;
+            goto payload;
+        case 0xd4: case 0xd5: case 0xd6: case 0xd7: case 0xd8:
+            it->type = MP_EXT;
+            if (r->p >= r->end) return false;
+            r->p++;
+            it->len = 1u << (t - 0xd4);
+            goto payload;
+            
+        case 0xca: {
+            float f;
+            uint32_t bits;
+            if (!mp_take(r, 4, &v)) return false;
+            bits = (uint32_t)v;
+            memcpy(&f, &bits, sizeof(f));
+            it->type = MP_FLOAT;
+            it->v.f = f;
+            return true;
+        }
+        case 0xcb:
+            if (!mp_take(r, 8, &v)) return false;
+            it->type = MP_FLOAT;
+            memcpy(&it->v.f, &v, sizeof(it->v.f));
+            return true;
+            
+        case 0xcc: case 0xcd: case 0xce: case 0xcf:
+            if (!mp_take(r, 1 << (t - 0xcc), &it->v.u)) return false;
+            it->type = MP_UINT;
+            return true;
+        case 0xd0: case 0xd1: case 0xd2: case 0xd3: {
+            const int bytes = 1 << (t - 0xd0);
+            if (!mp_take(r, bytes, &v)) return false;
+            if (bytes < 8 && (v >> (bytes * 8 - 1))) {
+                v |= ~0ULL << (bytes * 8);                  /* sign-extend */
+            }
+            it->type = MP_INT;
+            it->v.i = (int64_t)v;
+            return true;
+        }
+            
+        case 0xdc: case 0xdd:
+            if (!mp_take(r, t == 0xdc ? 2 : 4, &v)) return false;
+            it->type = MP_ARRAY;
+            it->len = (uint32_t)v;
+            return true;
+        case 0xde: case 0xdf:
+            if (!mp_take(r, t == 0xde ? 2 : 4, &v)) return false;
+            it->type = MP_MAP;
+            it->len = (uint32_t)v;
+            return true;
+            
+        default:
+            return false;                           /* 0xc1 is never used */
+    }
+    
+    if (!mp_take(r, len_bytes, &v)) return false;
+    it->len = (uint32_t)v;
+    
+payload:
+    if ((size_t)(r->end - r->p) < it->len) return false;
+    it->data = r->p;
+    r->p += it->len;
+    return true;
+}
+
+/* Skip one complete value, containers included */
+static bool mp_skip(mp_reader_t *r, int depth) {
+    mp_item_t it;
+    if (depth > OBSWS_JSON_MAX_DEPTH || !mp_read(r, &it)) return false;
+    if (it.type == MP_ARRAY || it.type == MP_MAP) {
+        uint64_t n = (uint64_t)it.len * (it.type == MP_MAP ? 2 : 1);
+        for (uint64_t i = 0; i < n; i++) {
+            if (!mp_skip(r, depth + 1)) return false;
+        }
+    }
+    return true;
+}
+
+static bool mp_str_is(const mp_item_t *it, const char *s) {
+    return it->type == MP_STR && strlen(s) == it->len && memcmp(it->data, s, it->len) == 0;
+}
+
+/* Walk a map once, pointing fields[i] at the value of keys[i]. keys is
+   NULL-terminated; fields for keys that aren't present are left with p NULL.
+   One pass matters here: OBS sorts keys, so "d" comes before "op" and
+   "eventData" before "eventType" - looking them up one at a time would walk
+   the whole payload once per key. */
+static bool mp_map_fields(mp_reader_t map, const char *const *keys, mp_reader_t *fields) {
+    mp_item_t it, key;
+    for (size_t k = 0; keys[k]; k++) {
+        fields[k].p = NULL;
+        fields[k].end = NULL;
+    }
+    if (!map.p || !mp_read(&map, &it) || it.type != MP_MAP) return false;
+    
+    for (uint32_t i = 0; i < it.len; i++) {
+        if (!mp_read(&map, &key)) return false;
+        for (size_t k = 0; keys[k]; k++) {
+            if (mp_str_is(&key, keys[k])) {
+                fields[k] = map;
+                break;
+            }
+        }
+        if (!mp_skip(&map, 0)) return false;
+    }
+    return true;
+}
+
+static bool mp_get_int(mp_reader_t field, int64_t *out) {
+    mp_item_t it;
+    if (!field.p || !mp_read(&field, &it)) return false;
+    if (it.type == MP_INT)  { *out = it.v.i; return true; }
+    if (it.type == MP_UINT) { *out = (int64_t)it.v.u; return true; }
+    return false;
+}
+
+static bool mp_get_bool(mp_reader_t field, bool *out) {
+    mp_item_t it;
+    if (!field.p || !mp_read(&field, &it) || it.type != MP_BOOL) return false;
+    *out = it.v.b;
+    return true;
+}
+
+/* Copy a string field into a new NUL-terminated allocation (NULL if absent) */
+static char* mp_get_strdup(mp_reader_t field) {
+    mp_item_t it;
+    if (!field.p || !mp_read(&field, &it) || it.type != MP_STR) return NULL;
+    char *s = malloc(it.len + 1);
+    if (!s) return NULL;
+    memcpy(s, it.data, it.len);
+    s[it.len] = '\0';
+    return s;
+}
+
+/* Format a double the way cJSON does - shortest of %.15g / %.17g that
+   round-trips - so responses read the same whichever protocol is in use */
+static void json_put_double(obsws_writer_t *w, double d) {
+    char num[32];
+    if (d != d || d - d != d - d) {
+        writer_put(w, "null", 4);                   /* NaN / Inf aren't JSON */
+        return;
+    }
+    int n = snprintf(num, sizeof(num), "%1.15g", d);
+    if (strtod(num, NULL) != d) {
+        n = snprintf(num, sizeof(num), "%1.17g", d);
+    }
+    writer_put(w, num, printed_len(n, sizeof(num)));
+}
+
+static void json_put_string(obsws_writer_t *w, const unsigned char *s, size_t n) {
+    size_t escaped = json_escaped_len((const char *)s, n);
+    writer_put(w, "\"", 1);
+    if (w->p) {
+        w->p = (unsigned char *)json_write_escaped((char *)w->p, (const char *)s, n);
+    }
+    w->len += escaped;
+    writer_put(w, "\"", 1);
+}
+
+/* Render one MessagePack value as compact JSON text. BIN and EXT have no JSON
+   equivalent and never appear in obs-websocket messages; they become null. */
+static bool msgpack_to_json(obsws_writer_t *w, mp_reader_t *r, int depth) {
+    mp_item_t it;
+    char num[24];
+    if (depth > OBSWS_JSON_MAX_DEPTH || !mp_read(r, &it)) return false;
+    
+    switch (it.type) {
+        case MP_NIL:
+        case MP_BIN:
+        case MP_EXT:
+            writer_put(w, "null", 4);
+            return true;
+        case MP_BOOL:
+            if (it.v.b) writer_put(w, "true", 4);
+            else writer_put(w, "false", 5);
+            return true;
+        case MP_INT:
+            writer_put(w, num, printed_len(snprintf(num, sizeof(num), "%lld", (long long)it.v.i), sizeof(num)));
+            return true;
+        case MP_UINT:
+            writer_put(w, num, printed_len(snprintf(num, sizeof(num), "%llu", (unsigned long long)it.v.u),
+                                          sizeof(num)));
+            return true;
+        case MP_FLOAT:
+            json_put_double(w, it.v.f);
+            return true;
+        case MP_STR:
+            json_put_string(w, it.data, it.len);
+            return true;
+        case MP_ARRAY:
+            writer_put(w, "[", 1);
+            for (uint32_t i = 0; i < it.len; i++) {
+                if (i) writer_put(w, ",", 1);
+                if (!msgpack_to_json(w, r, depth + 1)) return false;
+            }
+            writer_put(w, "]", 1);
+            return true;
+        case MP_MAP:
+            writer_put(w, "{", 1);
+            for (uint32_t i = 0; i < it.len; i++) {
+                if (i) writer_put(w, ",", 1);
+                mp_item_t key;
+                if (!mp_read(r, &key) || key.type != MP_STR) return false;   /* JSON keys are strings */
+                json_put_string(w, key.data, key.len);
+                writer_put(w, ":", 1);
+                if (!msgpack_to_json(w, r, depth + 1)) return false;
+            }
+            writer_put(w, "}", 1);
+            return true;
+    }
+    return false;
+}
+
+/* Render the value a field points at as a malloc'd JSON string, or NULL if
+   the field is absent or malformed. Measures first so it allocates once. */
+static char* mp_get_json(mp_reader_t field) {
+    if (!field.p) return NULL;
+    
+    obsws_writer_t w = { NULL, 0 };
+    mp_reader_t measure = field;
+    if (!msgpack_to_json(&w, &measure, 0)) return NULL;
+    
+    char *json = malloc(w.len + 1);
+    if (!json) return NULL;
+    w.p = (unsigned char *)json;
+    w.len = 0;
+    msgpack_to_json(&w, &field, 0);
+    json[w.len] = '\0';
+    return json;
+}
+
+/* MessagePack counterpart of scan_request_id(): find the "requestId" key in
+   raw, possibly truncated MessagePack and copy out the string after it */
+static bool mp_scan_request_id(const char *buf, size_t len, char *id_out) {
+    static const char key[] = "\xa9" "requestId";           /* fixstr(9) "requestId" */
+    const size_t key_len = sizeof(key) - 1;
+    
+    for (size_t i = 0; i + key_len < len; i++) {
+        if (memcmp(buf + i, key, key_len) != 0) continue;
+        
+        mp_reader_t r = { (const unsigned char *)buf + i + key_len, (const unsigned char *)buf + len };
+        mp_item_t it;
+        if (!mp_read(&r, &it) || it.type != MP_STR || it.len == 0 || it.len >= OBSWS_REQUEST_ID_LENGTH) {
+            return false;
+        }
+        memcpy(id_out, it.data, it.len);
+        id_out[it.len] = '\0';
+        return true;
+    }
+    return false;
+}
+
+static void mp_encode_request(obsws_writer_t *w, const char *request_type, const char *request_id,
+                              const char *data, size_t data_len) {
+    mp_put_container(w, true, 2);
+    mp_put_str(w, "op", 2);
+    mp_put_uint(w, OBSWS_OPCODE_REQUEST);
+    mp_put_str(w, "d", 1);
+    mp_put_container(w, true, data ? 3 : 2);
+    mp_put_str(w, "requestType", 11);
+    mp_put_str(w, request_type, strlen(request_type));
+    mp_put_str(w, "requestId", 9);
+    mp_put_str(w, request_id, strlen(request_id));
+    if (data) {
+        mp_put_str(w, "requestData", 11);
+        (void)json_to_msgpack(w, &data, data + data_len, 0);  /* Already validated */
+    }
+}
+
+/* MessagePack version of build_request_frame(). data/data_len is the already
+   validated requestData span, or NULL to omit it. */
+static obsws_frame_t* build_request_frame_msgpack(obsws_connection_t *conn, const char *request_type,
+                                                  const char *request_id, const char *data, size_t data_len) {
+    obsws_writer_t w = { NULL, 0 };
+    mp_encode_request(&w, request_type, request_id, data, data_len);
+    
+    obsws_frame_t *frame = frame_alloc(conn, w.len);
+    if (!frame) return NULL;
+    
+    w.p = frame->buf + LWS_PRE;
+    w.len = 0;
+    mp_encode_request(&w, request_type, request_id, data, data_len);
+    
+    snprintf(frame->request_id, sizeof(frame->request_id), "%s", request_id);
+    return frame;
+}
+
+/* ============================================================================
+ * Request Batches
+ * ============================================================================ */
+
+/* A RequestBatch (opcode 8) carries many requests in one message, and OBS
+   answers them all in one RequestBatchResponse (opcode 9). A scene setup of
+   fifty requests costs one round trip instead of fifty.
+   
+   The batch is built up front with obsws_batch_add(), which copies each
+   request type and its (validated) requestData, so sending is just
+   serialization - and the same batch can be sent again, or replayed after a
+   reconnect when every request in it is idempotent.
+   
+   Each request in the batch gets its index as its requestId. OBS echoes it in
+   the matching result, which is how results land in the right slot whatever
+   order they come back in. */
+
+typedef struct {
+    char *request_type;
+    char *request_data;                     /* Trimmed, validated JSON value, or NULL */
+} batch_item_t;
+
+struct obsws_batch {
+    obsws_batch_execution_t execution_type;
+    bool halt_on_failure;
+    bool idempotent;                        /* Every request is Get* / Set* */
+    batch_item_t *items;
+    size_t count;
+    size_t capacity;
+};
+
+/* The opcode 8 envelope as JSON, through the same measure-then-write writer
+   the MessagePack encoders use */
+static void json_encode_batch(obsws_writer_t *w, const obsws_batch_t *batch, const char *request_id) {
+    static const char part_op[] = "{\"op\":8,\"d\":{\"requestId\":";
+    static const char part_halt[] = ",\"haltOnFailure\":";
+    static const char part_type[] = ",\"executionType\":";
+    static const char part_requests[] = ",\"requests\":[";
+    char num[48];                           /* Widest: ,"requestId":"<20 digits>" */
+    int n;
+    
+    writer_put(w, part_op, sizeof(part_op) - 1);
+    json_put_string(w, (const unsigned char *)request_id, strlen(request_id));
+    writer_put(w, part_halt, sizeof(part_halt) - 1);
+    writer_put(w, batch->halt_on_failure ? "true" : "false", batch->halt_on_failure ? 4 : 5);
+    writer_put(w, part_type, sizeof(part_type) - 1);
+    n = snprintf(num, sizeof(num), "%d", (int)batch->execution_type);
+    writer_put(w, num, printed_len(n, sizeof(num)));
+    writer_put(w, part_requests, sizeof(part_requests) - 1);
+    
+    for (size_t i = 0; i < batch->count; i++) {
+        const batch_item_t *item = &batch->items[i];
+        writer_put(w, i ? ",{\"requestType\":" : "{\"requestType\":", i ? 16 : 15);
+        json_put_string(w, (const unsigned char *)item->request_type, strlen(item->request_type));
+        n = snprintf(num, sizeof(num), ",\"requestId\":\"%zu\"", i);
+        writer_put(w, num, printed_len(n, sizeof(num)));
+        if (item->request_data) {
+            writer_put(w, ",\"requestData\":", 15);
+            writer_put(w, item->request_data, strlen(item->request_data));
+        }
+        writer_put(w, "}", 1);
+    }
+    writer_put(w, "]}}", 3);
+}
+
+static void mp_encode_batch(obsws_writer_t *w, const obsws_batch_t *batch, const char *request_id) {
+    char num[24];
+    
+    mp_put_container(w, true, 2);
+    mp_put_str(w, "op", 2);
+    mp_put_uint(w, OBSWS_OPCODE_REQUEST_BATCH);
+    mp_put_str(w, "d", 1);
+    mp_put_container(w, true, 4);
+    mp_put_str(w, "requestId", 9);
+    mp_put_str(w, request_id, strlen(request_id));
+    mp_put_str(w, "haltOnFailure", 13);
+    mp_put_head(w, batch->halt_on_failure ? 0xc3 : 0xc2, 0, 0);
+    mp_put_str(w, "executionType", 13);
+    mp_put_int(w, batch->execution_type);
+    mp_put_str(w, "requests", 8);
+    mp_put_container(w, false, batch->count);
+    
+    for (size_t i = 0; i < batch->count; i++) {
+        const batch_item_t *item = &batch->items[i];
+        mp_put_container(w, true, item->request_data ? 3 : 2);
+        mp_put_str(w, "requestType", 11);
+        mp_put_str(w, item->request_type, strlen(item->request_type));
+        mp_put_str(w, "requestId", 9);
+        mp_put_str(w, num, printed_len(snprintf(num, sizeof(num), "%zu", i), sizeof(num)));
+        if (item->request_data) {
+            const char *data = item->request_data;
+            mp_put_str(w, "requestData", 11);
+            (void)json_to_msgpack(w, &data, data + strlen(data), 0);  /* Validated in obsws_batch_add */
+        }
+    }
+}
+
+/* Serialize a whole batch into one frame, in whichever format the connection
+   negotiated. Returns NULL only if allocation fails. */
+static obsws_frame_t* build_batch_frame(obsws_connection_t *conn, const obsws_batch_t *batch,
+                                        const char *request_id) {
+    void (*encode)(obsws_writer_t *, const obsws_batch_t *, const char *) =
+        conn->msgpack_active ? mp_encode_batch : json_encode_batch;
+    
+    obsws_writer_t w = { NULL, 0 };
+    encode(&w, batch, request_id);
+    
+    obsws_frame_t *frame = frame_alloc(conn, w.len);
+    if (!frame) return NULL;
+    
+    w.p = frame->buf + LWS_PRE;
+    w.len = 0;
+    encode(&w, batch, request_id);
+    *w.p = '\0';                             /* Handy for debug logging; not sent */
+    
+    snprintf(frame->request_id, sizeof(frame->request_id), "%s", request_id);
+    return frame;
+}
+
+/* Which slot a batch result belongs in: the index we sent as its requestId,
+   or - should OBS ever leave it out - the next one in order */
+static size_t batch_result_slot(const char *id, size_t id_len, size_t position) {
+    size_t index = 0;
+    if (id && id_len > 0 && id_len < 20) {
+        for (size_t i = 0; i < id_len; i++) {
+            if (id[i] < '0' || id[i] > '9') return position;
+            index = index * 10 + (size_t)(id[i] - '0');
+        }
+        return index;
+    }
+    return position;
+}
+
+/* ============================================================================
+ * Request Templates
+ * ============================================================================ */
+
+/* Hot requests - a hotkey's scene cut, a filter or visibility toggle - send
+   the same shape every time with one or two values changed. A template is
+   that shape compiled once: the envelope is split at the requestId and the
+   requestData skeleton at each slot, so sending one is memcpy()s of the fixed
+   text with the escaped values and the ID written in between, straight into
+   a pooled frame. No JSON is parsed or checked on the way out - the skeleton
+   was checked when it was compiled.
+   
+   Slots are written as %s (string), %d (integer), %f (number) or %b (bool)
+   where a JSON value would go, e.g. {"sceneName":%s,"sceneItemId":%d}. A %
+   inside a string in the skeleton is just a character.
+   
+   The JSON envelope is the only one built this way. When a connection needs
+   the requestData text - MessagePack transcodes it, replay and coalescing
+   keep a copy - the skeleton is rendered to text and sent the ordinary way. */
+
+typedef struct {
+    size_t offset;                          /* Where in tail the value goes */
+    char kind;                              /* 's', 'd', 'f' or 'b' */
+} template_slot_t;
+
+struct obsws_request_template {
+    char *request_type;
+    char *head;                             /* {"op":6,"d":{"requestType":"...","requestId":" */
+    size_t head_len;
+    char *tail;                             /* ","requestData":<skeleton without slots>}}, or "}} */
+    size_t tail_len;
+    size_t data_start;                      /* requestData's span in tail (equal if there's none) */
+    size_t data_end;
+    size_t slot_count;
+    template_slot_t slots[];                /* In order of offset */
+};
+
+static void template_put_arg(obsws_writer_t *w, char kind, const obsws_template_arg_t *arg) {
+    char num[24];
+    switch (kind) {
+        case 's':
+            if (arg->string) {
+                json_put_string(w, (const unsigned char *)arg->string, strlen(arg->string));
+            } else {
+                writer_put(w, "null", 4);
+            }
+            break;
+        case 'd':
+            writer_put(w, num, printed_len(snprintf(num, sizeof(num), "%lld", (long long)arg->integer),
+                                          sizeof(num)));
+            break;
+        case 'f':
+            json_put_double(w, arg->number);
+            break;
+        default:
+            writer_put(w, arg->boolean ? "true" : "false", arg->boolean ? 4 : 5);
+            break;
+    }
+}
+
+/* Write tail[from, to) with the slots in that range filled in from args */
+static void template_put(obsws_writer_t *w, const obsws_request_template_t *tmpl,
+                         const obsws_template_arg_t *args, size_t from, size_t to) {
+    size_t at = from;
+    for (size_t i = 0; i < tmpl->slot_count; i++) {
+        const template_slot_t *slot = &tmpl->slots[i];
+        if (slot->offset < from || slot->offset > to) continue;
+        writer_put(w, tmpl->tail + at, slot->offset - at);
+        template_put_arg(w, slot->kind, &args[i]);
+        at = slot->offset;
+    }
+    writer_put(w, tmpl->tail + at, to - at);
+}
+
+/* Serialize a request from its template straight into a frame. JSON
+   connections only - see template_render() for the rest. Returns NULL only
+   if allocation fails. */
+static obsws_frame_t* build_template_frame(obsws_connection_t *conn, const obsws_request_template_t *tmpl,
+                                           const obsws_template_arg_t *args, const char *request_id) {
+    size_t id_len = strlen(request_id);
+    obsws_writer_t w = { NULL, 0 };
+    template_put(&w, tmpl, args, 0, tmpl->tail_len);
+    
+    obsws_frame_t *frame = frame_alloc(conn, tmpl->head_len + id_len + w.len);
+    if (!frame) return NULL;
+    
+    w.p = frame->buf + LWS_PRE;
+    w.len = 0;
+    writer_put(&w, tmpl->head, tmpl->head_len);
+    writer_put(&w, request_id, id_len);
+    template_put(&w, tmpl, args, 0, tmpl->tail_len);
+    *w.p = '\0';                             /* Handy for debug logging; not sent */
+    
+    snprintf(frame->request_id, sizeof(frame->request_id), "%s", request_id);
+    return frame;
+}
+
+/* The requestData text with the slots filled in, for the paths that need it
+   as a string. Goes in buf if it fits, else in a new allocation the caller
+   frees. *out is NULL for a template without requestData. Returns false if
+   allocation fails. */
+static bool template_render(const obsws_request_template_t *tmpl, const obsws_template_arg_t *args,
+                            char *buf, size_t buf_size, char **out) {
+    *out = NULL;
+    if (tmpl->data_end == tmpl->data_start) {
+        return true;
+    }
+    
+    obsws_writer_t w = { NULL, 0 };
+    template_put(&w, tmpl, args, tmpl->data_start, tmpl->data_end);
+    char *text = w.len < buf_size ? buf : malloc(w.len + 1);
+    if (!text) return false;
+    
+    w.p = (unsigned char *)text;
+    template_put(&w, tmpl, args, tmpl->data_start, tmpl->data_end);
+    *w.p = '\0';
+    *out = text;
+    return true;
+}
+
+/* A template request's frame in whichever format the connection negotiated.
+   MessagePack has no template form, so there the requestData is rendered to
+   text and transcoded as for any other request. Returns NULL only if
+   allocation fails. */
+static obsws_frame_t* build_template_request_frame(obsws_connection_t *conn, const obsws_request_template_t *tmpl,
+                                                   const obsws_template_arg_t *args, const char *request_id) {
+    if (!conn->msgpack_active) {
+        return build_template_frame(conn, tmpl, args, request_id);
+    }
+    
+    char buf[256];
+    char *text;
+    if (!template_render(tmpl, args, buf, sizeof(buf), &text)) {
+        return NULL;
+    }
+    obsws_frame_t *frame = build_request_frame(conn, tmpl->request_type, request_id, text);
+    if (text != buf) {
+        free(text);
+    }
+    return frame;
+}
+
+/* The library's own hot requests, compiled on first use and kept for the
+   life of the process */
+typedef enum {
+    BUILTIN_SET_SCENE,
+    BUILTIN_GET_SCENE_ITEMS,
+    BUILTIN_SET_ITEM_ENABLED,
+    BUILTIN_SET_FILTER_ENABLED,
+    BUILTIN_TEMPLATE_COUNT
+} builtin_template_id_t;
+
+static obsws_request_template_t *g_builtin_templates[BUILTIN_TEMPLATE_COUNT];
+static pthread_once_t g_builtin_templates_once = PTHREAD_ONCE_INIT;
+
+static void builtin_templates_compile(void) {
+    g_builtin_templates[BUILTIN_SET_SCENE] =
+        obsws_request_template_create("SetCurrentProgramScene", "{\"sceneName\":%s}");
+    g_builtin_templates[BUILTIN_GET_SCENE_ITEMS] =
+        obsws_request_template_create("GetSceneItemList", "{\"sceneName\":%s}");
+    g_builtin_templates[BUILTIN_SET_ITEM_ENABLED] =
+        obsws_request_template_create("SetSceneItemEnabled",
+                                      "{\"sceneName\":%s,\"sceneItemId\":%d,\"sceneItemEnabled\":%b}");
+    g_builtin_templates[BUILTIN_SET_FILTER_ENABLED] =
+        obsws_request_template_create("SetSourceFilterEnabled",
+                                      "{\"sourceName\":%s,\"filterName\":%s,\"filterEnabled\":%b}");
+}
+
+/* NULL only if compiling it ran out of memory */
+static const obsws_request_template_t* builtin_template(builtin_template_id_t id) {
+    pthread_once(&g_builtin_templates_once, builtin_templates_compile);
+    return g_builtin_templates[id];
+}
+
+/* Cut a skeleton into tail (after the requestData key) and note its slots.
+   check gets the same text with a stand-in value at each slot, to be
+   validated as JSON. A slot has to be a whole value - after ':', '[' or ','
+   and before ',', '}' or ']' - or a stand-in could pass where the real value
+   doesn't ("1%d" checks as 10, sends as 1-5). Returns the number of slots,
+   or -1 on a bad placeholder. */
+static long template_scan(const char *skeleton, char *tail, size_t *tail_len, char *check,
+                          template_slot_t *slots) {
+    long count = 0;
+    size_t t = *tail_len, c = 0;
+    bool in_string = false;
+    char last = '\0';  /* Last non-blank character outside a string */
+    for (const char *p = skeleton; *p; p++) {
+        if (in_string) {
+            if (*p == '\\' && p[1]) {
+                tail[t++] = check[c++] = *p++;
+            } else if (*p == '"') {
+                in_string = false;
+            }
+        } else if (*p == '"') {
+            in_string = true;
+        } else if (*p == '%') {
+            static const char *const stand_ins[] = { "\"\"", "0", "0", "true" };
+            const char *kind = p[1] ? strchr("sdfb", p[1]) : NULL;
+            if (!kind || !last || !strchr(":[,", last)) return -1;
+            const char *next = p + 2;
+            while (*next == ' ' || *next == '\t' || *next == '\n' || *next == '\r') next++;
+            if (!*next || !strchr(",}]", *next)) return -1;
+            const char *stand_in = stand_ins[kind - "sdfb"];
+            memcpy(check + c, stand_in, strlen(stand_in));
+            c += strlen(stand_in);
+            slots[count].offset = t;
+            slots[count].kind = *kind;
+            count++;
+            last = '0';  /* A value */
+            p++;
+            continue;
+        }
+        if (*p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') {
+            last = *p;
+        }
+        tail[t++] = check[c++] = *p;
+    }
+    check[c] = '\0';
+    *tail_len = t;
+    return count;
+}
+
+/* ============================================================================
+ * Envelope Pre-Scan
+ * ============================================================================ */
+
+/* One JSON value inside a message, quotes included for a string. p is NULL
+   if the field wasn't there. */
+typedef struct {
+    const char *p;
+    size_t len;
+} json_span_t;
+
+/* What one forward pass over an incoming JSON message learned: the fields
+   that route it, copied out, and where the payloads sit in the message.
+   Lives on the stack - nothing here is allocated. */
+typedef struct {
+    int64_t op;                                   /* -1 if there was none */
+    bool routable;                                /* false: a routing field was escaped or oversized */
+    char event_type[OBSWS_EVENT_TYPE_LENGTH];     /* d.eventType ("" if none) */
+    char request_id[OBSWS_REQUEST_ID_LENGTH];     /* d.requestId ("" if none) */
+    json_span_t event_data;                       /* d.eventData */
+    json_span_t request_status;                   /* d.requestStatus */
+    json_span_t response_data;                    /* d.responseData */
+    const char *end;                              /* End of the message */
+} json_envelope_t;
+
+/* Read an object member's key and step over its ':'. p is at the key's
+   opening quote; key gets the text between the quotes, still escaped.
+   Returns where the value starts, or NULL if it's malformed. */
+static const char* json_member_key(const char *p, const char *end, json_span_t *key) {
+    const char *stop = json_skip_value(p, end, 0);
+    if (!stop || *p != '"') return NULL;
+    key->p = p + 1;
+    key->len = (size_t)(stop - p) - 2;
+    p = json_skip_ws(stop, end);
+    if (p >= end || *p != ':') return NULL;
+    return json_skip_ws(p + 1, end);
+}
+
+static bool json_key_is(json_span_t key, const char *name) {
+    return strlen(name) == key.len && memcmp(key.p, name, key.len) == 0;
+}
+
+/* Step over the value at p and the ',' after it, to the next member's key.
+   NULL at the end of the object or the buffer, or if the value is malformed. */
+static const char* json_next_member(const char *p, const char *end) {
+    p = json_skip_value(p, end, 1);
+    if (!p) return NULL;
+    p = json_skip_ws(p, end);
+    if (p >= end || *p != ',') return NULL;
+    return json_skip_ws(p + 1, end);
+}
+
+/* Pull d.requestId out of raw, possibly truncated JSON without parsing it.
+   Used when a message is too big to keep - OBS serializes keys in sorted
+   order, so requestId sits near the front of a response and is almost always
+   inside the part we did buffer. Only the top-level key of the "d" object
+   counts: a "requestId" inside responseData or eventData is the payload's
+   business. Members before it are stepped over whole, so the ID is found
+   only if they were buffered complete. Returns true if an ID was copied. */
+static bool scan_request_id(const char *buf, size_t len, char *id_out) {
+    const char *end = buf + len;
+    json_span_t key;
+    
+    const char *p = json_skip_ws(buf, end);
+    if (p >= end || *p != '{') return false;
+    p = json_skip_ws(p + 1, end);
+    while (p && (p = json_member_key(p, end, &key)) && !json_key_is(key, "d")) {
+        p = json_next_member(p, end);
+    }
+    if (!p || p >= end || *p != '{') return false;
+    
+    p = json_skip_ws(p + 1, end);
+    while (p && (p = json_member_key(p, end, &key)) && !json_key_is(key, "requestId")) {
+        p = json_next_member(p, end);
+    }
+    const char *stop = p ? json_skip_value(p, end, 1) : NULL;
+    if (!stop || *p != '"') return false;
+    
+    size_t n = (size_t)(stop - p) - 2;
+    if (n == 0 || n >= OBSWS_REQUEST_ID_LENGTH) return false;
+    memcpy(id_out, p + 1, n);
+    id_out[n] = '\0';
+    return true;
+}
+
+/* The JSON counterpart of mp_map_fields(): walk the object at p once,
+   pointing fields[i] at the value of keys[i] (keys NULL-terminated, matched
+   against the raw key text). Every value is still checked as it's stepped
+   over. Returns the position just past the object, or NULL if it's
+   malformed. */
+static const char* json_object_fields(const char *p, const char *end, const char *const *keys,
+                                      json_span_t *fields, int depth) {
+    for (size_t k = 0; keys[k]; k++) {
+        fields[k].p = NULL;
+        fields[k].len = 0;
+    }
+    p = json_skip_ws(p, end);
+    if (depth > OBSWS_JSON_MAX_DEPTH || p >= end || *p != '{') return NULL;
+    p = json_skip_ws(p + 1, end);
+    if (p < end && *p == '}') return p + 1;
+    
+    for (;;) {
+        json_span_t key;
+        const char *value = json_member_key(p, end, &key);
+        if (!value) return NULL;
+        p = json_skip_value(value, end, depth + 1);
+        if (!p) return NULL;
+        for (size_t k = 0; keys[k]; k++) {
+            if (json_key_is(key, keys[k])) {
+                fields[k].p = value;
+                fields[k].len = (size_t)(p - value);
+                break;
+            }
+        }
+        p = json_skip_ws(p, end);
+        if (p >= end) return NULL;
+        if (*p == '}') return p + 1;
+        if (*p != ',') return NULL;
+        p = json_skip_ws(p + 1, end);
+    }
+}
+
+/* A plain integer value (no fraction or exponent) */
+static bool json_span_int(json_span_t span, int64_t *out) {
+    if (!span.p || !span.len) return false;
+    size_t i = span.p[0] == '-' ? 1 : 0;
+    if (i == span.len || span.len - i > 18) return false;
+    int64_t v = 0;
+    for (; i < span.len; i++) {
+        if (!isdigit((unsigned char)span.p[i])) return false;
+        v = v * 10 + (span.p[i] - '0');
+    }
+    *out = span.p[0] == '-' ? -v : v;
+    return true;
+}
+
+/* Copy a string value with no escapes in it into buf. False if it isn't a
+   string, has escapes or doesn't fit - the caller decides what then. */
+static bool json_span_string(json_span_t span, char *buf, size_t size) {
+    if (!span.p || span.len < 2 || span.p[0] != '"') return false;
+    size_t n = span.len - 2;
+    if (n >= size || memchr(span.p + 1, '\\', n)) return false;
+    memcpy(buf, span.p + 1, n);
+    buf[n] = '\0';
+    return true;
+}
+
+/* A string value as a new NUL-terminated allocation (NULL if absent or not
+   a string). Escaped strings - rare in OBS names - are decoded by cJSON. */
+static char* json_span_strdup(json_span_t span) {
+    if (!span.p || span.len < 2 || span.p[0] != '"') return NULL;
+    size_t n = span.len - 2;
+    if (!memchr(span.p + 1, '\\', n)) {
+        char *s = malloc(n + 1);
+        if (s) {
+            memcpy(s, span.p + 1, n);
+            s[n] = '\0';
+        }
+        return s;
+    }
+    cJSON *str = cJSON_ParseWithLength(span.p, span.len);
+    char *s = cJSON_IsString(str) ? strdup(str->valuestring) : NULL;
+    cJSON_Delete(str);
+    return s;
+}
+
+/* A value's text as a new NUL-terminated allocation - for eventData and
+   responseData, which go to the application as JSON text anyway, so they're
+   handed over as OBS wrote them instead of parsed and printed again */
+static char* json_span_dup(json_span_t span) {
+    if (!span.p) return NULL;
+    char *s = malloc(span.len + 1);
+    if (s) {
+        memcpy(s, span.p, span.len);
+        s[span.len] = '\0';
+    }
+    return s;
+}
+
+/* Pre-scan an incoming JSON message in one forward pass: find op, and in d
+   the eventType / requestId that route it plus the spans of eventData,
+   requestStatus and responseData. The whole message is checked for
+   well-formedness on the way, as cJSON would, but nothing is built or
+   allocated - so an event nobody wants or a response nobody is waiting for
+   costs this pass and nothing else. Returns false if the message isn't a
+   well-formed JSON object. */
+static bool scan_envelope(const char *message, size_t len, json_envelope_t *env) {
+    static const char *const d_keys[] = {
+        "eventType", "requestId", "eventData", "requestStatus", "responseData", NULL
+    };
+    json_span_t d_field[5] = { { NULL, 0 } };
+    const char *end = message + len;
+    bool has_d = false;
+    
+    memset(env, 0, sizeof(*env));
+    env->op = -1;
+    env->routable = true;
+    env->end = end;
+    
+    const char *p = json_skip_ws(message, end);
+    if (p >= end || *p != '{') return false;
+    p = json_skip_ws(p + 1, end);
+    if (p < end && *p == '}') {
+        p++;
+    } else {
+        for (;;) {
+            json_span_t key;
+            const char *value = json_member_key(p, end, &key);
+            if (!value) return false;
+            if (json_key_is(key, "d") && value < end && *value == '{') {
+                p = json_object_fields(value, end, d_keys, d_field, 1);
+                has_d = true;
+            } else {
+                p = json_skip_value(value, end, 1);
+                if (p && json_key_is(key, "op")) {
+                    json_span_t op = { value, (size_t)(p - value) };
+                    json_span_int(op, &env->op);
+                }
+            }
+            if (!p) return false;
+            p = json_skip_ws(p, end);
+            if (p >= end) return false;
+            if (*p == '}') {
+                p++;
+                break;
+            }
+            if (*p != ',') return false;
+            p = json_skip_ws(p + 1, end);
+        }
+    }
+    if (json_skip_ws(p, end) != end) return false;
+    
+    if (has_d) {
+        if (d_field[0].p && !json_span_string(d_field[0], env->event_type, sizeof(env->event_type))) {
+            env->routable = false;
+        }
+        if (d_field[1].p && !json_span_string(d_field[1], env->request_id, sizeof(env->request_id))) {
+            env->routable = false;
+        }
+        env->event_data = d_field[2];
+        env->request_status = d_field[3];
+        env->response_data = d_field[4];
+    }
+    return true;
+}
+
+/* ============================================================================
+ * WebSocket Protocol Handling
+ * ============================================================================ */
+
+/**
+ * @brief Handle the initial HELLO handshake message from OBS.
+ * 
+ * When we first connect to OBS, the server sends a HELLO message containing
+ * protocol version information and, if required, an authentication challenge
+ * and salt. This function extracts that information and immediately responds
+ * with an IDENTIFY message.
+ * 
+ * The authentication flow (if enabled) works as follows:
+ * 1. Server sends HELLO with a random challenge string and a salt
+ * 2. We compute: secret = base64(SHA256(password + salt))
+ * 3. We compute: response = base64(SHA256(secret + challenge))
+ * 4. We send this response in the IDENTIFY message
+ * 5. If it matches what the server computed, auth succeeds
+ * 
+ * This challenge-response approach has several advantages over sending the
+ * raw password:
+ * - Password never travels across the network (only the computed response)
+ * - If someone captures the network traffic, they can't replay the captured
+ *   response because it's specific to this challenge (which was random)
+ * - Similar to HTTP Digest Authentication (RFC 2617) but simpler
+ * 
+ * The function transitions the connection state from CONNECTING to AUTHENTICATING,
+ * sends the IDENTIFY message, and logs any authentication requirements.
+ * 
+ * @param conn The connection structure containing buffers, config, and state
+ * @param data The parsed JSON "d" field from the HELLO message, containing
+ *             authentication info if auth is required
+ * @return 0 on success, -1 on error (though errors are logged and connection
+ *         continues - failure to authenticate will be detected by the server
+ *         refusing to transition to IDENTIFIED state)
+ * 
+ * @internal
+ */
+static int send_identify(obsws_connection_t *conn);
+
+static int handle_hello_message(obsws_connection_t *conn, cJSON *data) {
+    /* DEBUG_LOW: Basic connection event */
+    obsws_debug(conn, OBSWS_DEBUG_LOW, "Received Hello message from OBS");
+    
+    cJSON *auth = cJSON_GetObjectItem(data, "authentication");
+    if (auth) {
+        conn->auth_required = true;
+        
+        cJSON *challenge = cJSON_GetObjectItem(auth, "challenge");
+        cJSON *salt = cJSON_GetObjectItem(auth, "salt");
+        
+        if (challenge && salt) {
+            free(conn->challenge);
+            free(conn->salt);
+            conn->challenge = strdup(challenge->valuestring);
+            conn->salt = strdup(salt->valuestring);
+            /* DEBUG_MEDIUM: Show auth parameters */
+            obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Authentication required - salt: %s, challenge: %s", 
+                     conn->salt, conn->challenge);
+        }
+    } else {
+        conn->auth_required = false;
+        obsws_debug(conn, OBSWS_DEBUG_LOW, "No authentication required");
+    }
+    
+    /* Send Identify message */
+    set_connection_state(conn, OBSWS_STATE_AUTHENTICATING);
+    return send_identify(conn);
+}
+
+/* Opcode 1 Identify body in MessagePack. Called twice by send_identify(): once
+   to measure, once to write into the frame. */
+static void mp_encode_identify(obsws_writer_t *w, uint32_t subscriptions, const char *auth_response) {
+    mp_put_container(w, true, 2);
+    mp_put_str(w, "op", 2);
+    mp_put_uint(w, OBSWS_OPCODE_IDENTIFY);
+    mp_put_str(w, "d", 1);
+    mp_put_container(w, true, auth_response ? 3 : 2);
+    mp_put_str(w, "rpcVersion", 10);
+    mp_put_uint(w, OBSWS_PROTOCOL_VERSION);
+    mp_put_str(w, "eventSubscriptions", 18);
+    mp_put_uint(w, subscriptions);
+    if (auth_response) {
+        mp_put_str(w, "authentication", 14);
+        mp_put_str(w, auth_response, strlen(auth_response));
+    }
+}
+
+/* Opcode 3 Reidentify body in MessagePack, measured then written like Identify */
+static void mp_encode_reidentify(obsws_writer_t *w, uint32_t subscriptions) {
+    mp_put_container(w, true, 2);
+    mp_put_str(w, "op", 2);
+    mp_put_uint(w, OBSWS_OPCODE_REIDENTIFY);
+    mp_put_str(w, "d", 1);
+    mp_put_container(w, true, 1);
+    mp_put_str(w, "eventSubscriptions", 18);
+    mp_put_uint(w, subscriptions);
+}
+
+/* Build and queue the Identify message answering a Hello, using the challenge
+   and salt stored on the connection. JSON or MessagePack, whichever
+   subprotocol was negotiated.
+   
+   The JSON form is the cached template, then the authentication field if
+   needed, then the closing braces - no cJSON tree and no intermediate string.
+   The base64 alphabet needs no JSON escaping. */
+static int send_identify(obsws_connection_t *conn) {
+    uint32_t subscriptions = atomic_load_explicit(&conn->event_subscriptions, memory_order_relaxed);
+    
+    char auth_buf[OBSWS_SHA256_B64_LENGTH + 1];
+    const char *auth_response = NULL;
+    if (conn->auth_required && conn->config.password) {
+        /* DEBUG_HIGH: Show password being used */
+        obsws_debug(conn, OBSWS_DEBUG_HIGH, "Generating auth response with password: '%s'", conn->config.password);
+        if (generate_auth_response(conn, auth_buf)) {
+            auth_response = auth_buf;
+            /* DEBUG_MEDIUM: Show generated auth string */
+            obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Generated auth response: '%s'", auth_response);
+        } else {
+            obsws_log(conn, OBSWS_LOG_ERROR, "Failed to compute authentication response");
+        }
+    } else if (conn->auth_required) {
+        obsws_log(conn, OBSWS_LOG_ERROR, "Authentication required but no password provided!");
+    }
+    
+    if (conn->msgpack_active) {
+        obsws_writer_t w = { NULL, 0 };
+        mp_encode_identify(&w, subscriptions, auth_response);
+        obsws_frame_t *frame = frame_alloc(conn, w.len);
+        if (!frame) {
+            return -1;
+        }
+        w.p = frame->buf + LWS_PRE;
+        mp_encode_identify(&w, subscriptions, auth_response);
+        
+        obsws_debug(conn, OBSWS_DEBUG_HIGH, "Sending Identify message (MessagePack, %zu bytes)", frame->len);
+        enqueue_frame(conn, frame);
+        return 0;
+    }
+    
+    if (conn->identify_template_len == 0 || conn->identify_template_subs != subscriptions) {
+        int n = snprintf(conn->identify_template, sizeof(conn->identify_template),
+                         "{\"op\":%d,\"d\":{\"rpcVersion\":%d,\"eventSubscriptions\":%u",
+                         OBSWS_OPCODE_IDENTIFY, OBSWS_PROTOCOL_VERSION, subscriptions);
+        conn->identify_template_len = (size_t)n;
+        conn->identify_template_subs = subscriptions;
+    }
+    
+    static const char auth_key[] = ",\"authentication\":\"";
+    size_t len = conn->identify_template_len + 2;
+    if (auth_response) {
+        len += sizeof(auth_key) - 1 + OBSWS_SHA256_B64_LENGTH + 1;
+    }
+    
+    obsws_frame_t *frame = frame_alloc(conn, len);
+    if (!frame) {
+        return -1;
+    }
+    char *p = (char *)frame->buf + LWS_PRE;
+    memcpy(p, conn->identify_template, conn->identify_template_len);
+    p += conn->identify_template_len;
+    if (auth_response) {
+        memcpy(p, auth_key, sizeof(auth_key) - 1);
+        p += sizeof(auth_key) - 1;
+        memcpy(p, auth_response, OBSWS_SHA256_B64_LENGTH);
+        p += OBSWS_SHA256_B64_LENGTH;
+        *p++ = '"';
+    }
+    *p++ = '}';
+    *p++ = '}';
+    
+    /* DEBUG_HIGH: Show full Identify message */
+    obsws_debug(conn, OBSWS_DEBUG_HIGH, "Sending Identify message: %.*s",
+                (int)frame->len, (const char *)frame->buf + LWS_PRE);
+    
+    /* Queue it like any other frame - it goes out on the next writable callback */
+    enqueue_frame(conn, frame);
+    return 0;
+}
+
+static bool replay_held_visit(obsws_connection_t *conn, pending_request_t *req, void *arg) {
+    pthread_mutex_lock(&req->mutex);
+    bool replay = req->held && !req->completed;
+    req->held = false;
+    pthread_mutex_unlock(&req->mutex);
+    if (!replay) {
+        return false;
+    }
+    
+    obsws_frame_t *frame;
+    if (req->replay_batch) {
+        frame = build_batch_frame(conn, req->replay_batch, req->request_id);
+    } else if (req->replay_template) {
+        frame = build_template_request_frame(conn, req->replay_template, req->replay_args, req->request_id);
+    } else {
+        frame = build_request_frame(conn, req->replay_type, req->request_id, req->replay_data);
+    }
+    if (frame) {
+        frame->lane = req->lane;
+        enqueue_frame(conn, frame);
+        (*(size_t *)arg)++;
+    } else {
+        pthread_mutex_lock(&req->mutex);
+        req->error = OBSWS_ERROR_OUT_OF_MEMORY;
+        req->response->success = false;
+        complete_request_locked(conn, req);
+        pthread_mutex_unlock(&req->mutex);
+    }
+    return false;
+}
+
+/* Resend the requests held when the previous socket died. Same request IDs, so
+   the callers still waiting on them never know. Rebuilt rather than kept as
+   frames, because the new socket may have negotiated a different format. */
+static void replay_held_requests(obsws_connection_t *conn) {
+    size_t replayed = 0;
+    visit_pending_requests(conn, replay_held_visit, &replayed);
+    
+    if (replayed > 0) {
+        obsws_log(conn, OBSWS_LOG_INFO, "Replayed %zu idempotent request(s) after reconnect", replayed);
+    }
+}
+
+/**
+ * @brief Handle the IDENTIFIED confirmation message from OBS.
+ * 
+ * After we send an IDENTIFY message with authentication (or without if auth
+ * isn't required), OBS responds with an IDENTIFIED message to confirm that
+ * the connection is established and ready for commands. This function marks
+ * the connection as fully established, records connection statistics, and
+ * resets the reconnection state.
+ * 
+ * Receiving this message means:
+ * - Authentication succeeded (if it was required)
+ * - The server has accepted our protocol version
+ * - We can now send REQUEST messages and receive EVENT messages
+ * - The connection is in a healthy state
+ * 
+ * We take this opportunity to:
+ * 1. Log successful authentication
+ * 2. Transition state to CONNECTED (the only valid way to enter this state)
+ * 3. Record the timestamp of successful connection (for statistics)
+ * 4. Reset the reconnection attempt counter and delay (we're connected!)
+ * 5. Resend any idempotent requests held over from a dropped connection
+ * 
+ * OBS also sends IDENTIFIED in answer to a Reidentify (opcode 3) from
+ * obsws_reidentify(). The connection is already CONNECTED then, and none of the
+ * above applies.
+ * 
+ * @param conn The connection structure to mark as identified
+ * @param data Unused (the IDENTIFIED message typically has no data payload)
+ * @return Always 0 (this message type should never fail)
+ * 
+ * @internal
+ */
+static int handle_identified_message(obsws_connection_t *conn, cJSON *data) {
+    (void)data;  /* Unused parameter */
+    
+    if (conn->state == OBSWS_STATE_CONNECTED) {
+        /* Answer to a Reidentify - the session carries on, nothing to reset */
+        obsws_debug(conn, OBSWS_DEBUG_LOW, "Reidentified - event subscriptions now 0x%x",
+                    atomic_load_explicit(&conn->event_subscriptions, memory_order_relaxed));
+        return 0;
+    }
+    
+    obsws_log(conn, OBSWS_LOG_INFO, "Successfully authenticated with OBS");
+    /* DEBUG_LOW: Authentication success */
+    obsws_debug(conn, OBSWS_DEBUG_LOW, "Identified message received - authentication successful");
+    set_connection_state(conn, OBSWS_STATE_CONNECTED);
+    
+    pthread_mutex_lock(&conn->stats_mutex);
+    conn->stats.connected_since = time(NULL);
+    if (conn->reconnecting) {
+        conn->stats.reconnect_count++;
+    }
+    pthread_mutex_unlock(&conn->stats_mutex);
+    
+    if (conn->reconnecting) {
+        obsws_log(conn, OBSWS_LOG_INFO, "Reconnected after %u attempt(s)", conn->reconnect_attempts);
+    }
+    conn->ever_identified = true;
+    conn->reconnecting = false;
+    conn->reconnect_attempts = 0;
+    conn->current_reconnect_delay = conn->config.reconnect_delay_ms;
+    
+    arm_keepalive(conn);
+    replay_held_requests(conn);
+    window_drain(conn);  /* Requests that backlogged while we were away */
+    
+    return 0;
+}
+
+/**
+ * @brief Handle EVENT messages from OBS (real-time notifications).
+ * 
+ * OBS continuously sends EVENT messages whenever something happens in the
+ * application (scene changes, source muted/unmuted, recording started, etc.).
+ * These events are only delivered if we subscribed to them in the IDENTIFY
+ * message using the eventSubscriptions bitmask.
+ * 
+ * This function:
+ * 1. Extracts the event type and event data from the JSON
+ * 2. Calls the user's event_callback if one was configured (async event loop)
+ * 3. Updates internal caches (e.g., current scene name on SceneChanged)
+ * 
+ * Important threading note: This is called from the background event_thread,
+ * NOT from the main application thread. Therefore:
+ * - The event_callback is executed in the event thread context
+ * - The callback should not block (keep processing fast)
+ * - The callback should not make blocking library calls
+ * - The event_data_str parameter is temporary and freed after callback returns
+ * - If the callback needs to keep the data, it must copy it
+ * 
+ * Scene caching optimization:
+ * We maintain a cache of the currently active scene name in the connection
+ * structure. When we see a CurrentProgramSceneChanged event, we update this
+ * cache immediately. This avoids the need for the application to call
+ * obsws_send_request(..., "GetCurrentProgramScene", ...) repeatedly.
+ * The cache is protected by scene_mutex for thread safety.
+ * 
+ * @param conn The connection that received the event
+ * @param data The parsed JSON "d" field containing eventType and eventData
+ * @return 0 on success, -1 if the event data is malformed
+ * 
+ * @internal
+ */
+static void deliver_event(obsws_connection_t *conn, const char *event_type,
+                          const char *event_data_str, const char *scene_name);
+
+static int handle_event_message(obsws_connection_t *conn, cJSON *data) {
+    cJSON *event_type = cJSON_GetObjectItem(data, "eventType");
+    cJSON *event_data = cJSON_GetObjectItem(data, "eventData");
+    
+    if (!event_type || !event_type->valuestring) {
+        return 0;
+    }
+    
+    char *event_data_str = (event_data && conn->config.event_callback) ? cJSON_PrintUnformatted(event_data) : NULL;
+    
+    cJSON *scene_name = NULL;
+    if (strcmp(event_type->valuestring, "CurrentProgramSceneChanged") == 0) {
+        scene_name = cJSON_GetObjectItem(event_data, "sceneName");
+    }
+    
+    deliver_event(conn, event_type->valuestring, event_data_str,
+                  scene_name ? scene_name->valuestring : NULL);
+    free(event_data_str);
+    return 0;
+}
+
+/* Hand a decoded event to the application and keep the scene cache current.
+   Shared by the JSON and MessagePack paths; event_data_str is only rendered
+   when there's an event_callback to give it to. */
+static void deliver_event(obsws_connection_t *conn, const char *event_type,
+                          const char *event_data_str, const char *scene_name) {
+    /* DEBUG_MEDIUM: Show event type */
+    obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Event received: %s", event_type);
+    
+    if (conn->config.event_callback) {
+        /* DEBUG_HIGH: Show full event data */
+        if (event_data_str) {
+            obsws_debug(conn, OBSWS_DEBUG_HIGH, "Event data: %s", event_data_str);
+        }
+        conn->config.event_callback(conn, event_type, event_data_str, conn->config.user_data);
+    }
+    
+    /* Update current scene cache if scene changed */
+    if (scene_name) {
+        pthread_mutex_lock(&conn->scene_mutex);
+        free(conn->current_scene);
+        conn->current_scene = strdup(scene_name);
+        pthread_mutex_unlock(&conn->scene_mutex);
+        /* DEBUG_LOW: Scene changes are important */
+        obsws_debug(conn, OBSWS_DEBUG_LOW, "Scene changed to: %s", scene_name);
+    }
+}
+
+/* Does anything consume this event? The application does if it set an
+   event_callback; without one, only scene changes matter, for the cache. */
+static bool event_wanted(obsws_connection_t *conn, const char *event_type, size_t len) {
+    static const char scene_changed[] = "CurrentProgramSceneChanged";
+    return conn->config.event_callback ||
+           (len == sizeof(scene_changed) - 1 && memcmp(event_type, scene_changed, len) == 0);
+}
+
+static void event_dropped(obsws_connection_t *conn, const char *event_type, size_t len) {
+    obsws_debug(conn, OBSWS_DEBUG_HIGH, "Dropped unconsumed event: %.*s", (int)len, event_type);
+    pthread_mutex_lock(&conn->stats_mutex);
+    conn->stats.events_dropped++;
+    pthread_mutex_unlock(&conn->stats_mutex);
+}
+
+/* handle_event_message() from the pre-scan, with no tree built: eventData
+   goes to the callback as the text OBS sent, and an event nobody consumes is
+   dropped before anything is allocated */
+static int handle_event_envelope(obsws_connection_t *conn, const json_envelope_t *env) {
+    static const char *const scene_keys[] = { "sceneName", NULL };
+    const char *event_type = env->event_type;
+    
+    if (!event_type[0]) {
+        return 0;
+    }
+    if (!event_wanted(conn, event_type, strlen(event_type))) {
+        event_dropped(conn, event_type, strlen(event_type));
+        return 0;
+    }
+    
+    char *event_data_str = conn->config.event_callback ? json_span_dup(env->event_data) : NULL;
+    
+    char *scene_name = NULL;
+    json_span_t scene;
+    if (strcmp(event_type, "CurrentProgramSceneChanged") == 0 && env->event_data.p &&
+        json_object_fields(env->event_data.p, env->end, scene_keys, &scene, 2)) {
+        scene_name = json_span_strdup(scene);
+    }
+    
+    deliver_event(conn, event_type, event_data_str, scene_name);
+    
+    free(scene_name);
+    free(event_data_str);
+    return 0;
+}
+
+/**
+ * @brief Handle REQUEST_RESPONSE messages from OBS (responses to our commands).
+ * 
+ * When we send a REQUEST message (via obsws_send_request), OBS processes it
+ * and sends back a REQUEST_RESPONSE message with the same requestId that we
+ * used. This function matches the response to the pending request, populates
+ * the response data, and wakes up the waiting thread.
+ * 
+ * The async request/response pattern allows the application to send multiple
+ * requests without waiting for each response. The flow is:
+ * 1. Application calls obsws_send_request("GetScenes", ...) -> returns immediately
+ * 2. The request is created with a unique ID and added to the pending request table
+ * 3. Background thread sends the request to OBS
+ * 4. Background thread waits for response (on condition variable, not busy-polling)
+ * 5. OBS responds with REQUEST_RESPONSE containing the requestId
+ * 6. This function matches it to the pending request
+ * 7. Function sets response->success, response->status_code, response->response_data
+ * 8. Function signals the condition variable to wake the waiting thread
+ * 9. Application thread wakes up with the response ready
+ * 
+ * This is far more efficient than synchronous request/response because:
+ * - No blocking wait in the background thread
+ * - Multiple requests can be in-flight simultaneously
+ * - Doesn't freeze the application while waiting for OBS
+ * - Condition variables are more efficient than polling
+ * 
+ * Response structure contains:
+ * - success: Did the operation succeed? (not the HTTP status, but "was it valid?")
+ * - status_code: The OBS response code (0 = success, >0 = error)
+ * - response_data: JSON string with the actual result (e.g., scene list)
+ * - data_tree: the same responseData as cJSON, detached from the message
+ *   rather than parsed again, for obsws_response_get_*()
+ * - error_message: If something failed, what was the reason?
+ * 
+ * @param conn The connection that received the response
+ * @param data The parsed JSON "d" field containing requestId, requestStatus, etc.
+ * @return 0 on success, -1 if the response is malformed (e.g., missing requestId)
+ * 
+ * @internal
+ */
+static void fill_response(obsws_response_t *response, cJSON *data, bool print_data) {
+    cJSON *request_status = cJSON_GetObjectItem(data, "requestStatus");
+    if (request_status) {
+        cJSON *result = cJSON_GetObjectItem(request_status, "result");
+        cJSON *code = cJSON_GetObjectItem(request_status, "code");
+        cJSON *comment = cJSON_GetObjectItem(request_status, "comment");
+        
+        response->success = result ? result->valueint : false;
+        response->status_code = code ? code->valueint : -1;
+        
+        if (comment) {
+            response->error_message = strdup(comment->valuestring);
+        }
+    }
+    
+    /* The message is deleted once it's handled, so keep its responseData
+       instead - taking it out of the tree is cheaper than any copy. Library
+       helpers that only read it through the tree skip the text. */
+    cJSON *response_data = cJSON_GetObjectItem(data, "responseData");
+    if (response_data) {
+        if (print_data) {
+            response->response_data = cJSON_PrintUnformatted(response_data);
+        }
+        response->data_tree = cJSON_DetachItemViaPointer(data, response_data);
+    }
+}
+
+/* A response's responseData as a tree: the one it came with (see
+   fill_response() and fill_response_envelope()) or, failing that, parsed
+   from response_data the first time it's asked for. NULL if it has none. The parse is a cache, which is
+   why the accessors can take a const response. */
+static cJSON *response_tree(const obsws_response_t *response) {
+    if (!response->data_tree && response->response_data) {
+        ((obsws_response_t *)response)->data_tree = cJSON_Parse(response->response_data);
+    }
+    return response->data_tree;
+}
+
+/* Does the JSON pointer token tok/len, still escaped, name key? */
+static bool pointer_token_is(const char *tok, size_t len, const char *key) {
+    for (size_t i = 0; i < len; i++, key++) {
+        char c = tok[i];
+        if (c == '~') {
+            if (++i == len || (tok[i] != '0' && tok[i] != '1')) return false;
+            c = tok[i] == '0' ? '~' : '/';
+        }
+        if (*key != c) return false;
+    }
+    return *key == '\0';
+}
+
+/* Resolve an RFC 6901 JSON pointer ("/scenes/0/sceneName") in a response's
+   responseData. Keys are matched in place, escapes and all, and array
+   indices are plain decimal - no leading zeros, no "-". NULL if nothing is
+   there. */
+static cJSON *response_lookup(const obsws_response_t *response, const char *pointer) {
+    if (!response || !pointer) return NULL;
+    
+    cJSON *node = response_tree(response);
+    while (node && *pointer) {
+        if (*pointer != '/') return NULL;
+        const char *tok = ++pointer;
+        size_t len = strcspn(tok, "/");
+        pointer += len;
+        
+        if (cJSON_IsArray(node)) {
+            if (len == 0 || (len > 1 && tok[0] == '0')) return NULL;
+            size_t index = 0;
+            for (size_t i = 0; i < len; i++) {
+                if (!isdigit((unsigned char)tok[i]) || index > (SIZE_MAX - 9) / 10) return NULL;
+                index = index * 10 + (size_t)(tok[i] - '0');
+            }
+            for (node = node->child; node && index; index--) {
+                node = node->next;
+            }
+        } else if (cJSON_IsObject(node)) {
+            cJSON *child = node->child;
+            while (child && !(child->string && pointer_token_is(tok, len, child->string))) {
+                child = child->next;
+            }
+            node = child;
+        } else {
+            return NULL;
+        }
+    }
+    return node;
+}
+
+static int handle_request_response_message(obsws_connection_t *conn, cJSON *data) {
+    cJSON *request_id = cJSON_GetObjectItem(data, "requestId");
+    if (!request_id) return -1;
+    
+    /* DEBUG_MEDIUM: Show request ID being processed */
+    obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Response received for request: %s", request_id->valuestring);
+    
+    pending_request_t *req = find_pending_request(conn, request_id->valuestring);
+    uint64_t seq;
+    if (!req && request_id_issued(conn, request_id->valuestring, &seq)) {
+        late_response_dropped(conn, request_id->valuestring);
+        return 0;
+    }
+    if (!req) {
+        obsws_log(conn, OBSWS_LOG_WARNING, "Received response for unknown request: %s", request_id->valuestring);
+        return -1;
+    }
+    
+    pthread_mutex_lock(&req->mutex);
+    if (req->completed) {
+        /* Cancelled or timed out while OBS was working on it */
+        pthread_mutex_unlock(&req->mutex);
+        late_response_dropped(conn, request_id->valuestring);
+        return 0;
+    }
+    fill_response(req->response, data, !req->data_tree_only);
+    complete_request_locked(conn, req);
+    pthread_mutex_unlock(&req->mutex);
+    
+    return 0;
+}
+
+/* fill_response() from the pre-scan. responseData is copied out of the
+   message as OBS wrote it rather than parsed and printed; obsws_response_get_*()
+   parse it if and when they're used. Library helpers that read nothing but
+   the tree get it parsed straight from the span instead. */
+static void fill_response_envelope(obsws_response_t *response, const json_envelope_t *env, bool print_data) {
+    static const char *const status_keys[] = { "result", "code", "comment", NULL };
+    json_span_t status[3];
+    
+    if (env->request_status.p &&
+        json_object_fields(env->request_status.p, env->end, status_keys, status, 2)) {
+        int64_t code = -1;
+        json_span_int(status[1], &code);
+        response->success = status[0].len == 4 && memcmp(status[0].p, "true", 4) == 0;
+        response->status_code = (int)code;
+        response->error_message = json_span_strdup(status[2]);
+    }
+    
+    if (env->response_data.p) {
+        if (print_data) {
+            response->response_data = json_span_dup(env->response_data);
+        } else {
+            response->data_tree = cJSON_ParseWithLength(env->response_data.p, env->response_data.len);
+        }
+    }
+}
+
+/* handle_request_response_message() from the pre-scan: the request is
+   found by the ID copied onto the stack, so a response that's late or
+   unknown is dropped without anything being allocated */
+static int handle_request_response_envelope(obsws_connection_t *conn, const json_envelope_t *env) {
+    const char *request_id = env->request_id;
+    if (!request_id[0]) return -1;
+    
+    obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Response received for request: %s", request_id);
+    
+    pending_request_t *req = find_pending_request(conn, request_id);
+    uint64_t seq;
+    if (!req && request_id_issued(conn, request_id, &seq)) {
+        late_response_dropped(conn, request_id);
+        return 0;
+    }
+    if (!req) {
+        obsws_log(conn, OBSWS_LOG_WARNING, "Received response for unknown request: %s", request_id);
+        return -1;
+    }
+    
+    pthread_mutex_lock(&req->mutex);
+    if (req->completed) {
+        pthread_mutex_unlock(&req->mutex);
+        late_response_dropped(conn, request_id);
+        return 0;
+    }
+    fill_response_envelope(req->response, env, !req->data_tree_only);
+    complete_request_locked(conn, req);
+    pthread_mutex_unlock(&req->mutex);
+    
+    return 0;
+}
+
+/**
+ * @brief Handle a REQUEST_BATCH_RESPONSE (opcode 9) from OBS.
+ * 
+ * The "results" array holds one entry per request OBS actually ran - fewer
+ * than were sent if haltOnFailure stopped the batch early. Each entry is
+ * shaped like an opcode 7 response and goes into the slot given by its
+ * requestId (the request's index in the batch).
+ * 
+ * @param conn The connection that received the response
+ * @param data The parsed JSON "d" field containing requestId and results
+ * @return 0 on success, -1 if the response is malformed or unexpected
+ * 
+ * @internal
+ */
+static int handle_batch_response_message(obsws_connection_t *conn, cJSON *data) {
+    cJSON *request_id = cJSON_GetObjectItem(data, "requestId");
+    if (!cJSON_IsString(request_id)) return -1;
+    
+    obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Batch response received for request: %s", request_id->valuestring);
+    
+    pending_request_t *req = find_pending_request(conn, request_id->valuestring);
+    uint64_t seq;
+    if (!req && request_id_issued(conn, request_id->valuestring, &seq)) {
+        late_response_dropped(conn, request_id->valuestring);
+        return 0;
+    }
+    if (!req || !req->batch_result) {
+        obsws_log(conn, OBSWS_LOG_WARNING, "Received batch response for unknown request: %s", request_id->valuestring);
+        return -1;
+    }
+    
+    pthread_mutex_lock(&req->mutex);
+    if (req->completed) {
+        pthread_mutex_unlock(&req->mutex);
+        late_response_dropped(conn, request_id->valuestring);
+        return 0;
+    }
+    obsws_batch_result_t *result = req->batch_result;
+    cJSON *results = cJSON_GetObjectItem(data, "results");
+    cJSON *item;
+    size_t position = 0;
+    cJSON_ArrayForEach(item, results) {
+        cJSON *id = cJSON_GetObjectItem(item, "requestId");
+        size_t slot = batch_result_slot(cJSON_IsString(id) ? id->valuestring : NULL,
+                                        cJSON_IsString(id) ? strlen(id->valuestring) : 0, position++);
+        if (slot < result->count && !result->responses[slot].status_code) {
+            fill_response(&result->responses[slot], item, true);
+            result->executed++;
+        }
+    }
+    req->response->success = true;
+    complete_request_locked(conn, req);
+    pthread_mutex_unlock(&req->mutex);
+    
+    return 0;
+}
+
+/* MessagePack counterparts of the handlers above. Each takes a reader over
+   the message's "d" value (p == NULL if it had none) and pulls out only the
+   fields it needs; see the MessagePack section for the decoder. */
+
+static int handle_hello_msgpack(obsws_connection_t *conn, mp_reader_t data) {
+    static const char *const keys[] = { "authentication", NULL };
+    static const char *const auth_keys[] = { "challenge", "salt", NULL };
+    mp_reader_t field[1], auth[2];
+    
+    obsws_debug(conn, OBSWS_DEBUG_LOW, "Received Hello message from OBS");
+    
+    mp_map_fields(data, keys, field);
+    conn->auth_required = field[0].p != NULL;
+    if (conn->auth_required) {
+        mp_map_fields(field[0], auth_keys, auth);
+        char *challenge = mp_get_strdup(auth[0]);
+        char *salt = mp_get_strdup(auth[1]);
+        if (challenge && salt) {
+            free(conn->challenge);
+            free(conn->salt);
+            conn->challenge = challenge;
+            conn->salt = salt;
+            obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Authentication required - salt: %s, challenge: %s",
+                     conn->salt, conn->challenge);
+        } else {
+            free(challenge);
+            free(salt);
+        }
+    } else {
+        obsws_debug(conn, OBSWS_DEBUG_LOW, "No authentication required");
+    }
+    
+    set_connection_state(conn, OBSWS_STATE_AUTHENTICATING);
+    return send_identify(conn);
+}
+
+static int handle_event_msgpack(obsws_connection_t *conn, mp_reader_t data) {
+    static const char *const keys[] = { "eventType", "eventData", NULL };
+    static const char *const scene_keys[] = { "sceneName", NULL };
+    mp_reader_t field[2], scene_field[1];
+    
+    if (!mp_map_fields(data, keys, field)) return -1;
+    
+    mp_reader_t type_field = field[0];
+    mp_item_t type;
+    if (mp_read(&type_field, &type) && type.type == MP_STR &&
+        !event_wanted(conn, (const char *)type.data, type.len)) {
+        event_dropped(conn, (const char *)type.data, type.len);
+        return 0;
+    }
+    
+    char *event_type = mp_get_strdup(field[0]);
+    if (!event_type) return 0;
+    
+    char *event_data_str = conn->config.event_callback ? mp_get_json(field[1]) : NULL;
+    
+    char *scene_name = NULL;
+    if (strcmp(event_type, "CurrentProgramSceneChanged") == 0 &&
+        mp_map_fields(field[1], scene_keys, scene_field)) {
+        scene_name = mp_get_strdup(scene_field[0]);
+    }
+    
+    deliver_event(conn, event_type, event_data_str, scene_name);
+    
+    free(scene_name);
+    free(event_data_str);
+    free(event_type);
+    return 0;
+}
+
+/* requestStatus / responseData of one response (a lone opcode 7, or one
+   entry of an opcode 9 results array) */
+static void fill_response_msgpack(obsws_response_t *response, mp_reader_t status_field, mp_reader_t data_field) {
+    static const char *const status_keys[] = { "result", "code", "comment", NULL };
+    mp_reader_t status[3];
+    
+    if (mp_map_fields(status_field, status_keys, status)) {
+        bool result = false;
+        int64_t code = -1;
+        mp_get_bool(status[0], &result);
+        mp_get_int(status[1], &code);
+        response->success = result;
+        response->status_code = (int)code;
+        response->error_message = mp_get_strdup(status[2]);
+    }
+    
+    response->response_data = mp_get_json(data_field);
+}
+
+static int handle_request_response_msgpack(obsws_connection_t *conn, mp_reader_t data) {
+    static const char *const keys[] = { "requestId", "requestStatus", "responseData", NULL };
+    mp_reader_t field[3];
+    mp_item_t id;
+    
+    if (!mp_map_fields(data, keys, field) || !field[0].p) return -1;
+    if (!mp_read(&field[0], &id) || id.type != MP_STR || id.len >= OBSWS_REQUEST_ID_LENGTH) return -1;
+    
+    char request_id[OBSWS_REQUEST_ID_LENGTH];
+    memcpy(request_id, id.data, id.len);
+    request_id[id.len] = '\0';
+    
+    obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Response received for request: %s", request_id);
+    
+    pending_request_t *req = find_pending_request(conn, request_id);
+    uint64_t seq;
+    if (!req && request_id_issued(conn, request_id, &seq)) {
+        late_response_dropped(conn, request_id);
+        return 0;
+    }
+    if (!req) {
+        obsws_log(conn, OBSWS_LOG_WARNING, "Received response for unknown request: %s", request_id);
+        return -1;
+    }
+    
+    pthread_mutex_lock(&req->mutex);
+    if (req->completed) {
+        pthread_mutex_unlock(&req->mutex);
+        late_response_dropped(conn, request_id);
+        return 0;
+    }
+    fill_response_msgpack(req->response, field[1], field[2]);
+    complete_request_locked(conn, req);
+    pthread_mutex_unlock(&req->mutex);
+    
+    return 0;
+}
+
+static int handle_batch_response_msgpack(obsws_connection_t *conn, mp_reader_t data) {
+    static const char *const keys[] = { "requestId", "results", NULL };
+    static const char *const item_keys[] = { "requestId", "requestStatus", "responseData", NULL };
+    mp_reader_t field[2], item_field[3];
+    mp_item_t id, array;
+    
+    if (!mp_map_fields(data, keys, field) || !field[0].p) return -1;
+    if (!mp_read(&field[0], &id) || id.type != MP_STR || id.len >= OBSWS_REQUEST_ID_LENGTH) return -1;
+    
+    char request_id[OBSWS_REQUEST_ID_LENGTH];
+    memcpy(request_id, id.data, id.len);
+    request_id[id.len] = '\0';
+    
+    obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Batch response received for request: %s", request_id);
+    
+    pending_request_t *req = find_pending_request(conn, request_id);
+    uint64_t seq;
+    if (!req && request_id_issued(conn, request_id, &seq)) {
+        late_response_dropped(conn, request_id);
+        return 0;
+    }
+    if (!req || !req->batch_result) {
+        obsws_log(conn, OBSWS_LOG_WARNING, "Received batch response for unknown request: %s", request_id);
+        return -1;
+    }
+    
+    pthread_mutex_lock(&req->mutex);
+    if (req->completed) {
+        pthread_mutex_unlock(&req->mutex);
+        late_response_dropped(conn, request_id);
+        return 0;
+    }
+    obsws_batch_result_t *result = req->batch_result;
+    mp_reader_t r = field[1];
+    if (r.p && mp_read(&r, &array) && array.type == MP_ARRAY) {
+        for (uint32_t i = 0; i < array.len; i++) {
+            mp_reader_t item = r;
+            if (!mp_skip(&r, 0)) break;
+            if (!mp_map_fields(item, item_keys, item_field)) continue;
+            
+            mp_item_t item_id;
+            mp_reader_t id_field = item_field[0];
+            bool has_id = id_field.p && mp_read(&id_field, &item_id) && item_id.type == MP_STR;
+            size_t slot = batch_result_slot(has_id ? (const char *)item_id.data : NULL,
+                                            has_id ? item_id.len : 0, i);
+            if (slot < result->count && !result->responses[slot].status_code) {
+                fill_response_msgpack(&result->responses[slot], item_field[1], item_field[2]);
+                result->executed++;
+            }
+        }
+    }
+    req->response->success = true;
+    complete_request_locked(conn, req);
+    pthread_mutex_unlock(&req->mutex);
+    
+    return 0;
+}
+
+/* Opcode routing for obswebsocket.msgpack connections - the binary-frame
+   twin of the JSON path in handle_websocket_message() */
+static int handle_msgpack_message(obsws_connection_t *conn, const unsigned char *message, size_t len) {
+    static const char *const keys[] = { "op", "d", NULL };
+    mp_reader_t field[2];
+    mp_reader_t msg = { message, message + len };
+    int64_t op;
+    
+    obsws_debug(conn, OBSWS_DEBUG_HIGH, "Received MessagePack message (%zu bytes)", len);
+    
+    if (!mp_map_fields(msg, keys, field)) {
+        obsws_log(conn, OBSWS_LOG_ERROR, "Failed to decode MessagePack message");
+        return -1;
+    }
+    if (!mp_get_int(field[0], &op)) {
+        obsws_log(conn, OBSWS_LOG_ERROR, "Message missing 'op' field");
+        return -1;
+    }
+    
+    obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Processing opcode: %d", (int)op);
+    
+    switch (op) {
+        case OBSWS_OPCODE_HELLO:
+            return handle_hello_msgpack(conn, field[1]);
+        case OBSWS_OPCODE_IDENTIFIED:
+            return handle_identified_message(conn, NULL);
+        case OBSWS_OPCODE_EVENT:
+            return handle_event_msgpack(conn, field[1]);
+        case OBSWS_OPCODE_REQUEST_RESPONSE:
+            return handle_request_response_msgpack(conn, field[1]);
+        case OBSWS_OPCODE_REQUEST_BATCH_RESPONSE:
+            return handle_batch_response_msgpack(conn, field[1]);
+        default:
+            obsws_log(conn, OBSWS_LOG_DEBUG, "Unhandled opcode: %d", (int)op);
+            return 0;
+    }
+}
+
+/**
+ * @brief Route incoming WebSocket messages to appropriate handlers based on opcode.
+ * 
+ * Every message from OBS contains an "op" field (opcode) that identifies the
+ * message type. This function:
+ * 1. Pre-scans the JSON (see scan_envelope()) - or, on an obswebsocket.msgpack
+ *    connection, reads the MessagePack in place - to extract the opcode and data
+ * 2. Routes to the appropriate handler function based on the opcode
+ * 3. Updates statistics (messages_received, bytes_received)
+ * 
+ * The OBS WebSocket protocol uses these opcodes:
+ * - HELLO (0): Server greeting with auth info - handled by handle_hello_message
+ * - IDENTIFY (1): Client auth - we send this, don't receive it
+ * - IDENTIFIED (2): Auth success - handled by handle_identified_message
+ * - EVENT (5): Real-time notifications - handled by handle_event_envelope
+ * - REQUEST_RESPONSE (7): Command responses - handled by handle_request_response_envelope
+ * - REQUEST_BATCH_RESPONSE (9): Batch results - handled by handle_batch_response_message
+ * - REIDENTIFY (3) and the other client-to-server opcodes: we send these, don't receive them
+ * 
+ * This is one of the most critical functions in the library because it's in
+ * the hot path of message processing. Performance matters here. We keep it
+ * lightweight and defer heavy processing to the specific handlers. Events and
+ * responses never get a cJSON tree: the pre-scan finds what routes them and
+ * where their payloads are, and one nobody wants is dropped right there. The
+ * _message handlers, which work on a tree, take the rest.
+ * 
+ * Error handling is conservative: malformed JSON or missing opcode doesn't
+ * crash the connection, it just logs and continues. This allows us to be
+ * resilient to protocol variations or corruption.
+ * 
+ * @param conn The connection that received the message
+ * @param message Pointer to the raw message data (not null-terminated)
+ * @param len Number of bytes in the message
+ * @return 0 on success, -1 on parse error (does not disconnect)
+ * 
+ * @internal
+ */
+static int handle_websocket_message(obsws_connection_t *conn, const char *message, size_t len) {
+    pthread_mutex_lock(&conn->stats_mutex);
+    conn->stats.messages_received++;
+    conn->stats.bytes_received += len;
+    pthread_mutex_unlock(&conn->stats_mutex);
+    
+    if (conn->msgpack_active) {
+        /* While a cancelled or timed-out request may still be answered, look
+           at the ID up front: its response goes straight in the bin, undecoded.
+           JSON needs no such step - scan_envelope() reads the ID in its one
+           pass, and handle_request_response_envelope() drops it from there
+           before anything is built. */
+        if (atomic_load_explicit(&conn->abandoned_count, memory_order_relaxed) > 0) {
+            char request_id[OBSWS_REQUEST_ID_LENGTH];
+            if (mp_scan_request_id(message, len < OBSWS_LATE_SCAN_BYTES ? len : OBSWS_LATE_SCAN_BYTES,
+                                   request_id) &&
+                request_id_abandoned(conn, request_id)) {
+                late_response_dropped(conn, request_id);
+                return 0;
+            }
+        }
+        return handle_msgpack_message(conn, (const unsigned char *)message, len);
+    }
+    
+    /* DEBUG_HIGH: Show full message content */
+    obsws_debug(conn, OBSWS_DEBUG_HIGH, "Received message (%zu bytes): %.*s", len, (int)len, message);
+    
+    /* Route from a single pass over the text. Events and responses - nearly
+       all the traffic - are handled from the spans it found; only the rare
+       opcodes with more structure (and messages whose routing fields are
+       escaped) get a cJSON tree. */
+    json_envelope_t env;
+    if (!scan_envelope(message, len, &env)) {
+        obsws_log(conn, OBSWS_LOG_ERROR, "Failed to parse JSON message");
+        return -1;
+    }
+    if (env.op < 0) {
+        obsws_log(conn, OBSWS_LOG_ERROR, "Message missing 'op' field");
+        return -1;
+    }
+    
+    /* DEBUG_MEDIUM: Show opcode being processed */
+    obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Processing opcode: %d", (int)env.op);
+    
+    if (env.routable && env.op == OBSWS_OPCODE_EVENT) {
+        return handle_event_envelope(conn, &env);
+    }
+    if (env.routable && env.op == OBSWS_OPCODE_REQUEST_RESPONSE) {
+        return handle_request_response_envelope(conn, &env);
+    }
+    
+    cJSON *json = cJSON_ParseWithLength(message, len);
+    if (!json) {
+        obsws_log(conn, OBSWS_LOG_ERROR, "Failed to parse JSON message");
+        return -1;
+    }
+    
+    cJSON *data = cJSON_GetObjectItem(json, "d");
+    
+    int result = 0;
+    switch (env.op) {
+        case OBSWS_OPCODE_HELLO:
+            result = handle_hello_message(conn, data);
+            break;
+        case OBSWS_OPCODE_IDENTIFIED:
+            result = handle_identified_message(conn, data);
+            break;
+        case OBSWS_OPCODE_EVENT:
+            result = handle_event_message(conn, data);
+            break;
+        case OBSWS_OPCODE_REQUEST_RESPONSE:
+            result = handle_request_response_message(conn, data);
+            break;
+        case OBSWS_OPCODE_REQUEST_BATCH_RESPONSE:
+            result = handle_batch_response_message(conn, data);
+            break;
+        default:
+            obsws_log(conn, OBSWS_LOG_DEBUG, "Unhandled opcode: %d", (int)env.op);
+            break;
+    }
+    
+    cJSON_Delete(json);
+    
+    return result;
+}
+
+/* ============================================================================
+ * Message Reassembly
+ * ============================================================================ */
+
+/* Make room for at least `needed` bytes in the receive buffer.
+   
+   Growth is geometric (doubling) so a message that arrives in many fragments
+   costs O(log n) reallocs, not one per fragment. We never go past the
+   connection's max_message_size - the caller treats a false return as
+   "message too large". */
+static bool recv_buffer_reserve(obsws_connection_t *conn, size_t needed) {
+    if (needed <= conn->recv_buffer_size) {
+        return true;
+    }
+    
+    size_t limit = conn->config.max_message_size;
+    if (needed > limit) {
+        return false;
+    }
+    
+    size_t new_size = conn->recv_buffer_size;
+    while (new_size < needed) {
+        new_size = (new_size > limit / 2) ? limit : new_size * 2;
+    }
+    
+    char *grown = realloc(conn->recv_buffer, new_size);
+    if (!grown) {
+        return false;
+    }
+    
+    /* DEBUG_MEDIUM: Buffer growth is rare and worth knowing about */
+    obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Receive buffer grown %zu -> %zu bytes",
+                conn->recv_buffer_size, new_size);
+    conn->recv_buffer = grown;
+    conn->recv_buffer_size = new_size;
+    return true;
+}
+
+/* Give memory back once the connection has been quiet for a while. Runs as an
+   lws timer on the shard thread, so never mid-callback; if a message is being
+   reassembled right now, or the buffer was needed recently, it just re-arms
+   for the rest of the idle period. */
+static void recv_buffer_shrink_cb(lws_sorted_usec_list_t *sul) {
+    obsws_connection_t *conn = OBSWS_CONTAINER_OF(sul, obsws_connection_t, sul_shrink);
+    conn->shrink_armed = false;
+    
+    if (conn->recv_buffer_size <= OBSWS_DEFAULT_BUFFER_SIZE) {
+        return;
+    }
+    
+    uint64_t idle = monotonic_ms() - conn->recv_last_large_ms;
+    if (conn->recv_buffer_used > 0 || idle < OBSWS_RECV_SHRINK_IDLE_MS) {
+        uint64_t wait_ms = idle < OBSWS_RECV_SHRINK_IDLE_MS ? OBSWS_RECV_SHRINK_IDLE_MS - idle
+                                                            : OBSWS_RECV_SHRINK_IDLE_MS;
+        conn->shrink_armed = true;
+        lws_sul_schedule(conn->lws_context, 0, &conn->sul_shrink, recv_buffer_shrink_cb,
+                         (lws_usec_t)wait_ms * LWS_US_PER_MS);
+        return;
+    }
+    
+    char *shrunk = realloc(conn->recv_buffer, OBSWS_DEFAULT_BUFFER_SIZE);
+    if (shrunk) {
+        obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Receive buffer shrunk %zu -> %d bytes",
+                    conn->recv_buffer_size, OBSWS_DEFAULT_BUFFER_SIZE);
+        conn->recv_buffer = shrunk;
+        conn->recv_buffer_size = OBSWS_DEFAULT_BUFFER_SIZE;
+    }
+}
+
+/* Append one WebSocket fragment and dispatch the message once it's complete.
+   
+   There is no fixed cap: the buffer grows as needed up to max_message_size.
+   If a message goes over that, we stop buffering, skip the rest of its
+   fragments, and fail the pending request it belongs to straight away - the
+   caller gets OBSWS_ERROR_MESSAGE_TOO_LARGE instead of waiting out its timeout.
+   The request ID is fished out of the part we had already buffered. */
+static void receive_fragment(obsws_connection_t *conn, struct lws *wsi, const char *in, size_t len) {
+    bool final = lws_is_final_fragment(wsi);
+    
+    if (!conn->recv_discarding) {
+        /* lws knows how much of the current frame is still to come - use it as a
+           size hint so one big frame costs one realloc instead of several */
+        size_t needed = conn->recv_buffer_used + len + lws_remaining_packet_payload(wsi) + 1;
+        
+        if (recv_buffer_reserve(conn, needed)) {
+            memcpy(conn->recv_buffer + conn->recv_buffer_used, in, len);
+            conn->recv_buffer_used += len;
+            if (conn->recv_buffer_size > OBSWS_DEFAULT_BUFFER_SIZE) {
+                conn->recv_last_large_ms = monotonic_ms();
+                if (!conn->shrink_armed) {
+                    conn->shrink_armed = true;
+                    lws_sul_schedule(conn->lws_context, 0, &conn->sul_shrink, recv_buffer_shrink_cb,
+                                     (lws_usec_t)OBSWS_RECV_SHRINK_IDLE_MS * LWS_US_PER_MS);
+                }
+            }
+            
+            if (final) {
+                if (conn->deflate_rx_message) {
+                    pthread_mutex_lock(&conn->stats_mutex);
+                    conn->stats.uncompressed_bytes_received += conn->recv_buffer_used;
+                    pthread_mutex_unlock(&conn->stats_mutex);
+                    conn->deflate_rx_message = false;
+                }
+                handle_websocket_message(conn, conn->recv_buffer, conn->recv_buffer_used);
+                conn->recv_buffer_used = 0;
+            }
+            return;
+        }
+        
+        /* Over the limit - remember which request this was, then start skipping */
+        conn->recv_discarding = true;
+        conn->recv_discarded = conn->recv_buffer_used;
+        conn->recv_overflow_id[0] = '\0';
+        bool (*scan)(const char *, size_t, char *) =
+            conn->msgpack_active ? mp_scan_request_id : scan_request_id;
+        if (!scan(conn->recv_buffer, conn->recv_buffer_used, conn->recv_overflow_id)) {
+            scan(in, len, conn->recv_overflow_id);
+        }
+        conn->recv_buffer_used = 0;
+    }
+    
+    conn->recv_discarded += len;
+    if (!final) {
+        return;
+    }
+    conn->deflate_rx_message = false;
+    
+    obsws_log(conn, OBSWS_LOG_ERROR, "Discarded %zu-byte message (max_message_size is %zu)%s%s",
+              conn->recv_discarded, conn->config.max_message_size,
+              conn->recv_overflow_id[0] ? " for request " : "", conn->recv_overflow_id);
+    
+    pthread_mutex_lock(&conn->stats_mutex);
+    conn->stats.error_count++;
+    pthread_mutex_unlock(&conn->stats_mutex);
+    
+    if (conn->recv_overflow_id[0]) {
+        fail_pending_request(conn, conn->recv_overflow_id, OBSWS_ERROR_MESSAGE_TOO_LARGE,
+                             "Response exceeds max_message_size");
+    }
+    
+    conn->recv_discarding = false;
+    conn->recv_discarded = 0;
+}
+
+/* ============================================================================
+ * Compression (permessage-deflate)
+ * ============================================================================ */
+
+/* We don't implement deflate ourselves - libwebsockets' permessage-deflate
+   extension does the work. Extensions are registered per lws_context, though,
+   and a shared reactor context serves connections with different settings.
+   So the extension is registered on every context, each connection vetoes it
+   during the handshake unless config.compression is set, and this thin wrapper
+   around lws' own callback adds the per-connection parts:
+   
+   - the compression threshold: small outbound messages bypass the extension
+     and go out with RSV1 clear (uncompressed)
+   - byte accounting: how big compressed messages were on the wire versus
+     before compression / after inflation, for obsws_stats_t
+   
+   The deflate stream itself is untouched, so skipping a message never upsets
+   the shared compression context. */
+
+#if !defined(LWS_WITHOUT_EXTENSIONS)
+static int obsws_deflate_callback(struct lws_context *context, const struct lws_extension *ext,
+                                  struct lws *wsi, enum lws_extension_callback_reasons reason,
+                                  void *user, void *in, size_t len) {
+    obsws_connection_t *conn = wsi ? (obsws_connection_t *)lws_wsi_user(wsi) : NULL;
+    struct lws_ext_pm_deflate_rx_ebufs *bufs = (struct lws_ext_pm_deflate_rx_ebufs *)in;
+    
+    if (reason == LWS_EXT_CB_PAYLOAD_TX && conn && conn->deflate_skip_tx) {
+        return 0;                           /* Leave the payload as-is, RSV1 stays clear */
+    }
+    
+    int in_before = (bufs && (reason == LWS_EXT_CB_PAYLOAD_TX || reason == LWS_EXT_CB_PAYLOAD_RX))
+                    ? bufs->eb_in.len : 0;
+    
+    int ret = lws_extension_callback_pm_deflate(context, ext, wsi, reason, user, in, len);
+    if (!conn || ret < 0) {
+        return ret;
+    }
+    
+    switch (reason) {
+        case LWS_EXT_CB_CLIENT_CONSTRUCT:
+            conn->deflate_active = true;
+            break;
+            
+        case LWS_EXT_CB_PAYLOAD_TX:
+            pthread_mutex_lock(&conn->stats_mutex);
+            conn->stats.compressed_bytes_sent += (uint64_t)(bufs->eb_out.len > 0 ? bufs->eb_out.len : 0);
+            pthread_mutex_unlock(&conn->stats_mutex);
+            break;
+            
+        case LWS_EXT_CB_PAYLOAD_RX: {
+            /* The extension reports how much input it consumed by advancing
+               eb_in; an uncompressed message passes through with nothing consumed */
+            int consumed = in_before - bufs->eb_in.len;
+            if (consumed > 0) {
+                conn->deflate_rx_message = true;
+                pthread_mutex_lock(&conn->stats_mutex);
+                conn->stats.compressed_bytes_received += (uint64_t)consumed;
+                pthread_mutex_unlock(&conn->stats_mutex);
+            }
+            break;
+        }
+        
+        default:
+            break;
+    }
+    
+    return ret;
+}
+
+static const struct lws_extension extensions[] = {
+    {
+        "permessage-deflate",
+        obsws_deflate_callback,
+        "permessage-deflate; client_max_window_bits"
+    },
+    { NULL, NULL, NULL }
+};
+#endif
+
+/* Apply per-connection deflate options once the handshake has settled. Only
+   our own compressor's window can be narrowed here; the server picks its own. */
+static void deflate_configure(obsws_connection_t *conn, struct lws *wsi) {
+#if !defined(LWS_WITHOUT_EXTENSIONS)
+    if (!conn->deflate_active) {
+        return;
+    }
+    
+    uint8_t bits = conn->config.compression_window_bits;
+    if (bits >= 9 && bits < 15) {
+        char value[4];
+        snprintf(value, sizeof(value), "%u", (unsigned)bits);
+        lws_set_extension_option(wsi, "permessage-deflate", "client_max_window_bits", value);
+    }
+    obsws_log(conn, OBSWS_LOG_INFO, "permessage-deflate negotiated (window %u bits, threshold %zu bytes)",
+              (unsigned)(bits >= 9 && bits <= 15 ? bits : 15), conn->config.compression_threshold);
+#else
+    (void)wsi;
+    if (conn->config.compression) {
+        obsws_log(conn, OBSWS_LOG_WARNING, "Compression requested but libwebsockets was built without extensions");
+    }
+#endif
+}
+
+/* Switch the connection to MessagePack if OBS accepted obswebsocket.msgpack.
+   lws binds the wsi to whichever protocols[] entry the server agreed to, so
+   that's what we go by rather than what we asked for. */
+static void msgpack_configure(obsws_connection_t *conn, struct lws *wsi) {
+    const struct lws_protocols *protocol = lws_get_protocol(wsi);
+    conn->msgpack_active = protocol && protocol->name &&
+                           strcmp(protocol->name, OBSWS_MSGPACK_PROTOCOL) == 0;
+    
+    if (conn->msgpack_active) {
+        obsws_log(conn, OBSWS_LOG_INFO, "Using the %s subprotocol", OBSWS_MSGPACK_PROTOCOL);
+    } else if (conn->config.msgpack) {
+        obsws_log(conn, OBSWS_LOG_WARNING, "OBS did not accept %s, falling back to JSON", OBSWS_MSGPACK_PROTOCOL);
+    }
+}
+
+/* ============================================================================
+ * libwebsockets Callbacks
+ * ============================================================================ */
+
+static void shard_dispatch_writes(obsws_shard_t *shard);
+static void shard_finish_detach(obsws_connection_t *conn);
+static void shard_track_pollfd(obsws_shard_t *shard, obsws_poll_op_t op, int fd, short events);
+static void connection_lost(obsws_connection_t *conn);
+static void connection_restart(obsws_connection_t *conn);
+
+/**
+ * @brief libwebsockets callback - routes WebSocket events to our handlers.
+ * 
+ * libwebsockets is an event-driven WebSocket library. It calls this callback
+ * function whenever something happens (connection established, data received,
+ * connection closed, etc.). The "reason" parameter identifies what happened.
+ * 
+ * We handle these key reasons:
+ * - LWS_CALLBACK_CLIENT_ESTABLISHED: TCP/WebSocket handshake complete, ready for messages
+ * - LWS_CALLBACK_CLIENT_CONFIRM_EXTENSION_SUPPORTED: Per-connection opt-in to permessage-deflate
+ * - LWS_CALLBACK_ADD/DEL/CHANGE_MODE_POLL_FD: Socket bookkeeping for external event loops
+ * - LWS_CALLBACK_CLIENT_RECEIVE: Data arrived from OBS
+ * - LWS_CALLBACK_CLIENT_RECEIVE_PONG: Answer to a keep-alive ping - RTT sample
+ * - LWS_CALLBACK_CLIENT_WRITEABLE: Socket is writable - drain the outbound send queue
+ * - LWS_CALLBACK_EVENT_WAIT_CANCELLED: Another thread queued a frame or a shard op and woke the loop
+ * - LWS_CALLBACK_CLIENT_CONNECTION_ERROR: Connection failed (network error, bad host, etc.)
+ * - LWS_CALLBACK_CLIENT_CLOSED: Connection closed normally
+ * - LWS_CALLBACK_WSI_DESTROY: Cleanup callback - and where an unplanned drop starts a reconnect
+ * 
+ * Important: This callback is called from the shard's service thread, not
+ * the main application thread. So it must be thread-safe and not block. With
+ * a shared reactor it also runs for other connections on the same shard, so a
+ * slow handler delays all of them.
+ * 
+ * Message assembly: OBS WebSocket messages might arrive fragmented (multiple
+ * packets). receive_fragment() accumulates them in recv_buffer (growing it as
+ * needed) and parses once lws_is_final_fragment() says the message is complete.
+ * 
+ * Error handling: Connection errors and oversized messages are logged
+ * but don't crash. We just transition to ERROR state and let the connection
+ * cleanup/reconnection logic handle recovery (see connection_lost).
+ * 
+ * @param wsi The WebSocket instance (provided by libwebsockets)
+ * @param reason The callback reason (LWS_CALLBACK_*)
+ * @param user Our connection pointer (registered at context creation)
+ * @param in Incoming data (for LWS_CALLBACK_CLIENT_RECEIVE)
+ * @param len Size of incoming data
+ * @return 0 for success, -1 for error (affects connection handling)
+ * 
+ * @internal
+ */
+static int lws_callback(struct lws *wsi, enum lws_callback_reasons reason,
+                       void *user, void *in, size_t len) {
+    obsws_connection_t *conn = (obsws_connection_t *)user;
+    
+    switch (reason) {
+        case LWS_CALLBACK_CLIENT_ESTABLISHED:
+            obsws_log(conn, OBSWS_LOG_INFO, "WebSocket connection established");
+            deflate_configure(conn, wsi);
+            msgpack_configure(conn, wsi);
+            set_connection_state(conn, OBSWS_STATE_CONNECTING);
+            break;
+            
+        case LWS_CALLBACK_CLIENT_CONFIRM_EXTENSION_SUPPORTED:
+            /* Every context offers permessage-deflate; a non-zero return drops
+               it from this connection's handshake unless it asked for it */
+            if (in && strcmp((const char *)in, "permessage-deflate") == 0) {
+                return (conn && conn->config.compression) ? 0 : 1;
+            }
+            break;
+            
+        case LWS_CALLBACK_CLIENT_RECEIVE:
+            receive_fragment(conn, wsi, (const char *)in, len);
+            dispatch_completions(conn);
+            break;
+            
+        case LWS_CALLBACK_CLIENT_RECEIVE_PONG:
+            handle_pong(conn, in, len);
+            break;
+            
+        case LWS_CALLBACK_CLIENT_WRITEABLE: {
+            /* The only place we ever call lws_write() - drain the send queue */
+            int result = flush_send_queue(conn, wsi);
+            dispatch_completions(conn);  /* Requests failed by the write */
+            return result;
+        }
+            
+        case LWS_CALLBACK_EVENT_WAIT_CANCELLED: {
+            /* Some thread queued a frame or a shard op and called
+               lws_cancel_service(). This arrives without per-session user data,
+               so find the shard through the context instead. Shard ops are run
+               once lws_service() returns, outside any callback. */
+            obsws_shard_t *shard = (obsws_shard_t *)lws_context_user(lws_get_context(wsi));
+            if (shard) {
+                shard_dispatch_writes(shard);
+            }
+            break;
+        }
+            
+#if defined(LWS_WITH_EXTERNAL_POLL)
+        case LWS_CALLBACK_ADD_POLL_FD:
+        case LWS_CALLBACK_DEL_POLL_FD:
+        case LWS_CALLBACK_CHANGE_MODE_POLL_FD: {
+            /* lws telling us which sockets to watch - only matters when the
+               application runs the loop; our own threads let lws poll itself */
+            obsws_shard_t *shard = (obsws_shard_t *)lws_context_user(lws_get_context(wsi));
+            const struct lws_pollargs *pa = (const struct lws_pollargs *)in;
+            if (shard && shard->external && pa) {
+                obsws_poll_op_t op = reason == LWS_CALLBACK_ADD_POLL_FD ? OBSWS_POLL_ADD
+                                   : reason == LWS_CALLBACK_DEL_POLL_FD ? OBSWS_POLL_REMOVE
+                                   : OBSWS_POLL_MODIFY;
+                shard_track_pollfd(shard, op, pa->fd, (short)pa->events);
+            }
+            break;
+        }
+#endif
+            
+        case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
+            obsws_log(conn, OBSWS_LOG_ERROR, "Connection error: %s", in ? (char *)in : "unknown");
+            set_connection_state(conn, OBSWS_STATE_ERROR);
+            break;
+            
+        case LWS_CALLBACK_CLIENT_CLOSED:
+            obsws_log(conn, OBSWS_LOG_INFO, "WebSocket connection closed (reason in 'in' param)");
+            if (in && len > 0) {
+                obsws_log(conn, OBSWS_LOG_INFO, "Close reason: %.*s", (int)len, (char*)in);
+            }
+            set_connection_state(conn, OBSWS_STATE_DISCONNECTED);
+            break;
+            
+        case LWS_CALLBACK_WSI_DESTROY:
+            if (conn) {
+                conn->wsi = NULL;
+                if (conn->closing) {
+                    shard_finish_detach(conn);
+                } else {
+                    /* Not our doing - OBS went away, the network dropped, or
+                       the connect attempt failed */
+                    connection_lost(conn);
+                }
+            }
+            break;
+            
+        default:
+            break;
+    }
+    
+    return 0;
+}
+
+static const struct lws_protocols protocols[] = {
+    {
+        "obs-websocket",
+        lws_callback,
+        0,
+        OBSWS_DEFAULT_BUFFER_SIZE,
+        0, /* id */
+        NULL, /* user */
+        0 /* tx_packet_size */
+    },
+    {
+        /* Same callback - the connection decides how to encode once it knows
+           which subprotocol OBS picked */
+        OBSWS_MSGPACK_PROTOCOL,
+        lws_callback,
+        0,
+        OBSWS_DEFAULT_BUFFER_SIZE,
+        0, /* id */
+        NULL, /* user */
+        0 /* tx_packet_size */
+    },
+    { NULL, NULL, 0, 0, 0, NULL, 0 }
+};
+
+/* ============================================================================
+ * Reconnection
+ * ============================================================================ */
+
+/* Everything here runs on the shard thread. The state machine is:
+   
+     socket dies (WSI_DESTROY) -> connection_lost()
+       -> backoff timer (sul_reconnect) -> reconnect_cb() -> connection_open()
+       -> Hello / Identify / IDENTIFIED -> held requests replayed
+   
+   and a failed attempt simply comes back through WSI_DESTROY for the next,
+   longer wait. We only reconnect connections that made it to CONNECTED at
+   least once - a wrong host or port at startup should fail, not spin.
+   
+   Why full jitter? When an OBS host restarts, every controller attached to it
+   notices within the same few milliseconds. Plain exponential backoff keeps
+   them in lockstep, so they all hit the fresh server together on every
+   attempt. Picking the delay uniformly from [0, ceiling] spreads them out,
+   and the ceiling still doubles so a long outage costs few attempts. */
+
+static bool connection_open(obsws_connection_t *conn);
+
+/* xorshift64* - a private generator per connection, seeded in obsws_connect().
+   rand() would hand every process started in the same second the same
+   "random" delays, which is exactly the lockstep we are trying to break. */
+static uint64_t jitter_next(obsws_connection_t *conn) {
+    uint64_t x = conn->jitter_state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    conn->jitter_state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+/* Delay before the next attempt: uniform in [0, ceiling], with the ceiling
+   doubling per attempt from reconnect_delay_ms up to max_reconnect_delay_ms */
+static uint32_t reconnect_backoff_ms(obsws_connection_t *conn) {
+    uint64_t ceiling = conn->config.reconnect_delay_ms ? conn->config.reconnect_delay_ms : 1;
+    uint64_t cap = conn->config.max_reconnect_delay_ms > ceiling ? conn->config.max_reconnect_delay_ms : ceiling;
+    for (uint32_t i = 0; i < conn->reconnect_attempts && ceiling < cap; i++) {
+        ceiling *= 2;
+    }
+    if (ceiling > cap) {
+        ceiling = cap;
+    }
+    conn->current_reconnect_delay = (uint32_t)ceiling;
+    return (uint32_t)(jitter_next(conn) % (ceiling + 1));
+}
+
+static void reconnect_cb(lws_sorted_usec_list_t *sul) {
+    obsws_connection_t *conn = OBSWS_CONTAINER_OF(sul, obsws_connection_t, sul_reconnect);
+    
+    if (atomic_load_explicit(&conn->shutting_down, memory_order_acquire) || conn->wsi) {
+        return;
+    }
+    
+    conn->reconnect_attempts++;
+    conn->reconnecting = true;
+    obsws_log(conn, OBSWS_LOG_INFO, "Reconnect attempt %u to %s:%d",
+              conn->reconnect_attempts, conn->config.host, conn->config.port);
+    set_connection_state(conn, OBSWS_STATE_CONNECTING);
+    
+    if (!connection_open(conn)) {
+        /* Refused outright. lws may already have raised WSI_DESTROY for it, in
+           which case the next attempt is scheduled - don't lose count twice. */
+        if (lws_dll2_is_detached(&conn->sul_reconnect.list)) {
+            connection_lost(conn);
+        }
+    }
+}
+
+/* Decide whether (and when) to try again. Returns true if an attempt is
+   scheduled. */
+static bool reconnect_schedule(obsws_connection_t *conn) {
+    if (atomic_load_explicit(&conn->shutting_down, memory_order_acquire)) {
+        return false;
+    }
+    
+    uint32_t delay_ms = 0;
+    if (conn->restarting) {
+        /* obsws_reconnect(): go again right away, whatever auto_reconnect says */
+        conn->restarting = false;
+    } else {
+        if (!conn->config.auto_reconnect || !conn->ever_identified) {
+            return false;
+        }
+        if (conn->config.max_reconnect_attempts > 0 &&
+            conn->reconnect_attempts >= conn->config.max_reconnect_attempts) {
+            obsws_log(conn, OBSWS_LOG_ERROR, "Giving up after %u reconnect attempts", conn->reconnect_attempts);
+            set_connection_state(conn, OBSWS_STATE_ERROR);
+            return false;
+        }
+        delay_ms = reconnect_backoff_ms(conn);
+    }
+    
+    obsws_log(conn, OBSWS_LOG_INFO, "Reconnecting in %u ms (backoff ceiling %u ms)",
+              delay_ms, conn->current_reconnect_delay);
+    atomic_store_explicit(&conn->offline, false, memory_order_seq_cst);
+    lws_sul_schedule(conn->lws_context, 0, &conn->sul_reconnect, reconnect_cb,
+                     (lws_usec_t)delay_ms * LWS_US_PER_MS);
+    return true;
+}
+
+/* The socket is gone and it wasn't us closing it for good. Drop what was
+   queued for it (it was framed for a dead session), schedule the next
+   attempt, then hold or fail every outstanding request accordingly. */
+static void connection_lost(obsws_connection_t *conn) {
+    if (atomic_load_explicit(&conn->shutting_down, memory_order_acquire)) {
+        /* obsws_disconnect() is tearing everything down and freeing requests */
+        return;
+    }
+    
+    lws_sul_cancel(&conn->sul_keepalive);
+    lws_sul_cancel(&conn->sul_ping_timeout);
+    conn->ping_sent_us = 0;
+    conn->ping_due = false;
+    drain_send_queue(conn);
+    atomic_store_explicit(&conn->abandoned_count, 0, memory_order_relaxed);  /* Nothing more is coming on that socket */
+    
+    bool will_reconnect = reconnect_schedule(conn);
+    atomic_store_explicit(&conn->offline, !will_reconnect, memory_order_seq_cst);
+    hold_or_fail_requests(conn, will_reconnect);
+    dispatch_completions(conn);
+    if (will_reconnect) {
+        /* Held requests still time out while we're away */
+        arm_request_deadline(conn);
+    }
+}
+
+/* obsws_reconnect() on the shard thread: start over with a fresh backoff.
+   With a live socket, close it and let WSI_DESTROY bring us to
+   connection_lost(); otherwise cut any pending wait short. */
+static void connection_restart(obsws_connection_t *conn) {
+    if (conn->closing || atomic_load_explicit(&conn->shutting_down, memory_order_acquire)) {
+        return;
+    }
+    
+    conn->reconnect_attempts = 0;
+    conn->current_reconnect_delay = conn->config.reconnect_delay_ms;
+    conn->restarting = true;
+    
+    if (conn->wsi) {
+        lws_callback_on_writable(conn->wsi);
+    } else {
+        lws_sul_cancel(&conn->sul_reconnect);
+        reconnect_schedule(conn);
+    }
+}
+
+/* ============================================================================
+ * Event Loop and Shared Reactor
+ * ============================================================================ */
+
+/* Ask for a writable callback on every connection that queued frames since the
+   last wakeup, and pick up obsws_reconnect() / obsws_ping() requests that
+   came in the same way. Shard thread only (called from LWS_CALLBACK_EVENT_WAIT_CANCELLED).
+   
+   The scheduled flag is cleared before asking for the callback, so a producer
+   racing with us either sees it clear and queues the connection again, or its
+   frame is already in the send queue that this writable callback drains. */
+static void shard_dispatch_writes(obsws_shard_t *shard) {
+    obsws_queue_node_t *node;
+    while ((node = mpsc_pop(&shard->ready)) != NULL) {
+        atomic_fetch_sub_explicit(&shard->ready.depth, 1, memory_order_relaxed);
+        obsws_connection_t *conn = OBSWS_CONTAINER_OF(node, obsws_connection_t, ready_node);
+        atomic_store_explicit(&conn->write_scheduled, false, memory_order_release);
+        if (atomic_exchange_explicit(&conn->reconnect_requested, false, memory_order_acq_rel)) {
+            connection_restart(conn);
+        }
+        if (atomic_exchange_explicit(&conn->ping_requested, false, memory_order_acq_rel)) {
+            conn->ping_due = true;
+        }
+        if (atomic_exchange_explicit(&conn->window_drain, false, memory_order_acq_rel)) {
+            window_drain(conn);
+        }
+        if (atomic_exchange_explicit(&conn->deadline_rearm, false, memory_order_acq_rel)) {
+            arm_request_deadline(conn);
+        }
+        if (!conn->wsi && atomic_load_explicit(&conn->offline, memory_order_seq_cst)) {
+            fail_send_queue(conn);  /* Sent just as the connection went for good */
+        }
+        dispatch_completions(conn);  /* Async requests cancelled from another thread */
+        if (conn->wsi) {
+            lws_callback_on_writable(conn->wsi);
+        }
+    }
+}
+
+/* Start the WebSocket handshake for a connection on its shard's context.
+   Must run on the shard thread once the shard is servicing (or before its
+   thread starts, for a private shard). Also used for every reconnect attempt,
+   so it starts from a clean slate. Returns false if lws refused. */
+static bool connection_open(obsws_connection_t *conn) {
+    struct lws_client_connect_info ccinfo;
+    memset(&ccinfo, 0, sizeof(ccinfo));
+    
+    ccinfo.context = conn->lws_context;
+    ccinfo.address = conn->config.host;
+    ccinfo.port = conn->config.port;
+    ccinfo.path = "/";
+    ccinfo.host = ccinfo.address;
+    ccinfo.origin = ccinfo.address;
+    ccinfo.protocol = conn->config.msgpack ? OBSWS_MSGPACK_PROTOCOL : protocols[0].name;
+    ccinfo.userdata = conn;
+    
+    if (conn->config.use_ssl) {
+        ccinfo.ssl_connection = LCCSCF_USE_SSL;
+    }
+    
+    conn->closing = false;
+    conn->restarting = false;
+    conn->msgpack_active = false;
+    conn->deflate_active = false;
+    conn->deflate_rx_message = false;
+    conn->recv_buffer_used = 0;
+    conn->recv_discarding = false;
+    conn->recv_discarded = 0;
+    conn->ping_due = false;
+    conn->ping_sent_us = 0;
+    conn->wsi = lws_client_connect_via_info(&ccinfo);
+    return conn->wsi != NULL;
+}
+
+/* Mark a detaching connection as released and wake obsws_disconnect(). Called
+   on the shard thread once the connection's wsi is gone (or never existed). */
+static void shard_finish_detach(obsws_connection_t *conn) {
+    obsws_shard_t *shard = conn->shard;
+    if (!shard || !shard->shared) return;
+    
+    pthread_mutex_lock(&shard->ops_mutex);
+    if (conn->shard_op == OBSWS_SHARD_OP_CLOSING) {
+        conn->shard_op = OBSWS_SHARD_OP_DETACHED;
+        pthread_cond_broadcast(&shard->ops_cond);
+    }
+    pthread_mutex_unlock(&shard->ops_mutex);
+}
+
+/* Unlink a connection from the shard's attached list. Shard thread only. */
+static void shard_unlink(obsws_shard_t *shard, obsws_connection_t *conn) {
+    obsws_connection_t **link = &shard->conns;
+    while (*link && *link != conn) {
+        link = &(*link)->shard_next;
+    }
+    if (*link) {
+        *link = conn->shard_next;
+        conn->shard_next = NULL;
+    }
+}
+
+/* Run queued attach/detach ops. Shard thread only, between service passes.
+   
+   A detach is held back while the connection still sits in the ready queue -
+   the queue holds a pointer into the connection, so it must be popped before
+   obsws_disconnect() is allowed to free it. */
+static void shard_process_ops(obsws_shard_t *shard) {
+    pthread_mutex_lock(&shard->ops_mutex);
+    obsws_connection_t *ops = shard->ops;
+    shard->ops = NULL;
+    
+    bool retry = false;
+    while (ops) {
+        obsws_connection_t *conn = ops;
+        ops = conn->op_next;
+        conn->op_next = NULL;
+        
+        if (conn->shard_op == OBSWS_SHARD_OP_ATTACH) {
+            conn->shard_op = OBSWS_SHARD_OP_NONE;
+            conn->shard_next = shard->conns;
+            shard->conns = conn;
+            
+            /* Don't hold ops_mutex across lws - WSI_DESTROY can re-enter it */
+            pthread_mutex_unlock(&shard->ops_mutex);
+            if (!connection_open(conn)) {
+                obsws_log(conn, OBSWS_LOG_ERROR, "Failed to initiate connection");
+                set_connection_state(conn, OBSWS_STATE_ERROR);
+            }
+            pthread_mutex_lock(&shard->ops_mutex);
+        } else if (conn->shard_op == OBSWS_SHARD_OP_DETACH) {
+            if (atomic_load_explicit(&conn->write_scheduled, memory_order_acquire)) {
+                conn->op_next = shard->ops;
+                shard->ops = conn;
+                retry = true;
+                continue;
+            }
+            
+            shard_unlink(shard, conn);
+            cancel_connection_timers(conn);
+            if (conn->wsi) {
+                /* Close from the writable callback so OBS gets a proper close
+                   frame; the timeout is a backstop for sockets that never
+                   become writable (still resolving, handshake stalled). */
+                conn->shard_op = OBSWS_SHARD_OP_CLOSING;
+                conn->closing = true;
+                lws_callback_on_writable(conn->wsi);
+                lws_set_timeout(conn->wsi, PENDING_TIMEOUT_USER_OK, 1);
+            } else {
+                conn->shard_op = OBSWS_SHARD_OP_DETACHED;
+                pthread_cond_broadcast(&shard->ops_cond);
+            }
+        }
+    }
+    pthread_mutex_unlock(&shard->ops_mutex);
+    
+    if (retry) {
+        lws_cancel_service(shard->context);
+    }
+}
+
+/* Queue an op for the shard thread and wake it */
+static void shard_post_op(obsws_shard_t *shard, obsws_connection_t *conn, obsws_shard_op_t op) {
+    pthread_mutex_lock(&shard->ops_mutex);
+    conn->shard_op = op;
+    conn->op_next = shard->ops;
+    shard->ops = conn;
+    pthread_mutex_unlock(&shard->ops_mutex);
+    lws_cancel_service(shard->context);
+}
+
+/**
+ * @brief Background thread function that continuously processes WebSocket events.
+ * 
+ * Each shard has one background thread dedicated to processing WebSocket
+ * messages and timers for the connections attached to it - just one for a
+ * private shard, many for a shared reactor. The main application thread
+ * remains free to make requests and do application work without blocking.
+ * 
+ * This thread:
+ * 1. Calls lws_service() to pump the libwebsockets event loop - it sleeps in
+ *    poll() until there's network activity, an lws timer is due, or another
+ *    thread calls lws_cancel_service()
+ * 2. Runs queued attach/detach ops for shared shards
+ * 3. Exits gracefully when should_exit flag is set
+ * 
+ * Periodic work is not done here: request deadlines, keep-alive pings
+ * and receive buffer shrinking are lws_sul timers that fire from inside
+ * lws_service(), and each is only scheduled while it has something to do.
+ * 
+ * Lifetime: A private shard's thread is created in obsws_connect() and joined
+ * in obsws_disconnect(). A shared shard's thread lives from
+ * obsws_reactor_create() to obsws_reactor_destroy().
+ * 
+ * The lws_service() call is the core of this loop. It:
+ * - Waits for data from the network using poll(), for as long as the next
+ *   scheduled lws timer allows (the timeout argument is ignored by lws 4.x;
+ *   we pass 0 to make that explicit)
+ * - If data arrives, invokes lws_callback to notify us
+ * - Returns right away when lws_cancel_service() is called - that's how new
+ *   frames, shard ops and shutdown get noticed without any polling delay
+ * 
+ * An idle connection therefore costs no wakeups at all, instead of the 20 per
+ * second the old fixed 50ms service timeout did.
+ * 
+ * This asynchronous design has several advantages:
+ * - App thread isn't blocked waiting for responses
+ * - Multiple requests can be in-flight simultaneously
+ * - Events can be delivered to callbacks instantly (no polling delay)
+ * - Automatic keep-alive pings keep the connection alive through firewalls
+ * 
+ * Memory note: Callbacks invoked from this thread have access to the same
+ * connection object as the main thread, hence all the mutexes protecting
+ * critical sections. The pending_request_t condition variables synchronize
+ * request responses between this thread and application threads.
+ * 
+ * @param arg The obsws_shard_t* that this thread services
+ * @return Always NULL (threads don't return values)
+ * 
+ * @internal
+ */
+static void* event_thread_func(void *arg) {
+    obsws_shard_t *shard = (obsws_shard_t *)arg;
+    
+    while (!atomic_load_explicit(&shard->should_exit, memory_order_acquire)) {
+        lws_service(shard->context, 0);
+        
+        if (shard->shared) {
+            shard_process_ops(shard);
+        }
+    }
+    
+    return NULL;
+}
+
+/* Record a change to the descriptors an external loop must watch and pass it
+   on to the application's poll_callback. Runs wherever lws does: inside
+   obsws_service(), or in obsws_connect()/obsws_disconnect() on the caller. */
+static void shard_track_pollfd(obsws_shard_t *shard, obsws_poll_op_t op, int fd, short events) {
+    size_t i = 0;
+    while (i < shard->pollfd_count && shard->pollfds[i].fd != fd) i++;
+    
+    if (op == OBSWS_POLL_REMOVE) {
+        if (i == shard->pollfd_count) return;
+        shard->pollfds[i] = shard->pollfds[--shard->pollfd_count];
+        events = 0;
+    } else {
+        if (i == shard->pollfd_count) {
+            if (shard->pollfd_count == shard->pollfd_cap) {
+                size_t cap = shard->pollfd_cap ? shard->pollfd_cap * 2 : 4;
+                struct pollfd *grown = realloc(shard->pollfds, cap * sizeof(*grown));
+                if (!grown) {
+                    obsws_log(shard->conns, OBSWS_LOG_ERROR, "Out of memory tracking fd %d", fd);
+                    return;
+                }
+                shard->pollfds = grown;
+                shard->pollfd_cap = cap;
+            }
+            shard->pollfd_count++;
+            op = OBSWS_POLL_ADD;
+        }
+        shard->pollfds[i].fd = fd;
+        shard->pollfds[i].events = events;
+        shard->pollfds[i].revents = 0;
+    }
+    
+    obsws_connection_t *conn = shard->conns;
+    if (conn && conn->config.poll_callback) {
+        conn->config.poll_callback(conn, op, fd, events, conn->config.user_data);
+    }
+}
+
+/* Set up the self-pipe that stands in for lws_cancel_service() when the
+   application runs the loop. Both ends are non-blocking: producers must never
+   stall on a full pipe, and obsws_service() drains it until empty. */
+static bool shard_wake_pipe_open(obsws_shard_t *shard) {
+    if (pipe(shard->wake_fd) != 0) {
+        return false;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(shard->wake_fd[i], F_SETFL, fcntl(shard->wake_fd[i], F_GETFL) | O_NONBLOCK);
+        fcntl(shard->wake_fd[i], F_SETFD, FD_CLOEXEC);
+    }
+    shard_track_pollfd(shard, OBSWS_POLL_ADD, shard->wake_fd[0], POLLIN);
+    return true;
+}
+
+/* Create a shard's lws_context. The thread is started separately - or never,
+   for an external shard whose loop belongs to the application. */
+static bool shard_init(obsws_shard_t *shard, bool shared, bool external) {
+    memset(shard, 0, sizeof(*shard));
+    shard->shared = shared;
+    shard->external = external;
+    shard->wake_fd[0] = shard->wake_fd[1] = -1;
+    atomic_init(&shard->should_exit, false);
+    atomic_init(&shard->conn_count, 0);
+    pthread_mutex_init(&shard->ops_mutex, NULL);
+    pthread_cond_init(&shard->ops_cond, NULL);
+    pthread_mutex_init(&shard->service_mutex, NULL);
+    mpsc_init(&shard->ready);
+    
+    if (external && !shard_wake_pipe_open(shard)) {
+        pthread_mutex_destroy(&shard->ops_mutex);
+        pthread_cond_destroy(&shard->ops_cond);
+        pthread_mutex_destroy(&shard->service_mutex);
+        return false;
+    }
+    
+    struct lws_context_creation_info info;
+    memset(&info, 0, sizeof(info));
+    
+    info.port = CONTEXT_PORT_NO_LISTEN;
+    info.protocols = protocols;
+    info.gid = -1;
+    info.uid = -1;
+    info.options = LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT;
+    info.user = shard;                      /* Lets WAIT_CANCELLED find the shard */
+#if !defined(LWS_WITHOUT_EXTENSIONS)
+    info.extensions = extensions;           /* Offered only if the connection opts in */
+#endif
+    
+    shard->context = lws_create_context(&info);
+    if (!shard->context) {
+        if (external) {
+            close(shard->wake_fd[0]);
+            close(shard->wake_fd[1]);
+            free(shard->pollfds);
+        }
+        pthread_mutex_destroy(&shard->ops_mutex);
+        pthread_cond_destroy(&shard->ops_cond);
+        pthread_mutex_destroy(&shard->service_mutex);
+        return false;
+    }
+    return true;
+}
+
+static bool shard_start(obsws_shard_t *shard) {
+    shard->thread_running = pthread_create(&shard->thread, NULL, event_thread_func, shard) == 0;
+    return shard->thread_running;
+}
+
+/* Stop the shard thread and destroy its context. Any wsi still open is torn
+   down by lws_context_destroy(), which raises WSI_DESTROY for each. */
+static void shard_shutdown(obsws_shard_t *shard) {
+    if (shard->thread_running) {
+        atomic_store_explicit(&shard->should_exit, true, memory_order_release);
+        lws_cancel_service(shard->context);
+        pthread_join(shard->thread, NULL);
+        shard->thread_running = false;
+    }
+    if (shard->context) {
+        lws_context_destroy(shard->context);
+        shard->context = NULL;
+    }
+    if (shard->external) {
+        shard_track_pollfd(shard, OBSWS_POLL_REMOVE, shard->wake_fd[0], 0);
+        close(shard->wake_fd[0]);
+        close(shard->wake_fd[1]);
+        free(shard->pollfds);
+        shard->pollfds = NULL;
+        shard->pollfd_count = shard->pollfd_cap = 0;
+    }
+    pthread_mutex_destroy(&shard->ops_mutex);
+    pthread_cond_destroy(&shard->ops_cond);
+    pthread_mutex_destroy(&shard->service_mutex);
+}
+
+/* Pick the least loaded shard of a reactor */
+static obsws_shard_t* reactor_pick_shard(obsws_reactor_t *reactor) {
+    obsws_shard_t *best = &reactor->shards[0];
+    size_t best_count = atomic_load_explicit(&best->conn_count, memory_order_relaxed);
+    for (uint32_t i = 1; i < reactor->num_shards; i++) {
+        size_t count = atomic_load_explicit(&reactor->shards[i].conn_count, memory_order_relaxed);
+        if (count < best_count) {
+            best = &reactor->shards[i];
+            best_count = count;
+        }
+    }
+    return best;
+}
+
+/* ============================================================================
+ * Public API Implementation
+ * ============================================================================ */
+
+/**
+ * @brief Initialize the libwsv5 library.
+ * 
+ * This function must be called before creating any connections. It:
+ * 1. Initializes OpenSSL (EVP library for hashing)
+ * 2. Sets the global g_library_initialized flag
+ * 
+ * Thread safety: This function is thread-safe. Multiple threads can call it
+ * simultaneously, and only one will actually do the initialization (protected
+ * by g_init_mutex). Subsequent calls are no-ops.
+ * 
+ * Note: obsws_connect() will call this automatically if you forget, so you
+ * don't *have* to call it explicitly. But doing so allows you to initialize
+ * in a controlled way, separate from connection creation.
+ * 
+ * Cleanup: When you're done with the library, call obsws_cleanup() to
+ * deallocate resources. This is technically optional on program exit (the OS
+ * cleans up anyway), but good practice for testing and library shutdown.
+ * 
+ * @return OBSWS_OK always (initialization cannot fail in the current design)
+ * 
+ * @see obsws_cleanup, obsws_connect
+ */
+obsws_error_t obsws_init(void) {
+    pthread_mutex_lock(&g_init_mutex);
+    
+    if (g_library_initialized) {
+        pthread_mutex_unlock(&g_init_mutex);
+        return OBSWS_OK;
+    }
+    
+    /* Initialize OpenSSL */
+    OpenSSL_add_all_algorithms();
+    
+    /* Detect if stderr is a TTY for color output auto-detection */
+    g_log_ctx.is_tty = isatty(STDERR_FILENO) == 1;
+    
+    g_library_initialized = true;
+    pthread_mutex_unlock(&g_init_mutex);
+    
+    return OBSWS_OK;
+}
+
+/**
+ * @brief Clean up library resources.
+ * 
+ * Call this when you're done with the library to deallocate OpenSSL resources.
+ * This is a counterpart to obsws_init().
+ * 
+ * Important: Make sure all obsws_connection_t objects have been disconnected
+ * and freed via obsws_disconnect() before calling this. If not, you might have
+ * dangling references and resource leaks.
+ * 
+ * Thread safety: This function is thread-safe and idempotent (safe to call
+ * multiple times). It checks g_library_initialized before doing anything.
+ * 
+ * Note: This is optional on program exit because the OS will clean up memory
+ * anyway. But it's good practice for:
+ * - Library consumers that need clean shutdown
+ * - Memory leak detectors / Valgrind tests
+ * - Programs that unload the library
+ * 
+ * @see obsws_init
+ */
+void obsws_cleanup(void) {
+    pthread_mutex_lock(&g_init_mutex);
+    
+    if (!g_library_initialized) {
+        pthread_mutex_unlock(&g_init_mutex);
+        return;
+    }
+    
+    EVP_cleanup();
+    g_library_initialized = false;
+    
+    pthread_mutex_unlock(&g_init_mutex);
+}
+
+/**
+ * @brief Get the library version string.
+ * 
+ * Returns a semantic version string like "1.0.0" that identifies which
+ * version of libwsv5 is being used. Useful for debugging and logging.
+ * 
+ * @return Pointer to static version string (don't free)
+ */
+const char* obsws_version(void) {
+    return OBSWS_VERSION;
+}
+
+/**
+ * @brief Set the global log level threshold.
+ * 
+ * The library logs various messages during operation. This function sets which
+ * messages are displayed. All messages at the specified level and higher
+ * severity are shown; lower severity messages are hidden.
+ * 
+ * Levels in increasing severity:
+ * - OBSWS_LOG_DEBUG: Low-level diagnostic info (too verbose for production)
+ * - OBSWS_LOG_INFO: General informational messages (usual choice)
+ * - OBSWS_LOG_WARNING: Potentially problematic situations (degraded but working)
+ * - OBSWS_LOG_ERROR: Error conditions that need attention
+ * 
+ * Example: If you call obsws_set_log_level(OBSWS_LOG_WARNING), you'll see
+ * only WARNING and ERROR messages, but not INFO or DEBUG messages.
+ * 
+ * Thread safety: This modifies a global variable without locking, so if you
+ * might call this from multiple threads, use synchronization externally.
+ * 
+ * @param level The minimum severity level to display
+ * @see obsws_set_debug_level
+ */
+void obsws_set_log_level(obsws_log_level_t level) {
+    g_log_level = level;
+}
+
+/**
+ * @brief Set the global debug level.
+ * 
+ * Debug logging is separate from regular logging. It provides extremely
+ * detailed trace information about the WebSocket protocol, message parsing,
+ * authentication, etc. This is useful during development and troubleshooting.
+ * 
+ * Debug levels:
+ * - OBSWS_DEBUG_NONE: No debug output (fastest)
+ * - OBSWS_DEBUG_LOW: Major state transitions and connection events
+ * - OBSWS_DEBUG_MEDIUM: Message types and handlers invoked
+ * - OBSWS_DEBUG_HIGH: Full message content and every operation
+ * 
+ * Debug logging is independent of log level. You can have OBSWS_LOG_ERROR
+ * set (hide non-error logs) but still see OBSWS_DEBUG_HIGH output.
+ * 
+ * Performance warning: OBSWS_DEBUG_HIGH produces enormous output and will
+ * slow down the library significantly. Only use during debugging!
+ * 
+ * Thread safety: Same as obsws_set_log_level (modifies global without locking).
+ * 
+ * @param level The debug verbosity level
+ * @see obsws_set_log_level, obsws_get_debug_level
+ */
+void obsws_set_debug_level(obsws_debug_level_t level) {
+    g_debug_level = level;
+}
+
+/**
+ * @brief Get the current debug level.
+ * 
+ * This is a read-only query - it doesn't change anything, just returns the
+ * current global debug level that was set by obsws_set_debug_level().
+ * 
+ * Useful for conditional logging in your application, e.g.:
+ * ```
+ * if (obsws_get_debug_level() >= OBSWS_DEBUG_MEDIUM) {
+ *     // do expensive trace operation
+ * }
+ * ```
+ * 
+ * @return The currently active debug level
+ * @see obsws_set_debug_level
+ */
+obsws_debug_level_t obsws_get_debug_level(void) {
+    return g_debug_level;
+}
+
+/**
+ * @brief Initialize a connection configuration structure with safe defaults.
+ * 
+ * Before calling obsws_connect(), you create an obsws_config_t structure
+ * with the connection parameters. This function initializes that structure
+ * with sensible defaults so you only need to change what's different for
+ * your use case.
+ * 
+ * Default values set:
+ * - port: 4455 (OBS WebSocket v5 default port)
+ * - use_ssl: false (OBS uses ws://, not wss://)
+ * - connect_timeout_ms: 5000 (5 seconds to connect)
+ * - recv_timeout_ms: 5000 (5 seconds to receive each message)
+ * - send_timeout_ms: 5000 (5 seconds to send each message)
+ * - ping_interval_ms: 10000 (send ping every 10 seconds)
+ * - ping_timeout_ms: 5000 (expect pong within 5 seconds)
+ * - auto_reconnect: true (reconnect automatically if connection drops)
+ * - reconnect_delay_ms: 1000 (backoff ceiling starts at 1 second, doubles per attempt)
+ * - max_reconnect_delay_ms: 30000 (ceiling never goes past 30 seconds)
+ * - max_reconnect_attempts: 0 (infinite attempts)
+ * - max_message_size: 32MB (largest incoming message we will reassemble)
+ * - reactor: NULL (each connection gets its own event thread)
+ * - compression: false (permessage-deflate is opt-in)
+ * - compression_window_bits: 15, compression_threshold: 256 bytes
+ * - msgpack: false (JSON text frames)
+ * - external_loop: false (the library runs its own event thread)
+ * - event_subscriptions: OBSWS_EVENT_ALL (every event category)
+ * - replay_idempotent_requests: true (resend Get* / Set* requests after a reconnect)
+ * - coalesce_reads: false (every request goes to OBS, even identical reads)
+ * - max_in_flight: 256, window_policy: OBSWS_WINDOW_BLOCK, window_backlog: 1024
+ * - bulk_share: 10 (percent of writes bulk requests get while normal ones wait)
+ * 
+ * After calling this, you typically set:
+ * - config.host = "localhost" (where OBS is running)
+ * - config.password = "your_password" (if OBS has auth enabled)
+ * - config.event_callback = your_callback_func (to receive events)
+ * 
+ * @param config Pointer to structure to initialize (must not be NULL)
+ * 
+ * @see obsws_connect
+ */
+void obsws_config_init(obsws_config_t *config) {
+    memset(config, 0, sizeof(obsws_config_t));
+    
+    config->port = 4455;
+    config->use_ssl = false;
+    config->connect_timeout_ms = 5000;
+    config->recv_timeout_ms = 5000;
+    config->send_timeout_ms = 5000;
+    config->ping_interval_ms = 10000;
+    config->ping_timeout_ms = 5000;
+    config->auto_reconnect = true;
+    config->reconnect_delay_ms = 1000;
+    config->max_reconnect_delay_ms = 30000;
+    config->max_reconnect_attempts = 0; /* Infinite */
+    config->max_message_size = OBSWS_DEFAULT_MAX_MESSAGE_SIZE;
+    config->compression = false;
+    config->compression_window_bits = OBSWS_DEFAULT_COMPRESSION_WINDOW_BITS;
+    config->compression_threshold = OBSWS_DEFAULT_COMPRESSION_THRESHOLD;
+    config->msgpack = false;
+    config->external_loop = false;
+    config->event_subscriptions = OBSWS_EVENT_ALL;
+    config->replay_idempotent_requests = true;
+    config->coalesce_reads = false;
+    config->max_in_flight = OBSWS_MAX_PENDING_REQUESTS;
+    config->window_policy = OBSWS_WINDOW_BLOCK;
+    config->window_backlog = OBSWS_DEFAULT_WINDOW_BACKLOG;
+    config->bulk_share = OBSWS_DEFAULT_BULK_SHARE;
+    config->completion_executor = NULL; /* Run completion callbacks on the event thread */
+}
+
+/**
+ * @brief Establish a connection to OBS.
+ * 
+ * This is the main entry point for using the library. You provide a configuration
+ * structure (initialized with obsws_config_init and then customized), and this
+ * function connects to OBS, authenticates if needed, and spawns a background
+ * thread to handle incoming messages and events.
+ * 
+ * The function returns immediately - it doesn't wait for the connection to
+ * complete. Instead, it:
+ * 1. Creates a connection structure with the provided config
+ * 2. Allocates buffers for sending and receiving messages
+ * 3. Creates a libwebsockets context and connects to OBS - or, if
+ *    config->reactor is set, hands the connection to the least loaded shard
+ *    of that shared reactor, whose thread opens the WebSocket
+ * 4. Spawns a background event_thread to process WebSocket messages
+ *    (private mode only - a reactor's threads already exist, and with
+ *    config->external_loop the application's own loop services it)
+ * 5. Returns the connection handle
+ * 
+ * Connection states: The connection progresses through states:
+ * - DISCONNECTED -> CONNECTING (TCP handshake, WebSocket upgrade)
+ * - CONNECTING -> AUTHENTICATING (receive HELLO, send IDENTIFY)
+ * - AUTHENTICATING -> CONNECTED (receive IDENTIFIED)
+ * 
+ * You don't have to wait for CONNECTED state before calling obsws_send_request,
+ * but requests sent while not connected will return OBSWS_ERROR_NOT_CONNECTED.
+ * 
+ * Memory ownership: The connection structure is allocated and owned by this
+ * function. You must free it by calling obsws_disconnect(). Don't free it directly
+ * with free() - that will cause memory leaks (threads won't be cleaned up properly).
+ * 
+ * Error cases:
+ * - NULL config or config->host: Returns NULL
+ * - libwebsockets context creation fails: Returns NULL and logs error
+ * - Network connection fails: Returns valid pointer but connection stays in ERROR state
+ * - Reactor mode: lws refusing the connection also shows up as ERROR state,
+ *   since the attempt is made on the shard thread after this returns
+ * - Bad password: Returns valid pointer but stays in AUTHENTICATING (never reaches CONNECTED)
+ * 
+ * Note: This function calls obsws_init() automatically if the library isn't
+ * already initialized.
+ * 
+ * @param config Pointer to initialized obsws_config_t with connection parameters
+ * @return Pointer to new connection handle, or NULL if creation failed
+ * 
+ * @see obsws_disconnect, obsws_get_state, obsws_send_request
+ */
+obsws_connection_t* obsws_connect(const obsws_config_t *config) {
+    if (!g_library_initialized) {
+        obsws_init();
+    }
+    
+    if (!config || !config->host) {
+        return NULL;
+    }
+    
+    if (config->external_loop) {
+#if defined(LWS_WITH_EXTERNAL_POLL)
+        if (config->reactor) {
+            obsws_log(NULL, OBSWS_LOG_ERROR, "external_loop and reactor can't be combined");
+            return NULL;
+        }
+#else
+        obsws_log(NULL, OBSWS_LOG_ERROR, "external_loop needs libwebsockets built with LWS_WITH_EXTERNAL_POLL");
+        return NULL;
+#endif
+    }
+    
+    obsws_connection_t *conn = calloc(1, sizeof(obsws_connection_t));
+    if (!conn) return NULL;
+    
+    /* Copy configuration */
+    memcpy(&conn->config, config, sizeof(obsws_config_t));
+    if (config->host) conn->config.host = strdup(config->host);
+    if (config->password) conn->config.password = strdup(config->password);
+    if (conn->config.compression_window_bits < 9 || conn->config.compression_window_bits > 15) {
+        conn->config.compression_window_bits = OBSWS_DEFAULT_COMPRESSION_WINDOW_BITS;
+    }
+    if (conn->config.max_message_size < OBSWS_DEFAULT_BUFFER_SIZE) {
+        conn->config.max_message_size = conn->config.max_message_size ? OBSWS_DEFAULT_BUFFER_SIZE
+                                                                      : OBSWS_DEFAULT_MAX_MESSAGE_SIZE;
+    }
+    if (conn->config.bulk_share > OBSWS_MAX_BULK_SHARE) {
+        conn->config.bulk_share = OBSWS_MAX_BULK_SHARE;
+    }
+    
+    /* Initialize mutexes */
+    pthread_mutex_init(&conn->state_mutex, NULL);
+    pthread_mutex_init(&conn->stats_mutex, NULL);
+    pthread_mutex_init(&conn->scene_mutex, NULL);
+    pthread_mutex_init(&conn->frame_pool_mutex, NULL);
+    pthread_mutex_init(&conn->ping_mutex, NULL);
+    cond_init_monotonic(&conn->ping_cond);
+    if (!request_table_init(conn)) {
+        free((char *)conn->config.host);
+        free((char *)conn->config.password);
+        free(conn);
+        return NULL;
+    }
+    
+    /* Allocate buffers */
+    conn->recv_buffer_size = OBSWS_DEFAULT_BUFFER_SIZE;
+    conn->recv_buffer = malloc(conn->recv_buffer_size);
+    for (int lane = 0; lane < OBSWS_PRIORITY_COUNT; lane++) {
+        mpsc_init(&conn->send_queue[lane]);
+    }
+    
+    conn->state = OBSWS_STATE_DISCONNECTED;
+    conn->current_reconnect_delay = config->reconnect_delay_ms;
+    
+    atomic_init(&conn->write_scheduled, false);
+    atomic_init(&conn->event_subscriptions, config->event_subscriptions);
+    atomic_init(&conn->reconnect_requested, false);
+    atomic_init(&conn->shutting_down, false);
+    atomic_init(&conn->offline, false);
+    atomic_init(&conn->ping_requested, false);
+    atomic_init(&conn->completions_pending, false);
+    atomic_init(&conn->abandoned_count, 0);
+    
+    /* Seed the backoff jitter from things that differ between processes and
+       connections, so a fleet restarted together doesn't draw the same delays */
+    conn->jitter_state = (monotonic_ms() << 20) ^ ((uint64_t)getpid() << 40) ^
+                         (uint64_t)(uintptr_t)conn ^ (uint64_t)time(NULL);
+    if (conn->jitter_state == 0) {
+        conn->jitter_state = 0x9E3779B97F4A7C15ULL;
+    }
+    
+    /* Request ID prefix - from the OpenSSL CSPRNG where it can, else the
+       jitter generator, which is seeded well enough to tell connections apart */
+    if (RAND_bytes((unsigned char *)&conn->request_id_prefix, sizeof(conn->request_id_prefix)) != 1) {
+        conn->request_id_prefix = jitter_next(conn);
+    }
+    atomic_init(&conn->next_request_seq, 0);
+    
+    if (config->reactor) {
+        /* Shared reactor: the shard thread opens the WebSocket for us, since
+           only it may touch the shared context. Failure shows up as ERROR state. */
+        conn->shard = reactor_pick_shard(config->reactor);
+        conn->lws_context = conn->shard->context;
+        atomic_fetch_add_explicit(&conn->shard->conn_count, 1, memory_order_relaxed);
+        
+        obsws_log(conn, OBSWS_LOG_INFO, "Connecting to OBS at %s:%d (shared reactor)",
+                  config->host, config->port);
+        shard_post_op(conn->shard, conn, OBSWS_SHARD_OP_ATTACH);
+        return conn;
+    }
+    
+    /* Private shard: our own libwebsockets context, and our own event thread
+       unless the application is running the loop */
+    conn->shard = calloc(1, sizeof(obsws_shard_t));
+    if (!conn->shard || !shard_init(conn->shard, false, config->external_loop)) {
+        obsws_log(conn, OBSWS_LOG_ERROR, "Failed to create libwebsockets context");
+        free(conn->shard);
+        free(conn->recv_buffer);
+        request_table_destroy(conn);
+        free(conn);
+        return NULL;
+    }
+    conn->lws_context = conn->shard->context;
+    conn->shard->conns = conn;
+    atomic_store_explicit(&conn->shard->conn_count, 1, memory_order_relaxed);
+    
+    /* Descriptors registered while the context was being created had no
+       connection to report to yet - tell the application about them now */
+    if (config->poll_callback) {
+        for (size_t i = 0; i < conn->shard->pollfd_count; i++) {
+            config->poll_callback(conn, OBSWS_POLL_ADD, conn->shard->pollfds[i].fd,
+                                  conn->shard->pollfds[i].events, config->user_data);
+        }
+    }
+    
+    /* Connect to OBS - the thread isn't running yet, so this is safe here */
+    if (!connection_open(conn)) {
+        obsws_log(conn, OBSWS_LOG_ERROR, "Failed to initiate connection");
+        atomic_store_explicit(&conn->shutting_down, true, memory_order_release);
+        shard_shutdown(conn->shard);
+        free(conn->shard);
+        free(conn->recv_buffer);
+        request_table_destroy(conn);
+        free(conn);
+        return NULL;
+    }
+    
+    /* Start event thread */
+    if (!config->external_loop) {
+        shard_start(conn->shard);
+    }
+    
+    obsws_log(conn, OBSWS_LOG_INFO, "Connecting to OBS at %s:%d%s", config->host, config->port,
+              config->external_loop ? " (external event loop)" : "");
+    
+    return conn;
+}
+
+/* Teardown visitors for obsws_disconnect() */
+static bool fail_async_visit(obsws_connection_t *conn, pending_request_t *req, void *arg) {
+    if (req->async) {
+        hold_or_fail_locked(conn, req, false);
+    }
+    return false;
+}
+
+static bool take_any_visit(obsws_connection_t *conn, pending_request_t *req, void *arg) {
+    return true;
+}
+
+/**
+ * @brief Disconnect from OBS and clean up connection resources.
+ * 
+ * This is the counterpart to obsws_connect(). It cleanly shuts down the connection,
+ * stops the background event thread, and frees all allocated resources.
+ * 
+ * The function performs these steps:
+ * 1. Signal the event_thread to stop by setting should_exit flag
+ * 2. Wait for the event_thread to actually exit using pthread_join()
+ * 3. Send a normal WebSocket close frame to OBS (if connected)
+ * 4. Destroy the libwebsockets context
+ *    (with a shared reactor, steps 1-4 are instead: ask the shard thread to
+ *    close the WebSocket and detach us, and wait until it has - the reactor's
+ *    threads and context keep running for the other connections)
+ * 5. Free all pending requests (they won't get responses now, but don't leak memory)
+ * 6. Free buffers, config, authentication data
+ * 7. Destroy all mutexes and condition variables
+ * 8. Free the connection structure
+ * 
+ * After calling this, the connection pointer is invalid. Don't use it again.
+ * 
+ * Safe to call multiple times: If you call it twice, the second call will be
+ * a no-op (because conn will be NULL).
+ * 
+ * Safe to call even if connection never fully established: If you disconnect
+ * while in CONNECTING or AUTHENTICATING state, everything is still cleaned up.
+ * 
+ * Important: This function blocks until the event_thread exits. If you have
+ * a callback that's blocked, this will deadlock. Make sure your callbacks
+ * don't block!
+ * 
+ * @param conn The connection to close (can be NULL - safe to call)
+ * 
+ * @see obsws_connect
+ */
+void obsws_disconnect(obsws_connection_t *conn) {
+    if (!conn) return;
+    
+    obsws_log(conn, OBSWS_LOG_INFO, "Disconnecting from OBS");
+    
+    /* From here on a dropped socket is final - no reconnect, no replay */
+    atomic_store_explicit(&conn->shutting_down, true, memory_order_release);
+    
+    obsws_shard_t *shard = conn->shard;
+    if (shard && shard->shared) {
+        /* Shared reactor: ask the shard thread to close our WebSocket and let
+           go of us, then wait until it has - after that no callback will
+           touch this connection again. */
+        pthread_mutex_lock(&shard->ops_mutex);
+        if (conn->shard_op == OBSWS_SHARD_OP_ATTACH) {
+            /* Never got as far as attaching - just take it back off the list */
+            obsws_connection_t **link = &shard->ops;
+            while (*link && *link != conn) link = &(*link)->op_next;
+            if (*link) *link = conn->op_next;
+            conn->shard_op = OBSWS_SHARD_OP_DETACHED;
+            pthread_mutex_unlock(&shard->ops_mutex);
+        } else {
+            pthread_mutex_unlock(&shard->ops_mutex);
+            shard_post_op(shard, conn, OBSWS_SHARD_OP_DETACH);
+            
+            pthread_mutex_lock(&shard->ops_mutex);
+            while (conn->shard_op != OBSWS_SHARD_OP_DETACHED) {
+                pthread_cond_wait(&shard->ops_cond, &shard->ops_mutex);
+            }
+            pthread_mutex_unlock(&shard->ops_mutex);
+        }
+        atomic_fetch_sub_explicit(&shard->conn_count, 1, memory_order_relaxed);
+    } else if (shard) {
+        /* Private shard: stop our event thread */
+        atomic_store_explicit(&shard->should_exit, true, memory_order_release);
+        if (shard->thread_running) {
+            lws_cancel_service(shard->context);
+            pthread_join(shard->thread, NULL);
+            shard->thread_running = false;
+        }
+        
+        /* The thread is gone, so nothing else is touching the timers now.
+           With an external loop there never was one; just keep any other
+           thread out of obsws_service() while we do this. */
+        pthread_mutex_lock(&shard->service_mutex);
+        cancel_connection_timers(conn);
+        
+        /* Close WebSocket - only if connected */
+        if (conn->wsi && conn->state == OBSWS_STATE_CONNECTED) {
+            lws_close_reason(conn->wsi, LWS_CLOSE_STATUS_NORMAL, NULL, 0);
+        }
+        pthread_mutex_unlock(&shard->service_mutex);
+        
+        /* Cleanup libwebsockets */
+        shard_shutdown(shard);
+        free(shard);
+    }
+    conn->shard = NULL;
+    conn->lws_context = NULL;
+    
+    /* Async requests still outstanding fail with OBSWS_ERROR_NOT_CONNECTED and
+       get their callbacks, here on the caller's thread. Their futures stay
+       valid until the application frees them. */
+    visit_pending_requests(conn, fail_async_visit, NULL);
+    dispatch_completions(conn);
+    
+    /* Free pending requests */
+    pending_request_t *req = visit_pending_requests(conn, take_any_visit, NULL);
+    while (req) {
+        pending_request_t *next = req->next;
+        request_retire(conn, req);
+        free_pending_request(req);
+        req = next;
+    }
+    
+    /* Free frames that never made it onto the wire */
+    drain_send_queue(conn);
+    frame_pool_destroy(conn);
+    
+    /* Free resources */
+    free(conn->recv_buffer);
+    free((char *)conn->config.host);
+    free((char *)conn->config.password);
+    free(conn->challenge);
+    free(conn->salt);
+    free(conn->auth_secret_salt);
+    OPENSSL_cleanse(conn->auth_secret, sizeof(conn->auth_secret));
+    free(conn->current_scene);
+    
+    /* Destroy mutexes */
+    pthread_mutex_destroy(&conn->state_mutex);
+    request_table_destroy(conn);
+    pthread_mutex_destroy(&conn->stats_mutex);
+    pthread_mutex_destroy(&conn->scene_mutex);
+    pthread_mutex_destroy(&conn->frame_pool_mutex);
+    pthread_mutex_destroy(&conn->ping_mutex);
+    pthread_cond_destroy(&conn->ping_cond);
+    
+    free(conn);
 }
 
 /**
- * @brief Handle the IDENTIFIED confirmation message from OBS.
+ * @brief Create a shared reactor - a fixed pool of event loop threads.
  * 
- * After we send an IDENTIFY message with authentication (or without if auth
- * isn't required), OBS responds with an IDENTIFIED message to confirm that
- * the connection is established and ready for commands. This function marks
- * the connection as fully established, records connection statistics, and
- * resets the reconnection state.
+ * Normally every connection gets its own libwebsockets context and its own
+ * background thread. That's simple and isolates connections from each other,
+ * but an application driving hundreds of OBS instances ends up with hundreds
+ * of threads, each waking up on its own timer. A reactor replaces that with
+ * num_threads shards, each one lws_context serviced by one thread. Connections
+ * created with config.reactor set are spread across the shards (new ones go to
+ * whichever has the fewest), so thread count, context switches and per-
+ * connection memory stop scaling with the number of connections.
  * 
- * Receiving this message means:
- * - Authentication succeeded (if it was required)
- * - The server has accepted our protocol version
- * - We can now send REQUEST messages and receive EVENT messages
- * - The connection is in a healthy state
+ * Why several contexts instead of one context with several service threads?
+ * lws only supports multiple service threads per context when it's built with
+ * LWS_MAX_SMP > 1, which most distro packages aren't. Independent shards work
+ * with any build and never share locks inside lws.
  * 
- * We take this opportunity to:
- * 1. Log successful authentication
- * 2. Transition state to CONNECTED (the only valid way to enter this state)
- * 3. Record the timestamp of successful connection (for statistics)
- * 4. Reset the reconnection attempt counter and delay (we're connected!)
+ * Trade-off: callbacks for all connections on a shard run on the same thread,
+ * so a slow event or log callback delays every other connection on that shard.
  * 
- * @param conn The connection structure to mark as identified
- * @param data Unused (the IDENTIFIED message typically has no data payload)
- * @return Always 0 (this message type should never fail)
+ * @param num_threads Number of shards/threads (0 = one per online CPU)
+ * @return Reactor handle, or NULL if allocation or context creation failed
  * 
- * @internal
+ * @see obsws_reactor_destroy, obsws_config_t
  */
-static int handle_identified_message(obsws_connection_t *conn, cJSON *data) {
-    (void)data;  /* Unused parameter */
-    obsws_log(conn, OBSWS_LOG_INFO, "Successfully authenticated with OBS");
-    /* DEBUG_LOW: Authentication success */
-    obsws_debug(conn, OBSWS_DEBUG_LOW, "Identified message received - authentication successful");
-    set_connection_state(conn, OBSWS_STATE_CONNECTED);
+obsws_reactor_t* obsws_reactor_create(uint32_t num_threads) {
+    if (!g_library_initialized) {
+        obsws_init();
+    }
+    
+    if (num_threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = cpus > 0 ? (uint32_t)cpus : 1;
+    }
+    
+    obsws_reactor_t *reactor = calloc(1, sizeof(obsws_reactor_t));
+    if (!reactor) return NULL;
+    
+    reactor->shards = calloc(num_threads, sizeof(obsws_shard_t));
+    if (!reactor->shards) {
+        free(reactor);
+        return NULL;
+    }
+    
+    for (uint32_t i = 0; i < num_threads; i++) {
+        if (!shard_init(&reactor->shards[i], true, false) || !shard_start(&reactor->shards[i])) {
+            obsws_log(NULL, OBSWS_LOG_ERROR, "Failed to start reactor shard %u", i);
+            if (reactor->shards[i].context) {
+                shard_shutdown(&reactor->shards[i]);
+            }
+            reactor->num_shards = i;
+            obsws_reactor_destroy(reactor);
+            return NULL;
+        }
+        reactor->num_shards = i + 1;
+    }
+    
+    obsws_log(NULL, OBSWS_LOG_INFO, "Shared reactor started with %u threads", num_threads);
+    return reactor;
+}
+
+/**
+ * @brief Stop a shared reactor's threads and free it.
+ * 
+ * Every connection using the reactor must be disconnected first - their
+ * WebSockets live in the reactor's contexts, and obsws_disconnect() needs the
+ * shard threads to detach them. Connections still attached here are torn down
+ * at the lws level and left unusable; we log a warning if that happens.
+ * 
+ * @param reactor Reactor to destroy (NULL is safe - does nothing)
+ * 
+ * @see obsws_reactor_create
+ */
+void obsws_reactor_destroy(obsws_reactor_t *reactor) {
+    if (!reactor) return;
+    
+    for (uint32_t i = 0; i < reactor->num_shards; i++) {
+        obsws_shard_t *shard = &reactor->shards[i];
+        size_t remaining = atomic_load_explicit(&shard->conn_count, memory_order_relaxed);
+        if (remaining > 0) {
+            obsws_log(NULL, OBSWS_LOG_WARNING,
+                      "Destroying reactor shard %u with %zu connections still attached", i, remaining);
+        }
+        shard_shutdown(shard);
+    }
+    
+    free(reactor->shards);
+    free(reactor);
+}
+
+/**
+ * @brief Check if a connection is actively connected to OBS.
+ * 
+ * Convenience function that returns true if the connection is in CONNECTED state
+ * and false otherwise. Useful for checking before sending requests.
+ * 
+ * Thread-safe: This function locks the state_mutex before checking, so it's
+ * safe to call from any thread.
+ * 
+ * Return value: The connection must be in OBSWS_STATE_CONNECTED to return true.
+ * If it's CONNECTING, AUTHENTICATING, ERROR, or DISCONNECTED, this returns false.
+ * 
+ * @param conn The connection to check (NULL is safe - returns false)
+ * @return true if connected, false otherwise
+ * 
+ * @see obsws_get_state
+ */
+bool obsws_is_connected(const obsws_connection_t *conn) {
+    if (!conn) return false;
+    
+    /* Thread-safe state check */
+    pthread_mutex_lock((pthread_mutex_t *)&conn->state_mutex);
+    bool connected = (conn->state == OBSWS_STATE_CONNECTED);
+    pthread_mutex_unlock((pthread_mutex_t *)&conn->state_mutex);
+    
+    return connected;
+}
+
+/**
+ * @brief Get the current connection state.
+ * 
+ * Returns one of the connection states:
+ * - OBSWS_STATE_DISCONNECTED: Not connected, idle
+ * - OBSWS_STATE_CONNECTING: TCP connection established, waiting for WebSocket handshake
+ * - OBSWS_STATE_AUTHENTICATING: WebSocket established, waiting for auth response
+ * - OBSWS_STATE_CONNECTED: Connected and ready for requests
+ * - OBSWS_STATE_ERROR: Connection encountered an error
+ * 
+ * State transitions normally follow this flow:
+ * DISCONNECTED -> CONNECTING -> AUTHENTICATING -> CONNECTED
+ * 
+ * But with errors, you can also have:
+ * (any state) -> ERROR
+ * 
+ * You don't usually need to call this - just try to send requests and check
+ * the error code. But it's useful for monitoring and debugging.
+ * 
+ * Thread-safe: This function locks the state_mutex, so it's safe to call
+ * from any thread.
+ * 
+ * @param conn The connection to check (NULL is safe - returns DISCONNECTED)
+ * @return The current connection state
+ * 
+ * @see obsws_is_connected
+ */
+obsws_state_t obsws_get_state(const obsws_connection_t *conn) {
+    if (!conn) return OBSWS_STATE_DISCONNECTED;
+    
+    pthread_mutex_lock((pthread_mutex_t *)&conn->state_mutex);
+    obsws_state_t state = conn->state;
+    pthread_mutex_unlock((pthread_mutex_t *)&conn->state_mutex);
+    
+    return state;
+}
+
+/**
+ * @brief Check whether the current session speaks MessagePack.
+ * 
+ * config.msgpack only asks for obswebsocket.msgpack; OBS may turn it down, in
+ * which case the connection quietly carries on in JSON. This tells the two
+ * apart. The subprotocol is settled during the handshake, so the answer is
+ * only meaningful while connected - any other state returns false.
+ * 
+ * Thread-safe: msgpack_active is set on the event thread before the
+ * connection becomes CONNECTED, so reading it under state_mutex once the
+ * state says CONNECTED is safe from any thread.
+ * 
+ * @param conn The connection to check (NULL is safe - returns false)
+ * @return true if connected with the MessagePack subprotocol, false otherwise
+ * 
+ * @see obsws_is_connected
+ */
+bool obsws_is_msgpack(const obsws_connection_t *conn) {
+    if (!conn) return false;
+    
+    pthread_mutex_lock((pthread_mutex_t *)&conn->state_mutex);
+    bool msgpack = conn->state == OBSWS_STATE_CONNECTED && conn->msgpack_active;
+    pthread_mutex_unlock((pthread_mutex_t *)&conn->state_mutex);
+    
+    return msgpack;
+}
+
+/**
+ * @brief Retrieve performance and connectivity statistics.
+ * 
+ * The library maintains statistics about the connection:
+ * - messages_sent / messages_received: Count of WebSocket messages
+ * - bytes_sent / bytes_received: Total bytes transmitted/received
+ * - connected_since: Timestamp of when we reached CONNECTED state
+ * - reconnect_count: How many times we've reconnected (0 if never disconnected)
+ * 
+ * These can be useful for:
+ * - Monitoring connection health
+ * - Detecting stalled connections (if bytes_received stops increasing)
+ * - Debugging and performance profiling
+ * - Health dashboards or logging
+ * 
+ * Thread-safe: This function acquires stats_mutex and copies the entire
+ * stats structure, so it's safe to call from any thread. The copy operation
+ * is atomic from the caller's perspective.
+ * 
+ * Example usage:
+ * ```
+ * obsws_stats_t stats;
+ * obsws_get_stats(conn, &stats);
+ * printf("Received %zu messages, %zu bytes\\n", 
+ *        stats.messages_received, stats.bytes_received);
+ * ```
+ * 
+ * @param conn The connection to query (NULL returns error)
+ * @param stats Pointer to stats structure to fill (must not be NULL)
+ * @return OBSWS_OK on success, OBSWS_ERROR_INVALID_PARAM if conn or stats is NULL
+ * 
+ * @see obsws_stats_t
+ */
+obsws_error_t obsws_get_stats(const obsws_connection_t *conn, obsws_stats_t *stats) {
+    if (!conn || !stats) return OBSWS_ERROR_INVALID_PARAM;
+    
+    pthread_mutex_lock((pthread_mutex_t *)&conn->stats_mutex);
+    memcpy(stats, &conn->stats, sizeof(obsws_stats_t));
+    pthread_mutex_unlock((pthread_mutex_t *)&conn->stats_mutex);
+    
+    stats->in_flight = atomic_load_explicit(&conn->in_flight, memory_order_relaxed);
+    stats->in_flight_peak = atomic_load_explicit(&conn->in_flight_peak, memory_order_relaxed);
+    stats->window_backlog_depth = atomic_load_explicit(&conn->backlog_count, memory_order_relaxed);
+    
+    return OBSWS_OK;
+}
+
+/* First half of sending a request: an ID, the pending entry (with replay
+   copies for idempotent requests) and the serialized frame. Nothing is
+   tracked or queued yet, so the caller can still fill in the entry - the
+   async fields, say - without the event thread seeing it half-done, and a
+   failure here leaves nothing behind. launch_request() is the second half.
+   
+   data/data_len is the requestData as a validated JSON value, or NULL to
+   omit it; prepare_request() is the usual way in, from a string. */
+static obsws_error_t prepare_request_span(obsws_connection_t *conn, const char *request_type,
+                                          const char *data, size_t data_len,
+                                          pending_request_t **out_req, obsws_frame_t **out_frame) {
+    /* Create pending request (this assigns its ID) */
+    pending_request_t *req = alloc_pending_request(conn);
+    if (!req) {
+        return OBSWS_ERROR_OUT_OF_MEMORY;
+    }
+    
+    /* Keep what we need to send it again if the connection drops first. Only
+       for requests that are safe to run twice; the rest fail fast instead. */
+    if (conn->config.replay_idempotent_requests && request_is_idempotent(request_type)) {
+        req->replay_type = strdup(request_type);
+        if (data && (req->replay_data = malloc(data_len + 1)) != NULL) {
+            memcpy(req->replay_data, data, data_len);
+            req->replay_data[data_len] = '\0';
+        }
+        if (!req->replay_type || (data && !req->replay_data)) {
+            free_pending_request(req);
+            return OBSWS_ERROR_OUT_OF_MEMORY;
+        }
+    }
+    
+    /* Reads that an identical in-flight request could answer */
+    if (conn->config.coalesce_reads && request_is_read_only(request_type) &&
+        !coalesce_key_init(req, request_type, data, data_len)) {
+        free_pending_request(req);
+        return OBSWS_ERROR_OUT_OF_MEMORY;
+    }
+    
+    /* Serialize the envelope straight into a (usually pooled) frame */
+    obsws_frame_t *frame = build_request_frame_span(conn, request_type, req->request_id, data, data_len);
+    if (!frame) {
+        free_pending_request(req);
+        return OBSWS_ERROR_OUT_OF_MEMORY;
+    }
+    req->lane = request_priority(conn, request_type);
+    frame->lane = req->lane;
+    
+    *out_req = req;
+    *out_frame = frame;
+    return OBSWS_OK;
+}
+
+/* prepare_request_span() for requestData given as a string, which is checked
+   first - malformed requestData is left out, with a warning, rather than
+   getting the connection closed by OBS */
+static obsws_error_t prepare_request(obsws_connection_t *conn, const char *request_type,
+                                     const char *request_data, pending_request_t **out_req,
+                                     obsws_frame_t **out_frame) {
+    const char *data = NULL;
+    size_t data_len = 0;
+    if (request_data && !json_value_span(request_data, strlen(request_data), &data, &data_len)) {
+        obsws_log(conn, OBSWS_LOG_WARNING, "Ignoring malformed requestData for %s", request_type);
+        data = NULL;
+    }
+    return prepare_request_span(conn, request_type, data, data_len, out_req, out_frame);
+}
+
+/* prepare_request() for a template. The frame is built from the template
+   with nothing parsed or copied, unless the request needs its requestData as
+   text: to coalesce on, or - when the caller isn't waiting (borrow_args
+   false), so its args won't outlive the call - to replay from. Then the text
+   is rendered once and it goes the ordinary way. */
+static obsws_error_t prepare_template_request(obsws_connection_t *conn, const obsws_request_template_t *tmpl,
+                                              const obsws_template_arg_t *args, bool borrow_args,
+                                              pending_request_t **out_req, obsws_frame_t **out_frame) {
+    bool replay = conn->config.replay_idempotent_requests && request_is_idempotent(tmpl->request_type);
+    if ((replay && !borrow_args) || (conn->config.coalesce_reads && request_is_read_only(tmpl->request_type))) {
+        char buf[256];
+        char *text;
+        if (!template_render(tmpl, args, buf, sizeof(buf), &text)) {
+            return OBSWS_ERROR_OUT_OF_MEMORY;
+        }
+        obsws_error_t err = prepare_request(conn, tmpl->request_type, text, out_req, out_frame);
+        if (text != buf) {
+            free(text);
+        }
+        return err;
+    }
+    
+    pending_request_t *req = alloc_pending_request(conn);
+    if (!req) {
+        return OBSWS_ERROR_OUT_OF_MEMORY;
+    }
+    
+    obsws_frame_t *frame = build_template_request_frame(conn, tmpl, args, req->request_id);
+    if (!frame) {
+        free_pending_request(req);
+        return OBSWS_ERROR_OUT_OF_MEMORY;
+    }
+    if (replay) {
+        req->replay_template = tmpl;
+        req->replay_args = args;
+    }
+    req->lane = request_priority(conn, tmpl->request_type);
+    frame->lane = req->lane;
+    
+    *out_req = req;
+    *out_frame = frame;
+    return OBSWS_OK;
+}
+
+/* Is this the thread that runs the connection's callbacks? Blocking there
+   would stop the very responses that free a slot. */
+static bool on_event_thread(obsws_connection_t *conn) {
+    obsws_shard_t *shard = conn->shard;
+    return shard && shard->thread_running && pthread_equal(pthread_self(), shard->thread);
+}
+
+/* Sleep until a slot is free, req's deadline passes or req is cancelled.
+   External-loop connections are serviced while we wait, as in
+   wait_pending_request(). */
+static bool window_block(obsws_connection_t *conn, pending_request_t *req) {
+    uint64_t deadline_ms = req->deadline_ms;
+    if (conn->shard->external) {
+        for (;;) {
+            if (window_try_acquire(conn, false)) return true;
+            uint64_t now = monotonic_ms();
+            if (now >= deadline_ms || atomic_load(&req->cancelled)) return false;
+            obsws_process_events(conn, (uint32_t)(deadline_ms - now));
+        }
+    }
+    
+    bool acquired;
+    pthread_mutex_lock(&conn->window_mutex);
+    atomic_fetch_add_explicit(&conn->window_waiters, 1, memory_order_seq_cst);
+    while (!(acquired = window_try_acquire(conn, false)) && !atomic_load(&req->cancelled)) {
+        if (cond_wait_until(&conn->window_cond, &conn->window_mutex, deadline_ms) == ETIMEDOUT) {
+            acquired = window_try_acquire(conn, false);
+            break;
+        }
+    }
+    atomic_fetch_sub_explicit(&conn->window_waiters, 1, memory_order_seq_cst);
+    pthread_mutex_unlock(&conn->window_mutex);
+    return acquired;
+}
+
+/* Take back a request that's in the table but was never sent, failing it (and
+   anything coalesced onto it) with error. Returns false if it completed in
+   the meantime - it then stays and finishes like any other request. */
+static bool withdraw_request(obsws_connection_t *conn, pending_request_t *req, obsws_error_t error) {
+    request_shard_t *shard = request_shard(conn, req->seq);
+    
+    pthread_mutex_lock(&shard->mutex);
+    pthread_mutex_lock(&req->mutex);
+    bool withdrawn = !req->completed;
+    if (withdrawn) {
+        req->error = error;
+        req->response->success = false;
+        req->response->error_message = strdup(obsws_error_string(error));
+        complete_request_locked(conn, req);
+    }
+    pthread_mutex_unlock(&req->mutex);
+    if (withdrawn) {
+        request_shard_unlink(conn, shard, req);
+    }
+    pthread_mutex_unlock(&shard->mutex);
+    
+    if (withdrawn) {
+        request_retire(conn, req);
+    }
+    return withdrawn;
+}
+
+/* The window is full: block, queue or refuse, per config.window_policy. Takes
+   the frame in every case. A request that waits past its deadline isn't
+   sent, and times out like any other; OBSWS_ERROR_WINDOW_FULL means it was
+   taken back out of the table and freed. */
+static obsws_error_t window_admit(obsws_connection_t *conn, pending_request_t *req, obsws_frame_t *frame) {
+    obsws_window_policy_t policy = conn->config.window_policy;
+    if (policy == OBSWS_WINDOW_BLOCK && on_event_thread(conn)) {
+        policy = OBSWS_WINDOW_QUEUE;
+    }
+    
+    if (policy == OBSWS_WINDOW_QUEUE) {
+        if (window_backlog_push(conn, req, frame)) {
+            return OBSWS_OK;
+        }
+    } else if (policy == OBSWS_WINDOW_BLOCK) {
+        uint64_t since_us = monotonic_us();
+        bool acquired = window_block(conn, req);
+        window_note_wait(conn, since_us);
+        if (acquired && window_claim_slot(conn, req)) {
+            enqueue_frame(conn, frame);
+        } else {
+            frame_free(conn, frame);
+            atomic_store_explicit(&conn->deadline_rearm, true, memory_order_release);
+            connection_kick(conn);
+        }
+        return OBSWS_OK;
+    }
     
+    frame_free(conn, frame);
     pthread_mutex_lock(&conn->stats_mutex);
-    conn->stats.connected_since = time(NULL);
-    conn->stats.reconnect_count = conn->reconnect_attempts;
+    conn->stats.window_rejections++;
     pthread_mutex_unlock(&conn->stats_mutex);
+    if (!withdraw_request(conn, req, OBSWS_ERROR_WINDOW_FULL)) {
+        return OBSWS_OK;
+    }
+    free_pending_request(req);
+    return OBSWS_ERROR_WINDOW_FULL;
+}
+
+/* Second half: give the entry its deadline, make it visible to the event
+   thread, then hand it the frame - once it has a slot in the in-flight
+   window. Fails if the connection is offline, the deadline heap can't grow or
+   the window policy turns the request away, in which case req and frame are
+   freed. */
+static obsws_error_t launch_request(obsws_connection_t *conn, pending_request_t *req,
+                                    obsws_frame_t *frame, uint32_t timeout_ms) {
+    if (atomic_load_explicit(&conn->offline, memory_order_seq_cst)) {
+        /* No socket and no reconnect coming - it could only time out */
+        frame_free(conn, frame);
+        free_pending_request(req);
+        return OBSWS_ERROR_NOT_CONNECTED;
+    }
     
-    conn->reconnect_attempts = 0;
-    conn->current_reconnect_delay = conn->config.reconnect_delay_ms;
+    if (timeout_ms == 0) {
+        timeout_ms = conn->config.recv_timeout_ms;
+    }
+    req->deadline_ms = monotonic_ms() + timeout_ms;
+    bool earliest;
+    if (!deadline_push(conn, req->deadline_ms, req->seq, &earliest)) {
+        frame_free(conn, frame);
+        free_pending_request(req);
+        return OBSWS_ERROR_OUT_OF_MEMORY;
+    }
     
-    return 0;
+    /* A new earliest deadline can't wait for the frame to be written - it may
+       sit behind a choked socket, a full window or a leader - so have the
+       shard thread re-arm the timer now. A kick already pending (the frame's
+       own, below) covers it. */
+    if (earliest) {
+        atomic_store_explicit(&conn->deadline_rearm, true, memory_order_release);
+        connection_kick(conn);
+    }
+    
+    track_pending_request(conn, req);
+    
+    /* An identical read already on its way answers this one too. The frame
+       goes unsent. */
+    if (req->coalesce_key && coalesce_join(conn, req)) {
+        obsws_debug(conn, OBSWS_DEBUG_HIGH, "Request %s coalesced with one in flight", req->request_id);
+        frame_free(conn, frame);
+        pthread_mutex_lock(&conn->stats_mutex);
+        conn->stats.requests_coalesced++;
+        pthread_mutex_unlock(&conn->stats_mutex);
+        return OBSWS_OK;
+    }
+    
+    /* Take a slot in the in-flight window, or do what window_policy says.
+       Realtime requests take one regardless - a scene cut doesn't queue. */
+    if (!window_try_acquire(conn, req->lane == OBSWS_PRIORITY_REALTIME)) {
+        return window_admit(conn, req, frame);
+    }
+    if (!window_claim_slot(conn, req)) {
+        frame_free(conn, frame);  /* Already timed out - nothing left to send */
+        return OBSWS_OK;
+    }
+    
+    /* DEBUG_HIGH: Show request being sent */
+    obsws_debug(conn, OBSWS_DEBUG_HIGH, "Sending request (ID: %s): %s",
+                req->request_id, (const char *)frame->buf + LWS_PRE);
+    
+    /* Queue the frame for the event thread. No lock here - if the write later
+       fails, the event thread completes this request with OBSWS_ERROR_SEND_FAILED. */
+    enqueue_frame(conn, frame);
+    return OBSWS_OK;
+}
+
+/* The blocking half of obsws_send_request() / obsws_send_batch(): sleep until
+   req completes, or service the connection ourselves in external-loop mode.
+   The event thread times it out at req->deadline_ms; the caller's wait ends
+   at the same moment, so whichever notices first settles it. On timeout the
+   entry is removed and OBSWS_ERROR_TIMEOUT returned; on OBSWS_OK the caller
+   collects the result and removes it. */
+static obsws_error_t wait_pending_request(obsws_connection_t *conn, pending_request_t *req) {
+    bool timed_out = false;
+    
+    if (conn->shard->external) {
+        /* Nobody else is servicing this connection - pump it ourselves until
+           the response lands. Same outcome as the condvar wait below. */
+        for (;;) {
+            pthread_mutex_lock(&req->mutex);
+            bool done = req->completed;
+            pthread_mutex_unlock(&req->mutex);
+            if (done) break;
+            
+            uint64_t now = monotonic_ms();
+            if (now >= req->deadline_ms) {
+                timed_out = true;
+                break;
+            }
+            obsws_process_events(conn, (uint32_t)(req->deadline_ms - now));
+        }
+    } else {
+        pthread_mutex_lock(&req->mutex);
+        while (!req->completed) {
+            if (cond_wait_until(&req->cond, &req->mutex, req->deadline_ms) == ETIMEDOUT) {
+                timed_out = !req->completed;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&req->mutex);
+    }
+    
+    if (!timed_out) {
+        pthread_mutex_lock(&req->mutex);
+        timed_out = req->error == OBSWS_ERROR_TIMEOUT;
+        pthread_mutex_unlock(&req->mutex);
+    }
+    if (timed_out) {
+        remove_pending_request(conn, req);
+        return OBSWS_ERROR_TIMEOUT;
+    }
+    return OBSWS_OK;
+}
+
+/* The rest of a blocking send, once the request is prepared: put it on the
+   token, launch it, wait, and hand the response over */
+static obsws_error_t send_prepared(obsws_connection_t *conn, pending_request_t *req, obsws_frame_t *frame,
+                                   obsws_response_t **response, uint32_t timeout_ms,
+                                   obsws_cancel_token_t *token) {
+    obsws_error_t err;
+    if (token) {
+        pthread_mutex_lock(&token->mutex);
+        bool cancelled = token->cancelled;
+        if (!cancelled) {
+            req->token = token;
+            req->token_next = token->requests;
+            token->requests = req;
+        }
+        pthread_mutex_unlock(&token->mutex);
+        
+        if (cancelled) {
+            frame_free(conn, frame);
+            free_pending_request(req);
+            pthread_mutex_lock(&conn->stats_mutex);
+            conn->stats.requests_cancelled++;
+            pthread_mutex_unlock(&conn->stats_mutex);
+            return OBSWS_ERROR_CANCELLED;
+        }
+    }
+    
+    err = launch_request(conn, req, frame, timeout_ms);
+    if (err != OBSWS_OK) {
+        return err;
+    }
+    
+    err = wait_pending_request(conn, req);
+    if (err != OBSWS_OK) {
+        return err;
+    }
+    
+    pthread_mutex_lock(&req->mutex);
+    obsws_error_t result = req->error;
+    *response = req->response;
+    req->response = NULL; /* Transfer ownership */
+    pthread_mutex_unlock(&req->mutex);
+    
+    remove_pending_request(conn, req);
+    
+    return result;
+}
+
+/* The rest of an async send, once the request is prepared */
+static obsws_error_t send_prepared_async(obsws_connection_t *conn, pending_request_t *req, obsws_frame_t *frame,
+                                         uint32_t timeout_ms, obsws_completion_callback_t callback,
+                                         void *user_data, obsws_future_t **future) {
+    req->async = true;
+    req->callback = callback;
+    req->callback_data = user_data;
+    req->external = conn->shard->external;
+    if (future) {
+        /* The future's reference - taken before the event thread can drop the list's */
+        atomic_fetch_add_explicit(&req->refs, 1, memory_order_relaxed);
+        *future = (obsws_future_t *)req;
+    }
+    
+    obsws_error_t err = launch_request(conn, req, frame, timeout_ms);
+    if (err != OBSWS_OK && future) {
+        *future = NULL;
+    }
+    return err;
 }
 
 /**
- * @brief Handle EVENT messages from OBS (real-time notifications).
+ * @brief Send a synchronous request to OBS and wait for the response.
  * 
- * OBS continuously sends EVENT messages whenever something happens in the
- * application (scene changes, source muted/unmuted, recording started, etc.).
- * These events are only delivered if we subscribed to them in the IDENTIFY
- * message using the eventSubscriptions bitmask.
+ * This is the core function for all OBS operations. It implements the asynchronous
+ * request-response pattern of the OBS WebSocket v5 protocol:
  * 
- * This function:
- * 1. Extracts the event type and event data from the JSON
- * 2. Calls the user's event_callback if one was configured (async event loop)
- * 3. Updates internal caches (e.g., current scene name on SceneChanged)
+ * **Protocol Flow:**
+ * 1. Take a unique request ID (used to match responses)
+ * 2. Create a pending_request_t to track the in-flight operation
+ * 3. Build the request JSON with opcode 6 (REQUEST)
+ * 4. Push the frame onto the send queue; the event thread writes it on the next
+ *    LWS_CALLBACK_CLIENT_WRITEABLE
+ * 5. Block the caller with pthread_cond_timedwait() until response arrives
+ *    (with config->external_loop, service the connection inline instead)
+ * 6. Return the response to caller (who owns it and must free with obsws_response_free)
  * 
- * Important threading note: This is called from the background event_thread,
- * NOT from the main application thread. Therefore:
- * - The event_callback is executed in the event thread context
- * - The callback should not block (keep processing fast)
- * - The callback should not make blocking library calls
- * - The event_data_str parameter is temporary and freed after callback returns
- * - If the callback needs to keep the data, it must copy it
+ * **Why synchronous from caller's perspective?**
+ * Although WebSocket messages are async at the protocol level, we provide a
+ * synchronous API - the caller sends a request and blocks until the response
+ * arrives. This is simpler for application code than callback-based async APIs.
  * 
- * Scene caching optimization:
- * We maintain a cache of the currently active scene name in the connection
- * structure. When we see a CurrentProgramSceneChanged event, we update this
- * cache immediately. This avoids the need for the application to call
- * obsws_send_request(..., "GetCurrentProgramScene", ...) repeatedly.
- * The cache is protected by scene_mutex for thread safety.
+ * Behind the scenes, the background event_thread continuously processes WebSocket
+ * messages. When a REQUEST_RESPONSE (opcode 7) arrives matching a pending request
+ * ID, it signals the waiting condition variable, waking up the blocked caller.
  * 
- * @param conn The connection that received the event
- * @param data The parsed JSON "d" field containing eventType and eventData
- * @return 0 on success, -1 if the event data is malformed
+ * **Performance implications:**
+ * - Thread-safe: The main app thread can be blocked in obsws_send_request() while
+ *   the background event_thread processes other messages
+ * - No polling: Uses condition variables, not CPU-wasting polling loops
+ * - Can make multiple simultaneous requests from different threads (up to
+ *   config->max_in_flight, 256 by default, are sent at once; see window_policy
+ *   for the rest)
  * 
- * @internal
+ * **Connection drops:**
+ * If the connection goes away while a request is outstanding and a reconnect
+ * is coming, idempotent requests (Get*, Set*) are held and resent under the
+ * same ID once OBS has re-identified us; the caller just sees a slower
+ * response, still bounded by timeout_ms. Other requests fail at once with
+ * OBSWS_ERROR_NOT_CONNECTED - OBS may already have run them.
+ * 
+ * **Example usage:**
+ * ```
+ * obsws_response_t *response = NULL;
+ * obsws_error_t err = obsws_send_request(conn, "SetCurrentProgramScene",
+ *                                        "{\"sceneName\": \"Scene1\"}", 
+ *                                        &response, 0);
+ * if (err == OBSWS_OK && response && response->success) {
+ *     printf("Scene switched successfully\\n");
+ * }
+ * obsws_response_free(response);
+ * ```
+ * 
+ * @param conn Connection object (must be in CONNECTED state)
+ * @param request_type OBS request type like "GetCurrentProgramScene", "SetCurrentProgramScene", etc.
+ * @param request_data Optional JSON string with request parameters. NULL for no parameters.
+ *                     Example: "{\"sceneName\": \"Scene1\"}"
+ * @param response Output pointer for the response. Will be allocated by this function.
+ *                 Caller must free with obsws_response_free(). Can be NULL if caller doesn't
+ *                 need the response (but response is still consumed from server).
+ * @param timeout_ms Timeout in milliseconds (0 = use config->recv_timeout_ms, typically 30000ms)
+ * 
+ * @return OBSWS_OK if response received (check response->success for operation success)
+ * @return OBSWS_ERROR_INVALID_PARAM if conn, request_type, or response pointer is NULL
+ * @return OBSWS_ERROR_NOT_CONNECTED if connection is not in CONNECTED state
+ * @return OBSWS_ERROR_OUT_OF_MEMORY if pending request allocation fails
+ * @return OBSWS_ERROR_WINDOW_FULL if the in-flight window is full and window_policy
+ *         is OBSWS_WINDOW_FAIL (or the OBSWS_WINDOW_QUEUE backlog is full too)
+ * @return OBSWS_ERROR_SEND_FAILED if the event thread could not write the frame
+ * @return OBSWS_ERROR_MESSAGE_TOO_LARGE if the response went over config->max_message_size
+ * @return OBSWS_ERROR_NOT_CONNECTED if the connection dropped before the response and
+ *         the request can't be replayed (not idempotent, or no reconnect coming)
+ * @return OBSWS_ERROR_TIMEOUT if no response received within timeout_ms
+ * 
+ * @see obsws_response_t, obsws_response_free, obsws_error_string
  */
-static int handle_event_message(obsws_connection_t *conn, cJSON *data) {
-    cJSON *event_type = cJSON_GetObjectItem(data, "eventType");
-    cJSON *event_data = cJSON_GetObjectItem(data, "eventData");
-    
-    /* DEBUG_MEDIUM: Show event type */
-    if (event_type) {
-        obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Event received: %s", event_type->valuestring);
+obsws_error_t obsws_send_request(obsws_connection_t *conn, const char *request_type,
+                                 const char *request_data, obsws_response_t **response, uint32_t timeout_ms) {
+    return obsws_send_request_cancellable(conn, request_type, request_data, response, timeout_ms, NULL);
+}
+
+/**
+ * @brief obsws_send_request() that another thread can cut short with a cancel token.
+ * 
+ * The request is put on the token before it's launched, so cancelling the
+ * token wakes this call wherever it is waiting - for a slot in the in-flight
+ * window or for the response - and it returns OBSWS_ERROR_CANCELLED with a
+ * failed response. A token that's already cancelled fails the call up front,
+ * without sending anything.
+ * 
+ * @param conn Connection object (must be in CONNECTED state)
+ * @param request_type OBS request type like "GetSceneList"
+ * @param request_data Optional JSON string with request parameters (NULL for none)
+ * @param response Output pointer for the response (free with obsws_response_free())
+ * @param timeout_ms Timeout in milliseconds (0 = use config->recv_timeout_ms)
+ * @param token Cancel token from obsws_cancel_token_create(), or NULL
+ * 
+ * @return Everything obsws_send_request() returns, plus OBSWS_ERROR_CANCELLED
+ *         if the token was cancelled first
+ * 
+ * @see obsws_send_request, obsws_cancel_token_create
+ */
+obsws_error_t obsws_send_request_cancellable(obsws_connection_t *conn, const char *request_type,
+                                             const char *request_data, obsws_response_t **response,
+                                             uint32_t timeout_ms, obsws_cancel_token_t *token) {
+    if (!conn || !request_type || !response) {
+        return OBSWS_ERROR_INVALID_PARAM;
     }
     
-    if (event_type && conn->config.event_callback) {
-        char *event_data_str = event_data ? cJSON_PrintUnformatted(event_data) : NULL;
-        /* DEBUG_HIGH: Show full event data */
-        if (event_data_str) {
-            obsws_debug(conn, OBSWS_DEBUG_HIGH, "Event data: %s", event_data_str);
-        }
-        conn->config.event_callback(conn, event_type->valuestring, event_data_str, conn->config.user_data);
-        if (event_data_str) free(event_data_str);
+    if (conn->state != OBSWS_STATE_CONNECTED) {
+        return OBSWS_ERROR_NOT_CONNECTED;
     }
     
-    /* Update current scene cache if scene changed */
-    if (event_type && strcmp(event_type->valuestring, "CurrentProgramSceneChanged") == 0) {
-        cJSON *scene_name = cJSON_GetObjectItem(event_data, "sceneName");
-        if (scene_name) {
-            pthread_mutex_lock(&conn->scene_mutex);
-            free(conn->current_scene);
-            conn->current_scene = strdup(scene_name->valuestring);
-            pthread_mutex_unlock(&conn->scene_mutex);
-            /* DEBUG_LOW: Scene changes are important */
-            obsws_debug(conn, OBSWS_DEBUG_LOW, "Scene changed to: %s", scene_name->valuestring);
-        }
+    pending_request_t *req;
+    obsws_frame_t *frame;
+    obsws_error_t err = prepare_request(conn, request_type, request_data, &req, &frame);
+    if (err != OBSWS_OK) {
+        return err;
     }
-    
-    return 0;
+    return send_prepared(conn, req, frame, response, timeout_ms, token);
 }
 
 /**
- * @brief Handle REQUEST_RESPONSE messages from OBS (responses to our commands).
- * 
- * When we send a REQUEST message (via obsws_send_request), OBS processes it
- * and sends back a REQUEST_RESPONSE message with the same requestId that we
- * used. This function matches the response to the pending request, populates
- * the response data, and wakes up the waiting thread.
- * 
- * The async request/response pattern allows the application to send multiple
- * requests without waiting for each response. The flow is:
- * 1. Application calls obsws_send_request("GetScenes", ...) -> returns immediately
- * 2. The request is created with a unique UUID and added to pending_requests list
- * 3. Background thread sends the request to OBS
- * 4. Background thread waits for response (on condition variable, not busy-polling)
- * 5. OBS responds with REQUEST_RESPONSE containing the requestId
- * 6. This function matches it to the pending request
- * 7. Function sets response->success, response->status_code, response->response_data
- * 8. Function signals the condition variable to wake the waiting thread
- * 9. Application thread wakes up with the response ready
+ * @brief obsws_send_request() with requestData the caller vouches for.
  * 
- * This is far more efficient than synchronous request/response because:
- * - No blocking wait in the background thread
- * - Multiple requests can be in-flight simultaneously
- * - Doesn't freeze the application while waiting for OBS
- * - Condition variables are more efficient than polling
+ * The bytes go into the frame as they are, in a single copy - they aren't
+ * scanned, and needn't be NUL-terminated. That's for large payloads, like a
+ * SetInputSettings with a whole settings object, that the caller built or
+ * validated itself. Sending OBS malformed JSON gets the connection closed, so
+ * builds without NDEBUG check it anyway (see OBSWS_VALIDATE_RAW_REQUESTS).
+ * MessagePack connections always walk it, since they transcode it.
  * 
- * Response structure contains:
- * - success: Did the operation succeed? (not the HTTP status, but "was it valid?")
- * - status_code: The OBS response code (0 = success, >0 = error)
- * - response_data: JSON string with the actual result (e.g., scene list)
- * - error_message: If something failed, what was the reason?
+ * @param conn Connection object (must be in CONNECTED state)
+ * @param request_type OBS request type like "SetInputSettings"
+ * @param request_data requestData as one JSON object, or NULL for none
+ * @param data_len Length of request_data in bytes
+ * @param response Output pointer for the response (free with obsws_response_free())
+ * @param timeout_ms Timeout in milliseconds (0 = use config->recv_timeout_ms)
  * 
- * @param conn The connection that received the response
- * @param data The parsed JSON "d" field containing requestId, requestStatus, etc.
- * @return 0 on success, -1 if the response is malformed (e.g., missing requestId)
+ * @return Everything obsws_send_request() returns, plus
+ *         OBSWS_ERROR_INVALID_PARAM if checking found request_data malformed
  * 
- * @internal
+ * @see obsws_send_request, obsws_send_request_cjson
  */
-static int handle_request_response_message(obsws_connection_t *conn, cJSON *data) {
-    cJSON *request_id = cJSON_GetObjectItem(data, "requestId");
-    if (!request_id) return -1;
-    
-    /* DEBUG_MEDIUM: Show request ID being processed */
-    obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Response received for request: %s", request_id->valuestring);
-    
-    pending_request_t *req = find_pending_request(conn, request_id->valuestring);
-    if (!req) {
-        obsws_log(conn, OBSWS_LOG_WARNING, "Received response for unknown request: %s", request_id->valuestring);
-        return -1;
-    }
-    
-    pthread_mutex_lock(&req->mutex);
-    
-    cJSON *request_status = cJSON_GetObjectItem(data, "requestStatus");
-    if (request_status) {
-        cJSON *result = cJSON_GetObjectItem(request_status, "result");
-        cJSON *code = cJSON_GetObjectItem(request_status, "code");
-        cJSON *comment = cJSON_GetObjectItem(request_status, "comment");
-        
-        req->response->success = result ? result->valueint : false;
-        req->response->status_code = code ? code->valueint : -1;
-        
-        if (comment) {
-            req->response->error_message = strdup(comment->valuestring);
-        }
+obsws_error_t obsws_send_request_raw(obsws_connection_t *conn, const char *request_type,
+                                     const char *request_data, size_t data_len,
+                                     obsws_response_t **response, uint32_t timeout_ms) {
+    if (!conn || !request_type || !response) {
+        return OBSWS_ERROR_INVALID_PARAM;
     }
     
-    cJSON *response_data = cJSON_GetObjectItem(data, "responseData");
-    if (response_data) {
-        req->response->response_data = cJSON_PrintUnformatted(response_data);
+    if (conn->state != OBSWS_STATE_CONNECTED) {
+        return OBSWS_ERROR_NOT_CONNECTED;
     }
     
-    req->completed = true;
-    pthread_cond_broadcast(&req->cond);
-    pthread_mutex_unlock(&req->mutex);
+    const char *data = request_data;
+    if (request_data && (OBSWS_VALIDATE_RAW_REQUESTS || conn->msgpack_active) &&
+        (!json_value_span(request_data, data_len, &data, &data_len) || *data != '{')) {
+        obsws_log(conn, OBSWS_LOG_ERROR, "Malformed raw requestData for %s", request_type);
+        return OBSWS_ERROR_INVALID_PARAM;
+    }
     
-    return 0;
+    pending_request_t *req;
+    obsws_frame_t *frame;
+    obsws_error_t err = prepare_request_span(conn, request_type, data, data_len, &req, &frame);
+    if (err != OBSWS_OK) {
+        return err;
+    }
+    return send_prepared(conn, req, frame, response, timeout_ms, NULL);
 }
 
 /**
- * @brief Route incoming WebSocket messages to appropriate handlers based on opcode.
+ * @brief obsws_send_request() with requestData as a cJSON tree.
  * 
- * Every message from OBS contains an "op" field (opcode) that identifies the
- * message type. This function:
- * 1. Parses the JSON to extract the opcode and data
- * 2. Routes to the appropriate handler function based on the opcode
- * 3. Updates statistics (messages_received, bytes_received)
- * 
- * The OBS WebSocket protocol uses these opcodes:
- * - HELLO (0): Server greeting with auth info - handled by handle_hello_message
- * - IDENTIFY (1): Client auth - we send this, don't receive it
- * - IDENTIFIED (2): Auth success - handled by handle_identified_message
- * - EVENT (5): Real-time notifications - handled by handle_event_message
- * - REQUEST_RESPONSE (7): Command responses - handled by handle_request_response_message
- * - Other opcodes like REIDENTIFY, batch operations: not currently handled
- * 
- * This is one of the most critical functions in the library because it's in
- * the hot path of message processing. Performance matters here. We keep it
- * lightweight and defer heavy processing to the specific handlers.
+ * For callers that already have the tree. It's printed once, to a temporary
+ * string that is copied into the request frame like obsws_send_request_raw()
+ * data - cJSON's own output needs none of the syntax scan obsws_send_request()
+ * gives caller text. The tree is the library's from here on and is freed
+ * before this returns, whatever the outcome. Builds without NDEBUG check that
+ * it's an object.
  * 
- * Error handling is conservative: malformed JSON or missing opcode doesn't
- * crash the connection, it just logs and continues. This allows us to be
- * resilient to protocol variations or corruption.
+ * @param conn Connection object (must be in CONNECTED state)
+ * @param request_type OBS request type like "SetInputSettings"
+ * @param request_data requestData object, or NULL for none (always freed)
+ * @param response Output pointer for the response (free with obsws_response_free())
+ * @param timeout_ms Timeout in milliseconds (0 = use config->recv_timeout_ms)
  * 
- * @param conn The connection that received the message
- * @param message Pointer to the raw message data (not null-terminated)
- * @param len Number of bytes in the message
- * @return 0 on success, -1 on parse error (does not disconnect)
+ * @return Everything obsws_send_request() returns
  * 
- * @internal
+ * @see obsws_send_request, obsws_send_request_raw
  */
-static int handle_websocket_message(obsws_connection_t *conn, const char *message, size_t len) {
-    /* DEBUG_HIGH: Show full message content */
-    obsws_debug(conn, OBSWS_DEBUG_HIGH, "Received message (%zu bytes): %.*s", len, (int)len, message);
-    
-    cJSON *json = cJSON_ParseWithLength(message, len);
-    if (!json) {
-        obsws_log(conn, OBSWS_LOG_ERROR, "Failed to parse JSON message");
-        return -1;
+obsws_error_t obsws_send_request_cjson(obsws_connection_t *conn, const char *request_type,
+                                       struct cJSON *request_data, obsws_response_t **response,
+                                       uint32_t timeout_ms) {
+    obsws_error_t err = OBSWS_OK;
+    if (!conn || !request_type || !response) {
+        err = OBSWS_ERROR_INVALID_PARAM;
+    } else if (conn->state != OBSWS_STATE_CONNECTED) {
+        err = OBSWS_ERROR_NOT_CONNECTED;
+    } else if (OBSWS_VALIDATE_RAW_REQUESTS && request_data && !cJSON_IsObject(request_data)) {
+        obsws_log(conn, OBSWS_LOG_ERROR, "requestData for %s isn't a JSON object", request_type);
+        err = OBSWS_ERROR_INVALID_PARAM;
     }
     
-    cJSON *op = cJSON_GetObjectItem(json, "op");
-    cJSON *data = cJSON_GetObjectItem(json, "d");
-    
-    if (!op) {
-        obsws_log(conn, OBSWS_LOG_ERROR, "Message missing 'op' field");
-        cJSON_Delete(json);
-        return -1;
+    char *text = NULL;
+    if (err == OBSWS_OK && request_data && !(text = cJSON_PrintUnformatted(request_data))) {
+        err = OBSWS_ERROR_OUT_OF_MEMORY;
     }
-    
-    /* DEBUG_MEDIUM: Show opcode being processed */
-    obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Processing opcode: %d", op->valueint);
-    
-    int result = 0;
-    switch (op->valueint) {
-        case OBSWS_OPCODE_HELLO:
-            result = handle_hello_message(conn, data);
-            break;
-        case OBSWS_OPCODE_IDENTIFIED:
-            result = handle_identified_message(conn, data);
-            break;
-        case OBSWS_OPCODE_EVENT:
-            result = handle_event_message(conn, data);
-            break;
-        case OBSWS_OPCODE_REQUEST_RESPONSE:
-            result = handle_request_response_message(conn, data);
-            break;
-        default:
-            obsws_log(conn, OBSWS_LOG_DEBUG, "Unhandled opcode: %d", op->valueint);
-            break;
+    cJSON_Delete(request_data);
+    if (err != OBSWS_OK) {
+        return err;
     }
     
-    cJSON_Delete(json);
-    
-    pthread_mutex_lock(&conn->stats_mutex);
-    conn->stats.messages_received++;
-    conn->stats.bytes_received += len;
-    pthread_mutex_unlock(&conn->stats_mutex);
-    
-    return result;
+    /* cJSON's own output - nothing to check */
+    pending_request_t *req;
+    obsws_frame_t *frame;
+    err = prepare_request_span(conn, request_type, text, text ? strlen(text) : 0, &req, &frame);
+    free(text);
+    if (err != OBSWS_OK) {
+        return err;
+    }
+    return send_prepared(conn, req, frame, response, timeout_ms, NULL);
 }
 
-/* ============================================================================
- * libwebsockets Callbacks
- * ============================================================================ */
-
 /**
- * @brief libwebsockets callback - routes WebSocket events to our handlers.
- * 
- * libwebsockets is an event-driven WebSocket library. It calls this callback
- * function whenever something happens (connection established, data received,
- * connection closed, etc.). The "reason" parameter identifies what happened.
+ * @brief Send a request to OBS without waiting for the response.
  * 
- * We handle these key reasons:
- * - LWS_CALLBACK_CLIENT_ESTABLISHED: TCP/WebSocket handshake complete, ready for messages
- * - LWS_CALLBACK_CLIENT_RECEIVE: Data arrived from OBS
- * - LWS_CALLBACK_CLIENT_WRITEABLE: Socket is writable (less common with our design)
- * - LWS_CALLBACK_CLIENT_CONNECTION_ERROR: Connection failed (network error, bad host, etc.)
- * - LWS_CALLBACK_CLIENT_CLOSED: Connection closed normally
- * - LWS_CALLBACK_WSI_DESTROY: Cleanup callback
+ * Same request as obsws_send_request(), but it returns as soon as the frame is
+ * queued. When the response arrives - or the request fails or times out - the
+ * event thread completes it: the optional callback runs (on the event thread,
+ * or through config->completion_executor) and the future, if one was asked
+ * for, becomes ready. One thread can keep hundreds of requests in flight this
+ * way, across any number of connections, without a thread per request.
  * 
- * Important: This callback is called from the background event_thread, not
- * the main application thread. So it must be thread-safe and not block.
+ * **Lifetime:** the request belongs to the library until it completes. The
+ * response is owned by the future (or, without one, freed once the callback
+ * returns) - callbacks and obsws_future_get() only borrow it. Futures stay
+ * valid after the connection is gone; free each with obsws_future_free().
  * 
- * Message assembly: OBS WebSocket messages might arrive fragmented (multiple
- * packets). We accumulate them in recv_buffer and check lws_is_final_fragment()
- * to know when a complete message has arrived. Only then do we parse it.
+ * **Timeouts:** the event thread completes the request with
+ * OBSWS_ERROR_TIMEOUT as soon as timeout_ms has passed, measured on
+ * CLOCK_MONOTONIC (a timer armed for the earliest outstanding deadline).
  * 
- * Error handling: Connection errors and receive buffer overflows are logged
- * but don't crash. We just transition to ERROR state and let the connection
- * cleanup/reconnection logic handle recovery.
+ * **Example usage:**
+ * ```
+ * obsws_future_t *futures[3];
+ * obsws_send_request_async(conn, "GetVersion", NULL, 0, NULL, NULL, &futures[0]);
+ * obsws_send_request_async(conn, "GetSceneList", NULL, 0, NULL, NULL, &futures[1]);
+ * obsws_send_request_async(conn, "GetStats", NULL, 0, NULL, NULL, &futures[2]);
+ * obsws_future_wait_all(futures, 3, 0);
+ * for (int i = 0; i < 3; i++) {
+ *     const obsws_response_t *response;
+ *     if (obsws_future_get(futures[i], &response) == OBSWS_OK && response->success) {
+ *         printf("%s\n", response->response_data);
+ *     }
+ *     obsws_future_free(futures[i]);
+ * }
+ * ```
  * 
- * @param wsi The WebSocket instance (provided by libwebsockets)
- * @param reason The callback reason (LWS_CALLBACK_*)
- * @param user Our connection pointer (registered at context creation)
- * @param in Incoming data (for LWS_CALLBACK_CLIENT_RECEIVE)
- * @param len Size of incoming data
- * @return 0 for success, -1 for error (affects connection handling)
+ * @param conn Connection object (must be in CONNECTED state)
+ * @param request_type OBS request type like "GetVersion"
+ * @param request_data Optional JSON string with request parameters (NULL for none)
+ * @param timeout_ms Timeout in milliseconds (0 = use config->recv_timeout_ms)
+ * @param callback Optional completion callback (NULL for none)
+ * @param user_data Passed to callback
+ * @param future Optional output for a future to wait on (NULL for fire-and-forget / callback only)
+ * 
+ * @return OBSWS_OK once the request is queued - completion is reported later
+ * @return OBSWS_ERROR_INVALID_PARAM if conn or request_type is NULL
+ * @return OBSWS_ERROR_NOT_CONNECTED if connection is not in CONNECTED state
+ * @return OBSWS_ERROR_OUT_OF_MEMORY if the request could not be allocated
+ * @return OBSWS_ERROR_WINDOW_FULL if the in-flight window turned it away (see window_policy)
  * 
- * @internal
+ * @note Errors returned here mean the request was not sent; the callback doesn't run.
+ * @note With window_policy OBSWS_WINDOW_BLOCK (the default) this call waits while
+ *       config->max_in_flight requests are already out - except on the event
+ *       thread, where the request joins the backlog instead.
  */
-static int lws_callback(struct lws *wsi, enum lws_callback_reasons reason,
-                       void *user, void *in, size_t len) {
-    obsws_connection_t *conn = (obsws_connection_t *)user;
+obsws_error_t obsws_send_request_async(obsws_connection_t *conn, const char *request_type,
+                                       const char *request_data, uint32_t timeout_ms,
+                                       obsws_completion_callback_t callback, void *user_data,
+                                       obsws_future_t **future) {
+    if (future) {
+        *future = NULL;
+    }
+    if (!conn || !request_type) {
+        return OBSWS_ERROR_INVALID_PARAM;
+    }
     
-    switch (reason) {
-        case LWS_CALLBACK_CLIENT_ESTABLISHED:
-            obsws_log(conn, OBSWS_LOG_INFO, "WebSocket connection established");
-            set_connection_state(conn, OBSWS_STATE_CONNECTING);
-            break;
-            
-        case LWS_CALLBACK_CLIENT_RECEIVE:
-            if (conn->recv_buffer_used + len < conn->recv_buffer_size) {
-                memcpy(conn->recv_buffer + conn->recv_buffer_used, in, len);
-                conn->recv_buffer_used += len;
-                
-                if (lws_is_final_fragment(wsi)) {
-                    handle_websocket_message(conn, conn->recv_buffer, conn->recv_buffer_used);
-                    conn->recv_buffer_used = 0;
-                }
+    if (conn->state != OBSWS_STATE_CONNECTED) {
+        return OBSWS_ERROR_NOT_CONNECTED;
+    }
+    
+    pending_request_t *req;
+    obsws_frame_t *frame;
+    obsws_error_t err = prepare_request(conn, request_type, request_data, &req, &frame);
+    if (err != OBSWS_OK) {
+        return err;
+    }
+    return send_prepared_async(conn, req, frame, timeout_ms, callback, user_data, future);
+}
+
+/* Futures. An obsws_future_t is the async request's pending_request_t. Waiting
+   on several is done with a future_waiter_t linked onto each of them, so one
+   condition variable covers futures from any mix of connections. Futures on
+   external-loop connections are waited for by servicing those connections. */
+
+static bool future_completed(pending_request_t *req) {
+    pthread_mutex_lock(&req->mutex);
+    bool done = req->completed;
+    pthread_mutex_unlock(&req->mutex);
+    return done;
+}
+
+/* Each thread that waits on futures keeps one future_waiter_t for good, made
+   on its first wait and destroyed when the thread exits, rather than setting
+   up a mutex and condition variable per wait. A callback that waits on
+   futures from inside another wait on the same thread shares it harmlessly:
+   both loops recheck their futures after every wakeup. */
+static pthread_key_t waiter_key;
+static pthread_once_t waiter_key_once = PTHREAD_ONCE_INIT;
+
+static void thread_waiter_destroy(void *arg) {
+    future_waiter_t *waiter = (future_waiter_t *)arg;
+    pthread_cond_destroy(&waiter->cond);
+    pthread_mutex_destroy(&waiter->mutex);
+    free(waiter);
+}
+
+static void thread_waiter_key_create(void) {
+    pthread_key_create(&waiter_key, thread_waiter_destroy);
+}
+
+static future_waiter_t* thread_waiter(void) {
+    pthread_once(&waiter_key_once, thread_waiter_key_create);
+    
+    future_waiter_t *waiter = pthread_getspecific(waiter_key);
+    if (!waiter) {
+        waiter = malloc(sizeof(future_waiter_t));
+        if (!waiter) return NULL;
+        pthread_mutex_init(&waiter->mutex, NULL);
+        cond_init_monotonic(&waiter->cond);
+        waiter->fired = 0;
+        pthread_setspecific(waiter_key, waiter);
+    }
+    return waiter;
+}
+
+/* Shared by obsws_future_wait / wait_any / wait_all. Returns the index of a
+   completed future (any), OBSWS_OK once all are complete (all), or
+   OBSWS_ERROR_TIMEOUT. timeout_ms of 0 waits for as long as it takes - each
+   request's own timeout bounds that. */
+static int futures_wait(obsws_future_t *const *futures, size_t count, uint32_t timeout_ms, bool all) {
+    pending_request_t *const *reqs = (pending_request_t *const *)futures;
+    future_waiter_link_t stack_links[8];
+    future_waiter_link_t *links = count <= 8 ? stack_links : malloc(count * sizeof(*links));
+    future_waiter_t *waiter = thread_waiter();
+    if (!links || !waiter) {
+        if (links != stack_links) {
+            free(links);
+        }
+        return OBSWS_ERROR_OUT_OF_MEMORY;
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        pthread_mutex_lock(&reqs[i]->mutex);
+        links[i].waiter = waiter;
+        links[i].next = reqs[i]->waiters;
+        reqs[i]->waiters = &links[i];
+        pthread_mutex_unlock(&reqs[i]->mutex);
+    }
+    
+    uint64_t deadline = monotonic_ms() + timeout_ms;
+    int result = OBSWS_ERROR_TIMEOUT;
+    
+    for (;;) {
+        pthread_mutex_lock(&waiter->mutex);
+        unsigned seen = waiter->fired;
+        pthread_mutex_unlock(&waiter->mutex);
+        
+        size_t done = 0, external = 0;
+        int first = -1;
+        bool threaded = false;
+        for (size_t i = 0; i < count; i++) {
+            if (future_completed(reqs[i])) {
+                done++;
+                if (first < 0) first = (int)i;
+            } else if (reqs[i]->external) {
+                external++;
             } else {
-                obsws_log(conn, OBSWS_LOG_ERROR, "Receive buffer overflow");
-                conn->recv_buffer_used = 0;
+                threaded = true;
             }
+        }
+        if (all ? done == count : first >= 0) {
+            result = all ? OBSWS_OK : first;
             break;
-            
-        case LWS_CALLBACK_CLIENT_WRITEABLE:
-            /* Handle queued sends if needed */
-            break;
-            
-        case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
-            obsws_log(conn, OBSWS_LOG_ERROR, "Connection error: %s", in ? (char *)in : "unknown");
-            set_connection_state(conn, OBSWS_STATE_ERROR);
+        }
+        
+        uint64_t now = monotonic_ms();
+        if (timeout_ms && now >= deadline) {
             break;
-            
-        case LWS_CALLBACK_CLIENT_CLOSED:
-            obsws_log(conn, OBSWS_LOG_INFO, "WebSocket connection closed (reason in 'in' param)");
-            if (in && len > 0) {
-                obsws_log(conn, OBSWS_LOG_INFO, "Close reason: %.*s", (int)len, (char*)in);
+        }
+        uint32_t wait_ms = timeout_ms ? (uint32_t)(deadline - now) : OBSWS_EXTERNAL_MAX_WAIT_MS;
+        
+        if (external > 0) {
+            /* A single external connection can be serviced for the whole wait;
+               otherwise give each a non-blocking turn and nap briefly */
+            bool alone = external == 1 && !threaded;
+            for (size_t i = 0; i < count; i++) {
+                if (reqs[i]->external && !future_completed(reqs[i])) {
+                    obsws_process_events(reqs[i]->conn, alone ? wait_ms : 0);
+                }
             }
-            set_connection_state(conn, OBSWS_STATE_DISCONNECTED);
-            break;
-            
-        case LWS_CALLBACK_WSI_DESTROY:
-            conn->wsi = NULL;
-            break;
-            
-        default:
-            break;
+            if (alone) {
+                continue;
+            }
+            if (wait_ms > OBSWS_FUTURE_PUMP_MS) {
+                wait_ms = OBSWS_FUTURE_PUMP_MS;
+            }
+        }
+        
+        pthread_mutex_lock(&waiter->mutex);
+        if (waiter->fired == seen) {
+            if (timeout_ms || external > 0) {
+                cond_wait_until(&waiter->cond, &waiter->mutex, monotonic_ms() + wait_ms);
+            } else {
+                pthread_cond_wait(&waiter->cond, &waiter->mutex);
+            }
+        }
+        pthread_mutex_unlock(&waiter->mutex);
     }
     
-    return 0;
+    for (size_t i = 0; i < count; i++) {
+        pthread_mutex_lock(&reqs[i]->mutex);
+        future_waiter_link_t **link = &reqs[i]->waiters;
+        while (*link && *link != &links[i]) {
+            link = &(*link)->next;
+        }
+        if (*link) {
+            *link = links[i].next;
+        }
+        pthread_mutex_unlock(&reqs[i]->mutex);
+    }
+    
+    if (links != stack_links) {
+        free(links);
+    }
+    return result;
 }
 
-static const struct lws_protocols protocols[] = {
-    {
-        "obs-websocket",
-        lws_callback,
-        0,
-        OBSWS_DEFAULT_BUFFER_SIZE,
-        0, /* id */
-        NULL, /* user */
-        0 /* tx_packet_size */
-    },
-    { NULL, NULL, 0, 0, 0, NULL, 0 }
-};
+/**
+ * @brief Check whether a future has completed, without blocking.
+ * 
+ * @param future Future from obsws_send_request_async()
+ * @return true once the request has completed (successfully or not)
+ */
+bool obsws_future_ready(obsws_future_t *future) {
+    return future && future_completed((pending_request_t *)future);
+}
 
-/* ============================================================================
- * Event Thread
- * ============================================================================ */
+/**
+ * @brief Wait for a future to complete.
+ * 
+ * @param future Future from obsws_send_request_async()
+ * @param timeout_ms Longest to wait (0 = until the request completes or times out)
+ * @return OBSWS_OK once complete (see obsws_future_get for the outcome)
+ * @return OBSWS_ERROR_TIMEOUT if it's still pending after timeout_ms - the
+ *         request itself carries on
+ * @return OBSWS_ERROR_INVALID_PARAM if future is NULL
+ */
+obsws_error_t obsws_future_wait(obsws_future_t *future, uint32_t timeout_ms) {
+    if (!future) {
+        return OBSWS_ERROR_INVALID_PARAM;
+    }
+    return (obsws_error_t)futures_wait(&future, 1, timeout_ms, true);
+}
 
 /**
- * @brief Background thread function that continuously processes WebSocket events.
- * 
- * Each connection has one background thread dedicated to processing WebSocket
- * messages and timers. The main application thread remains free to make requests
- * and do application work without blocking.
- * 
- * This thread:
- * 1. Calls lws_service() to pump the libwebsockets event loop (typically blocks
- *    for 50ms waiting for events, then processes them and returns)
- * 2. Periodically cleans up old/timed-out requests
- * 3. Sends keep-alive pings if configured (to detect dead connections)
- * 4. Exits gracefully when should_exit flag is set
- * 
- * Lifetime: This thread is created in obsws_connect() and destroyed in
- * obsws_disconnect() using pthread_join(). The should_exit flag is used to
- * signal the thread to stop, which it checks at the start of each loop.
- * 
- * The lws_service() call is the core of this loop. It:
- * - Waits up to 50ms for data from the network using select/poll
- * - If data arrives, invokes lws_callback to notify us
- * - Returns after ~50ms even if no data (so we stay responsive to should_exit)
- * 
- * This asynchronous design has several advantages:
- * - App thread isn't blocked waiting for responses
- * - Multiple requests can be in-flight simultaneously
- * - Events can be delivered to callbacks instantly (no polling delay)
- * - Automatic keep-alive pings keep the connection alive through firewalls
- * 
- * Memory note: Callbacks invoked from this thread have access to the same
- * connection object as the main thread, hence all the mutexes protecting
- * critical sections. The pending_request_t condition variables synchronize
- * request responses between this thread and application threads.
- * 
- * @param arg The obsws_connection_t* that this thread services
- * @return Always NULL (threads don't return values)
- * 
- * @internal
+ * @brief Wait until any one of several futures completes.
+ * 
+ * The futures may belong to different connections. Handy for a control
+ * thread that acts on whichever response comes back first.
+ * 
+ * @param futures Array of futures
+ * @param count Number of futures in the array
+ * @param timeout_ms Longest to wait (0 = until one completes)
+ * @return Index of a completed future (the lowest, if several are)
+ * @return OBSWS_ERROR_TIMEOUT if none completed within timeout_ms
+ * @return OBSWS_ERROR_INVALID_PARAM if futures is NULL, count is 0 or an entry is NULL
+ * @return OBSWS_ERROR_OUT_OF_MEMORY if the wait could not be set up
  */
-static void* event_thread_func(void *arg) {
-    obsws_connection_t *conn = (obsws_connection_t *)arg;
-    
-    bool should_continue = true;
-    while (should_continue) {
-        /* Check exit flag with mutex protection */
-        pthread_mutex_lock(&conn->state_mutex);
-        should_continue = !conn->should_exit;
-        pthread_mutex_unlock(&conn->state_mutex);
-        
-        if (!should_continue) break;
-        
-        if (conn->lws_context) {
-            lws_service(conn->lws_context, 50);
-            
-            /* Cleanup old requests periodically */
-            cleanup_old_requests(conn);
-            
-            /* Handle keep-alive pings */
-            if (conn->config.ping_interval_ms > 0 && conn->state == OBSWS_STATE_CONNECTED) {
-                time_t now = time(NULL);
-                if (now - conn->last_ping_sent >= conn->config.ping_interval_ms / 1000) {
-                    if (conn->wsi) {
-                        lws_callback_on_writable(conn->wsi);
-                    }
-                    conn->last_ping_sent = now;
-                }
-            }
-        } else {
-            struct timespec ts = {0, 50000000};  /* 50ms = 50,000,000 nanoseconds */
-            nanosleep(&ts, NULL);
-        }
+int obsws_future_wait_any(obsws_future_t *const *futures, size_t count, uint32_t timeout_ms) {
+    if (!futures || count == 0) {
+        return OBSWS_ERROR_INVALID_PARAM;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!futures[i]) return OBSWS_ERROR_INVALID_PARAM;
     }
-    
-    return NULL;
+    return futures_wait(futures, count, timeout_ms, false);
 }
 
-/* ============================================================================
- * Public API Implementation
- * ============================================================================ */
-
 /**
- * @brief Initialize the libwsv5 library.
- * 
- * This function must be called before creating any connections. It:
- * 1. Initializes OpenSSL (EVP library for hashing)
- * 2. Seeds the random number generator for UUID generation
- * 3. Sets the global g_library_initialized flag
- * 
- * Thread safety: This function is thread-safe. Multiple threads can call it
- * simultaneously, and only one will actually do the initialization (protected
- * by g_init_mutex). Subsequent calls are no-ops.
- * 
- * Note: obsws_connect() will call this automatically if you forget, so you
- * don't *have* to call it explicitly. But doing so allows you to initialize
- * in a controlled way, separate from connection creation.
- * 
- * Cleanup: When you're done with the library, call obsws_cleanup() to
- * deallocate resources. This is technically optional on program exit (the OS
- * cleans up anyway), but good practice for testing and library shutdown.
- * 
- * @return OBSWS_OK always (initialization cannot fail in the current design)
- * 
- * @see obsws_cleanup, obsws_connect
+ * @brief Wait until all of several futures have completed.
+ * 
+ * @param futures Array of futures (may belong to different connections)
+ * @param count Number of futures in the array
+ * @param timeout_ms Longest to wait (0 = until all complete)
+ * @return OBSWS_OK once every future is complete
+ * @return OBSWS_ERROR_TIMEOUT if some are still pending after timeout_ms
+ * @return OBSWS_ERROR_INVALID_PARAM if futures is NULL or an entry is NULL
+ * @return OBSWS_ERROR_OUT_OF_MEMORY if the wait could not be set up
  */
-obsws_error_t obsws_init(void) {
-    pthread_mutex_lock(&g_init_mutex);
-    
-    if (g_library_initialized) {
-        pthread_mutex_unlock(&g_init_mutex);
+obsws_error_t obsws_future_wait_all(obsws_future_t *const *futures, size_t count, uint32_t timeout_ms) {
+    if (!futures && count > 0) {
+        return OBSWS_ERROR_INVALID_PARAM;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!futures[i]) return OBSWS_ERROR_INVALID_PARAM;
+    }
+    if (count == 0) {
         return OBSWS_OK;
     }
-    
-    /* Initialize OpenSSL */
-    OpenSSL_add_all_algorithms();
-    
-    /* Seed random number generator */
-    srand(time(NULL));
-    
-    /* Detect if stderr is a TTY for color output auto-detection */
-    g_log_ctx.is_tty = isatty(STDERR_FILENO) == 1;
-    
-    g_library_initialized = true;
-    pthread_mutex_unlock(&g_init_mutex);
-    
-    return OBSWS_OK;
+    return (obsws_error_t)futures_wait(futures, count, timeout_ms, true);
 }
 
 /**
- * @brief Clean up library resources.
- * 
- * Call this when you're done with the library to deallocate OpenSSL resources.
- * This is a counterpart to obsws_init().
- * 
- * Important: Make sure all obsws_connection_t objects have been disconnected
- * and freed via obsws_disconnect() before calling this. If not, you might have
- * dangling references and resource leaks.
- * 
- * Thread safety: This function is thread-safe and idempotent (safe to call
- * multiple times). It checks g_library_initialized before doing anything.
- * 
- * Note: This is optional on program exit because the OS will clean up memory
- * anyway. But it's good practice for:
- * - Library consumers that need clean shutdown
- * - Memory leak detectors / Valgrind tests
- * - Programs that unload the library
- * 
- * @see obsws_init
+ * @brief Get the outcome of a future, waiting for it if need be.
+ * 
+ * @param future Future from obsws_send_request_async()
+ * @param response Optional output: the response, owned by the future - valid
+ *                 until obsws_future_free(). Check response->success as with
+ *                 obsws_send_request().
+ * @return The request's result: OBSWS_OK if OBS answered, otherwise the error
+ *         that ended it (OBSWS_ERROR_TIMEOUT, OBSWS_ERROR_NOT_CONNECTED,
+ *         OBSWS_ERROR_SEND_FAILED, ...)
+ * @return OBSWS_ERROR_INVALID_PARAM if future is NULL
  */
-void obsws_cleanup(void) {
-    pthread_mutex_lock(&g_init_mutex);
-    
-    if (!g_library_initialized) {
-        pthread_mutex_unlock(&g_init_mutex);
-        return;
+obsws_error_t obsws_future_get(obsws_future_t *future, const obsws_response_t **response) {
+    if (response) {
+        *response = NULL;
+    }
+    if (!future) {
+        return OBSWS_ERROR_INVALID_PARAM;
     }
     
-    EVP_cleanup();
-    g_library_initialized = false;
-    
-    pthread_mutex_unlock(&g_init_mutex);
+    pending_request_t *req = (pending_request_t *)future;
+    obsws_error_t err = obsws_future_wait(future, 0);
+    if (err != OBSWS_OK) {
+        return err;
+    }
+    if (response) {
+        *response = req->response;
+    }
+    return req->error;
 }
 
 /**
- * @brief Get the library version string.
+ * @brief Release a future.
  * 
- * Returns a semantic version string like "1.0.0" that identifies which
- * version of libwsv5 is being used. Useful for debugging and logging.
+ * Frees the future and its response. If the request is still in flight it
+ * carries on - its callback still runs - the result just has nowhere to go.
  * 
- * @return Pointer to static version string (don't free)
+ * @param future Future from obsws_send_request_async() (NULL is a no-op)
  */
-const char* obsws_version(void) {
-    return OBSWS_VERSION;
+void obsws_future_free(obsws_future_t *future) {
+    if (future) {
+        release_pending_request((pending_request_t *)future);
+    }
 }
 
 /**
- * @brief Set the global log level threshold.
- * 
- * The library logs various messages during operation. This function sets which
- * messages are displayed. All messages at the specified level and higher
- * severity are shown; lower severity messages are hidden.
+ * @brief Cancel an async request.
  * 
- * Levels in increasing severity:
- * - OBSWS_LOG_DEBUG: Low-level diagnostic info (too verbose for production)
- * - OBSWS_LOG_INFO: General informational messages (usual choice)
- * - OBSWS_LOG_WARNING: Potentially problematic situations (degraded but working)
- * - OBSWS_LOG_ERROR: Error conditions that need attention
- * 
- * Example: If you call obsws_set_log_level(OBSWS_LOG_WARNING), you'll see
- * only WARNING and ERROR messages, but not INFO or DEBUG messages.
+ * The request completes at once with OBSWS_ERROR_CANCELLED, from the calling
+ * thread: anyone waiting on the future wakes up, and the callback runs on the
+ * event thread (or the completion executor) as for any other completion. A
+ * request still waiting for a window slot is never sent. One that's already
+ * out may still run in OBS - there's no way to recall it - and its response
+ * is dropped, unparsed, when it arrives.
  * 
- * Thread safety: This modifies a global variable without locking, so if you
- * might call this from multiple threads, use synchronization externally.
+ * Requests coalesced onto this one (config->coalesce_reads) didn't ask to be
+ * cancelled: they're sent on their own instead.
  * 
- * @param level The minimum severity level to display
- * @see obsws_set_debug_level
+ * @param future Future from obsws_send_request_async()
+ * @return true if this call cancelled the request
+ * @return false if it had already completed, or future is NULL
  */
-void obsws_set_log_level(obsws_log_level_t level) {
-    g_log_level = level;
+bool obsws_cancel(obsws_future_t *future) {
+    return future && cancel_request((pending_request_t *)future);
 }
 
 /**
- * @brief Set the global debug level.
- * 
- * Debug logging is separate from regular logging. It provides extremely
- * detailed trace information about the WebSocket protocol, message parsing,
- * authentication, etc. This is useful during development and troubleshooting.
- * 
- * Debug levels:
- * - OBSWS_DEBUG_NONE: No debug output (fastest)
- * - OBSWS_DEBUG_LOW: Major state transitions and connection events
- * - OBSWS_DEBUG_MEDIUM: Message types and handlers invoked
- * - OBSWS_DEBUG_HIGH: Full message content and every operation
- * 
- * Debug logging is independent of log level. You can have OBSWS_LOG_ERROR
- * set (hide non-error logs) but still see OBSWS_DEBUG_HIGH output.
+ * @brief Create a cancel token.
  * 
- * Performance warning: OBSWS_DEBUG_HIGH produces enormous output and will
- * slow down the library significantly. Only use during debugging!
- * 
- * Thread safety: Same as obsws_set_log_level (modifies global without locking).
+ * Pass it to obsws_send_request_cancellable(). Any thread can then cancel it,
+ * which ends every request sent with it straight away - the blocked callers
+ * return OBSWS_ERROR_CANCELLED - and fails any sent with it later. One token
+ * can cover many requests on many connections, e.g. all the work for one
+ * UI action.
  * 
- * @param level The debug verbosity level
- * @see obsws_set_log_level, obsws_get_debug_level
+ * @return New token, or NULL if allocation fails
  */
-void obsws_set_debug_level(obsws_debug_level_t level) {
-    g_debug_level = level;
+obsws_cancel_token_t* obsws_cancel_token_create(void) {
+    obsws_cancel_token_t *token = calloc(1, sizeof(obsws_cancel_token_t));
+    if (!token) return NULL;
+    pthread_mutex_init(&token->mutex, NULL);
+    return token;
 }
 
 /**
- * @brief Get the current debug level.
- * 
- * This is a read-only query - it doesn't change anything, just returns the
- * current global debug level that was set by obsws_set_debug_level().
+ * @brief Cancel a token and every request sent with it.
  * 
- * Useful for conditional logging in your application, e.g.:
- * ```
- * if (obsws_get_debug_level() >= OBSWS_DEBUG_MEDIUM) {
- *     // do expensive trace operation
- * }
- * ```
+ * Cancelling twice is harmless.
  * 
- * @return The currently active debug level
- * @see obsws_set_debug_level
+ * @param token Token from obsws_cancel_token_create() (NULL is a no-op)
  */
-obsws_debug_level_t obsws_get_debug_level(void) {
-    return g_debug_level;
+void obsws_cancel_token_cancel(obsws_cancel_token_t *token) {
+    if (!token) return;
+    
+    /* Requests leave the list (token_forget) under this same mutex, so none
+       of them can be freed while we go through it */
+    pthread_mutex_lock(&token->mutex);
+    token->cancelled = true;
+    for (pending_request_t *req = token->requests; req; req = req->token_next) {
+        cancel_request(req);
+    }
+    pthread_mutex_unlock(&token->mutex);
 }
 
 /**
- * @brief Initialize a connection configuration structure with safe defaults.
- * 
- * Before calling obsws_connect(), you create an obsws_config_t structure
- * with the connection parameters. This function initializes that structure
- * with sensible defaults so you only need to change what's different for
- * your use case.
- * 
- * Default values set:
- * - port: 4455 (OBS WebSocket v5 default port)
- * - use_ssl: false (OBS uses ws://, not wss://)
- * - connect_timeout_ms: 5000 (5 seconds to connect)
- * - recv_timeout_ms: 5000 (5 seconds to receive each message)
- * - send_timeout_ms: 5000 (5 seconds to send each message)
- * - ping_interval_ms: 10000 (send ping every 10 seconds)
- * - ping_timeout_ms: 5000 (expect pong within 5 seconds)
- * - auto_reconnect: true (reconnect automatically if connection drops)
- * - reconnect_delay_ms: 1000 (start with 1 second delay)
- * - max_reconnect_delay_ms: 30000 (max wait is 30 seconds)
- * - max_reconnect_attempts: 0 (infinite attempts)
- * 
- * After calling this, you typically set:
- * - config.host = "localhost" (where OBS is running)
- * - config.password = "your_password" (if OBS has auth enabled)
- * - config.event_callback = your_callback_func (to receive events)
- * 
- * @param config Pointer to structure to initialize (must not be NULL)
+ * @brief Check whether a token has been cancelled.
  * 
- * @see obsws_connect
+ * @param token Token from obsws_cancel_token_create()
+ * @return true once obsws_cancel_token_cancel() has been called (false for NULL)
  */
-void obsws_config_init(obsws_config_t *config) {
-    memset(config, 0, sizeof(obsws_config_t));
-    
-    config->port = 4455;
-    config->use_ssl = false;
-    config->connect_timeout_ms = 5000;
-    config->recv_timeout_ms = 5000;
-    config->send_timeout_ms = 5000;
-    config->ping_interval_ms = 10000;
-    config->ping_timeout_ms = 5000;
-    config->auto_reconnect = true;
-    config->reconnect_delay_ms = 1000;
-    config->max_reconnect_delay_ms = 30000;
-    config->max_reconnect_attempts = 0; /* Infinite */
+bool obsws_cancel_token_is_cancelled(obsws_cancel_token_t *token) {
+    if (!token) return false;
+    pthread_mutex_lock(&token->mutex);
+    bool cancelled = token->cancelled;
+    pthread_mutex_unlock(&token->mutex);
+    return cancelled;
 }
 
 /**
- * @brief Establish a connection to OBS.
- * 
- * This is the main entry point for using the library. You provide a configuration
- * structure (initialized with obsws_config_init and then customized), and this
- * function connects to OBS, authenticates if needed, and spawns a background
- * thread to handle incoming messages and events.
+ * @brief Free a cancel token.
  * 
- * The function returns immediately - it doesn't wait for the connection to
- * complete. Instead, it:
- * 1. Creates a connection structure with the provided config
- * 2. Allocates buffers for sending and receiving messages
- * 3. Creates a libwebsockets context and connects to OBS
- * 4. Spawns a background event_thread to process WebSocket messages
- * 5. Returns the connection handle
- * 
- * Connection states: The connection progresses through states:
- * - DISCONNECTED -> CONNECTING (TCP handshake, WebSocket upgrade)
- * - CONNECTING -> AUTHENTICATING (receive HELLO, send IDENTIFY)
- * - AUTHENTICATING -> CONNECTED (receive IDENTIFIED)
- * 
- * You don't have to wait for CONNECTED state before calling obsws_send_request,
- * but requests sent while not connected will return OBSWS_ERROR_NOT_CONNECTED.
- * 
- * Memory ownership: The connection structure is allocated and owned by this
- * function. You must free it by calling obsws_disconnect(). Don't free it directly
- * with free() - that will cause memory leaks (threads won't be cleaned up properly).
- * 
- * Error cases:
- * - NULL config or config->host: Returns NULL
- * - libwebsockets context creation fails: Returns NULL and logs error
- * - Network connection fails: Returns valid pointer but connection stays in ERROR state
- * - Bad password: Returns valid pointer but stays in AUTHENTICATING (never reaches CONNECTED)
+ * Every obsws_send_request_cancellable() call using it must have returned.
  * 
- * Note: This function calls obsws_init() automatically if the library isn't
- * already initialized.
- * 
- * @param config Pointer to initialized obsws_config_t with connection parameters
- * @return Pointer to new connection handle, or NULL if creation failed
- * 
- * @see obsws_disconnect, obsws_get_state, obsws_send_request
+ * @param token Token to free (NULL is a no-op)
  */
-obsws_connection_t* obsws_connect(const obsws_config_t *config) {
-    if (!g_library_initialized) {
-        obsws_init();
-    }
-    
-    if (!config || !config->host) {
-        return NULL;
-    }
-    
-    obsws_connection_t *conn = calloc(1, sizeof(obsws_connection_t));
-    if (!conn) return NULL;
-    
-    /* Copy configuration */
-    memcpy(&conn->config, config, sizeof(obsws_config_t));
-    if (config->host) conn->config.host = strdup(config->host);
-    if (config->password) conn->config.password = strdup(config->password);
-    
-    /* Initialize mutexes */
-    pthread_mutex_init(&conn->state_mutex, NULL);
-    pthread_mutex_init(&conn->send_mutex, NULL);
-    pthread_mutex_init(&conn->requests_mutex, NULL);
-    pthread_mutex_init(&conn->stats_mutex, NULL);
-    pthread_mutex_init(&conn->scene_mutex, NULL);
-    
-    /* Allocate buffers */
-    conn->recv_buffer_size = OBSWS_DEFAULT_BUFFER_SIZE;
-    conn->recv_buffer = malloc(conn->recv_buffer_size);
-    conn->send_buffer_size = OBSWS_DEFAULT_BUFFER_SIZE;
-    conn->send_buffer = malloc(conn->send_buffer_size);
-    
-    conn->state = OBSWS_STATE_DISCONNECTED;
-    conn->current_reconnect_delay = config->reconnect_delay_ms;
-    
-    /* Create libwebsockets context */
-    struct lws_context_creation_info info;
-    memset(&info, 0, sizeof(info));
+void obsws_cancel_token_free(obsws_cancel_token_t *token) {
+    if (!token) return;
+    pthread_mutex_destroy(&token->mutex);
+    free(token);
+}
+
+/**
+ * @brief Put a request type in a priority lane.
+ * 
+ * Outbound requests wait in one of three lanes. Realtime goes out ahead of
+ * everything and isn't held by the in-flight window; normal goes next; bulk
+ * gets config.bulk_share percent of the writes while normal requests are
+ * waiting, and everything otherwise. Every request type is normal until it's
+ * given a rule here. Batches are always normal.
+ * 
+ * Lanes reorder requests: a realtime request queued after a normal one can
+ * reach OBS first, and a bulk one can be overtaken by normal requests sent
+ * after it. Only move a type out of normal if it doesn't depend on requests
+ * sent before it (a SetCurrentProgramScene right after the CreateScene that
+ * makes its scene, say, can fail).
+ * 
+ * Takes effect for requests sent afterwards; setting a type back to normal
+ * removes the effect.
+ * 
+ * @param conn Connection
+ * @param request_type OBS request type, e.g. "GetSourceScreenshot"
+ * @param priority Lane to use for it
+ * @return OBSWS_OK, OBSWS_ERROR_INVALID_PARAM or OBSWS_ERROR_OUT_OF_MEMORY
+ */
+obsws_error_t obsws_set_request_priority(obsws_connection_t *conn, const char *request_type,
+                                         obsws_priority_t priority) {
+    if (!conn || !request_type || !*request_type ||
+        priority < OBSWS_PRIORITY_NORMAL || priority >= OBSWS_PRIORITY_COUNT) {
+        return OBSWS_ERROR_INVALID_PARAM;
+    }
     
-    info.port = CONTEXT_PORT_NO_LISTEN;
-    info.protocols = protocols;
-    info.gid = -1;
-    info.uid = -1;
-    info.options = LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT;
+    obsws_error_t result = OBSWS_OK;
+    pthread_mutex_lock(&conn->priority_mutex);
+    size_t count = atomic_load_explicit(&conn->priority_rule_count, memory_order_relaxed);
+    size_t i;
+    for (i = 0; i < count; i++) {
+        if (strcmp(conn->priority_rules[i].request_type, request_type) == 0) {
+            conn->priority_rules[i].priority = priority;
+            break;
+        }
+    }
     
-    conn->lws_context = lws_create_context(&info);
-    if (!conn->lws_context) {
-        obsws_log(conn, OBSWS_LOG_ERROR, "Failed to create libwebsockets context");
-        free(conn->recv_buffer);
-        free(conn->send_buffer);
-        free(conn);
+    if (i == count) {
+        char *type = strdup(request_type);
+        priority_rule_t *rules = type ? realloc(conn->priority_rules, (count + 1) * sizeof(*rules)) : NULL;
+        if (rules) {
+            conn->priority_rules = rules;
+            rules[count].request_type = type;
+            rules[count].priority = priority;
+            atomic_store_explicit(&conn->priority_rule_count, count + 1, memory_order_release);
+        } else {
+            free(type);
+            result = OBSWS_ERROR_OUT_OF_MEMORY;
+        }
+    }
+    pthread_mutex_unlock(&conn->priority_mutex);
+    return result;
+}
+
+/**
+ * @brief Compile a request template.
+ * 
+ * The envelope up to the requestId is built once, with the request type
+ * escaped, and the skeleton is cut at its slots; see the Request Templates
+ * section. The skeleton is checked by filling each slot with a stand-in value
+ * and scanning the result, so what goes out later is always well-formed -
+ * string values are escaped and doubles that JSON can't hold go as null.
+ * 
+ * @param request_type OBS request type, e.g. "SetSourceFilterEnabled"
+ * @param skeleton requestData JSON with %s / %d / %f / %b slots, or NULL for none
+ * @return New template, or NULL if request_type is empty, the skeleton has a
+ *         bad slot or isn't valid JSON, or allocation fails
+ */
+obsws_request_template_t* obsws_request_template_create(const char *request_type, const char *skeleton) {
+    if (!request_type || !*request_type) {
         return NULL;
     }
     
-    /* Connect to OBS */
-    struct lws_client_connect_info ccinfo;
-    memset(&ccinfo, 0, sizeof(ccinfo));
-    
-    ccinfo.context = conn->lws_context;
-    ccinfo.address = conn->config.host;
-    ccinfo.port = conn->config.port;
-    ccinfo.path = "/";
-    ccinfo.host = ccinfo.address;
-    ccinfo.origin = ccinfo.address;
-    ccinfo.protocol = protocols[0].name;
-    ccinfo.userdata = conn;
-    
-    if (config->use_ssl) {
-        ccinfo.ssl_connection = LCCSCF_USE_SSL;
+    size_t skeleton_len = skeleton ? strlen(skeleton) : 0;
+    size_t max_slots = 0;
+    for (size_t i = 0; i < skeleton_len; i++) {
+        if (skeleton[i] == '%') max_slots++;
     }
     
-    conn->wsi = lws_client_connect_via_info(&ccinfo);
-    if (!conn->wsi) {
-        obsws_log(conn, OBSWS_LOG_ERROR, "Failed to initiate connection");
-        lws_context_destroy(conn->lws_context);
-        free(conn->recv_buffer);
-        free(conn->send_buffer);
-        free(conn);
+    size_t type_len = strlen(request_type);
+    size_t head_len = (sizeof(request_part_op) - 1) + json_escaped_len(request_type, type_len) +
+                      (sizeof(request_part_id) - 1);
+    obsws_request_template_t *tmpl = calloc(1, sizeof(*tmpl) + max_slots * sizeof(template_slot_t));
+    char *check = skeleton ? malloc(skeleton_len * 2 + 1) : NULL;     /* Stand-ins are at most 2x a slot */
+    if (!tmpl || (skeleton && !check)) {
+        free(tmpl);
+        free(check);
+        return NULL;
+    }
+    tmpl->request_type = strdup(request_type);
+    tmpl->head = malloc(head_len + 1);
+    tmpl->tail = malloc((sizeof(request_part_data) - 1) + skeleton_len + sizeof(request_part_end_nodata));
+    if (!tmpl->request_type || !tmpl->head || !tmpl->tail) {
+        free(check);
+        obsws_request_template_free(tmpl);
         return NULL;
     }
     
-    /* Start event thread - protect flags with mutex */
-    pthread_mutex_lock(&conn->state_mutex);
-    conn->thread_running = true;
-    conn->should_exit = false;
-    pthread_mutex_unlock(&conn->state_mutex);
-    
-    pthread_create(&conn->event_thread, NULL, event_thread_func, conn);
-    
-    obsws_log(conn, OBSWS_LOG_INFO, "Connecting to OBS at %s:%d", config->host, config->port);
-    
-    return conn;
+    char *p = tmpl->head;
+    memcpy(p, request_part_op, sizeof(request_part_op) - 1);
+    p += sizeof(request_part_op) - 1;
+    p = json_write_escaped(p, request_type, type_len);
+    memcpy(p, request_part_id, sizeof(request_part_id) - 1);
+    tmpl->head_len = head_len;
+    
+    if (skeleton) {
+        memcpy(tmpl->tail, request_part_data, sizeof(request_part_data) - 1);
+        tmpl->tail_len = sizeof(request_part_data) - 1;
+        tmpl->data_start = tmpl->tail_len;
+        
+        long slots = template_scan(skeleton, tmpl->tail, &tmpl->tail_len, check, tmpl->slots);
+        const char *value;
+        size_t value_len;
+        if (slots < 0 || !json_value_span(check, strlen(check), &value, &value_len)) {
+            obsws_log(NULL, OBSWS_LOG_WARNING, "Bad request template for %s: %s", request_type, skeleton);
+            free(check);
+            obsws_request_template_free(tmpl);
+            return NULL;
+        }
+        free(check);
+        tmpl->slot_count = (size_t)slots;
+        tmpl->data_end = tmpl->tail_len;
+        memcpy(tmpl->tail + tmpl->tail_len, request_part_end_data, sizeof(request_part_end_data) - 1);
+        tmpl->tail_len += sizeof(request_part_end_data) - 1;
+    } else {
+        memcpy(tmpl->tail, request_part_end_nodata, sizeof(request_part_end_nodata) - 1);
+        tmpl->tail_len = sizeof(request_part_end_nodata) - 1;
+    }
+    return tmpl;
 }
 
 /**
- * @brief Disconnect from OBS and clean up connection resources.
- * 
- * This is the counterpart to obsws_connect(). It cleanly shuts down the connection,
- * stops the background event thread, and frees all allocated resources.
+ * @brief Number of slots in a template.
  * 
- * The function performs these steps:
- * 1. Signal the event_thread to stop by setting should_exit flag
- * 2. Wait for the event_thread to actually exit using pthread_join()
- * 3. Send a normal WebSocket close frame to OBS (if connected)
- * 4. Destroy the libwebsockets context
- * 5. Free all pending requests (they won't get responses now, but don't leak memory)
- * 6. Free buffers, config, authentication data
- * 7. Destroy all mutexes and condition variables
- * 8. Free the connection structure
+ * @param tmpl Template (NULL gives 0)
+ * @return How many values obsws_send_template() takes for it
+ */
+size_t obsws_request_template_slots(const obsws_request_template_t *tmpl) {
+    return tmpl ? tmpl->slot_count : 0;
+}
+
+/**
+ * @brief Free a request template.
  * 
- * After calling this, the connection pointer is invalid. Don't use it again.
+ * Blocking sends still waiting on it would resend from it after a reconnect,
+ * so every send using it must have returned first.
  * 
- * Safe to call multiple times: If you call it twice, the second call will be
- * a no-op (because conn will be NULL).
+ * @param tmpl Template to free (NULL is a no-op)
+ */
+void obsws_request_template_free(obsws_request_template_t *tmpl) {
+    if (!tmpl) return;
+    free(tmpl->request_type);
+    free(tmpl->head);
+    free(tmpl->tail);
+    free(tmpl);
+}
+
+/**
+ * @brief Send a request from a template and wait for the response.
  * 
- * Safe to call even if connection never fully established: If you disconnect
- * while in CONNECTING or AUTHENTICATING state, everything is still cleaned up.
+ * obsws_send_request() without the requestData string: the frame is written
+ * straight from the template and args. Priority lanes, the in-flight window,
+ * coalescing and replay after a reconnect all apply as usual; a replay is
+ * rebuilt from the same template and args, which stay the caller's.
  * 
- * Important: This function blocks until the event_thread exits. If you have
- * a callback that's blocked, this will deadlock. Make sure your callbacks
- * don't block!
+ * @param conn Connection object (must be in CONNECTED state)
+ * @param tmpl Template from obsws_request_template_create()
+ * @param args One value per slot, in slot order (may be NULL with no slots)
+ * @param response Output pointer for the response (free with obsws_response_free())
+ * @param timeout_ms Timeout in milliseconds (0 = use config->recv_timeout_ms)
  * 
- * @param conn The connection to close (can be NULL - safe to call)
+ * @return Everything obsws_send_request() returns
  * 
- * @see obsws_connect
+ * @see obsws_request_template_create, obsws_send_request
  */
-void obsws_disconnect(obsws_connection_t *conn) {
-    if (!conn) return;
-    
-    obsws_log(conn, OBSWS_LOG_INFO, "Disconnecting from OBS");
-    
-    /* Stop event thread - protect flag with mutex */
-    pthread_mutex_lock(&conn->state_mutex);
-    conn->should_exit = true;
-    bool thread_was_running = conn->thread_running;
-    pthread_mutex_unlock(&conn->state_mutex);
-    
-    if (thread_was_running) {
-        pthread_join(conn->event_thread, NULL);
+obsws_error_t obsws_send_template(obsws_connection_t *conn, const obsws_request_template_t *tmpl,
+                                  const obsws_template_arg_t *args, obsws_response_t **response,
+                                  uint32_t timeout_ms) {
+    if (!conn || !tmpl || !response || (tmpl->slot_count && !args)) {
+        return OBSWS_ERROR_INVALID_PARAM;
     }
     
-    /* Close WebSocket - only if connected */
-    if (conn->wsi && conn->state == OBSWS_STATE_CONNECTED) {
-        lws_close_reason(conn->wsi, LWS_CLOSE_STATUS_NORMAL, NULL, 0);
+    if (conn->state != OBSWS_STATE_CONNECTED) {
+        return OBSWS_ERROR_NOT_CONNECTED;
     }
     
-    /* Cleanup libwebsockets */
-    if (conn->lws_context) {
-        lws_context_destroy(conn->lws_context);
+    pending_request_t *req;
+    obsws_frame_t *frame;
+    obsws_error_t err = prepare_template_request(conn, tmpl, args, true, &req, &frame);
+    if (err != OBSWS_OK) {
+        return err;
     }
-    
-    /* Free pending requests */
-    pthread_mutex_lock(&conn->requests_mutex);
-    pending_request_t *req = conn->pending_requests;
-    while (req) {
-        pending_request_t *next = req->next;
-        if (req->response) {
-            obsws_response_free(req->response);
-        }
-        pthread_mutex_destroy(&req->mutex);
-        pthread_cond_destroy(&req->cond);
-        free(req);
-        req = next;
+    return send_prepared(conn, req, frame, response, timeout_ms, NULL);
+}
+
+/* A blocking send for the helpers below that read the response only through
+   obsws_response_get_*() and never hand it out: its responseData is kept as
+   the tree and not printed to response_data. Sends tmpl with args if given,
+   request_type otherwise. */
+static obsws_error_t send_for_tree(obsws_connection_t *conn, const char *request_type,
+                                   const obsws_request_template_t *tmpl, const obsws_template_arg_t *args,
+                                   obsws_response_t **response) {
+    if (conn->state != OBSWS_STATE_CONNECTED) {
+        return OBSWS_ERROR_NOT_CONNECTED;
     }
-    pthread_mutex_unlock(&conn->requests_mutex);
-    
-    /* Free resources */
-    free(conn->recv_buffer);
-    free(conn->send_buffer);
-    free((char *)conn->config.host);
-    free((char *)conn->config.password);
-    free(conn->challenge);
-    free(conn->salt);
-    free(conn->current_scene);
-    
-    /* Destroy mutexes */
-    pthread_mutex_destroy(&conn->state_mutex);
-    pthread_mutex_destroy(&conn->send_mutex);
-    pthread_mutex_destroy(&conn->requests_mutex);
-    pthread_mutex_destroy(&conn->stats_mutex);
-    pthread_mutex_destroy(&conn->scene_mutex);
     
-    free(conn);
+    pending_request_t *req;
+    obsws_frame_t *frame;
+    obsws_error_t err = tmpl ? prepare_template_request(conn, tmpl, args, true, &req, &frame)
+                             : prepare_request(conn, request_type, NULL, &req, &frame);
+    if (err != OBSWS_OK) {
+        return err;
+    }
+    req->data_tree_only = true;
+    return send_prepared(conn, req, frame, response, 0, NULL);
 }
 
 /**
- * @brief Check if a connection is actively connected to OBS.
- * 
- * Convenience function that returns true if the connection is in CONNECTED state
- * and false otherwise. Useful for checking before sending requests.
+ * @brief Send a request from a template without waiting for the response.
  * 
- * Thread-safe: This function locks the state_mutex before checking, so it's
- * safe to call from any thread.
+ * obsws_send_request_async() for templates. The args are only read during
+ * the call. An idempotent request that may need replaying after a reconnect
+ * keeps its requestData as text, since the args can't be kept - that costs
+ * one render and copy. Fire-and-forget cuts that would rather skip it can
+ * turn off config->replay_idempotent_requests.
  * 
- * Return value: The connection must be in OBSWS_STATE_CONNECTED to return true.
- * If it's CONNECTING, AUTHENTICATING, ERROR, or DISCONNECTED, this returns false.
+ * @param conn Connection object (must be in CONNECTED state)
+ * @param tmpl Template from obsws_request_template_create()
+ * @param args One value per slot, in slot order (may be NULL with no slots)
+ * @param timeout_ms Timeout in milliseconds (0 = use config->recv_timeout_ms)
+ * @param callback Optional completion callback (NULL for none)
+ * @param user_data Passed to callback
+ * @param future Optional output for a future to wait on
  * 
- * @param conn The connection to check (NULL is safe - returns false)
- * @return true if connected, false otherwise
+ * @return Everything obsws_send_request_async() returns
  * 
- * @see obsws_get_state
+ * @see obsws_request_template_create, obsws_send_request_async
  */
-bool obsws_is_connected(const obsws_connection_t *conn) {
-    if (!conn) return false;
+obsws_error_t obsws_send_template_async(obsws_connection_t *conn, const obsws_request_template_t *tmpl,
+                                        const obsws_template_arg_t *args, uint32_t timeout_ms,
+                                        obsws_completion_callback_t callback, void *user_data,
+                                        obsws_future_t **future) {
+    if (future) {
+        *future = NULL;
+    }
+    if (!conn || !tmpl || (tmpl->slot_count && !args)) {
+        return OBSWS_ERROR_INVALID_PARAM;
+    }
     
-    /* Thread-safe state check */
-    pthread_mutex_lock((pthread_mutex_t *)&conn->state_mutex);
-    bool connected = (conn->state == OBSWS_STATE_CONNECTED);
-    pthread_mutex_unlock((pthread_mutex_t *)&conn->state_mutex);
+    if (conn->state != OBSWS_STATE_CONNECTED) {
+        return OBSWS_ERROR_NOT_CONNECTED;
+    }
     
-    return connected;
+    pending_request_t *req;
+    obsws_frame_t *frame;
+    obsws_error_t err = prepare_template_request(conn, tmpl, args, false, &req, &frame);
+    if (err != OBSWS_OK) {
+        return err;
+    }
+    return send_prepared_async(conn, req, frame, timeout_ms, callback, user_data, future);
 }
 
 /**
- * @brief Get the current connection state.
- * 
- * Returns one of the connection states:
- * - OBSWS_STATE_DISCONNECTED: Not connected, idle
- * - OBSWS_STATE_CONNECTING: TCP connection established, waiting for WebSocket handshake
- * - OBSWS_STATE_AUTHENTICATING: WebSocket established, waiting for auth response
- * - OBSWS_STATE_CONNECTED: Connected and ready for requests
- * - OBSWS_STATE_ERROR: Connection encountered an error
- * 
- * State transitions normally follow this flow:
- * DISCONNECTED -> CONNECTING -> AUTHENTICATING -> CONNECTED
- * 
- * But with errors, you can also have:
- * (any state) -> ERROR
- * 
- * You don't usually need to call this - just try to send requests and check
- * the error code. But it's useful for monitoring and debugging.
- * 
- * Thread-safe: This function locks the state_mutex, so it's safe to call
- * from any thread.
- * 
- * @param conn The connection to check (NULL is safe - returns DISCONNECTED)
- * @return The current connection state
- * 
- * @see obsws_is_connected
+ * @brief Create an empty request batch.
+ * 
+ * Build it up with obsws_batch_add(), then send it with obsws_send_batch().
+ * A batch isn't tied to a connection and isn't consumed by sending, so a
+ * fixed sequence (a scene setup, say) can be built once and sent many times.
+ * 
+ * Execution types (the protocol's RequestBatchExecutionType):
+ * - OBSWS_BATCH_SERIAL_REALTIME: one after another, as fast as possible
+ * - OBSWS_BATCH_SERIAL_FRAME: one after another, one per rendered frame -
+ *   for changes that should land on consecutive frames
+ * - OBSWS_BATCH_PARALLEL: all at once on OBS's thread pool; results may
+ *   complete in any order and halt_on_failure doesn't apply
+ * 
+ * @param execution_type How OBS should run the requests
+ * @param halt_on_failure Stop at the first request that fails (serial types only)
+ * @return New batch, or NULL if allocation fails or execution_type is invalid
  */
-obsws_state_t obsws_get_state(const obsws_connection_t *conn) {
-    if (!conn) return OBSWS_STATE_DISCONNECTED;
+obsws_batch_t* obsws_batch_create(obsws_batch_execution_t execution_type, bool halt_on_failure) {
+    if (execution_type < OBSWS_BATCH_SERIAL_REALTIME || execution_type > OBSWS_BATCH_PARALLEL) {
+        return NULL;
+    }
     
-    pthread_mutex_lock((pthread_mutex_t *)&conn->state_mutex);
-    obsws_state_t state = conn->state;
-    pthread_mutex_unlock((pthread_mutex_t *)&conn->state_mutex);
+    obsws_batch_t *batch = calloc(1, sizeof(obsws_batch_t));
+    if (!batch) return NULL;
     
-    return state;
+    batch->execution_type = execution_type;
+    batch->halt_on_failure = halt_on_failure;
+    batch->idempotent = true;
+    return batch;
 }
 
 /**
- * @brief Retrieve performance and connectivity statistics.
- * 
- * The library maintains statistics about the connection:
- * - messages_sent / messages_received: Count of WebSocket messages
- * - bytes_sent / bytes_received: Total bytes transmitted/received
- * - connected_since: Timestamp of when we reached CONNECTED state
- * - reconnect_count: How many times we've reconnected (0 if never disconnected)
- * 
- * These can be useful for:
- * - Monitoring connection health
- * - Detecting stalled connections (if bytes_received stops increasing)
- * - Debugging and performance profiling
- * - Health dashboards or logging
+ * @brief Append a request to a batch.
  * 
- * Thread-safe: This function acquires stats_mutex and copies the entire
- * stats structure, so it's safe to call from any thread. The copy operation
- * is atomic from the caller's perspective.
- * 
- * Example usage:
- * ```
- * obsws_stats_t stats;
- * obsws_get_stats(conn, &stats);
- * printf("Received %zu messages, %zu bytes\\n", 
- *        stats.messages_received, stats.bytes_received);
- * ```
+ * The request type and data are copied, so the caller's strings may go away
+ * straight after. requestData is checked here rather than at send time: a
+ * malformed payload is rejected now, with the batch left as it was.
  * 
- * @param conn The connection to query (NULL returns error)
- * @param stats Pointer to stats structure to fill (must not be NULL)
- * @return OBSWS_OK on success, OBSWS_ERROR_INVALID_PARAM if conn or stats is NULL
+ * For serial batches, OBS's "Sleep" request (requestData
+ * {"sleepMillis": n} or {"sleepFrames": n}) can be appended like any other
+ * to space the others out.
  * 
- * @see obsws_stats_t
+ * @param batch Batch from obsws_batch_create()
+ * @param request_type OBS request type like "SetSceneItemEnabled"
+ * @param request_data Optional JSON string with request parameters (NULL for none)
+ * @return OBSWS_OK on success
+ * @return OBSWS_ERROR_INVALID_PARAM if batch or request_type is NULL, or
+ *         request_data isn't a single well-formed JSON value
+ * @return OBSWS_ERROR_OUT_OF_MEMORY if the copy could not be allocated
  */
-obsws_error_t obsws_get_stats(const obsws_connection_t *conn, obsws_stats_t *stats) {
-    if (!conn || !stats) return OBSWS_ERROR_INVALID_PARAM;
+obsws_error_t obsws_batch_add(obsws_batch_t *batch, const char *request_type, const char *request_data) {
+    if (!batch || !request_type) {
+        return OBSWS_ERROR_INVALID_PARAM;
+    }
     
-    pthread_mutex_lock((pthread_mutex_t *)&conn->stats_mutex);
-    memcpy(stats, &conn->stats, sizeof(obsws_stats_t));
-    pthread_mutex_unlock((pthread_mutex_t *)&conn->stats_mutex);
+    const char *data = NULL;
+    size_t data_len = 0;
+    if (request_data && !json_value_span(request_data, strlen(request_data), &data, &data_len)) {
+        return OBSWS_ERROR_INVALID_PARAM;
+    }
+    
+    if (batch->count == batch->capacity) {
+        size_t capacity = batch->capacity ? batch->capacity * 2 : 16;
+        batch_item_t *items = realloc(batch->items, capacity * sizeof(batch_item_t));
+        if (!items) return OBSWS_ERROR_OUT_OF_MEMORY;
+        batch->items = items;
+        batch->capacity = capacity;
+    }
+    
+    batch_item_t *item = &batch->items[batch->count];
+    item->request_type = strdup(request_type);
+    item->request_data = data ? strndup(data, data_len) : NULL;
+    if (!item->request_type || (data && !item->request_data)) {
+        free(item->request_type);
+        free(item->request_data);
+        return OBSWS_ERROR_OUT_OF_MEMORY;
+    }
     
+    batch->idempotent = batch->idempotent && request_is_idempotent(request_type);
+    batch->count++;
     return OBSWS_OK;
 }
 
 /**
- * @brief Send a synchronous request to OBS and wait for the response.
+ * @brief Number of requests in a batch.
  * 
- * This is the core function for all OBS operations. It implements the asynchronous
- * request-response pattern of the OBS WebSocket v5 protocol:
+ * @param batch Batch from obsws_batch_create()
+ * @return Request count (0 for NULL)
+ */
+size_t obsws_batch_count(const obsws_batch_t *batch) {
+    return batch ? batch->count : 0;
+}
+
+/**
+ * @brief Free a batch and the requests copied into it.
  * 
- * **Protocol Flow:**
- * 1. Generate a unique UUID for this request (used to match responses)
- * 2. Create a pending_request_t to track the in-flight operation
- * 3. Build the request JSON with opcode 6 (REQUEST)
- * 4. Send the message via lws_write()
- * 5. Block the caller with pthread_cond_timedwait() until response arrives
- * 6. Return the response to caller (who owns it and must free with obsws_response_free)
+ * @param batch Batch to free (NULL is a no-op)
+ */
+void obsws_batch_free(obsws_batch_t *batch) {
+    if (!batch) return;
+    
+    for (size_t i = 0; i < batch->count; i++) {
+        free(batch->items[i].request_type);
+        free(batch->items[i].request_data);
+    }
+    free(batch->items);
+    free(batch);
+}
+
+/**
+ * @brief Render a batch as the JSON RequestBatch message it would go out as.
  * 
- * **Why synchronous from caller's perspective?**
- * Although WebSocket messages are async at the protocol level, we provide a
- * synchronous API - the caller sends a request and blocks until the response
- * arrives. This is simpler for application code than callback-based async APIs.
+ * Runs the same encoder obsws_send_batch() uses on a JSON connection, so what
+ * comes back is byte for byte the frame OBS would see - useful for logging a
+ * batch, and for checking the encoding without a server.
+ * 
+ * @param batch Batch from obsws_batch_create()
+ * @param request_id requestId to put in the envelope (NULL for "batch")
+ * @return NUL-terminated JSON text (free with free()), or NULL on NULL batch /
+ *         out of memory
+ */
+char* obsws_batch_to_json(const obsws_batch_t *batch, const char *request_id) {
+    if (!batch) return NULL;
+    if (!request_id) request_id = "batch";
+    
+    obsws_writer_t w = { NULL, 0 };
+    json_encode_batch(&w, batch, request_id);
+    
+    char *json = malloc(w.len + 1);
+    if (!json) return NULL;
+    
+    w.p = (unsigned char *)json;
+    w.len = 0;
+    json_encode_batch(&w, batch, request_id);
+    *w.p = '\0';
+    return json;
+}
+
+/**
+ * @brief Send a batch in one message and wait for all its results.
  * 
- * Behind the scenes, the background event_thread continuously processes WebSocket
- * messages. When a REQUEST_RESPONSE (opcode 7) arrives matching a pending request
- * ID, it signals the waiting condition variable, waking up the blocked caller.
+ * The whole batch goes out as a single RequestBatch (opcode 8) and comes back
+ * as a single RequestBatchResponse (opcode 9): one round trip, however many
+ * requests. The results are demultiplexed into an array indexed like the
+ * batch, so result->responses[i] is the outcome of the i-th request added.
  * 
- * **Performance implications:**
- * - Thread-safe: The main app thread can be blocked in obsws_send_request() while
- *   the background event_thread processes other messages
- * - No polling: Uses condition variables, not CPU-wasting polling loops
- * - Can make multiple simultaneous requests from different threads (up to
- *   OBSWS_MAX_PENDING_REQUESTS = 256)
+ * With halt_on_failure, OBS stops at the first failing request; the ones
+ * after it never ran and keep status_code 0 (result->executed says how many
+ * did). Like single requests, a batch in which every request is idempotent
+ * (Get* / Set*) is resent if the connection drops and comes back before the
+ * results arrive; others fail with OBSWS_ERROR_NOT_CONNECTED.
  * 
  * **Example usage:**
  * ```
- * obsws_response_t *response = NULL;
- * obsws_error_t err = obsws_send_request(conn, "SetCurrentProgramScene",
- *                                        "{\"sceneName\": \"Scene1\"}", 
- *                                        &response, 0);
- * if (err == OBSWS_OK && response && response->success) {
- *     printf("Scene switched successfully\\n");
+ * obsws_batch_t *batch = obsws_batch_create(OBSWS_BATCH_SERIAL_REALTIME, true);
+ * obsws_batch_add(batch, "SetCurrentProgramScene", "{\"sceneName\":\"Live\"}");
+ * obsws_batch_add(batch, "SetInputMute", "{\"inputName\":\"Mic\",\"inputMuted\":false}");
+ * 
+ * obsws_batch_result_t *result = NULL;
+ * if (obsws_send_batch(conn, batch, &result, 0) == OBSWS_OK) {
+ *     for (size_t i = 0; i < result->count; i++) {
+ *         printf("%zu: %s\n", i, result->responses[i].success ? "ok" : "failed");
+ *     }
  * }
- * obsws_response_free(response);
+ * obsws_batch_result_free(result);
+ * obsws_batch_free(batch);
  * ```
  * 
  * @param conn Connection object (must be in CONNECTED state)
- * @param request_type OBS request type like "GetCurrentProgramScene", "SetCurrentProgramScene", etc.
- * @param request_data Optional JSON string with request parameters. NULL for no parameters.
- *                     Example: "{\"sceneName\": \"Scene1\"}"
- * @param response Output pointer for the response. Will be allocated by this function.
- *                 Caller must free with obsws_response_free(). Can be NULL if caller doesn't
- *                 need the response (but response is still consumed from server).
- * @param timeout_ms Timeout in milliseconds (0 = use config->recv_timeout_ms, typically 30000ms)
- * 
- * @return OBSWS_OK if response received (check response->success for operation success)
- * @return OBSWS_ERROR_INVALID_PARAM if conn, request_type, or response pointer is NULL
- * @return OBSWS_ERROR_NOT_CONNECTED if connection is not in CONNECTED state
- * @return OBSWS_ERROR_OUT_OF_MEMORY if pending request allocation fails
- * @return OBSWS_ERROR_SEND_FAILED if message send fails (buffer too small, invalid wsi, etc)
- * @return OBSWS_ERROR_TIMEOUT if no response received within timeout_ms
- * 
- * @see obsws_response_t, obsws_response_free, obsws_error_string
+ * @param batch Batch to send (must hold at least one request; not modified)
+ * @param result Output: per-request results, free with obsws_batch_result_free()
+ * @param timeout_ms Timeout for the whole batch (0 = use config->recv_timeout_ms).
+ *                   Allow for OBSWS_BATCH_SERIAL_FRAME running one request per frame.
+ * 
+ * @return OBSWS_OK once the batch response arrived (check each response's success)
+ * @return OBSWS_ERROR_INVALID_PARAM if an argument is NULL or the batch is empty
+ * @return OBSWS_ERROR_NOT_CONNECTED if not connected, or the connection dropped
+ * @return OBSWS_ERROR_OUT_OF_MEMORY if the frame or result could not be allocated
+ * @return OBSWS_ERROR_WINDOW_FULL if the in-flight window turned it away (a batch takes one slot)
+ * @return OBSWS_ERROR_TIMEOUT if no response within timeout_ms
  */
-obsws_error_t obsws_send_request(obsws_connection_t *conn, const char *request_type,
-                                 const char *request_data, obsws_response_t **response, uint32_t timeout_ms) {
-    if (!conn || !request_type || !response) {
+obsws_error_t obsws_send_batch(obsws_connection_t *conn, const obsws_batch_t *batch,
+                               obsws_batch_result_t **result, uint32_t timeout_ms) {
+    if (!conn || !batch || !result || batch->count == 0) {
         return OBSWS_ERROR_INVALID_PARAM;
     }
+    *result = NULL;
     
     if (conn->state != OBSWS_STATE_CONNECTED) {
         return OBSWS_ERROR_NOT_CONNECTED;
     }
     
-    /* Generate request ID */
-    char request_id[OBSWS_UUID_LENGTH];
-    generate_uuid(request_id);
-    
-    /* Create pending request */
-    pending_request_t *req = create_pending_request(conn, request_id);
+    pending_request_t *req = alloc_pending_request(conn);
     if (!req) {
         return OBSWS_ERROR_OUT_OF_MEMORY;
     }
     
-    /* Build request JSON */
-    cJSON *request = cJSON_CreateObject();
-    cJSON_AddNumberToObject(request, "op", OBSWS_OPCODE_REQUEST);
-    
-    cJSON *d = cJSON_CreateObject();
-    cJSON_AddStringToObject(d, "requestType", request_type);
-    cJSON_AddStringToObject(d, "requestId", request_id);
+    req->batch_result = calloc(1, sizeof(obsws_batch_result_t));
+    if (req->batch_result) {
+        req->batch_result->count = batch->count;
+        req->batch_result->responses = calloc(batch->count, sizeof(obsws_response_t));
+    }
+    obsws_frame_t *frame = build_batch_frame(conn, batch, req->request_id);
+    if (!req->batch_result || !req->batch_result->responses || !frame) {
+        frame_free(conn, frame);
+        free_pending_request(req);
+        return OBSWS_ERROR_OUT_OF_MEMORY;
+    }
     
-    if (request_data) {
-        cJSON *data = cJSON_Parse(request_data);
-        if (data) {
-            cJSON_AddItemToObject(d, "requestData", data);
-        }
+    /* The caller's batch outlives this call, so a replay can rebuild from it */
+    if (conn->config.replay_idempotent_requests && batch->idempotent) {
+        req->replay_batch = batch;
     }
     
-    cJSON_AddItemToObject(request, "d", d);
+    obsws_error_t err = launch_request(conn, req, frame, timeout_ms);
+    if (err != OBSWS_OK) {
+        return err;
+    }
     
-    char *message = cJSON_PrintUnformatted(request);
-    cJSON_Delete(request);
+    err = wait_pending_request(conn, req);
+    if (err != OBSWS_OK) {
+        return err;
+    }
     
-    /* DEBUG_HIGH: Show request being sent */
-    obsws_debug(conn, OBSWS_DEBUG_HIGH, "Sending request (ID: %s): %s", request_id, message);
+    pthread_mutex_lock(&req->mutex);
+    err = req->error;
+    if (err == OBSWS_OK) {
+        *result = req->batch_result;
+        req->batch_result = NULL; /* Transfer ownership */
+    }
+    pthread_mutex_unlock(&req->mutex);
     
-    /* Send request */
-    pthread_mutex_lock(&conn->send_mutex);
-    size_t len = strlen(message);
-    obsws_error_t result = OBSWS_OK;
+    remove_pending_request(conn, req);
+    return err;
+}
+
+/**
+ * @brief Free a batch result and every response in it.
+ * 
+ * @param result Result from obsws_send_batch() (NULL is a no-op)
+ */
+void obsws_batch_result_free(obsws_batch_result_t *result) {
+    if (!result) return;
     
-    if (len < conn->send_buffer_size - LWS_PRE && conn->wsi) {
-        memcpy(conn->send_buffer + LWS_PRE, message, len);
-        int written = lws_write(conn->wsi, (unsigned char *)(conn->send_buffer + LWS_PRE), len, LWS_WRITE_TEXT);
-        
-        if (written < 0) {
-            result = OBSWS_ERROR_SEND_FAILED;
-        } else {
-            pthread_mutex_lock(&conn->stats_mutex);
-            conn->stats.messages_sent++;
-            conn->stats.bytes_sent += len;
-            pthread_mutex_unlock(&conn->stats_mutex);
+    if (result->responses) {
+        for (size_t i = 0; i < result->count; i++) {
+            response_clear(&result->responses[i]);
         }
-    } else {
-        result = OBSWS_ERROR_SEND_FAILED;
+        free(result->responses);
     }
-    pthread_mutex_unlock(&conn->send_mutex);
-    
-    free(message);
-    
-    if (result != OBSWS_OK) {
-        remove_pending_request(conn, req);
-        return result;
+    free(result);
+}
+
+/**
+ * @brief Change the event subscriptions of a live connection.
+ * 
+ * Sends a Reidentify (opcode 3) carrying the new eventSubscriptions mask. The
+ * WebSocket and the session stay up - no new handshake, no re-authentication,
+ * pending requests carry on. OBS confirms with an Identified (opcode 2), which
+ * the event thread logs at OBSWS_DEBUG_LOW.
+ * 
+ * The mask is also remembered for the connection, so any later reconnect
+ * identifies with it straight away.
+ * 
+ * **Example usage:**
+ * ```
+ * // Only scene and output events from now on
+ * obsws_reidentify(conn, OBSWS_EVENT_SCENES | OBSWS_EVENT_OUTPUTS);
+ * ```
+ * 
+ * @param conn Connection object (must be in CONNECTED state)
+ * @param event_subscriptions Bitmask of OBSWS_EVENT_* categories
+ * 
+ * @return OBSWS_OK once the message is queued
+ * @return OBSWS_ERROR_INVALID_PARAM if conn is NULL
+ * @return OBSWS_ERROR_NOT_CONNECTED if connection is not in CONNECTED state
+ * @return OBSWS_ERROR_OUT_OF_MEMORY if the frame could not be allocated
+ */
+obsws_error_t obsws_reidentify(obsws_connection_t *conn, uint32_t event_subscriptions) {
+    if (!conn) {
+        return OBSWS_ERROR_INVALID_PARAM;
     }
     
-    /* Wait for response */
-    if (timeout_ms == 0) {
-        timeout_ms = conn->config.recv_timeout_ms;
+    if (conn->state != OBSWS_STATE_CONNECTED) {
+        return OBSWS_ERROR_NOT_CONNECTED;
     }
     
-    struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
-    ts.tv_sec += timeout_ms / 1000;
-    ts.tv_nsec += (timeout_ms % 1000) * 1000000;
-    if (ts.tv_nsec >= 1000000000) {
-        ts.tv_sec++;
-        ts.tv_nsec -= 1000000000;
-    }
+    atomic_store_explicit(&conn->event_subscriptions, event_subscriptions, memory_order_relaxed);
     
-    pthread_mutex_lock(&req->mutex);
-    while (!req->completed) {
-        int wait_result = pthread_cond_timedwait(&req->cond, &req->mutex, &ts);
-        if (wait_result == ETIMEDOUT) {
-            pthread_mutex_unlock(&req->mutex);
-            remove_pending_request(conn, req);
-            return OBSWS_ERROR_TIMEOUT;
+    obsws_frame_t *frame;
+    if (conn->msgpack_active) {
+        obsws_writer_t w = { NULL, 0 };
+        mp_encode_reidentify(&w, event_subscriptions);
+        frame = frame_alloc(conn, w.len);
+        if (!frame) {
+            return OBSWS_ERROR_OUT_OF_MEMORY;
+        }
+        w.p = frame->buf + LWS_PRE;
+        mp_encode_reidentify(&w, event_subscriptions);
+    } else {
+        char message[64];
+        int n = snprintf(message, sizeof(message), "{\"op\":%d,\"d\":{\"eventSubscriptions\":%u}}",
+                         OBSWS_OPCODE_REIDENTIFY, event_subscriptions);
+        size_t len = printed_len(n, sizeof(message));
+        frame = frame_alloc(conn, len);
+        if (!frame) {
+            return OBSWS_ERROR_OUT_OF_MEMORY;
         }
+        memcpy(frame->buf + LWS_PRE, message, len);
     }
     
-    *response = req->response;
-    req->response = NULL; /* Transfer ownership */
-    pthread_mutex_unlock(&req->mutex);
+    obsws_debug(conn, OBSWS_DEBUG_MEDIUM, "Sending Reidentify (eventSubscriptions 0x%x)", event_subscriptions);
+    enqueue_frame(conn, frame);
+    return OBSWS_OK;
+}
+
+/**
+ * @brief Drop the current socket (if any) and connect again right away.
+ * 
+ * Useful when the application knows better than the library - it saw OBS
+ * restart, or the network changed under it. The work happens on the event
+ * thread: a live socket is closed normally, and its WSI_DESTROY starts the
+ * new attempt with no delay. If the connection is already waiting out a
+ * backoff, the wait is cut short. Either way the backoff starts over.
+ * 
+ * Outstanding idempotent requests ride through the reconnect exactly as with
+ * an unplanned drop; the rest fail with OBSWS_ERROR_NOT_CONNECTED. A failed
+ * attempt is retried per config->auto_reconnect like any other drop.
+ * 
+ * @param conn Connection object
+ * @return OBSWS_OK once the request is handed to the event thread
+ * @return OBSWS_ERROR_INVALID_PARAM if conn is NULL or has no event loop
+ */
+obsws_error_t obsws_reconnect(obsws_connection_t *conn) {
+    if (!conn || !conn->shard) {
+        return OBSWS_ERROR_INVALID_PARAM;
+    }
     
-    remove_pending_request(conn, req);
+    obsws_log(conn, OBSWS_LOG_INFO, "Reconnect requested");
     
+    /* Ride the ready queue like a send would - the shard thread checks the
+       flag when it pops us */
+    atomic_store_explicit(&conn->reconnect_requested, true, memory_order_release);
+    connection_kick(conn);
     return OBSWS_OK;
 }
 
@@ -2323,7 +9099,7 @@ obsws_error_t obsws_send_request(obsws_connection_t *conn, const char *request_t
  * **Thread-safety:**
  * - Scene cache is protected by scene_mutex
  * - Safe to call from any thread
- * - Multiple calls can happen simultaneously (each uses send_mutex)
+ * - Multiple calls can happen simultaneously (sends go through the lock-free send queue)
  * 
  * @param conn Connection object (must be in CONNECTED state)
  * @param scene_name Name of the scene to switch to. Must not be NULL.
@@ -2358,15 +9134,16 @@ obsws_error_t obsws_set_current_scene(obsws_connection_t *conn, const char *scen
         return OBSWS_OK;
     }
     
-    cJSON *request_data = cJSON_CreateObject();
-    cJSON_AddStringToObject(request_data, "sceneName", scene_name);
-    
-    char *data_str = cJSON_PrintUnformatted(request_data);
-    cJSON_Delete(request_data);
+    /* Scene switches are the bulk of most apps' traffic, so they go out from a
+       precompiled template - no payload string at all */
+    const obsws_request_template_t *tmpl = builtin_template(BUILTIN_SET_SCENE);
+    if (!tmpl) {
+        return OBSWS_ERROR_OUT_OF_MEMORY;
+    }
+    obsws_template_arg_t args[] = { { .string = scene_name } };
     
     obsws_response_t *resp = NULL;
-    obsws_error_t result = obsws_send_request(conn, "SetCurrentProgramScene", data_str, &resp, 0);
-    free(data_str);
+    obsws_error_t result = obsws_send_template(conn, tmpl, args, &resp, 0);
     
     if (result == OBSWS_OK && resp && resp->success) {
         pthread_mutex_lock(&conn->scene_mutex);
@@ -2404,7 +9181,8 @@ obsws_error_t obsws_set_current_scene(obsws_connection_t *conn, const char *scen
  * 
  * **Thread-safety**
  * The scene_mutex protects the cache update, so this is safe to call from any thread.
- * Multiple concurrent calls are safe but will all query OBS (no deduplication).
+ * Multiple concurrent calls are safe. They all query OBS, unless config.coalesce_reads
+ * is set - then calls that overlap share a single GetCurrentProgramScene round trip.
  * 
  * **Example usage:**
  * ```
@@ -2432,23 +9210,19 @@ obsws_error_t obsws_get_current_scene(obsws_connection_t *conn, char *scene_name
     }
     
     obsws_response_t *response = NULL;
-    obsws_error_t result = obsws_send_request(conn, "GetCurrentProgramScene", NULL, &response, 0);
-    
-    if (result == OBSWS_OK && response && response->success && response->response_data) {
-        cJSON *data = cJSON_Parse(response->response_data);
-        if (data) {
-            cJSON *name = cJSON_GetObjectItem(data, "currentProgramSceneName");
-            if (name && name->valuestring) {
-                strncpy(scene_name, name->valuestring, buffer_size - 1);
-                scene_name[buffer_size - 1] = '\0';
-                
-                /* Update cache */
-                pthread_mutex_lock(&conn->scene_mutex);
-                free(conn->current_scene);
-                conn->current_scene = strdup(name->valuestring);
-                pthread_mutex_unlock(&conn->scene_mutex);
-            }
-            cJSON_Delete(data);
+    obsws_error_t result = send_for_tree(conn, "GetCurrentProgramScene", NULL, NULL, &response);
+    
+    if (result == OBSWS_OK && response && response->success) {
+        const char *name = obsws_response_get_string(response, "/currentProgramSceneName");
+        if (name) {
+            strncpy(scene_name, name, buffer_size - 1);
+            scene_name[buffer_size - 1] = '\0';
+            
+            /* Update cache */
+            pthread_mutex_lock(&conn->scene_mutex);
+            free(conn->current_scene);
+            conn->current_scene = strdup(name);
+            pthread_mutex_unlock(&conn->scene_mutex);
         }
     }
     
@@ -2575,6 +9349,7 @@ obsws_error_t obsws_stop_streaming(obsws_connection_t *conn, obsws_response_t **
  * This function safely deallocates all memory associated with a response:
  * - The error_message string (if present)
  * - The response_data JSON string (if present)  
+ * - The parsed responseData behind obsws_response_get_*() (if present)
  * - The response structure itself
  * 
  * **Safe to call with NULL**
@@ -2602,11 +9377,121 @@ obsws_error_t obsws_stop_streaming(obsws_connection_t *conn, obsws_response_t **
 void obsws_response_free(obsws_response_t *response) {
     if (!response) return;
     
-    free(response->error_message);
-    free(response->response_data);
+    response_clear(response);
     free(response);
 }
 
+/**
+ * @brief Read a string out of a response's responseData by JSON pointer.
+ * 
+ * The pointer is resolved against a cJSON tree of responseData, built from
+ * response_data on the first lookup and kept with the response, so every
+ * later lookup is a walk down the tree with no parsing and no allocation.
+ * Responses to the library's own helpers, and those that came through the
+ * cJSON path (see fill_response()), already have it.
+ * 
+ * **Pointer syntax (RFC 6901)**
+ * - "" is responseData itself, "/outputActive" a top-level field
+ * - Array elements are addressed by index: "/scenes/2/sceneName"
+ * - "~1" in a key stands for '/', "~0" for '~'
+ * 
+ * **NOT thread-safe**
+ * Same as the response itself: one thread at a time, since the first lookup
+ * may build the tree.
+ * 
+ * @param response Response from obsws_send_request() or a helper
+ * @param pointer JSON pointer into responseData
+ * 
+ * @return The string, owned by the response (valid until obsws_response_free()),
+ *         or NULL if the pointer doesn't resolve or doesn't name a string
+ * 
+ * @see obsws_response_get_bool, obsws_response_get_int, obsws_response_get_array_size
+ */
+const char* obsws_response_get_string(const obsws_response_t *response, const char *pointer) {
+    cJSON *node = response_lookup(response, pointer);
+    return cJSON_IsString(node) ? node->valuestring : NULL;
+}
+
+/**
+ * @brief Read a boolean out of a response's responseData by JSON pointer.
+ * 
+ * @param response Response from obsws_send_request() or a helper
+ * @param pointer JSON pointer into responseData (see obsws_response_get_string())
+ * @param value Receives the value
+ * 
+ * @return true if the pointer names a boolean; false otherwise, with value untouched
+ */
+bool obsws_response_get_bool(const obsws_response_t *response, const char *pointer, bool *value) {
+    cJSON *node = response_lookup(response, pointer);
+    if (!value || !cJSON_IsBool(node)) return false;
+    *value = cJSON_IsTrue(node);
+    return true;
+}
+
+/**
+ * @brief Read an integer out of a response's responseData by JSON pointer.
+ * 
+ * Taken from the number's double value, so it's exact up to 2^53 - more than
+ * any ID or byte count OBS reports - rather than cJSON's int-sized valueint.
+ * 
+ * @param response Response from obsws_send_request() or a helper
+ * @param pointer JSON pointer into responseData (see obsws_response_get_string())
+ * @param value Receives the value, truncated toward zero and clamped to int64_t
+ * 
+ * @return true if the pointer names a number; false otherwise, with value untouched
+ */
+bool obsws_response_get_int(const obsws_response_t *response, const char *pointer, int64_t *value) {
+    cJSON *node = response_lookup(response, pointer);
+    if (!value || !cJSON_IsNumber(node)) return false;
+    double d = node->valuedouble;
+    if (d >= 9223372036854775807.0) {
+        *value = INT64_MAX;
+    } else if (d <= -9223372036854775808.0) {
+        *value = INT64_MIN;
+    } else {
+        *value = (int64_t)d;
+    }
+    return true;
+}
+
+/**
+ * @brief Read a number out of a response's responseData by JSON pointer.
+ * 
+ * @param response Response from obsws_send_request() or a helper
+ * @param pointer JSON pointer into responseData (see obsws_response_get_string())
+ * @param value Receives the value
+ * 
+ * @return true if the pointer names a number; false otherwise, with value untouched
+ */
+bool obsws_response_get_double(const obsws_response_t *response, const char *pointer, double *value) {
+    cJSON *node = response_lookup(response, pointer);
+    if (!value || !cJSON_IsNumber(node)) return false;
+    *value = node->valuedouble;
+    return true;
+}
+
+/**
+ * @brief Count the elements of an array in a response's responseData.
+ * 
+ * For iterating with indexed pointers ("/scenes/0/sceneName",
+ * "/scenes/1/sceneName", ...). Each indexed lookup walks the array from its
+ * start, which is nothing next to a round trip for the arrays OBS returns.
+ * 
+ * @param response Response from obsws_send_request() or a helper
+ * @param pointer JSON pointer into responseData (see obsws_response_get_string())
+ * 
+ * @return Number of elements, or 0 if the pointer doesn't name an array
+ */
+size_t obsws_response_get_array_size(const obsws_response_t *response, const char *pointer) {
+    cJSON *node = response_lookup(response, pointer);
+    if (!cJSON_IsArray(node)) return 0;
+    size_t count = 0;
+    for (cJSON *item = node->child; item; item = item->next) {
+        count++;
+    }
+    return count;
+}
+
 /**
  * @brief Convert an error code to a human-readable string.
  * 
@@ -2647,6 +9532,9 @@ const char* obsws_error_string(obsws_error_t error) {
         case OBSWS_ERROR_ALREADY_CONNECTED: return "Already connected";
         case OBSWS_ERROR_OUT_OF_MEMORY: return "Out of memory";
         case OBSWS_ERROR_SSL_FAILED: return "SSL failed";
+        case OBSWS_ERROR_MESSAGE_TOO_LARGE: return "Message too large";
+        case OBSWS_ERROR_WINDOW_FULL: return "Too many requests in flight";
+        case OBSWS_ERROR_CANCELLED: return "Request cancelled";
         default: return "Unknown error";
     }
 }
@@ -2700,9 +9588,10 @@ const char* obsws_state_string(obsws_state_t state) {
 /**
  * @brief Process pending WebSocket events (compatibility function).
  * 
- * This function is provided for API compatibility with single-threaded applications.
- * However, the libwsv5 library uses a background event_thread by default, so this
- * function is usually not needed - events are processed automatically in the background.
+ * Without config->external_loop this function is provided for API compatibility
+ * with single-threaded applications. The libwsv5 library uses a background
+ * event_thread by default, so it is usually not needed - events are processed
+ * automatically in the background.
  * 
  * **Background Event Processing:**
  * By design, all WebSocket messages (events, responses, etc.) are processed by the
@@ -2716,24 +9605,30 @@ const char* obsws_state_string(obsws_state_t state) {
  * Applications don't need to call this function - the thread handles everything.
  * 
  * **What this function does:**
- * Currently, this is mainly for API compatibility. It:
  * - Validates the connection object
- * - If timeout_ms > 0, sleeps for that duration
+ * - Threaded mode: if timeout_ms > 0, sleeps for that duration
+ * - External loop mode: polls the connection's descriptors for up to
+ *   timeout_ms (never past the next library timer) and runs obsws_service()
+ *   on whatever became ready. This is a complete, if simple, event loop for
+ *   callers that want the single-threaded model without a poller of their own.
  * - Returns 0 (success)
  * 
  * **When to use:**
  * - Most applications: Don't call this - use background thread
- * - If you disable background thread: Call this in your main loop
+ * - config->external_loop without your own poller: call this in your main loop
+ * - config->external_loop with your own poller: use obsws_get_pollfds(),
+ *   obsws_service() and obsws_next_timeout() instead
  * 
- * **Example (not typical - background thread is recommended):**
+ * **Example (external loop):**
  * ```
- * // Not recommended - background thread is better
+ * config.external_loop = true;
+ * obsws_connection_t *conn = obsws_connect(&config);
  * while (app_running) {
- *     obsws_process_events(conn, 100);  // Check every 100ms
+ *     obsws_process_events(conn, 100);  // Wait at most 100ms
  * }
  * ```
  * 
- * Better approach - let background thread handle it:
+ * Better approach for most apps - let background thread handle it:
  * ```
  * obsws_connect(conn, "localhost", 4455, "password");
  * // Background thread processes events automatically
@@ -2744,16 +9639,44 @@ const char* obsws_state_string(obsws_state_t state) {
  * ```
  * 
  * @param conn Connection object (can be NULL - returns error)
- * @param timeout_ms Sleep duration in milliseconds (0 = don't sleep)
+ * @param timeout_ms Maximum time to wait in milliseconds (0 = don't wait)
  * 
  * @return 0 on success
  * @return OBSWS_ERROR_INVALID_PARAM if conn is NULL
  * 
- * @see obsws_connect, obsws_disconnect, event_thread_func
+ * @see obsws_connect, obsws_disconnect, obsws_service, event_thread_func
  */
 int obsws_process_events(obsws_connection_t *conn, uint32_t timeout_ms) {
     if (!conn) return OBSWS_ERROR_INVALID_PARAM;
     
+    if (conn->shard && conn->shard->external) {
+        struct pollfd fds[8];
+        size_t count = obsws_get_pollfds(conn, fds, sizeof(fds) / sizeof(fds[0]));
+        if (count > sizeof(fds) / sizeof(fds[0])) {
+            count = sizeof(fds) / sizeof(fds[0]);
+        }
+        
+        int wait_ms = obsws_next_timeout(conn);
+        if ((uint32_t)wait_ms > timeout_ms) {
+            wait_ms = (int)timeout_ms;
+        }
+        
+        int ready = poll(fds, (nfds_t)count, wait_ms);
+        bool serviced = false;
+        for (size_t i = 0; ready > 0 && i < count; i++) {
+            if (fds[i].revents) {
+                obsws_service(conn, fds[i].fd, fds[i].revents);
+                serviced = true;
+                ready--;
+            }
+        }
+        if (!serviced) {
+            /* Timed out - still give any due timers their turn */
+            obsws_service(conn, -1, 0);
+        }
+        return 0;
+    }
+    
     /* Events are processed in the background thread */
     /* This function is provided for API compatibility */
     if (timeout_ms > 0) {
@@ -2766,14 +9689,164 @@ int obsws_process_events(obsws_connection_t *conn, uint32_t timeout_ms) {
     return 0;
 }
 
+/* ============================================================================
+ * External Event Loop
+ * ============================================================================ */
+
+/**
+ * @brief List the file descriptors an external event loop must watch.
+ * 
+ * Only meaningful with config->external_loop. The set is the WebSocket socket
+ * (once connecting) plus an internal wake pipe that fires whenever another
+ * thread queues a request. It changes as the connection comes and goes; track
+ * it through config->poll_callback or call this again after each
+ * obsws_service().
+ * 
+ * @param conn Connection object
+ * @param fds Array to fill (may be NULL when max_fds is 0)
+ * @param max_fds Capacity of fds
+ * @return Total number of descriptors, which may exceed max_fds - only the
+ *         first max_fds are written
+ */
+size_t obsws_get_pollfds(obsws_connection_t *conn, struct pollfd *fds, size_t max_fds) {
+    if (!conn || !conn->shard || !conn->shard->external) {
+        return 0;
+    }
+    
+    obsws_shard_t *shard = conn->shard;
+    pthread_mutex_lock(&shard->service_mutex);
+    size_t count = shard->pollfd_count;
+    for (size_t i = 0; i < count && i < max_fds; i++) {
+        fds[i] = shard->pollfds[i];
+        fds[i].revents = 0;
+    }
+    pthread_mutex_unlock(&shard->service_mutex);
+    
+    return count;
+}
+
+/**
+ * @brief Service a connection after its external event loop saw activity.
+ * 
+ * Call with a descriptor from obsws_get_pollfds() and the revents your poller
+ * reported for it, or with fd = -1 when the timeout from obsws_next_timeout()
+ * expired with nothing ready. Every call also runs any library timers that
+ * have come due (keep-alive, request deadlines, buffer shrink), so a loop that
+ * always honours obsws_next_timeout() never needs anything else.
+ * 
+ * Callbacks (events, state changes, logging) run on the calling thread from
+ * inside this function. Calls for the same connection from several threads
+ * are serialized.
+ * 
+ * @param conn Connection object created with config->external_loop
+ * @param fd The ready descriptor, or -1 for a timer-only pass
+ * @param revents Events reported for fd (POLLIN, POLLOUT, POLLERR, ...)
+ * @return OBSWS_OK on success
+ * @return OBSWS_ERROR_INVALID_PARAM if conn is NULL or not in external loop mode
+ */
+obsws_error_t obsws_service(obsws_connection_t *conn, int fd, short revents) {
+    if (!conn || !conn->shard || !conn->shard->external) {
+        return OBSWS_ERROR_INVALID_PARAM;
+    }
+    
+    obsws_shard_t *shard = conn->shard;
+    pthread_mutex_lock(&shard->service_mutex);
+    
+    if (fd == shard->wake_fd[0]) {
+        /* Another thread queued frames - drain the pipe, then ask lws for the
+           writable callbacks, just as EVENT_WAIT_CANCELLED does in threaded mode */
+        char drain[64];
+        while (read(fd, drain, sizeof(drain)) > 0) {}
+        shard_dispatch_writes(shard);
+    } else if (fd >= 0 && revents) {
+        struct pollfd pfd = { .fd = fd, .events = 0, .revents = revents };
+        for (size_t i = 0; i < shard->pollfd_count; i++) {
+            if (shard->pollfds[i].fd == fd) {
+                pfd.events = shard->pollfds[i].events;
+                break;
+            }
+        }
+        lws_service_fd(shard->context, &pfd);
+    }
+    
+    /* Non-blocking pass: due timers, plus anything lws still has buffered
+       (TLS records, forced service) that a poller would never see as ready */
+    lws_service(shard->context, -1);
+    
+    pthread_mutex_unlock(&shard->service_mutex);
+    return OBSWS_OK;
+}
+
+/* Milliseconds until a scheduled timer fires, or -1 if it isn't scheduled */
+static int sul_remaining_ms(const lws_sorted_usec_list_t *sul, lws_usec_t now) {
+    if (lws_dll2_is_detached(&sul->list)) {
+        return -1;
+    }
+    if (sul->us <= now) {
+        return 0;
+    }
+    lws_usec_t ms = (sul->us - now + 999) / 1000;
+    return ms > INT_MAX ? INT_MAX : (int)ms;
+}
+
+/**
+ * @brief How long an external event loop may sleep before calling obsws_service().
+ * 
+ * Accounts for the connection's own timers and for data lws already holds in
+ * memory. Capped at one second so a loop that ignores poll_callback still
+ * notices new descriptors reasonably soon.
+ * 
+ * @param conn Connection object created with config->external_loop
+ * @return Milliseconds to wait (0 = service now), or -1 if conn is not in
+ *         external loop mode
+ */
+int obsws_next_timeout(obsws_connection_t *conn) {
+    if (!conn || !conn->shard || !conn->shard->external) {
+        return -1;
+    }
+    
+    obsws_shard_t *shard = conn->shard;
+    int timeout = OBSWS_EXTERNAL_MAX_WAIT_MS;
+    
+    pthread_mutex_lock(&shard->service_mutex);
+    if (lws_service_adjust_timeout(shard->context, timeout, 0) == 0) {
+        timeout = 0;
+    } else {
+        lws_usec_t now = lws_now_usecs();
+        const lws_sorted_usec_list_t *suls[] = {
+            &conn->sul_keepalive, &conn->sul_deadline, &conn->sul_shrink, &conn->sul_reconnect,
+            &conn->sul_ping_timeout
+        };
+        for (size_t i = 0; i < sizeof(suls) / sizeof(suls[0]); i++) {
+            int ms = sul_remaining_ms(suls[i], now);
+            if (ms >= 0 && ms < timeout) {
+                timeout = ms;
+            }
+        }
+    }
+    pthread_mutex_unlock(&shard->service_mutex);
+    
+    return timeout;
+}
+
 /**
  * @brief Send a ping to OBS and measure round-trip latency.
  * 
- * Sends a WebSocket ping frame and waits for a pong response, returning
- * the round-trip time. Useful for connectivity checks and latency measurement.
+ * Sends a WebSocket ping frame and waits for the pong, returning the
+ * round-trip time. Useful for connectivity checks and latency measurement.
+ * 
+ * This used to send a JSON "Ping" request timed with gettimeofday(), which
+ * measured OBS's request handling as much as the network and only to the
+ * millisecond. Now it's a real ping/pong at the WebSocket layer, timed on
+ * CLOCK_MONOTONIC by the event thread - the same measurement the keep-alive
+ * makes, and the sample lands in the RTT stats too. Full microsecond
+ * resolution is in obsws_stats_t.last_rtt_us.
+ * 
+ * The ping is sent by the event thread; if a keep-alive ping is already
+ * outstanding, its pong answers this call as well.
  * 
  * @param conn Connection object (must be in CONNECTED state)
- * @param timeout_ms Maximum time to wait for pong in milliseconds
+ * @param timeout_ms Maximum time to wait for pong in milliseconds (0 = ping_timeout_ms)
  * @return Round-trip time in milliseconds (>= 0) if successful
  * @return Negative error code if failed (typically OBSWS_ERROR_TIMEOUT)
  */
@@ -2782,25 +9855,49 @@ int obsws_ping(obsws_connection_t *conn, uint32_t timeout_ms) {
         return OBSWS_ERROR_NOT_CONNECTED;
     }
     
-    obsws_response_t *response = NULL;
-    struct timeval start, end;
-    gettimeofday(&start, NULL);
-    
-    obsws_error_t err = obsws_send_request(conn, "Ping", NULL, &response, timeout_ms);
-    
-    gettimeofday(&end, NULL);
-    
-    int latency_ms = (int)((end.tv_sec - start.tv_sec) * 1000 + 
-                           (end.tv_usec - start.tv_usec) / 1000);
+    if (timeout_ms == 0) {
+        timeout_ms = conn->config.ping_timeout_ms ? conn->config.ping_timeout_ms : conn->config.recv_timeout_ms;
+    }
     
-    if (response) {
-        obsws_response_free(response);
+    pthread_mutex_lock(&conn->ping_mutex);
+    uint64_t seen = conn->pong_count;
+    pthread_mutex_unlock(&conn->ping_mutex);
+    
+    atomic_store_explicit(&conn->ping_requested, true, memory_order_release);
+    connection_kick(conn);
+    
+    uint64_t deadline = monotonic_ms() + timeout_ms;
+    bool answered = false;
+    
+    if (conn->shard->external) {
+        /* Nobody else services this connection - do it while we wait */
+        for (;;) {
+            pthread_mutex_lock(&conn->ping_mutex);
+            answered = conn->pong_count != seen;
+            pthread_mutex_unlock(&conn->ping_mutex);
+            uint64_t now = monotonic_ms();
+            if (answered || now >= deadline) break;
+            obsws_process_events(conn, (uint32_t)(deadline - now));
+        }
+    } else {
+        pthread_mutex_lock(&conn->ping_mutex);
+        while (conn->pong_count == seen) {
+            if (cond_wait_until(&conn->ping_cond, &conn->ping_mutex, deadline) == ETIMEDOUT) {
+                break;
+            }
+        }
+        answered = conn->pong_count != seen;
+        pthread_mutex_unlock(&conn->ping_mutex);
     }
     
-    if (err == OBSWS_OK) {
-        return latency_ms;
+    if (!answered) {
+        return OBSWS_ERROR_TIMEOUT;
     }
-    return (int)err;
+    
+    pthread_mutex_lock(&conn->stats_mutex);
+    int latency_ms = (int)conn->stats.last_ping_ms;
+    pthread_mutex_unlock(&conn->stats_mutex);
+    return latency_ms;
 }
 
 /**
@@ -2822,18 +9919,14 @@ obsws_error_t obsws_get_recording_status(obsws_connection_t *conn, bool *is_reco
     
     *is_recording = false;
     
+    /* The caller only gets the response if it asked for it - otherwise the
+       text of it is never needed */
     obsws_response_t *resp = NULL;
-    obsws_error_t result = obsws_send_request(conn, "GetRecordStatus", NULL, &resp, 0);
-    
-    if (result == OBSWS_OK && resp && resp->success && resp->response_data) {
-        cJSON *data = cJSON_Parse(resp->response_data);
-        if (data) {
-            cJSON *recording = cJSON_GetObjectItem(data, "outputActive");
-            if (recording && recording->type == cJSON_True) {
-                *is_recording = true;
-            }
-            cJSON_Delete(data);
-        }
+    obsws_error_t result = response ? obsws_send_request(conn, "GetRecordStatus", NULL, &resp, 0)
+                                    : send_for_tree(conn, "GetRecordStatus", NULL, NULL, &resp);
+    
+    if (result == OBSWS_OK && resp && resp->success) {
+        obsws_response_get_bool(resp, "/outputActive", is_recording);
     }
     
     if (response) {
@@ -2864,18 +9957,14 @@ obsws_error_t obsws_get_streaming_status(obsws_connection_t *conn, bool *is_stre
     
     *is_streaming = false;
     
+    /* The caller only gets the response if it asked for it - otherwise the
+       text of it is never needed */
     obsws_response_t *resp = NULL;
-    obsws_error_t result = obsws_send_request(conn, "GetStreamStatus", NULL, &resp, 0);
-    
-    if (result == OBSWS_OK && resp && resp->success && resp->response_data) {
-        cJSON *data = cJSON_Parse(resp->response_data);
-        if (data) {
-            cJSON *streaming = cJSON_GetObjectItem(data, "outputActive");
-            if (streaming && streaming->type == cJSON_True) {
-                *is_streaming = true;
-            }
-            cJSON_Delete(data);
-        }
+    obsws_error_t result = response ? obsws_send_request(conn, "GetStreamStatus", NULL, &resp, 0)
+                                    : send_for_tree(conn, "GetStreamStatus", NULL, NULL, &resp);
+    
+    if (result == OBSWS_OK && resp && resp->success) {
+        obsws_response_get_bool(resp, "/outputActive", is_streaming);
     }
     
     if (response) {
@@ -2909,31 +9998,27 @@ obsws_error_t obsws_get_scene_list(obsws_connection_t *conn, char ***scenes, siz
     *count = 0;
     
     obsws_response_t *response = NULL;
-    obsws_error_t result = obsws_send_request(conn, "GetSceneList", NULL, &response, 0);
-    
-    if (result == OBSWS_OK && response && response->success && response->response_data) {
-        cJSON *data = cJSON_Parse(response->response_data);
-        if (data) {
-            cJSON *scenes_array = cJSON_GetObjectItem(data, "scenes");
-            if (scenes_array && scenes_array->type == cJSON_Array) {
-                int num_scenes = cJSON_GetArraySize(scenes_array);
-                if (num_scenes > 0) {
-                    *scenes = calloc(num_scenes, sizeof(char *));
-                    if (*scenes) {
-                        int index = 0;
-                        cJSON *scene_item = NULL;
-                        cJSON_ArrayForEach(scene_item, scenes_array) {
-                            cJSON *scene_name = cJSON_GetObjectItem(scene_item, "sceneName");
-                            if (scene_name && scene_name->valuestring && index < num_scenes) {
-                                (*scenes)[index] = strdup(scene_name->valuestring);
-                                index++;
-                            }
-                        }
-                        *count = index;
+    obsws_error_t result = send_for_tree(conn, "GetSceneList", NULL, NULL, &response);
+    
+    if (result == OBSWS_OK && response && response->success) {
+        /* Walked directly rather than by index pointer, which would restart
+           from the head of the array for every scene */
+        cJSON *scenes_array = response_lookup(response, "/scenes");
+        size_t num_scenes = cJSON_IsArray(scenes_array) ? (size_t)cJSON_GetArraySize(scenes_array) : 0;
+        if (num_scenes > 0) {
+            *scenes = calloc(num_scenes, sizeof(char *));
+            if (*scenes) {
+                size_t index = 0;
+                cJSON *scene_item = NULL;
+                cJSON_ArrayForEach(scene_item, scenes_array) {
+                    cJSON *scene_name = cJSON_GetObjectItem(scene_item, "sceneName");
+                    if (cJSON_IsString(scene_name) && index < num_scenes) {
+                        (*scenes)[index] = strdup(scene_name->valuestring);
+                        index++;
                     }
                 }
+                *count = index;
             }
-            cJSON_Delete(data);
         }
     }
     
@@ -2981,34 +10066,31 @@ obsws_error_t obsws_set_source_visibility(obsws_connection_t *conn, const char *
         return OBSWS_ERROR_INVALID_PARAM;
     }
     
-    /* First get the source item ID for this source in this scene */
-    cJSON *req_data = cJSON_CreateObject();
-    cJSON_AddStringToObject(req_data, "sceneName", scene_name);
-    char *data_str = cJSON_PrintUnformatted(req_data);
-    cJSON_Delete(req_data);
+    const obsws_request_template_t *get_items = builtin_template(BUILTIN_GET_SCENE_ITEMS);
+    const obsws_request_template_t *set_enabled = builtin_template(BUILTIN_SET_ITEM_ENABLED);
+    if (!get_items || !set_enabled) {
+        return OBSWS_ERROR_OUT_OF_MEMORY;
+    }
     
+    /* First get the source item ID for this source in this scene */
+    obsws_template_arg_t get_args[] = { { .string = scene_name } };
     obsws_response_t *get_items_resp = NULL;
-    obsws_error_t result = obsws_send_request(conn, "GetSceneItemList", data_str, &get_items_resp, 0);
-    free(data_str);
+    obsws_error_t result = send_for_tree(conn, NULL, get_items, get_args, &get_items_resp);
     
     int source_id = -1;
-    if (result == OBSWS_OK && get_items_resp && get_items_resp->success && get_items_resp->response_data) {
-        cJSON *data = cJSON_Parse(get_items_resp->response_data);
-        if (data) {
-            cJSON *items = cJSON_GetObjectItem(data, "sceneItems");
-            if (items && items->type == cJSON_Array) {
-                cJSON *item = NULL;
-                cJSON_ArrayForEach(item, items) {
-                    cJSON *name = cJSON_GetObjectItem(item, "sourceName");
-                    cJSON *id = cJSON_GetObjectItem(item, "sceneItemId");
-                    if (name && name->valuestring && strcmp(name->valuestring, source_name) == 0 &&
-                        id && id->type == cJSON_Number) {
-                        source_id = id->valueint;
-                        break;
-                    }
+    if (result == OBSWS_OK && get_items_resp && get_items_resp->success) {
+        cJSON *items = response_lookup(get_items_resp, "/sceneItems");
+        if (cJSON_IsArray(items)) {
+            cJSON *item = NULL;
+            cJSON_ArrayForEach(item, items) {
+                cJSON *name = cJSON_GetObjectItem(item, "sourceName");
+                cJSON *id = cJSON_GetObjectItem(item, "sceneItemId");
+                if (cJSON_IsString(name) && strcmp(name->valuestring, source_name) == 0 &&
+                    cJSON_IsNumber(id)) {
+                    source_id = id->valueint;
+                    break;
                 }
             }
-            cJSON_Delete(data);
         }
     }
     
@@ -3021,17 +10103,9 @@ obsws_error_t obsws_set_source_visibility(obsws_connection_t *conn, const char *
     }
     
     /* Now set the visibility */
-    req_data = cJSON_CreateObject();
-    cJSON_AddStringToObject(req_data, "sceneName", scene_name);
-    cJSON_AddNumberToObject(req_data, "sceneItemId", source_id);
-    cJSON_AddBoolToObject(req_data, "sceneItemEnabled", visible);
-    
-    data_str = cJSON_PrintUnformatted(req_data);
-    cJSON_Delete(req_data);
-    
+    obsws_template_arg_t set_args[] = { { .string = scene_name }, { .integer = source_id }, { .boolean = visible } };
     obsws_response_t *resp = NULL;
-    result = obsws_send_request(conn, "SetSceneItemEnabled", data_str, &resp, 0);
-    free(data_str);
+    result = obsws_send_template(conn, set_enabled, set_args, &resp, 0);
     
     if (response) {
         *response = resp;
@@ -3062,17 +10136,14 @@ obsws_error_t obsws_set_source_filter_enabled(obsws_connection_t *conn, const ch
         return OBSWS_ERROR_INVALID_PARAM;
     }
     
-    cJSON *req_data = cJSON_CreateObject();
-    cJSON_AddStringToObject(req_data, "sourceName", source_name);
-    cJSON_AddStringToObject(req_data, "filterName", filter_name);
-    cJSON_AddBoolToObject(req_data, "filterEnabled", enabled);
-    
-    char *data_str = cJSON_PrintUnformatted(req_data);
-    cJSON_Delete(req_data);
+    const obsws_request_template_t *tmpl = builtin_template(BUILTIN_SET_FILTER_ENABLED);
+    if (!tmpl) {
+        return OBSWS_ERROR_OUT_OF_MEMORY;
+    }
+    obsws_template_arg_t args[] = { { .string = source_name }, { .string = filter_name }, { .boolean = enabled } };
     
     obsws_response_t *resp = NULL;
-    obsws_error_t result = obsws_send_request(conn, "SetSourceFilterEnabled", data_str, &resp, 0);
-    free(data_str);
+    obsws_error_t result = obsws_send_template(conn, tmpl, args, &resp, 0);
     
     if (response) {
         *response = resp;
@@ -30,6 +30,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <time.h>
+#include <poll.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -72,6 +73,9 @@ typedef enum {
     OBSWS_ERROR_PARSE_FAILED = -7,
     OBSWS_ERROR_NOT_CONNECTED = -8,
     OBSWS_ERROR_ALREADY_CONNECTED = -9,
+    OBSWS_ERROR_MESSAGE_TOO_LARGE = -12,     /* Response went over max_message_size and was dropped */
+    OBSWS_ERROR_WINDOW_FULL = -13,           /* Too many requests in flight (see max_in_flight) - not sent */
+    OBSWS_ERROR_CANCELLED = -14,             /* Cancelled by obsws_cancel() or a cancel token */
     
     /* Timeout errors (recoverable by retrying with patience) */
     OBSWS_ERROR_TIMEOUT = -4,
@@ -146,6 +150,45 @@ typedef enum {
 /* Forward declaration of connection handle - opaque structure for connection management */
 typedef struct obsws_connection obsws_connection_t;
 
+/* Forward declaration of shared reactor handle - a pool of event loop threads
+   that many connections can share (see obsws_reactor_create) */
+typedef struct obsws_reactor obsws_reactor_t;
+
+/* Forward declaration of future handle - the eventual result of a request sent
+   with obsws_send_request_async() */
+typedef struct obsws_future obsws_future_t;
+
+/* Forward declaration of cancel token handle - cancels the blocking requests
+   sent with it (see obsws_cancel_token_create) */
+typedef struct obsws_cancel_token obsws_cancel_token_t;
+
+/* Forward declaration of request batch handle - requests sent together in one
+   RequestBatch message (see obsws_batch_create) */
+typedef struct obsws_batch obsws_batch_t;
+
+/* Forward declaration of request template handle - a request compiled once
+   and sent many times with different values (see obsws_request_template_create) */
+typedef struct obsws_request_template obsws_request_template_t;
+
+/* A value for one slot of a request template. Set the member that matches
+   the slot: string for %s (NULL sends null), integer for %d, number for %f,
+   boolean for %b. */
+typedef union {
+    const char *string;
+    int64_t integer;
+    double number;
+    bool boolean;
+} obsws_template_arg_t;
+
+/**
+ * How OBS runs the requests of a batch (the protocol's RequestBatchExecutionType).
+ */
+typedef enum {
+    OBSWS_BATCH_SERIAL_REALTIME = 0,     /* One after another, as fast as possible */
+    OBSWS_BATCH_SERIAL_FRAME = 1,        /* One after another, one per rendered frame */
+    OBSWS_BATCH_PARALLEL = 2             /* All at once; completion order undefined, no halt_on_failure */
+} obsws_batch_execution_t;
+
 /**
  * Log callback function type - called when the library generates log messages.
  * 
@@ -227,6 +270,113 @@ typedef void (*obsws_event_callback_t)(obsws_connection_t *conn, const char *eve
  */
 typedef void (*obsws_state_callback_t)(obsws_connection_t *conn, obsws_state_t old_state, obsws_state_t new_state, void *user_data);
 
+/**
+ * What happened to a file descriptor, for obsws_poll_callback_t.
+ * 
+ * These line up one-to-one with epoll_ctl()'s EPOLL_CTL_ADD / MOD / DEL (or
+ * kqueue's EV_ADD / EV_DELETE), so an external event loop can mirror the
+ * connection's descriptors without diffing obsws_get_pollfds() snapshots.
+ */
+typedef enum {
+    OBSWS_POLL_ADD = 0,              /* Start watching fd for events */
+    OBSWS_POLL_MODIFY = 1,           /* fd now wants a different set of events */
+    OBSWS_POLL_REMOVE = 2            /* Stop watching fd - it's about to be closed */
+} obsws_poll_op_t;
+
+/**
+ * Poll callback function type - called when an external-loop connection's set
+ * of file descriptors, or the events wanted on one, changes.
+ * 
+ * Only used when config.external_loop is set. events uses poll() bits (POLLIN,
+ * POLLOUT); for epoll they map to EPOLLIN / EPOLLOUT.
+ * 
+ * @param conn The connection the descriptor belongs to
+ * @param op Add, modify or remove
+ * @param fd The file descriptor
+ * @param events poll() events wanted on fd (0 for OBSWS_POLL_REMOVE)
+ * @param user_data Pointer you provided in the config
+ * 
+ * @note The first calls arrive from inside obsws_connect(), before it returns.
+ * @note Later calls come from obsws_service() / obsws_disconnect() on your thread.
+ * @note Don't call obsws_get_pollfds() or obsws_service() from inside it.
+ */
+typedef void (*obsws_poll_callback_t)(obsws_connection_t *conn, obsws_poll_op_t op, int fd, short events, void *user_data);
+
+/**
+ * Executor function type - runs async completion callbacks somewhere other
+ * than the event thread.
+ * 
+ * When config.completion_executor is set, the library doesn't run completion
+ * callbacks itself; it hands each one over as a task. Call task(task_arg)
+ * exactly once, on whatever thread you like - a worker pool, your UI thread's
+ * queue, etc. That keeps slow callbacks from holding up the event thread (and,
+ * with a shared reactor, every other connection on it).
+ * 
+ * @param task Function to run
+ * @param task_arg Argument to pass to task
+ * @param executor_data config.executor_data
+ * 
+ * @note Called from the event thread; it should queue the task and return.
+ */
+typedef void (*obsws_executor_t)(void (*task)(void *task_arg), void *task_arg, void *executor_data);
+
+/* Event subscription flags - bitmask for which OBS event categories we subscribe to.
+   
+   The OBS WebSocket protocol lets you specify which events you want to receive. This
+   avoids bandwidth waste - if you don't care about media playback events, don't subscribe.
+   We subscribe to every category by default; set config.event_subscriptions to be
+   more selective, or change it on a live connection with obsws_reidentify().
+   
+   We chose a bitmask (0x7FF for all) rather than subscribing/unsubscribing individually
+   because it's more efficient - one subscription message at connect-time instead of
+   many individual subscribe/unsubscribe messages.
+*/
+
+#define OBSWS_EVENT_GENERAL (1 << 0)        /* General OBS events (startup, shutdown) */
+#define OBSWS_EVENT_CONFIG (1 << 1)         /* Configuration change events */
+#define OBSWS_EVENT_SCENES (1 << 2)         /* Scene-related events (scene switched, etc) */
+#define OBSWS_EVENT_INPUTS (1 << 3)         /* Input source events (muted, volume changed) */
+#define OBSWS_EVENT_TRANSITIONS (1 << 4)    /* Transition events (transition started) */
+#define OBSWS_EVENT_FILTERS (1 << 5)        /* Filter events (filter added, removed) */
+#define OBSWS_EVENT_OUTPUTS (1 << 6)        /* Output events (recording started, streaming stopped) */
+#define OBSWS_EVENT_SCENE_ITEMS (1 << 7)    /* Scene item events (source added to scene) */
+#define OBSWS_EVENT_MEDIA_INPUTS (1 << 8)   /* Media playback events (media finished) */
+#define OBSWS_EVENT_VENDORS (1 << 9)        /* Vendor-specific extensions */
+#define OBSWS_EVENT_UI (1 << 10)            /* UI events (Studio Mode toggled) */
+#define OBSWS_EVENT_ALL 0x7FF               /* Subscribe to all event types */
+
+/* What a request does when the connection's in-flight window is full.
+   
+   OBS runs requests one at a time on its own thread, so a burst of thousands
+   doesn't go any faster - it just queues up inside OBS, where it competes with
+   rendering. config.max_in_flight caps how many requests a connection has out
+   at once; the policy decides what happens to the next one.
+*/
+typedef enum {
+    OBSWS_WINDOW_BLOCK = 0,             /* Caller waits for a free slot, up to the request's timeout */
+    OBSWS_WINDOW_FAIL,                  /* Return OBSWS_ERROR_WINDOW_FULL at once */
+    OBSWS_WINDOW_QUEUE                  /* Wait in a bounded local backlog; sent as slots free up */
+} obsws_window_policy_t;
+
+/* Priority lane a request is sent in (see obsws_set_request_priority).
+   
+   Frames wait in one outbound queue per lane. The event thread always writes
+   realtime frames first, then normal ones; bulk frames go when nothing else
+   is waiting, plus config.bulk_share percent of the writes while normal
+   traffic is queued, so polling can't be starved outright. Realtime requests
+   also skip the in-flight window, so a scene cut never waits for a slot.
+   
+   Every request is normal unless obsws_set_request_priority() says otherwise.
+   Lanes reorder: requests in different lanes can reach OBS in a different
+   order than they were sent.
+*/
+typedef enum {
+    OBSWS_PRIORITY_NORMAL = 0,          /* Every request type unless given a rule */
+    OBSWS_PRIORITY_REALTIME,            /* What the audience sees - scene cuts, transitions (opt in) */
+    OBSWS_PRIORITY_BULK,                /* Background polling and monitoring */
+    OBSWS_PRIORITY_COUNT                /* Number of lanes - sizes the per-lane stats */
+} obsws_priority_t;
+
 /**
  * Connection configuration structure.
  * 
@@ -254,19 +404,75 @@ typedef struct {
     uint32_t send_timeout_ms;            /* How long to wait to send data to OBS (default: 5000) */
     
     /* === Keep-Alive / Health Monitoring ===
-       The library sends ping messages periodically to detect dead connections.
-       If OBS stops responding to pings, the library will try to reconnect. */
+       The library sends WebSocket ping frames periodically to detect dead connections.
+       If OBS doesn't answer one within ping_timeout_ms, the socket is dropped and the
+       library tries to reconnect (see auto_reconnect). With ping_timeout_ms at 0 a
+       ping still unanswered at the next interval is given up on and a new one sent.
+       Round trips go into the stats. */
     uint32_t ping_interval_ms;           /* Send ping this often (default: 10000, 0 to disable pings) */
-    uint32_t ping_timeout_ms;            /* Wait this long for pong response (default: 5000) */
+    uint32_t ping_timeout_ms;            /* Drop the connection if no pong by then (default: 5000, 0 = never) */
     
     /* === Automatic Reconnection ===
        If the connection dies, should we try to reconnect? Very useful for production
        because networks hiccup, OBS crashes, etc. The library uses exponential backoff
-       to avoid hammering the server - delays double each attempt up to the max. */
+       to avoid hammering the server - the ceiling doubles each attempt up to the max,
+       and each wait is drawn at random below it ("full jitter") so a fleet of
+       clients doesn't reconnect in lockstep when OBS restarts. Only connections
+       that were fully connected once are retried.
+       
+       Requests outstanding when the connection drops are either replayed after
+       the reconnect (idempotent ones - Get* and Set* - when
+       replay_idempotent_requests is set) or fail at once with
+       OBSWS_ERROR_NOT_CONNECTED. */
     bool auto_reconnect;                 /* Enable automatic reconnection (default: true) */
     uint32_t reconnect_delay_ms;         /* Wait this long before first reconnect (default: 1000) */
     uint32_t max_reconnect_delay_ms;     /* Don't wait longer than this between attempts (default: 30000) */
     uint32_t max_reconnect_attempts;     /* Give up after this many attempts (0 = retry forever) */
+    bool replay_idempotent_requests;     /* Resend Get* / Set* requests caught by a drop (default: true) */
+    
+    /* === Message Size Limits ===
+       Incoming messages are reassembled in a buffer that starts at 64KB and doubles
+       as needed. This caps how far it may grow. A response bigger than this fails its
+       request with OBSWS_ERROR_MESSAGE_TOO_LARGE; the buffer shrinks back to 64KB
+       after the connection has been idle for a while. */
+    size_t max_message_size;             /* Largest message to reassemble in bytes (default: 32MB) */
+    
+    /* === Compression ===
+       permessage-deflate (RFC 7692) trades some CPU for much smaller JSON on the
+       wire - worth it on slow or metered links to remote OBS hosts. OBS decides
+       whether to accept; if it doesn't, the connection just runs uncompressed. */
+    bool compression;                    /* Offer permessage-deflate (default: false) */
+    uint8_t compression_window_bits;     /* Our deflate window, 9-15 (default: 15 = 32KB) */
+    size_t compression_threshold;        /* Send messages smaller than this uncompressed (default: 256) */
+    
+    /* === Wire Format ===
+       OBS can exchange MessagePack in binary frames instead of JSON text. It's
+       smaller on the wire and much cheaper to decode, which adds up on busy
+       event streams. The API is unchanged: requestData still goes in as JSON and
+       response/event data still comes out as JSON strings. If OBS doesn't accept
+       the subprotocol, the connection falls back to JSON. */
+    bool msgpack;                        /* Negotiate obswebsocket.msgpack (default: false) */
+    
+    /* === Threading ===
+       By default each connection runs its own background thread. Point this at a
+       reactor from obsws_reactor_create() to share a small pool of threads across
+       many connections instead. The reactor must outlive the connection. */
+    obsws_reactor_t *reactor;            /* Shared reactor to run on (default: NULL = own thread) */
+    
+    /* === External Event Loop ===
+       Set external_loop to run the connection without any library thread. Your own
+       poll/epoll/kqueue loop watches the descriptors from obsws_get_pollfds() (or the
+       poll_callback), calls obsws_service() when one is ready and sleeps no longer
+       than obsws_next_timeout(). Responses and events are then delivered on your
+       thread. Can't be combined with reactor. */
+    bool external_loop;                  /* No internal thread; you drive the connection (default: false) */
+    obsws_poll_callback_t poll_callback; /* Optional: told about descriptor changes, for epoll-style loops */
+    
+    /* === Session ===
+       Which OBSWS_EVENT_* categories OBS should send us. Fewer categories mean
+       less traffic and fewer callbacks; obsws_reidentify() changes the mask
+       without reconnecting. */
+    uint32_t event_subscriptions;        /* Event categories to receive (default: OBSWS_EVENT_ALL) */
     
     /* === Callbacks ===
        These optional callbacks let you be notified of important events.
@@ -275,6 +481,41 @@ typedef struct {
     obsws_event_callback_t event_callback;  /* Called when OBS sends an event */
     obsws_state_callback_t state_callback;  /* Called when connection state changes */
     void *user_data;                     /* Passed to all callbacks - use for context (like "this" pointer) */
+    
+    /* === Async Completions ===
+       Where obsws_send_request_async() completion callbacks run. By default on
+       the event thread, right after the response is read; set an executor to
+       run them elsewhere. */
+    obsws_executor_t completion_executor;  /* Optional: runs completion callbacks (default: NULL = event thread) */
+    void *executor_data;                 /* Passed to completion_executor */
+    
+    /* === Request Coalescing ===
+       Dashboards and control surfaces often ask OBS the same thing from several
+       places at once (GetSceneList on every refresh, GetInputMute per widget).
+       With coalesce_reads set, a read-only (Get*) request whose type and
+       requestData exactly match one already in flight doesn't go to OBS at all:
+       it waits for that request and gets its own copy of the same response.
+       Each caller keeps its own timeout, callback and future. Off by default,
+       because two reads that start at different times can legitimately expect
+       different answers. */
+    bool coalesce_reads;                 /* Share one round trip between identical Get* requests (default: false) */
+    
+    /* === In-Flight Window ===
+       At most max_in_flight requests (a batch counts as one) are sent and not
+       yet answered at any time; see obsws_window_policy_t for what the next one
+       does. A request that doesn't get a slot before its timeout_ms fails with
+       OBSWS_ERROR_TIMEOUT. Completion callbacks run on the event thread and
+       can't block there, so with OBSWS_WINDOW_BLOCK their requests queue. */
+    uint32_t max_in_flight;              /* Requests out at once (default: 256, 0 = no limit) */
+    obsws_window_policy_t window_policy; /* When the window is full (default: OBSWS_WINDOW_BLOCK) */
+    uint32_t window_backlog;             /* Most requests queued locally under OBSWS_WINDOW_QUEUE (default: 1024) */
+    
+    /* === Priority Lanes ===
+       Requests go out realtime first, then normal, then bulk (see
+       obsws_priority_t). While normal requests are queued, bulk still gets
+       this share of the writes; 0 lets normal traffic hold bulk back entirely.
+       Capped at 90 so normal traffic always gets some. */
+    uint32_t bulk_share;                 /* Percent of writes bulk gets under load (default: 10, max 90) */
 } obsws_config_t;
 
 /**
@@ -294,6 +535,52 @@ typedef struct {
     uint64_t error_count;                /* Total errors encountered (some might be retried successfully) */
     uint64_t last_ping_ms;               /* Round-trip time of last ping - network latency indicator */
     time_t connected_since;              /* Unix timestamp of when this connection was established */
+    
+    /* permessage-deflate accounting - only messages that actually went through
+       compression are counted here; bytes_sent/bytes_received above are always
+       the uncompressed payload sizes. compressed / uncompressed = ratio achieved. */
+    uint64_t compressed_bytes_sent;      /* Wire size of the messages we compressed */
+    uint64_t uncompressed_bytes_sent;    /* Those same messages before compression */
+    uint64_t compressed_bytes_received;  /* Wire size of compressed messages from OBS */
+    uint64_t uncompressed_bytes_received;  /* Those same messages after inflation */
+    
+    /* WebSocket ping/pong round trips, timed on CLOCK_MONOTONIC by the event
+       thread. mean/min/max/jitter cover the most recent 32 pongs, so they
+       describe the link as it is now rather than since connect. Jitter is the
+       mean difference between consecutive round trips. All 0 until the first pong. */
+    uint64_t last_rtt_us;                /* Latest round trip in microseconds */
+    uint64_t rtt_mean_us;                /* Mean over the window */
+    uint64_t rtt_min_us;                 /* Fastest in the window */
+    uint64_t rtt_max_us;                 /* Slowest in the window */
+    uint64_t rtt_jitter_us;              /* Mean |RTT[n] - RTT[n-1]| over the window */
+    uint64_t ping_timeouts;              /* Pings unanswered within ping_timeout_ms (each drops the socket) */
+    uint64_t requests_coalesced;         /* Requests answered by another's round trip (config.coalesce_reads) */
+    
+    /* In-flight window (config.max_in_flight). in_flight and window_backlog_depth
+       are the values right now; the rest count since connect. A wait is the
+       time from finding the window full to getting a slot. */
+    uint64_t in_flight;                  /* Requests sent and not yet answered */
+    uint64_t in_flight_peak;             /* Most ever out at once */
+    uint64_t window_backlog_depth;       /* Requests waiting in the local backlog */
+    uint64_t window_waits;               /* Requests that found the window full and waited for a slot */
+    uint64_t window_wait_us_total;       /* Sum of those waits, in microseconds */
+    uint64_t window_wait_us_max;         /* Longest single wait */
+    uint64_t window_rejections;          /* Requests turned away with OBSWS_ERROR_WINDOW_FULL */
+    
+    /* Cancellation. A response that turns up for a request nobody is waiting
+       on any more - cancelled or timed out - is dropped unparsed. */
+    uint64_t requests_cancelled;         /* Requests ended by obsws_cancel() or a cancel token */
+    uint64_t late_responses;             /* Responses dropped because their request had already ended */
+    
+    /* Events nothing consumes - no event_callback, and not one the library
+       tracks itself - are dropped after a pre-scan, without being parsed. */
+    uint64_t events_dropped;             /* Events dropped that way */
+    
+    /* Priority lanes, indexed by obsws_priority_t. Queue time runs from a
+       frame being queued for the socket to it being written. */
+    uint64_t lane_frames_sent[OBSWS_PRIORITY_COUNT];     /* Frames written from each lane */
+    uint64_t lane_queue_us_total[OBSWS_PRIORITY_COUNT];  /* Sum of their queue times, in microseconds */
+    uint64_t lane_queue_us_max[OBSWS_PRIORITY_COUNT];    /* Longest single queue time */
 } obsws_stats_t;
 
 /**
@@ -307,17 +594,55 @@ typedef struct {
  * If you don't care about the response, you can pass NULL and not get one back.
  * Otherwise you must free it with obsws_response_free() when done.
  * 
- * Design note: Responses are returned as strings instead of parsed JSON to save
- * CPU - different callers care about different response fields, so we let them
- * parse what they need. This also avoids dependency bloat.
+ * Design note: response_data is plain JSON text, so callers can parse it with
+ * whatever they like. For a field or two, obsws_response_get_string() and
+ * friends are simpler: the response parses responseData once, the first time
+ * one is used, and keeps the tree for the rest.
+ * 
+ * ABI note: data_tree is new since 1.1.0 and changes sizeof(obsws_response_t);
+ * rebuild against this header, and zero any response you allocate yourself.
  */
 typedef struct {
     bool success;                        /* true if OBS said the operation worked */
     int status_code;                     /* OBS status code: 100-199 = success, 600+ = error */
     char *error_message;                 /* If success is false, this has the reason (e.g., "Scene does not exist") */
     char *response_data;                 /* Raw JSON response from OBS - parse yourself with cJSON */
+    void *data_tree;                     /* Internal: parsed responseData behind obsws_response_get_*() (may be NULL) */
 } obsws_response_t;
 
+/**
+ * Results of a request batch, indexed like the batch.
+ * 
+ * responses[i] is the outcome of the i-th request added with obsws_batch_add(),
+ * whatever order OBS ran them in. When halt_on_failure stopped the batch, the
+ * requests that never ran have success false and status_code 0, and executed
+ * is less than count. Free with obsws_batch_result_free().
+ */
+typedef struct {
+    size_t count;                        /* Requests in the batch (entries in responses) */
+    size_t executed;                     /* Results OBS returned - fewer than count if halted */
+    obsws_response_t *responses;         /* One per request, in batch order */
+} obsws_batch_result_t;
+
+/**
+ * Completion callback function type - called when a request sent with
+ * obsws_send_request_async() completes.
+ * 
+ * Runs exactly once per request, whatever the outcome. error is OBSWS_OK when
+ * OBS answered (check response->success, as with obsws_send_request), or
+ * what ended the request: OBSWS_ERROR_TIMEOUT, OBSWS_ERROR_NOT_CONNECTED,
+ * OBSWS_ERROR_SEND_FAILED, ...
+ * 
+ * @param error How the request ended
+ * @param response The response (never NULL) - borrowed, valid until the callback returns
+ * @param user_data Pointer you passed to obsws_send_request_async()
+ * 
+ * @note Called from the event thread unless config.completion_executor is set.
+ *       Don't block in it; sending more requests with obsws_send_request_async()
+ *       is fine, blocking calls like obsws_send_request() are not.
+ */
+typedef void (*obsws_completion_callback_t)(obsws_error_t error, const obsws_response_t *response, void *user_data);
+
 /* ============================================================================
  * Library Initialization and Cleanup
  * ============================================================================ */
@@ -627,6 +952,48 @@ obsws_connection_t* obsws_connect(const obsws_config_t *config);
  */
 void obsws_disconnect(obsws_connection_t *conn);
 
+/**
+ * Create a shared reactor: a fixed pool of event loop threads for many connections.
+ * 
+ * Each connection normally gets its own libwebsockets context and background
+ * thread. When you manage a large fleet of OBS instances, that's hundreds of
+ * threads. A reactor runs num_threads shards instead - each one libwebsockets
+ * context serviced by one thread - and connections created with
+ * config.reactor set to it are spread across the shards.
+ * 
+ * @param num_threads Number of event loop threads (0 = one per online CPU)
+ * @return Reactor handle, or NULL on failure
+ * 
+ * @note Callbacks of every connection on a shard run on that shard's thread, so
+ *       a slow callback delays the other connections sharing it.
+ * @note With a reactor, obsws_connect() starts the connection attempt on the
+ *       shard thread; if it can't even start, the state goes to ERROR rather
+ *       than obsws_connect() returning NULL.
+ * 
+ * @example Usage:
+ *   obsws_reactor_t *reactor = obsws_reactor_create(4);
+ *   for (int i = 0; i < num_hosts; i++) {
+ *       obsws_config_t config;
+ *       obsws_config_init(&config);
+ *       config.host = hosts[i];
+ *       config.reactor = reactor;
+ *       conns[i] = obsws_connect(&config);
+ *   }
+ *   // ...
+ *   for (int i = 0; i < num_hosts; i++) obsws_disconnect(conns[i]);
+ *   obsws_reactor_destroy(reactor);
+ */
+obsws_reactor_t* obsws_reactor_create(uint32_t num_threads);
+
+/**
+ * Stop a shared reactor's threads and free it.
+ * 
+ * Disconnect every connection that uses the reactor before calling this.
+ * 
+ * @param reactor Reactor to destroy (can be NULL, which does nothing)
+ */
+void obsws_reactor_destroy(obsws_reactor_t *reactor);
+
 /**
  * Check if connection is currently authenticated and ready to use.
  * 
@@ -657,6 +1024,19 @@ bool obsws_is_connected(const obsws_connection_t *conn);
  */
 obsws_state_t obsws_get_state(const obsws_connection_t *conn);
 
+/**
+ * Check whether the session negotiated the MessagePack subprotocol.
+ * 
+ * Setting config.msgpack only asks OBS for obswebsocket.msgpack; if OBS turns
+ * it down the connection falls back to JSON. Use this to find out which one
+ * you got.
+ * 
+ * @param conn Connection handle
+ * @return true if connected and exchanging MessagePack, false otherwise
+ *         (including while not connected)
+ */
+bool obsws_is_msgpack(const obsws_connection_t *conn);
+
 /**
  * Get connection statistics and performance metrics.
  * 
@@ -691,6 +1071,9 @@ obsws_error_t obsws_get_stats(const obsws_connection_t *conn, obsws_stats_t *sta
  * 
  * @note This is async - it returns immediately, reconnection happens in background.
  * @note If auto_reconnect is disabled, this still reconnects one time.
+ * @note The reconnect backoff starts over; the first attempt has no delay.
+ * @note Idempotent requests in flight are replayed once reconnected, others
+ *       fail with OBSWS_ERROR_NOT_CONNECTED (see replay_idempotent_requests).
  */
 obsws_error_t obsws_reconnect(obsws_connection_t *conn);
 
@@ -713,7 +1096,10 @@ obsws_error_t obsws_reconnect(obsws_connection_t *conn);
  * 
  * @note Returns immediately if not connected - doesn't attempt to connect.
  * @note The library also sends pings automatically at ping_interval_ms, so you
- *       usually don't need to call this manually.
+ *       usually don't need to call this manually - obsws_get_stats() has the
+ *       latest round trip (last_rtt_us) and a rolling mean/min/max/jitter.
+ * @note This is a WebSocket-level ping, answered by OBS's WebSocket layer.
+ *       timeout_ms of 0 uses config.ping_timeout_ms.
  * @note A high latency (e.g., several seconds) might indicate network problems.
  */
 int obsws_ping(obsws_connection_t *conn, uint32_t timeout_ms);
@@ -1108,6 +1494,7 @@ obsws_error_t obsws_set_source_filter_enabled(obsws_connection_t *conn, const ch
  * @return OBSWS_OK if request was sent and response received within timeout
  * @return OBSWS_ERROR_NOT_CONNECTED if not connected
  * @return OBSWS_ERROR_TIMEOUT if no response within timeout_ms
+ * @return OBSWS_ERROR_MESSAGE_TOO_LARGE if the response was bigger than config.max_message_size
  * @return OBSWS_ERROR_INVALID_PARAM if request_type is NULL
  * @return OBSWS_ERROR_PARSE_FAILED if response JSON was malformed
  * 
@@ -1142,10 +1529,401 @@ obsws_error_t obsws_set_source_filter_enabled(obsws_connection_t *conn, const ch
 obsws_error_t obsws_send_request(obsws_connection_t *conn, const char *request_type, 
                                  const char *request_data, obsws_response_t **response, uint32_t timeout_ms);
 
+/* cJSON's node type, for obsws_send_request_cjson() - declared here so this
+   header doesn't need cJSON's */
+struct cJSON;
+
+/**
+ * obsws_send_request() with requestData passed through untouched.
+ * 
+ * The caller promises request_data is one well-formed JSON object; its bytes
+ * are copied into the message as they are, without being scanned. Builds
+ * without NDEBUG check anyway and return OBSWS_ERROR_INVALID_PARAM for a bad
+ * one (define OBSWS_VALIDATE_RAW_REQUESTS to 0 or 1 when building the library
+ * to choose). Use it for big payloads like SetInputSettings.
+ * 
+ * @param request_data requestData JSON (needn't be NUL-terminated), or NULL for none
+ * @param data_len Its length in bytes
+ * @return Same as obsws_send_request()
+ */
+obsws_error_t obsws_send_request_raw(obsws_connection_t *conn, const char *request_type,
+                                     const char *request_data, size_t data_len,
+                                     obsws_response_t **response, uint32_t timeout_ms);
+
+/**
+ * obsws_send_request() with requestData as a cJSON object the caller built.
+ * 
+ * Takes ownership: request_data is freed before this returns, whether or not
+ * the request was sent. It's printed once and copied into the request as is,
+ * without the syntax scan obsws_send_request() gives requestData text.
+ * 
+ * @param request_data requestData object, or NULL for none
+ * @return Same as obsws_send_request()
+ * 
+ * @example
+ *   cJSON *data = cJSON_CreateObject();
+ *   cJSON_AddStringToObject(data, "inputName", "Browser");
+ *   cJSON_AddItemToObject(data, "inputSettings", settings);
+ *   obsws_send_request_cjson(conn, "SetInputSettings", data, &response, 0);
+ */
+obsws_error_t obsws_send_request_cjson(obsws_connection_t *conn, const char *request_type,
+                                       struct cJSON *request_data, obsws_response_t **response,
+                                       uint32_t timeout_ms);
+
+/**
+ * Send a request without waiting for the response.
+ * 
+ * Returns as soon as the request is queued. When it completes - answered,
+ * failed or timed out - callback runs (if given) and the future (if asked for)
+ * becomes ready. A single thread can keep hundreds of requests in flight this
+ * way, across connections, instead of blocking a thread per request.
+ * 
+ * The future owns the response; free it with obsws_future_free() when done.
+ * Pass future = NULL if the callback is all you need.
+ * 
+ * @param conn Connection handle (must be in CONNECTED state)
+ * @param request_type OBS request type name (e.g., "GetVersion")
+ * @param request_data JSON string with request parameters, or NULL
+ * @param timeout_ms Complete with OBSWS_ERROR_TIMEOUT after this long (0 = recv_timeout_ms).
+ *        Measured on CLOCK_MONOTONIC and enforced to the millisecond.
+ * @param callback Completion callback, or NULL
+ * @param user_data Passed to callback
+ * @param future Receives the future, or NULL
+ * @return OBSWS_OK once queued; OBSWS_ERROR_NOT_CONNECTED, OBSWS_ERROR_INVALID_PARAM,
+ *         OBSWS_ERROR_WINDOW_FULL or OBSWS_ERROR_OUT_OF_MEMORY if it wasn't sent
+ *         (the callback won't run)
+ * 
+ * @example Fan out and collect:
+ *   obsws_future_t *f[2];
+ *   obsws_send_request_async(conn, "GetVersion", NULL, 0, NULL, NULL, &f[0]);
+ *   obsws_send_request_async(conn, "GetSceneList", NULL, 0, NULL, NULL, &f[1]);
+ *   obsws_future_wait_all(f, 2, 0);
+ *   const obsws_response_t *response;
+ *   if (obsws_future_get(f[1], &response) == OBSWS_OK && response->success) {
+ *       // ... parse response->response_data ...
+ *   }
+ *   obsws_future_free(f[0]);
+ *   obsws_future_free(f[1]);
+ */
+obsws_error_t obsws_send_request_async(obsws_connection_t *conn, const char *request_type,
+                                       const char *request_data, uint32_t timeout_ms,
+                                       obsws_completion_callback_t callback, void *user_data,
+                                       obsws_future_t **future);
+
+/**
+ * Put a request type in a priority lane on this connection.
+ * 
+ * Applies to every request of that type sent afterwards, whichever call sends
+ * it. Every type is normal until given a rule; batches are always normal.
+ * 
+ * Lanes reorder requests: a realtime request can reach OBS ahead of normal
+ * ones sent before it, and normal requests overtake queued bulk ones. Only
+ * move a type whose requests don't depend on what was sent just before them.
+ * 
+ * @param conn Connection handle
+ * @param request_type OBS request type name (e.g., "GetInputSettings")
+ * @param priority Lane for it
+ * @return OBSWS_OK, OBSWS_ERROR_INVALID_PARAM or OBSWS_ERROR_OUT_OF_MEMORY
+ * 
+ * @example Cut scenes ahead of everything, keep monitoring polls out of the way:
+ *   obsws_set_request_priority(conn, "SetCurrentProgramScene", OBSWS_PRIORITY_REALTIME);
+ *   obsws_set_request_priority(conn, "GetSceneItemList", OBSWS_PRIORITY_BULK);
+ *   obsws_set_request_priority(conn, "GetInputSettings", OBSWS_PRIORITY_BULK);
+ */
+obsws_error_t obsws_set_request_priority(obsws_connection_t *conn, const char *request_type,
+                                         obsws_priority_t priority);
+
+/**
+ * Compile a request template.
+ * 
+ * The skeleton is the requestData JSON with a slot wherever a value changes
+ * from send to send: %s for a string, %d an integer, %f a number, %b a bool.
+ * A slot stands for a whole value: it follows ':', '[' or ',' and comes
+ * before ',', '}' or ']'.
+ * Sending a template only escapes the values and copies them in - no JSON is
+ * built, parsed or checked. A template isn't tied to a connection; share it
+ * between threads and connections freely.
+ * 
+ * @param request_type OBS request type, e.g. "SetCurrentProgramScene"
+ * @param skeleton requestData with slots, or NULL for a request without data
+ * @return New template (free with obsws_request_template_free), or NULL if
+ *         the skeleton isn't valid JSON once its slots are filled, or on out of memory
+ * 
+ * @example A hotkey's scene cut:
+ *   obsws_request_template_t *cut =
+ *       obsws_request_template_create("SetCurrentProgramScene", "{\"sceneName\":%s}");
+ *   obsws_template_arg_t args[] = { { .string = "Replay" } };
+ *   obsws_send_template_async(conn, cut, args, 0, NULL, NULL, NULL);
+ */
+obsws_request_template_t* obsws_request_template_create(const char *request_type, const char *skeleton);
+
+/**
+ * Number of slots in a template - the length of the args array it takes.
+ */
+size_t obsws_request_template_slots(const obsws_request_template_t *tmpl);
+
+/**
+ * Free a template. Safe to call with NULL. Every send using it must have returned.
+ */
+void obsws_request_template_free(obsws_request_template_t *tmpl);
+
+/**
+ * obsws_send_request() from a template.
+ * 
+ * @param conn Connection handle (must be in CONNECTED state)
+ * @param tmpl Template from obsws_request_template_create()
+ * @param args One value per slot, in order (NULL if it has none)
+ * @param response Receives the response (free with obsws_response_free)
+ * @param timeout_ms Timeout in milliseconds (0 = default timeout)
+ * @return Same as obsws_send_request()
+ */
+obsws_error_t obsws_send_template(obsws_connection_t *conn, const obsws_request_template_t *tmpl,
+                                  const obsws_template_arg_t *args, obsws_response_t **response,
+                                  uint32_t timeout_ms);
+
+/**
+ * obsws_send_request_async() from a template. args are used up by the time
+ * this returns.
+ * 
+ * @return Same as obsws_send_request_async()
+ */
+obsws_error_t obsws_send_template_async(obsws_connection_t *conn, const obsws_request_template_t *tmpl,
+                                        const obsws_template_arg_t *args, uint32_t timeout_ms,
+                                        obsws_completion_callback_t callback, void *user_data,
+                                        obsws_future_t **future);
+
+/**
+ * Create an empty request batch.
+ * 
+ * Many requests travel in one RequestBatch message and come back in one
+ * response - one round trip instead of one per request. A batch isn't tied to
+ * a connection and isn't used up by sending it.
+ * 
+ * @param execution_type Serial (realtime or one per frame) or parallel
+ * @param halt_on_failure Stop at the first failed request (serial types only)
+ * @return New batch (free with obsws_batch_free), or NULL on bad type / out of memory
+ */
+obsws_batch_t* obsws_batch_create(obsws_batch_execution_t execution_type, bool halt_on_failure);
+
+/**
+ * Append a request to a batch.
+ * 
+ * Copies request_type and request_data. requestData is validated here, so a
+ * malformed payload is caught before anything is sent.
+ * 
+ * @param batch Batch from obsws_batch_create()
+ * @param request_type OBS request type name (e.g., "SetInputMute")
+ * @param request_data JSON string with request parameters, or NULL
+ * @return OBSWS_OK, OBSWS_ERROR_INVALID_PARAM (including malformed JSON) or
+ *         OBSWS_ERROR_OUT_OF_MEMORY
+ */
+obsws_error_t obsws_batch_add(obsws_batch_t *batch, const char *request_type, const char *request_data);
+
+/**
+ * Number of requests in a batch.
+ */
+size_t obsws_batch_count(const obsws_batch_t *batch);
+
+/**
+ * Free a batch. Safe to call with NULL.
+ */
+void obsws_batch_free(obsws_batch_t *batch);
+
+/**
+ * Render a batch as the JSON RequestBatch message (opcode 8) that
+ * obsws_send_batch() would send on a JSON connection.
+ * 
+ * @param batch Batch from obsws_batch_create() (not modified)
+ * @param request_id requestId for the envelope, or NULL for "batch"
+ * @return JSON text (free with free()), or NULL on NULL batch / out of memory
+ */
+char* obsws_batch_to_json(const obsws_batch_t *batch, const char *request_id);
+
+/**
+ * Send a batch as one message and wait for all its results.
+ * 
+ * @param conn Connection handle (must be in CONNECTED state)
+ * @param batch Batch with at least one request (not modified)
+ * @param result Receives per-request results, indexed like the batch
+ *        (free with obsws_batch_result_free)
+ * @param timeout_ms Timeout for the whole batch (0 = default timeout)
+ * @return OBSWS_OK once results arrived (check each response's success),
+ *         OBSWS_ERROR_TIMEOUT, OBSWS_ERROR_NOT_CONNECTED, OBSWS_ERROR_INVALID_PARAM
+ *         or OBSWS_ERROR_OUT_OF_MEMORY
+ * 
+ * @example Scene setup in one round trip:
+ *   obsws_batch_t *batch = obsws_batch_create(OBSWS_BATCH_SERIAL_REALTIME, true);
+ *   obsws_batch_add(batch, "SetCurrentProgramScene", "{\"sceneName\":\"Live\"}");
+ *   obsws_batch_add(batch, "SetInputMute", "{\"inputName\":\"Mic\",\"inputMuted\":false}");
+ *   obsws_batch_result_t *result = NULL;
+ *   if (obsws_send_batch(conn, batch, &result, 0) == OBSWS_OK) {
+ *       for (size_t i = 0; i < result->count; i++) {
+ *           printf("%zu: %s\n", i, result->responses[i].success ? "ok" : "failed");
+ *       }
+ *   }
+ *   obsws_batch_result_free(result);
+ *   obsws_batch_free(batch);
+ */
+obsws_error_t obsws_send_batch(obsws_connection_t *conn, const obsws_batch_t *batch,
+                               obsws_batch_result_t **result, uint32_t timeout_ms);
+
+/**
+ * Free a batch result and all its responses. Safe to call with NULL.
+ */
+void obsws_batch_result_free(obsws_batch_result_t *result);
+
+/**
+ * Check whether a future has completed, without blocking.
+ * 
+ * @param future Future from obsws_send_request_async()
+ * @return true once the request has completed, however it ended
+ */
+bool obsws_future_ready(obsws_future_t *future);
+
+/**
+ * Wait for a future to complete.
+ * 
+ * @param future Future from obsws_send_request_async()
+ * @param timeout_ms Longest to wait (0 = until the request completes or times out)
+ * @return OBSWS_OK once complete, OBSWS_ERROR_TIMEOUT if still pending (the
+ *         request carries on)
+ */
+obsws_error_t obsws_future_wait(obsws_future_t *future, uint32_t timeout_ms);
+
+/**
+ * Wait until any one of several futures completes.
+ * 
+ * @param futures Array of futures - may belong to different connections
+ * @param count Number of futures
+ * @param timeout_ms Longest to wait (0 = until one completes)
+ * @return Index of a completed future (the lowest if several are), or
+ *         OBSWS_ERROR_TIMEOUT / OBSWS_ERROR_INVALID_PARAM
+ */
+int obsws_future_wait_any(obsws_future_t *const *futures, size_t count, uint32_t timeout_ms);
+
+/**
+ * Wait until all of several futures have completed.
+ * 
+ * @param futures Array of futures - may belong to different connections
+ * @param count Number of futures
+ * @param timeout_ms Longest to wait (0 = until all complete)
+ * @return OBSWS_OK once all are complete, or OBSWS_ERROR_TIMEOUT / OBSWS_ERROR_INVALID_PARAM
+ */
+obsws_error_t obsws_future_wait_all(obsws_future_t *const *futures, size_t count, uint32_t timeout_ms);
+
+/**
+ * Get the outcome of a future, waiting for it to complete if need be.
+ * 
+ * @param future Future from obsws_send_request_async()
+ * @param response Receives the response (may be NULL) - owned by the future,
+ *        valid until obsws_future_free()
+ * @return OBSWS_OK if OBS answered (check response->success), otherwise the
+ *         error that ended the request
+ */
+obsws_error_t obsws_future_get(obsws_future_t *future, const obsws_response_t **response);
+
+/**
+ * Release a future and its response.
+ * 
+ * Safe on a future whose request is still in flight: the request carries on
+ * and its callback still runs. Safe to call with NULL.
+ * 
+ * @param future Future to release
+ */
+void obsws_future_free(obsws_future_t *future);
+
+/**
+ * Cancel an async request.
+ * 
+ * The request completes at once with OBSWS_ERROR_CANCELLED: waiters on the
+ * future wake up and the callback runs as for any other completion. If OBS
+ * has already been sent the request it may still run it; its response is
+ * dropped when it arrives. Requests coalesced onto this one aren't cancelled
+ * with it - they're sent on their own.
+ * 
+ * @param future Future from obsws_send_request_async()
+ * @return true if this call cancelled the request, false if it had already
+ *         completed (or future is NULL)
+ */
+bool obsws_cancel(obsws_future_t *future);
+
+/**
+ * Create a cancel token.
+ * 
+ * A token is handed to obsws_send_request_cancellable(); cancelling it from
+ * any thread ends every request sent with it at once, waking the callers
+ * blocked on them. A token stays cancelled - requests sent with it afterwards
+ * fail straight away.
+ * 
+ * @return New token (free with obsws_cancel_token_free), or NULL if out of memory
+ */
+obsws_cancel_token_t* obsws_cancel_token_create(void);
+
+/**
+ * Cancel every request sent with a token, now and from now on.
+ * 
+ * @param token Token from obsws_cancel_token_create() (NULL is a no-op)
+ */
+void obsws_cancel_token_cancel(obsws_cancel_token_t *token);
+
+/**
+ * Has this token been cancelled?
+ */
+bool obsws_cancel_token_is_cancelled(obsws_cancel_token_t *token);
+
+/**
+ * Free a cancel token. Every request sent with it must have returned.
+ * Safe to call with NULL.
+ */
+void obsws_cancel_token_free(obsws_cancel_token_t *token);
+
+/**
+ * obsws_send_request() that another thread can cut short.
+ * 
+ * @param conn Connection handle (must be in CONNECTED state)
+ * @param request_type OBS request type name (e.g., "GetSceneList")
+ * @param request_data JSON string with request parameters, or NULL
+ * @param response Receives the response, as with obsws_send_request()
+ * @param timeout_ms Timeout in milliseconds (0 = recv_timeout_ms)
+ * @param token Cancel token, or NULL (then this is obsws_send_request())
+ * @return As obsws_send_request(), plus OBSWS_ERROR_CANCELLED if the token
+ *         was cancelled before the response arrived
+ * 
+ * @example Abort a slow query from a UI thread:
+ *   obsws_cancel_token_t *token = obsws_cancel_token_create();
+ *   // worker thread:
+ *   obsws_response_t *response = NULL;
+ *   obsws_send_request_cancellable(conn, "GetSceneList", NULL, &response, 0, token);
+ *   obsws_response_free(response);
+ *   // UI thread, while the worker waits:
+ *   obsws_cancel_token_cancel(token);
+ */
+obsws_error_t obsws_send_request_cancellable(obsws_connection_t *conn, const char *request_type,
+                                             const char *request_data, obsws_response_t **response,
+                                             uint32_t timeout_ms, obsws_cancel_token_t *token);
+
 /* ============================================================================
  * Event Handling
  * ============================================================================ */
 
+/**
+ * Change which event categories OBS sends, without reconnecting.
+ * 
+ * Sends a Reidentify (opcode 3) with the new mask. The socket, the
+ * authenticated session and any in-flight requests are untouched; OBS
+ * confirms with an Identified message. The mask is kept for the connection, so
+ * an automatic reconnect identifies with it too.
+ * 
+ * @param conn Connection handle (must be in CONNECTED state)
+ * @param event_subscriptions Bitmask of OBSWS_EVENT_* flags (0 = no events)
+ * @return OBSWS_OK once queued, OBSWS_ERROR_NOT_CONNECTED if not connected,
+ *         OBSWS_ERROR_INVALID_PARAM if conn is NULL
+ * 
+ * @example Drop everything except scene changes:
+ *   obsws_reidentify(conn, OBSWS_EVENT_SCENES);
+ */
+obsws_error_t obsws_reidentify(obsws_connection_t *conn, uint32_t event_subscriptions);
+
 /**
  * Process pending events from the WebSocket connection.
  * 
@@ -1174,6 +1952,55 @@ obsws_error_t obsws_send_request(obsws_connection_t *conn, const char *request_t
  */
 int obsws_process_events(obsws_connection_t *conn, uint32_t timeout_ms);
 
+/**
+ * Get the file descriptors an external-loop connection needs watched.
+ * 
+ * Fills fds with up to max_fds entries (fd and events set, revents zeroed), ready
+ * to hand to poll(). The set changes over the connection's life - sockets come
+ * and go as the connection is (re)opened - so either fetch it fresh before each
+ * poll() or track changes through config.poll_callback.
+ * 
+ * @param conn Connection created with config.external_loop set
+ * @param fds Array to fill (may be NULL when max_fds is 0)
+ * @param max_fds Capacity of fds
+ * @return Total number of descriptors (may exceed max_fds), 0 if not in external-loop mode
+ */
+size_t obsws_get_pollfds(obsws_connection_t *conn, struct pollfd *fds, size_t max_fds);
+
+/**
+ * Service an external-loop connection.
+ * 
+ * Call this when one of the connection's descriptors reports events, passing
+ * the fd and its revents, or with fd = -1 when obsws_next_timeout() expires.
+ * Either way it also runs any timers that have come due. This is where
+ * responses are matched and event / state callbacks run.
+ * 
+ * Safe to call from any thread, but only one thread services a connection at
+ * a time - concurrent calls serialize.
+ * 
+ * @param conn Connection created with config.external_loop set
+ * @param fd Ready descriptor, or -1 for timer-only servicing
+ * @param revents poll() events reported for fd (ignored when fd is -1)
+ * @return OBSWS_OK, or OBSWS_ERROR_INVALID_PARAM if conn isn't in external-loop mode
+ */
+obsws_error_t obsws_service(obsws_connection_t *conn, int fd, short revents);
+
+/**
+ * How long an external loop may sleep before calling obsws_service(conn, -1, 0).
+ * 
+ * Accounts for keep-alive, request timeout and buffer housekeeping timers. Capped
+ * at one second so libwebsockets' own handshake and close timeouts are honoured.
+ * 
+ * @param conn Connection created with config.external_loop set
+ * @return Milliseconds to wait (0 = service now), or -1 if not in external-loop mode
+ * 
+ * @note Blocking calls such as obsws_send_request() still work in this mode:
+ *       they service the connection themselves while waiting, so calling them
+ *       from your loop thread doesn't deadlock. As in threaded mode, they must
+ *       not be called from inside a library callback.
+ */
+int obsws_next_timeout(obsws_connection_t *conn);
+
 /* ============================================================================
  * Utility Functions
  * ============================================================================ */
@@ -1197,6 +2024,77 @@ int obsws_process_events(obsws_connection_t *conn, uint32_t timeout_ms);
  */
 void obsws_response_free(obsws_response_t *response);
 
+/**
+ * Read a string out of a response's responseData.
+ * 
+ * pointer is an RFC 6901 JSON pointer into responseData: "" is the whole
+ * object, "/currentProgramSceneName" a top-level field, "/scenes/0/sceneName"
+ * the first scene's name ("~1" stands for '/' in a key, "~0" for '~').
+ * responseData is parsed on the first lookup and the tree kept with the
+ * response, so later lookups parse and copy nothing.
+ * 
+ * @param response Response from obsws_send_request() or a helper
+ * @param pointer JSON pointer into responseData
+ * @return The string, owned by the response and valid until it's freed, or
+ *         NULL if there's nothing there or it isn't a string
+ * 
+ * @note Like the rest of a response, not safe to use from two threads at
+ *       once - the first lookup builds the tree.
+ * 
+ * @example Reading one field:
+ *   obsws_send_request(conn, "GetCurrentProgramScene", NULL, &response, 0);
+ *   const char *scene = obsws_response_get_string(response, "/currentProgramSceneName");
+ */
+const char* obsws_response_get_string(const obsws_response_t *response, const char *pointer);
+
+/**
+ * Read a boolean out of a response's responseData.
+ * 
+ * @param response Response from obsws_send_request() or a helper
+ * @param pointer JSON pointer into responseData (see obsws_response_get_string())
+ * @param value Receives the value if found
+ * @return true if pointer names a boolean, false otherwise (value untouched)
+ */
+bool obsws_response_get_bool(const obsws_response_t *response, const char *pointer, bool *value);
+
+/**
+ * Read an integer out of a response's responseData.
+ * 
+ * @param response Response from obsws_send_request() or a helper
+ * @param pointer JSON pointer into responseData (see obsws_response_get_string())
+ * @param value Receives the value, truncated toward zero, if found
+ * @return true if pointer names a number, false otherwise (value untouched)
+ */
+bool obsws_response_get_int(const obsws_response_t *response, const char *pointer, int64_t *value);
+
+/**
+ * Read a number out of a response's responseData.
+ * 
+ * @param response Response from obsws_send_request() or a helper
+ * @param pointer JSON pointer into responseData (see obsws_response_get_string())
+ * @param value Receives the value if found
+ * @return true if pointer names a number, false otherwise (value untouched)
+ */
+bool obsws_response_get_double(const obsws_response_t *response, const char *pointer, double *value);
+
+/**
+ * Count the elements of an array in a response's responseData.
+ * 
+ * Use it to iterate with indexed pointers:
+ * 
+ *   size_t n = obsws_response_get_array_size(response, "/scenes");
+ *   for (size_t i = 0; i < n; i++) {
+ *       char ptr[64];
+ *       snprintf(ptr, sizeof(ptr), "/scenes/%zu/sceneName", i);
+ *       puts(obsws_response_get_string(response, ptr));
+ *   }
+ * 
+ * @param response Response from obsws_send_request() or a helper
+ * @param pointer JSON pointer into responseData (see obsws_response_get_string())
+ * @return Number of elements, or 0 if pointer doesn't name an array
+ */
+size_t obsws_response_get_array_size(const obsws_response_t *response, const char *pointer);
+
 /**
  * Get a human-readable string for an error code.
  * 
@@ -9,6 +9,7 @@
  * - Scene item transformations
  * - Multi-connection concurrency
  * - Error handling and edge cases
+ * - Request throughput benchmarks
  * 
  * Author: Aidan A. Bradley
  * Maintainer: Aidan A. Bradley
@@ -25,6 +26,7 @@
  *   --skip-multi             Skip multi-connection tests
  *   --skip-batch             Skip batch request tests
  *   --skip-transforms        Skip scene transformation tests
+ *   --skip-bench             Skip performance benchmarks
  *   --help                   Show this help message
  */
 
@@ -39,6 +41,8 @@
 #include <unistd.h>
 #include <math.h>
 #include <stdint.h>
+#include <cjson/cJSON.h>
+#include <stdatomic.h>
 
 /* ========================================================================
  * CONFIGURATION CONSTANTS
@@ -52,6 +56,7 @@
 #define NUM_BATCH_REQUESTS        5
 #define BATCH_REQUEST_SIZE        10
 #define MAX_TRANSFORM_ITERATIONS  8
+#define BENCH_ITERATIONS          200
 
 /* ========================================================================
  * GLOBAL TEST STATE AND STATISTICS
@@ -62,6 +67,7 @@ typedef struct {
     int tests_passed;
     int tests_failed;
     int events_received;
+    int custom_events_received;
     int state_changes;
     
     time_t test_start_time;
@@ -75,6 +81,7 @@ static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
 static int skip_multi_connection = 0;
 static int skip_batch_requests = 0;
 static int skip_transform_tests = 0;
+static int skip_benchmarks = 0;
 
 /* ========================================================================
  * CONNECTION STATE FOR MULTI-CONNECTION TESTS
@@ -92,6 +99,7 @@ typedef struct {
     const char *host;
     int port;
     const char *password;
+    obsws_reactor_t *reactor;    /* Shared reactor, or NULL for a dedicated thread */
 } connection_context_t;
 
 /* ========================================================================
@@ -108,6 +116,16 @@ static void sleep_ms(int milliseconds) {
     nanosleep(&ts, NULL);
 }
 
+/**
+ * Thread body: cancel a token a little later, while another thread is blocked
+ * on a request that carries it
+ */
+static void* cancel_token_later(void *arg) {
+    sleep_ms(5);
+    obsws_cancel_token_cancel((obsws_cancel_token_t *)arg);
+    return NULL;
+}
+
 /**
  * Get current timestamp as formatted string
  */
@@ -176,6 +194,9 @@ static void unified_event_callback(obsws_connection_t *conn, const char *event_t
     
     pthread_mutex_lock(&stats_mutex);
     global_stats.events_received++;
+    if (strcmp(event_type, "CustomEvent") == 0) {
+        global_stats.custom_events_received++;
+    }
     pthread_mutex_unlock(&stats_mutex);
     
     int conn_id = (intptr_t)user_data;
@@ -209,6 +230,13 @@ static void unified_state_callback(obsws_connection_t *conn, obsws_state_t old_s
     }
 }
 
+/* Completion callback for the async request test - counts completions */
+static void async_count_callback(obsws_error_t error, const obsws_response_t *response, void *user_data) {
+    (void)error;
+    (void)response;
+    atomic_fetch_add((atomic_int *)user_data, 1);
+}
+
 /**
  * Wait for connection to be established with timeout
  */
@@ -223,6 +251,50 @@ static int wait_for_connection(obsws_connection_t *conn, int timeout_ms) {
     return 0;
 }
 
+/**
+ * CustomEvents the main connection's event callback has seen so far
+ */
+static int custom_events_received(void) {
+    pthread_mutex_lock(&stats_mutex);
+    int count = global_stats.custom_events_received;
+    pthread_mutex_unlock(&stats_mutex);
+    return count;
+}
+
+/**
+ * Broadcast a CustomEvent (General category) and give it time to come back
+ */
+static obsws_error_t broadcast_custom_event(obsws_connection_t *conn) {
+    obsws_response_t *response = NULL;
+    obsws_error_t err = obsws_send_request(conn, "BroadcastCustomEvent",
+                                           "{\"eventData\":{\"source\":\"libwsv5 test\"}}", &response, 0);
+    if (err == OBSWS_OK && !(response && response->success)) {
+        err = OBSWS_ERROR_UNKNOWN;
+    }
+    if (response) obsws_response_free(response);
+    sleep_ms(300);
+    return err;
+}
+
+/**
+ * Open a second connection with a variant of the main config - no event
+ * callback, so its events don't show up in the main connection's counts - and
+ * report whether it came up. Returns NULL (having cleaned up) if it didn't.
+ */
+static obsws_connection_t* connect_variant(obsws_config_t *cfg, const char *label) {
+    char test_name[128];
+    cfg->event_callback = NULL;
+    obsws_connection_t *variant = obsws_connect(cfg);
+    int connected = variant && wait_for_connection(variant, 10000);
+    snprintf(test_name, sizeof(test_name), "%s connection established", label);
+    print_test_result(test_name, connected);
+    if (!connected && variant) {
+        obsws_disconnect(variant);
+        variant = NULL;
+    }
+    return variant;
+}
+
 /**
  * Print usage information
  */
@@ -239,6 +311,7 @@ static void print_usage(const char *program_name) {
     printf("  --skip-multi           Skip multi-connection concurrency tests\n");
     printf("  --skip-batch           Skip batch request tests\n");
     printf("  --skip-transforms      Skip scene transformation tests\n");
+    printf("  --skip-bench           Skip performance benchmarks\n");
     printf("  --help                 Show this help message\n\n");
     printf("Examples:\n");
     printf("  %s --host 192.168.1.32 --password mypass\n", program_name);
@@ -290,6 +363,53 @@ static int test_library_initialization(void) {
     return 1;
 }
 
+/* Encode a batch for every execution type and halt flag - no OBS needed -
+   and check each frame parses as one JSON object carrying what was set */
+static int test_batch_encoding(void) {
+    static const obsws_batch_execution_t types[] = {
+        OBSWS_BATCH_SERIAL_REALTIME, OBSWS_BATCH_SERIAL_FRAME, OBSWS_BATCH_PARALLEL
+    };
+    int all_ok = 1;
+    
+    for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+        for (int halt = 0; halt <= 1; halt++) {
+            obsws_batch_t *batch = obsws_batch_create(types[t], halt != 0);
+            int ok = batch &&
+                     obsws_batch_add(batch, "GetVersion", NULL) == OBSWS_OK &&
+                     obsws_batch_add(batch, "SetInputMute",
+                                     "{\"inputName\":\"Mic\",\"inputMuted\":true}") == OBSWS_OK;
+            
+            char *json = ok ? obsws_batch_to_json(batch, "b1") : NULL;
+            cJSON *root = json ? cJSON_ParseWithLength(json, strlen(json)) : NULL;
+            cJSON *d = cJSON_GetObjectItemCaseSensitive(root, "d");
+            cJSON *op = cJSON_GetObjectItemCaseSensitive(root, "op");
+            cJSON *halt_item = cJSON_GetObjectItemCaseSensitive(d, "haltOnFailure");
+            cJSON *type_item = cJSON_GetObjectItemCaseSensitive(d, "executionType");
+            cJSON *id = cJSON_GetObjectItemCaseSensitive(d, "requestId");
+            cJSON *requests = cJSON_GetObjectItemCaseSensitive(d, "requests");
+            
+            ok = cJSON_IsObject(root) &&
+                 cJSON_IsNumber(op) && op->valueint == 8 &&
+                 cJSON_IsBool(halt_item) && cJSON_IsTrue(halt_item) == (halt != 0) &&
+                 cJSON_IsNumber(type_item) && type_item->valueint == (int)types[t] &&
+                 cJSON_IsString(id) && strcmp(id->valuestring, "b1") == 0 &&
+                 cJSON_IsArray(requests) && cJSON_GetArraySize(requests) == 2;
+            if (!ok) {
+                printf("  Bad frame (executionType %d, haltOnFailure %d): %s\n",
+                       (int)types[t], halt, json ? json : "(none)");
+                all_ok = 0;
+            }
+            
+            cJSON_Delete(root);
+            free(json);
+            obsws_batch_free(batch);
+        }
+    }
+    
+    print_test_result("obsws_batch_to_json() - one valid object per execution type and halt flag", all_ok);
+    return all_ok;
+}
+
 /* ========================================================================
  * SECTION 2: SINGLE CONNECTION TESTS
  * ======================================================================== */
@@ -426,6 +546,474 @@ static int test_single_connection(const char *obs_host, int obs_port, const char
     if (response) obsws_response_free(response);
     sleep_ms(500);
     
+    /* Test: Reidentify narrows then restores event subscriptions on the live
+       session - a General-category CustomEvent stops arriving, then returns */
+    err = obsws_reidentify(conn, OBSWS_EVENT_SCENES);
+    int reidentify_ok = (err == OBSWS_OK);
+    sleep_ms(200);
+    int custom_before = custom_events_received();
+    obsws_error_t broadcast_err = broadcast_custom_event(conn);
+    print_test_result("obsws_reidentify(OBSWS_EVENT_SCENES) - CustomEvent no longer delivered",
+                      reidentify_ok && broadcast_err == OBSWS_OK && custom_events_received() == custom_before);
+    err = obsws_reidentify(conn, OBSWS_EVENT_ALL);
+    reidentify_ok = reidentify_ok && err == OBSWS_OK;
+    sleep_ms(200);
+    broadcast_err = broadcast_custom_event(conn);
+    print_test_result("obsws_reidentify(OBSWS_EVENT_ALL) - CustomEvent delivered again",
+                      broadcast_err == OBSWS_OK && custom_events_received() > custom_before);
+    response = NULL;
+    err = obsws_send_request(conn, "GetVersion", NULL, &response, 0);
+    print_test_result("obsws_reidentify() keeps the session usable",
+                      reidentify_ok && err == OBSWS_OK && response && response->success &&
+                      obsws_is_connected(conn));
+    if (response) obsws_response_free(response);
+
+    /* Test: Async requests - fan out, then collect with futures and a callback */
+    {
+        static const char *const async_types[] = { "GetVersion", "GetSceneList", "GetStats", "GetInputList" };
+        obsws_future_t *futures[4] = {0};
+        static atomic_int async_callbacks;
+        atomic_store(&async_callbacks, 0);
+        int async_sent = 1;
+        for (int i = 0; i < 4; i++) {
+            err = obsws_send_request_async(conn, async_types[i], NULL, 0,
+                                           async_count_callback, &async_callbacks, &futures[i]);
+            async_sent = async_sent && err == OBSWS_OK;
+        }
+        print_test_result("obsws_send_request_async() x4", async_sent);
+        
+        int first = obsws_future_wait_any(futures, 4, 5000);
+        print_test_result("obsws_future_wait_any()", first >= 0 && first < 4);
+        
+        int async_ok = obsws_future_wait_all(futures, 4, 5000) == OBSWS_OK;
+        for (int i = 0; i < 4; i++) {
+            const obsws_response_t *async_response = NULL;
+            async_ok = async_ok && obsws_future_get(futures[i], &async_response) == OBSWS_OK &&
+                       async_response && async_response->success;
+            obsws_future_free(futures[i]);
+        }
+        print_test_result("obsws_future_wait_all() - all responses successful", async_ok);
+        /* Futures become ready just before their callbacks run - give them a moment */
+        for (int i = 0; i < 20 && atomic_load(&async_callbacks) < 4; i++) {
+            sleep_ms(50);
+        }
+        print_test_result("Completion callback ran once per request", atomic_load(&async_callbacks) == 4);
+    }
+
+    /* Test: Request batch - three requests in one round trip, results in order */
+    {
+        obsws_batch_t *batch = obsws_batch_create(OBSWS_BATCH_SERIAL_REALTIME, true);
+        int batch_built = batch &&
+                          obsws_batch_add(batch, "GetVersion", NULL) == OBSWS_OK &&
+                          obsws_batch_add(batch, "GetSceneList", NULL) == OBSWS_OK &&
+                          obsws_batch_add(batch, "GetStats", "{}") == OBSWS_OK &&
+                          obsws_batch_add(batch, "GetStats", "{broken") == OBSWS_ERROR_INVALID_PARAM;
+        print_test_result("obsws_batch_add() - 3 requests, malformed data rejected",
+                          batch_built && obsws_batch_count(batch) == 3);
+        
+        obsws_batch_result_t *batch_result = NULL;
+        err = obsws_send_batch(conn, batch, &batch_result, 0);
+        int batch_ok = err == OBSWS_OK && batch_result && batch_result->count == 3 &&
+                       batch_result->executed == 3;
+        for (size_t i = 0; batch_ok && i < batch_result->count; i++) {
+            batch_ok = batch_result->responses[i].success;
+        }
+        print_test_result("obsws_send_batch() - all results back and successful", batch_ok);
+        print_test_result("Batch results demultiplexed in order",
+                          batch_ok && batch_result->responses[0].response_data &&
+                          strstr(batch_result->responses[0].response_data, "\"obsWebSocketVersion\""));
+        obsws_batch_result_free(batch_result);
+        obsws_batch_free(batch);
+    }
+
+    /* Test: Same requests over the obswebsocket.msgpack subprotocol */
+    obsws_config_t mp_config = config;
+    mp_config.msgpack = true;
+    obsws_connection_t *mp_conn = connect_variant(&mp_config, "MessagePack");
+    if (mp_conn) {
+        print_test_result("obsws_is_msgpack() - subprotocol negotiated", obsws_is_msgpack(mp_conn));
+        print_test_result("obsws_is_msgpack() - false on a JSON connection", !obsws_is_msgpack(conn));
+        
+        response = NULL;
+        err = obsws_send_request(mp_conn, "GetVersion", NULL, &response, 0);
+        int mp_version_ok = (err == OBSWS_OK && response && response->success &&
+                             response->response_data && strstr(response->response_data, "\"obsWebSocketVersion\""));
+        print_test_result("GetVersion over MessagePack", mp_version_ok);
+        if (response) obsws_response_free(response);
+    
+        char mp_scene[256] = {0};
+        err = obsws_get_current_scene(mp_conn, mp_scene, sizeof(mp_scene));
+        print_test_result("obsws_get_current_scene() over MessagePack",
+                          err == OBSWS_OK && strcmp(mp_scene, current_scene) == 0);
+    
+        response = NULL;
+        err = obsws_set_current_scene(mp_conn, current_scene, &response);
+        print_test_result("obsws_set_current_scene() over MessagePack",
+                          err == OBSWS_OK && response && response->success);
+        if (response) obsws_response_free(response);
+    }
+    if (mp_conn) {
+        obsws_disconnect(mp_conn);
+    }
+    sleep_ms(500);
+
+    /* Test: Identical reads in flight together share one round trip */
+    obsws_config_t co_config = config;
+    co_config.coalesce_reads = true;
+    obsws_connection_t *co_conn = connect_variant(&co_config, "Coalescing");
+    if (co_conn) {
+        obsws_future_t *futures[4] = {0};
+        int co_ok = 1;
+        for (int i = 0; i < 4; i++) {
+            co_ok = co_ok && obsws_send_request_async(co_conn, "GetSceneList", NULL, 0,
+                                                      NULL, NULL, &futures[i]) == OBSWS_OK;
+        }
+        co_ok = co_ok && obsws_future_wait_all(futures, 4, 5000) == OBSWS_OK;
+        for (int i = 0; i < 4; i++) {
+            const obsws_response_t *co_response = NULL;
+            co_ok = co_ok && obsws_future_get(futures[i], &co_response) == OBSWS_OK &&
+                    co_response && co_response->success && co_response->response_data &&
+                    strstr(co_response->response_data, "\"scenes\"");
+            obsws_future_free(futures[i]);
+        }
+        obsws_stats_t co_stats;
+        obsws_get_stats(co_conn, &co_stats);
+        print_test_result("coalesce_reads - 4 identical GetSceneList, each with a response",
+                          co_ok && co_stats.requests_coalesced > 0);
+
+        /* A screenshot takes OBS a while to encode - long enough for a second
+           identical request, started later with a later deadline, to join it */
+        char shot_data[512];
+        snprintf(shot_data, sizeof(shot_data),
+                 "{\"sourceName\":\"%s\",\"imageFormat\":\"png\"}", current_scene);
+        obsws_future_t *first = NULL, *second = NULL;
+        uint64_t coalesced_before = co_stats.requests_coalesced;
+        int late_ok = obsws_send_request_async(co_conn, "GetSourceScreenshot", shot_data, 0,
+                                               NULL, NULL, &first) == OBSWS_OK;
+        sleep_ms(2);
+        late_ok = late_ok && obsws_send_request_async(co_conn, "GetSourceScreenshot", shot_data, 0,
+                                                      NULL, NULL, &second) == OBSWS_OK;
+        late_ok = late_ok && obsws_future_wait(first, 5000) == OBSWS_OK &&
+                  obsws_future_wait(second, 5000) == OBSWS_OK;
+        obsws_future_free(first);
+        obsws_future_free(second);
+        obsws_get_stats(co_conn, &co_stats);
+        print_test_result("coalesce_reads - request started after the first is in flight joins it",
+                          late_ok && co_stats.requests_coalesced == coalesced_before + 1);
+    }
+    if (co_conn) {
+        obsws_disconnect(co_conn);
+    }
+    sleep_ms(500);
+
+    /* Test: In-flight window - a burst past max_in_flight is turned away, not piled onto OBS */
+    obsws_config_t win_config = config;
+    win_config.max_in_flight = 4;
+    win_config.window_policy = OBSWS_WINDOW_FAIL;
+    obsws_connection_t *win_conn = connect_variant(&win_config, "Windowed");
+    if (win_conn) {
+        /* Screenshots keep OBS busy long enough that the burst is sure to
+           fill the window and have the rest turned away */
+        char win_shot[512];
+        snprintf(win_shot, sizeof(win_shot),
+                 "{\"sourceName\":\"%s\",\"imageFormat\":\"png\"}", current_scene);
+        obsws_future_t *futures[16] = {0};
+        int accepted = 0, rejected = 0;
+        for (int i = 0; i < 16; i++) {
+            err = obsws_send_request_async(win_conn, "GetSourceScreenshot", win_shot, 0, NULL, NULL, &futures[accepted]);
+            if (err == OBSWS_OK) {
+                accepted++;
+            } else if (err == OBSWS_ERROR_WINDOW_FULL) {
+                rejected++;
+            }
+        }
+        int win_ok = accepted + rejected == 16 && accepted >= 4 && rejected > 0 &&
+                     obsws_future_wait_all(futures, accepted, 10000) == OBSWS_OK;
+        for (int i = 0; i < accepted; i++) {
+            obsws_future_free(futures[i]);
+        }
+        obsws_stats_t win_stats;
+        obsws_get_stats(win_conn, &win_stats);
+        print_test_result("max_in_flight = 4 - burst of 16 fills the window and no more",
+                          win_ok && win_stats.in_flight_peak == 4 &&
+                          win_stats.window_rejections == (uint64_t)rejected);
+    }
+    if (win_conn) {
+        obsws_disconnect(win_conn);
+    }
+    sleep_ms(500);
+
+    /* Test: Cancellation - a cancelled request ends at once and its late
+       response doesn't disturb the next one */
+    {
+        obsws_stats_t cancel_before, cancel_after;
+        obsws_get_stats(conn, &cancel_before);
+        obsws_future_t *future = NULL;
+        err = obsws_send_request_async(conn, "GetSceneList", NULL, 0, NULL, NULL, &future);
+        int cancel_ok = err == OBSWS_OK;
+        bool cancelled = false;
+        if (cancel_ok) {
+            /* Wait for it to be written, so OBS is sure to answer it */
+            for (int i = 0; i < 1000; i++) {
+                obsws_get_stats(conn, &cancel_after);
+                if (cancel_after.messages_sent > cancel_before.messages_sent) break;
+                sleep_ms(1);
+            }
+            /* OBS may have answered already on a fast machine - then there's nothing to cancel */
+            cancelled = obsws_cancel(future);
+            err = obsws_future_get(future, NULL);
+            cancel_ok = cancelled ? err == OBSWS_ERROR_CANCELLED && !obsws_cancel(future) : err == OBSWS_OK;
+            obsws_future_free(future);
+        }
+        print_test_result("obsws_cancel() - async request ends with OBSWS_ERROR_CANCELLED", cancel_ok);
+        if (cancelled) {
+            sleep_ms(500);
+            obsws_get_stats(conn, &cancel_after);
+            print_test_result("Late response to the cancelled request counted in late_responses",
+                              cancel_after.late_responses > cancel_before.late_responses);
+        }
+        
+        /* A token cancelled from another thread wakes the caller blocked on it */
+        char shot_data[512];
+        snprintf(shot_data, sizeof(shot_data),
+                 "{\"sourceName\":\"%s\",\"imageFormat\":\"png\"}", current_scene);
+        obsws_cancel_token_t *blocked_token = obsws_cancel_token_create();
+        pthread_t canceller;
+        int thread_ok = blocked_token &&
+                        pthread_create(&canceller, NULL, cancel_token_later, blocked_token) == 0;
+        response = NULL;
+        err = thread_ok ? obsws_send_request_cancellable(conn, "GetSourceScreenshot", shot_data,
+                                                         &response, 10000, blocked_token)
+                        : OBSWS_ERROR_OUT_OF_MEMORY;
+        if (thread_ok) {
+            pthread_join(canceller, NULL);
+        }
+        /* The screenshot usually takes longer than the cancel; if not, it simply succeeded */
+        print_test_result("Token cancelled by another thread wakes obsws_send_request_cancellable()",
+                          thread_ok && (err == OBSWS_ERROR_CANCELLED || (err == OBSWS_OK && response && response->success)));
+        if (response) obsws_response_free(response);
+        obsws_cancel_token_free(blocked_token);
+        sleep_ms(500);
+        
+        obsws_cancel_token_t *token = obsws_cancel_token_create();
+        obsws_cancel_token_cancel(token);
+        response = NULL;
+        err = obsws_send_request_cancellable(conn, "GetVersion", NULL, &response, 0, token);
+        print_test_result("Cancelled token fails obsws_send_request_cancellable() up front",
+                          err == OBSWS_ERROR_CANCELLED && obsws_cancel_token_is_cancelled(token));
+        if (response) obsws_response_free(response);
+        obsws_cancel_token_free(token);
+        
+        response = NULL;
+        err = obsws_send_request(conn, "GetVersion", NULL, &response, 0);
+        print_test_result("Requests after a cancel still get their own response",
+                          err == OBSWS_OK && response && response->success);
+        if (response) obsws_response_free(response);
+    }
+
+    /* Test: Priority lanes - a bulk burst goes out in its own lane and a
+       realtime scene switch still gets through */
+    {
+        obsws_stats_t before, after;
+        obsws_get_stats(conn, &before);
+        err = obsws_set_request_priority(conn, "GetSceneList", OBSWS_PRIORITY_BULK);
+        print_test_result("obsws_set_request_priority() - GetSceneList to bulk", err == OBSWS_OK);
+        err = obsws_set_request_priority(conn, "SetCurrentProgramScene", OBSWS_PRIORITY_REALTIME);
+        print_test_result("obsws_set_request_priority() - SetCurrentProgramScene to realtime", err == OBSWS_OK);
+        
+        obsws_future_t *futures[8] = {0};
+        int sent = 0;
+        for (int i = 0; i < 8; i++) {
+            if (obsws_send_request_async(conn, "GetSceneList", NULL, 0, NULL, NULL, &futures[sent]) == OBSWS_OK) {
+                sent++;
+            }
+        }
+        char lane_scene[256];
+        int rt_ok = obsws_get_current_scene(conn, lane_scene, sizeof(lane_scene)) == OBSWS_OK &&
+                    obsws_set_current_scene(conn, lane_scene, NULL) == OBSWS_OK;
+        int bulk_ok = sent == 8 && obsws_future_wait_all(futures, sent, 5000) == OBSWS_OK;
+        for (int i = 0; i < sent; i++) {
+            obsws_future_free(futures[i]);
+        }
+        print_test_result("Realtime SetCurrentProgramScene during a bulk burst", rt_ok);
+        
+        obsws_get_stats(conn, &after);
+        print_test_result("Lane stats count the bulk and realtime messages",
+                          bulk_ok &&
+                          after.lane_frames_sent[OBSWS_PRIORITY_BULK] - before.lane_frames_sent[OBSWS_PRIORITY_BULK] == 8 &&
+                          after.lane_frames_sent[OBSWS_PRIORITY_REALTIME] > before.lane_frames_sent[OBSWS_PRIORITY_REALTIME]);
+        obsws_set_request_priority(conn, "GetSceneList", OBSWS_PRIORITY_NORMAL);
+        obsws_set_request_priority(conn, "SetCurrentProgramScene", OBSWS_PRIORITY_NORMAL);
+    }
+
+    /* Test: Request templates - a compiled request gets the same answer as the plain one */
+    {
+        char tmpl_scene[256];
+        obsws_request_template_t *items = obsws_request_template_create("GetSceneItemList", "{\"sceneName\":%s}");
+        print_test_result("obsws_request_template_create() - one string slot",
+                          items && obsws_request_template_slots(items) == 1);
+        print_test_result("obsws_request_template_create() rejects a bad skeleton",
+                          obsws_request_template_create("GetSceneItemList", "{\"sceneName\":%q}") == NULL);
+        
+        if (items && obsws_get_current_scene(conn, tmpl_scene, sizeof(tmpl_scene)) == OBSWS_OK) {
+            obsws_template_arg_t args[] = { { .string = tmpl_scene } };
+            obsws_response_t *tmpl_response = NULL;
+            err = obsws_send_template(conn, items, args, &tmpl_response, 0);
+            
+            char plain_data[512];
+            snprintf(plain_data, sizeof(plain_data), "{\"sceneName\":\"%s\"}", tmpl_scene);
+            response = NULL;
+            obsws_error_t plain_err = obsws_send_request(conn, "GetSceneItemList", plain_data, &response, 0);
+            print_test_result("obsws_send_template() - same response as obsws_send_request()",
+                              err == OBSWS_OK && plain_err == OBSWS_OK && tmpl_response && response &&
+                              tmpl_response->success && response->success &&
+                              tmpl_response->response_data && response->response_data &&
+                              strcmp(tmpl_response->response_data, response->response_data) == 0);
+            if (tmpl_response) obsws_response_free(tmpl_response);
+            if (response) obsws_response_free(response);
+        }
+        obsws_request_template_free(items);
+    }
+
+    /* Test: Raw and cJSON requestData - passed through without a second check */
+    {
+        static const char raw_data[] = "{\"sceneName\":\"\"}trailing bytes not sent";
+        response = NULL;
+        err = obsws_send_request_raw(conn, "GetSceneItemList", raw_data, strlen("{\"sceneName\":\"\"}"),
+                                     &response, 0);
+        print_test_result("obsws_send_request_raw() - length-bounded payload",
+                          err == OBSWS_OK && response != NULL);
+        if (response) obsws_response_free(response);
+        
+        response = NULL;
+        err = obsws_send_request_raw(conn, "GetVersion", NULL, 0, &response, 0);
+        print_test_result("obsws_send_request_raw() - no requestData",
+                          err == OBSWS_OK && response && response->success);
+        if (response) obsws_response_free(response);
+        
+        cJSON *cjson_data = cJSON_CreateObject();
+        cJSON_AddStringToObject(cjson_data, "sceneName", current_scene);
+        response = NULL;
+        err = obsws_send_request_cjson(conn, "GetSceneItemList", cjson_data, &response, 0);
+        print_test_result("obsws_send_request_cjson() - takes the tree and sends it",
+                          err == OBSWS_OK && response && response->success);
+        if (response) obsws_response_free(response);
+    }
+
+    /* Test: Response accessors - JSON pointers into the kept responseData */
+    {
+        response = NULL;
+        err = obsws_send_request(conn, "GetCurrentProgramScene", NULL, &response, 0);
+        const char *pointer_scene = response ? obsws_response_get_string(response, "/currentProgramSceneName") : NULL;
+        char helper_scene[256] = "";
+        obsws_get_current_scene(conn, helper_scene, sizeof(helper_scene));
+        print_test_result("obsws_response_get_string() - matches obsws_get_current_scene()",
+                          err == OBSWS_OK && pointer_scene && strcmp(pointer_scene, helper_scene) == 0);
+        print_test_result("obsws_response_get_string() - missing field is NULL",
+                          response && obsws_response_get_string(response, "/noSuchField") == NULL);
+        if (response) obsws_response_free(response);
+        
+        response = NULL;
+        err = obsws_send_request(conn, "GetSceneList", NULL, &response, 0);
+        char **list = NULL;
+        size_t list_count = 0;
+        obsws_get_scene_list(conn, &list, &list_count);
+        size_t n = response ? obsws_response_get_array_size(response, "/scenes") : 0;
+        int names_match = err == OBSWS_OK && n == list_count;
+        for (size_t i = 0; names_match && i < n; i++) {
+            char pointer[64];
+            snprintf(pointer, sizeof(pointer), "/scenes/%zu/sceneName", i);
+            const char *name = obsws_response_get_string(response, pointer);
+            names_match = name && strcmp(name, list[i]) == 0;
+        }
+        print_test_result("obsws_response_get_array_size() - iterates the scene list", names_match);
+        obsws_free_scene_list(list, list_count);
+        if (response) obsws_response_free(response);
+        
+        bool active = true;
+        response = NULL;
+        err = obsws_send_request(conn, "GetRecordStatus", NULL, &response, 0);
+        print_test_result("obsws_response_get_bool() - reads outputActive",
+                          err == OBSWS_OK && response && obsws_response_get_bool(response, "/outputActive", &active) &&
+                          !obsws_response_get_bool(response, "/outputTimecode", &active));
+        if (response) obsws_response_free(response);
+    }
+
+    /* Test: No library thread - this thread drives the connection itself */
+    obsws_config_t ext_config = config;
+    ext_config.external_loop = true;
+    obsws_connection_t *ext_conn = connect_variant(&ext_config, "External event loop");
+    if (ext_conn) {
+        struct pollfd ext_fds[8];
+        size_t ext_nfds = obsws_get_pollfds(ext_conn, ext_fds, 8);
+        print_test_result("obsws_get_pollfds() reports socket and wake pipe", ext_nfds >= 2);
+        print_test_result("obsws_next_timeout() within bounds",
+                          obsws_next_timeout(ext_conn) >= 0 && obsws_next_timeout(ext_conn) <= 1000);
+
+        response = NULL;
+        err = obsws_send_request(ext_conn, "GetVersion", NULL, &response, 0);
+        print_test_result("GetVersion over external event loop",
+                          err == OBSWS_OK && response && response->success);
+        if (response) obsws_response_free(response);
+
+        /* No event_callback here, so a CustomEvent has no consumer and is
+           dropped after the envelope pre-scan */
+        response = NULL;
+        err = obsws_send_request(ext_conn, "BroadcastCustomEvent",
+                                 "{\"eventData\":{\"source\":\"libwsv5 test\"}}", &response, 0);
+        if (response) obsws_response_free(response);
+        obsws_stats_t ext_stats = {0};
+        for (int i = 0; i < 10 && ext_stats.events_dropped == 0; i++) {
+            obsws_process_events(ext_conn, 100);
+            obsws_get_stats(ext_conn, &ext_stats);
+        }
+        print_test_result("Unconsumed event dropped after pre-scan",
+                          err == OBSWS_OK && ext_stats.events_dropped >= 1);
+    }
+    if (ext_conn) {
+        obsws_disconnect(ext_conn);
+    }
+    sleep_ms(500);
+
+    /* Test: Manual reconnect drops the socket and re-identifies */
+    obsws_config_t rc_config = config;
+    obsws_connection_t *rc_conn = connect_variant(&rc_config, "Reconnect test");
+    int rc_connected = rc_conn != NULL;
+    obsws_future_t *rc_future = NULL;
+    if (rc_connected) {
+        /* A screenshot is still being encoded when the socket goes, so it's
+           in flight across the reconnect - as a Get* it's replayed */
+        char rc_shot[512];
+        snprintf(rc_shot, sizeof(rc_shot),
+                 "{\"sourceName\":\"%s\",\"imageFormat\":\"png\"}", current_scene);
+        obsws_send_request_async(rc_conn, "GetSourceScreenshot", rc_shot, 10000, NULL, NULL, &rc_future);
+        err = obsws_reconnect(rc_conn);
+        sleep_ms(500);
+        rc_connected = (err == OBSWS_OK) && wait_for_connection(rc_conn, 10000);
+        obsws_stats_t rc_stats;
+        obsws_get_stats(rc_conn, &rc_stats);
+        rc_connected = rc_connected && rc_stats.reconnect_count >= 1;
+    }
+    print_test_result("obsws_reconnect() re-establishes the session", rc_connected);
+    if (rc_conn) {
+        const obsws_response_t *rc_response = NULL;
+        print_test_result("Request in flight across the reconnect completes with OBSWS_OK",
+                          rc_future && obsws_future_wait(rc_future, 10000) == OBSWS_OK &&
+                          obsws_future_get(rc_future, &rc_response) == OBSWS_OK &&
+                          rc_response && rc_response->success);
+        obsws_future_free(rc_future);
+    }
+    if (rc_connected) {
+        response = NULL;
+        err = obsws_send_request(rc_conn, "GetVersion", NULL, &response, 0);
+        print_test_result("GetVersion after reconnect", err == OBSWS_OK && response && response->success);
+        if (response) obsws_response_free(response);
+    }
+    if (rc_conn) {
+        obsws_disconnect(rc_conn);
+    }
+    sleep_ms(500);
+
     /* Store connection for later tests */
     extern obsws_connection_t *g_main_connection;
     g_main_connection = conn;
@@ -920,6 +1508,20 @@ static int test_all_library_functions(void) {
         printf("  Network latency: %d ms\n", ping_result);
     }
     
+    /* The pong should have landed in the RTT stats as well */
+    obsws_stats_t rtt_stats;
+    bool rtt_ok = ping_ok && obsws_get_stats(g_main_connection, &rtt_stats) == OBSWS_OK &&
+                  rtt_stats.last_rtt_us > 0 &&
+                  rtt_stats.rtt_min_us <= rtt_stats.rtt_mean_us &&
+                  rtt_stats.rtt_mean_us <= rtt_stats.rtt_max_us;
+    print_test_result("Ping RTT recorded in stats", rtt_ok);
+    if (rtt_ok) {
+        printf("  RTT: last %lu us, mean %lu us, min %lu us, max %lu us, jitter %lu us\n",
+               (unsigned long)rtt_stats.last_rtt_us, (unsigned long)rtt_stats.rtt_mean_us,
+               (unsigned long)rtt_stats.rtt_min_us, (unsigned long)rtt_stats.rtt_max_us,
+               (unsigned long)rtt_stats.rtt_jitter_us);
+    }
+    
     printf("\n  >>> RECORDING/STREAMING STATUS TESTS <<<\n");
     /* Test: Get recording status */
     bool is_recording = false;
@@ -1016,6 +1618,7 @@ static void* concurrent_connection_worker(void *arg) {
     config.send_timeout_ms = 5000;
     config.auto_reconnect = false;
     config.ping_interval_ms = 20000;
+    config.reactor = ctx->reactor;
     
     /* Connect */
     ctx->conn = obsws_connect(&config);
@@ -1121,6 +1724,44 @@ static int test_multi_connection_concurrency(const char *obs_host, int obs_port,
     
     print_test_result("Multi-connection concurrency test", all_ok);
     
+    /* Same workload again, with every connection sharing a two-thread reactor */
+    obsws_reactor_t *reactor = obsws_reactor_create(2);
+    print_test_result("obsws_reactor_create()", reactor != NULL);
+    if (!reactor) {
+        return 1;
+    }
+    
+    printf("\nCreating %d concurrent connections on a shared reactor...\n", NUM_CONCURRENT_CONNS);
+    memset(contexts, 0, sizeof(contexts));
+    for (int i = 0; i < NUM_CONCURRENT_CONNS; i++) {
+        contexts[i].conn_id = i + 1;
+        contexts[i].host = obs_host;
+        contexts[i].port = obs_port;
+        contexts[i].password = obs_password;
+        contexts[i].reactor = reactor;
+        
+        pthread_create(&contexts[i].thread_id, NULL, concurrent_connection_worker, &contexts[i]);
+    }
+    
+    for (int i = 0; i < NUM_CONCURRENT_CONNS; i++) {
+        pthread_join(contexts[i].thread_id, NULL);
+    }
+    
+    all_ok = 1;
+    for (int i = 0; i < NUM_CONCURRENT_CONNS; i++) {
+        printf("  [CONN %d] Status: %s | Commands: %d/%d successful\n",
+               contexts[i].conn_id, contexts[i].status,
+               contexts[i].commands_successful, contexts[i].commands_sent);
+        if (contexts[i].commands_sent == 0 ||
+            contexts[i].commands_successful < contexts[i].commands_sent) {
+            all_ok = 0;
+        }
+    }
+    print_test_result("Shared reactor concurrency test", all_ok);
+    
+    obsws_reactor_destroy(reactor);
+    print_test_result("obsws_reactor_destroy()", 1);
+    
     return 1;
 }
 
@@ -1169,15 +1810,147 @@ static int test_error_handling(void) {
     }
     sleep_ms(500);
     
+    /* Test: Response larger than the 64KB baseline receive buffer */
+    char current_scene[256];
+    if (obsws_get_current_scene(g_main_connection, current_scene, sizeof(current_scene)) == OBSWS_OK) {
+        response = NULL;
+        snprintf(request_data, sizeof(request_data),
+                 "{\"sourceName\":\"%s\",\"imageFormat\":\"bmp\",\"imageWidth\":640}", current_scene);
+        err = obsws_send_request(g_main_connection, "GetSourceScreenshot", request_data, &response, 10000);
+        int large_ok = (err == OBSWS_OK && response && response->success &&
+                        response->response_data && strlen(response->response_data) > 65536);
+        print_test_result("Large response reassembly (> 64KB)", large_ok);
+        if (large_ok) {
+            printf("  Screenshot response: %zu bytes\n", strlen(response->response_data));
+        }
+        obsws_response_free(response);
+        sleep_ms(500);
+    }
+    
+    return 1;
+}
+
+/* ========================================================================
+ * SECTION 7: PERFORMANCE BENCHMARKS
+ * ======================================================================== */
+
+/**
+ * Microseconds on the monotonic clock
+ */
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Scene-switch round trips - the small request that dominates real traffic.
+ * Calls obsws_send_request() directly so the scene cache doesn't short-circuit
+ * anything, and reports throughput, latency percentiles and average frame size.
+ */
+static int test_performance_benchmarks(void) {
+    if (skip_benchmarks) {
+        printf("SKIPPED: Performance benchmarks (--skip-bench)\n");
+        return 1;
+    }
+    
+    print_section_header("Performance Benchmarks", 7);
+    
+    if (!g_main_connection) {
+        printf("ERROR: No active connection for benchmarks\n");
+        return 0;
+    }
+    
+    char **scenes = NULL;
+    size_t scene_count = 0;
+    char original_scene[256] = "";
+    obsws_get_current_scene(g_main_connection, original_scene, sizeof(original_scene));
+    if (obsws_get_scene_list(g_main_connection, &scenes, &scene_count) != OBSWS_OK || scene_count < 2) {
+        printf("  Need at least two scenes for the scene-switch benchmark - skipping\n");
+        obsws_free_scene_list(scenes, scene_count);
+        return 1;
+    }
+    
+    static uint64_t samples[BENCH_ITERATIONS];
+    obsws_stats_t before, after;
+    obsws_get_stats(g_main_connection, &before);
+    
+    int ok = 0;
+    uint64_t start = now_us();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        char request_data[512];
+        snprintf(request_data, sizeof(request_data), "{\"sceneName\":\"%s\"}", scenes[i % 2]);
+        
+        obsws_response_t *response = NULL;
+        uint64_t t0 = now_us();
+        obsws_error_t err = obsws_send_request(g_main_connection, "SetCurrentProgramScene",
+                                               request_data, &response, 5000);
+        samples[i] = now_us() - t0;
+        if (err == OBSWS_OK && response && response->success) {
+            ok++;
+        }
+        obsws_response_free(response);
+    }
+    uint64_t elapsed = now_us() - start;
+    obsws_get_stats(g_main_connection, &after);
+    
+    qsort(samples, BENCH_ITERATIONS, sizeof(samples[0]), compare_u64);
+    uint64_t sent = after.messages_sent - before.messages_sent;
+    
+    printf("  Scene switches:  %d/%d succeeded\n", ok, BENCH_ITERATIONS);
+    printf("  Throughput:      %.0f requests/s\n", BENCH_ITERATIONS * 1e6 / (double)(elapsed ? elapsed : 1));
+    printf("  Round trip:      p50 %lu us | p99 %lu us | max %lu us\n",
+           (unsigned long)samples[BENCH_ITERATIONS / 2],
+           (unsigned long)samples[(BENCH_ITERATIONS * 99) / 100],
+           (unsigned long)samples[BENCH_ITERATIONS - 1]);
+    printf("  Avg frame size:  %lu bytes\n",
+           sent ? (unsigned long)((after.bytes_sent - before.bytes_sent) / sent) : 0UL);
+    print_test_result("Scene-switch benchmark", ok == BENCH_ITERATIONS);
+    
+    /* Pipelined requests: keep a window of async requests in flight, which is
+       where per-request setup cost (allocation, lock init) shows up */
+    enum { BENCH_WINDOW = 32 };
+    int pipelined_ok = 0;
+    start = now_us();
+    for (int i = 0; i < BENCH_ITERATIONS; i += BENCH_WINDOW) {
+        obsws_future_t *window[BENCH_WINDOW] = {0};
+        int n = BENCH_ITERATIONS - i < BENCH_WINDOW ? BENCH_ITERATIONS - i : BENCH_WINDOW;
+        for (int k = 0; k < n; k++) {
+            obsws_send_request_async(g_main_connection, "GetVersion", NULL, 5000, NULL, NULL, &window[k]);
+        }
+        for (int k = 0; k < n; k++) {
+            const obsws_response_t *response = NULL;
+            if (window[k] && obsws_future_get(window[k], &response) == OBSWS_OK && response->success) {
+                pipelined_ok++;
+            }
+            obsws_future_free(window[k]);
+        }
+    }
+    elapsed = now_us() - start;
+    printf("  Pipelined (%d in flight): %.0f requests/s\n", BENCH_WINDOW,
+           BENCH_ITERATIONS * 1e6 / (double)(elapsed ? elapsed : 1));
+    print_test_result("Pipelined request benchmark", pipelined_ok == BENCH_ITERATIONS);
+    
+    if (original_scene[0]) {
+        obsws_set_current_scene(g_main_connection, original_scene, NULL);
+    }
+    obsws_free_scene_list(scenes, scene_count);
+    sleep_ms(500);
+    
     return 1;
 }
 
 /* ========================================================================
- * SECTION 7: CONNECTION LIFECYCLE AND CLEANUP
+ * SECTION 8: CONNECTION LIFECYCLE AND CLEANUP
  * ======================================================================== */
 
 static int test_connection_lifecycle(void) {
-    print_section_header("Connection Lifecycle and Cleanup", 7);
+    print_section_header("Connection Lifecycle and Cleanup", 8);
     
     if (g_main_connection) {
         /* Test: Get final stats before disconnect */
@@ -1221,6 +1994,7 @@ int main(int argc, char *argv[]) {
         {"skip-multi",     no_argument,       0,  0 },
         {"skip-batch",     no_argument,       0,  0 },
         {"skip-transforms", no_argument,      0,  0 },
+        {"skip-bench",     no_argument,       0,  0 },
         {"help",           no_argument,       0,  0 },
         {0, 0, 0, 0}
     };
@@ -1257,6 +2031,8 @@ int main(int argc, char *argv[]) {
                     skip_batch_requests = 1;
                 } else if (strcmp(long_options[option_index].name, "skip-transforms") == 0) {
                     skip_transform_tests = 1;
+                } else if (strcmp(long_options[option_index].name, "skip-bench") == 0) {
+                    skip_benchmarks = 1;
                 } else if (strcmp(long_options[option_index].name, "help") == 0) {
                     print_usage(argv[0]);
                     return 0;
@@ -1291,6 +2067,10 @@ int main(int argc, char *argv[]) {
         goto cleanup;
     }
     
+    if (!test_batch_encoding()) {
+        all_passed = 0;
+    }
+    
     if (!test_single_connection(obs_host, obs_port, obs_password)) {
         all_passed = 0;
         goto cleanup;
@@ -1315,6 +2095,10 @@ int main(int argc, char *argv[]) {
     if (!test_error_handling()) {
         all_passed = 0;
     }
+    
+    if (!test_performance_benchmarks()) {
+        all_passed = 0;
+    }
 
 cleanup:
     if (!test_connection_lifecycle()) {